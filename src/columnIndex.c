@@ -0,0 +1,337 @@
+/**
+ * @file
+ * @brief This file implements the secondary indexes on table columns.
+ *
+ * The skip list is ordered by value and then by key, so every record
+ * has exactly one node and ranges are read by walking the bottom
+ * level. The hash part is a chained table keyed on the bytes of the
+ * field, which doubles when it holds more records than buckets.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "columnIndex.h"
+#include "hashTable.h"
+
+/**
+ * @brief Returns the height of a new skip list node.
+ *
+ * Each level is kept with probability 1/4. The caller holds the index
+ * lock for writing.
+ */
+static int ci_randomLevel(ColumnIndex *index)
+{
+	int level = 1;
+	uint32_t x = index->random;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	index->random = x;
+	while (level < CI_MAX_LEVEL && (x & 3) == 0) {
+		level++;
+		x >>= 2;
+	}
+	return level;
+}
+
+/**
+ * @brief Orders skip list entries by value, then by key.
+ */
+static int ci_compare(SkipNode *node, int64_t number, const char *key)
+{
+	if (node->number != number)
+		return node->number < number ? -1 : 1;
+	return strcmp(node->key, key);
+}
+
+/**
+ * @brief Finds the last node before (number, key) on every level.
+ */
+static void ci_skipFind(ColumnIndex *index, int64_t number, const char *key, SkipNode **update)
+{
+	SkipNode *node = index->head;
+	int i;
+	for (i = index->level - 1; i >= 0; i--) {
+		while (node->next[i] != NULL && ci_compare(node->next[i], number, key) < 0)
+			node = node->next[i];
+		update[i] = node;
+	}
+}
+
+static int ci_skipInsert(ColumnIndex *index, int64_t number, const char *key)
+{
+	SkipNode *update[CI_MAX_LEVEL];
+	int level = ci_randomLevel(index);
+	int i;
+
+	SkipNode *node = (SkipNode *)malloc(sizeof(SkipNode) + sizeof(SkipNode *) * level);
+	if (node == NULL || (node->key = myStrDup(key)) == NULL) {
+		free(node);
+		return -1;
+	}
+	node->number = number;
+
+	ci_skipFind(index, number, key, update);
+	for (i = index->level; i < level; i++)
+		update[i] = index->head;
+	if (level > index->level)
+		index->level = level;
+	for (i = 0; i < level; i++) {
+		node->next[i] = update[i]->next[i];
+		update[i]->next[i] = node;
+	}
+	return 0;
+}
+
+static void ci_skipRemove(ColumnIndex *index, int64_t number, const char *key)
+{
+	SkipNode *update[CI_MAX_LEVEL];
+	int i;
+
+	ci_skipFind(index, number, key, update);
+	SkipNode *node = update[0]->next[0];
+	if (node == NULL || ci_compare(node, number, key) != 0)
+		return;
+
+	for (i = 0; i < index->level && update[i]->next[i] == node; i++)
+		update[i]->next[i] = node->next[i];
+	while (index->level > 1 && index->head->next[index->level - 1] == NULL)
+		index->level--;
+	free(node->key);
+	free(node);
+}
+
+/**
+ * @brief Returns the bytes of a field that the hash part looks at.
+ *
+ * A char field is compared up to its terminator rather than over the
+ * whole declared size, which is mostly padding for short values.
+ */
+static size_t ci_fieldLength(ColumnIndex *index, const char *field)
+{
+	if (index->type == COLUMN_CHAR)
+		return strlen(field) + 1;
+	return sizeof(int64_t);
+}
+
+/**
+ * @brief Finds the link to the node of (field, key) in the hash part.
+ */
+static IndexNode **ci_hashFind(ColumnIndex *index, uint64_t hash, const char *field, size_t length, const char *key)
+{
+	IndexNode **link = &index->buckets[hash & index->mask];
+	for (; *link != NULL; link = &(*link)->next) {
+		IndexNode *node = *link;
+		if (node->hash == hash && memcmp(node->field, field, length) == 0
+				&& strcmp(node->key, key) == 0)
+			break;
+	}
+	return link;
+}
+
+/**
+ * @brief Doubles the buckets of the hash part.
+ *
+ * Keeps the old buckets if out of memory; chains just get longer.
+ */
+static void ci_grow(ColumnIndex *index)
+{
+	uint32_t size = index->mask + 1;
+	IndexNode **buckets = (IndexNode **)calloc((size_t)size * 2, sizeof(IndexNode *));
+	if (buckets == NULL)
+		return;
+
+	uint32_t i;
+	for (i = 0; i < size; i++) {
+		IndexNode *node = index->buckets[i];
+		while (node != NULL) {
+			IndexNode *next = node->next;
+			IndexNode **bucket = &buckets[node->hash & (size * 2 - 1)];
+			node->next = *bucket;
+			*bucket = node;
+			node = next;
+		}
+	}
+	free(index->buckets);
+	index->buckets = buckets;
+	index->mask = size * 2 - 1;
+}
+
+ColumnIndex *ci_create(Schema *schema, int column)
+{
+	Column *col = &schema->columns[column];
+	ColumnIndex *index = (ColumnIndex *)calloc(1, sizeof(ColumnIndex));
+	if (index == NULL)
+		return NULL;
+
+	index->column = column;
+	index->type = col->type;
+	index->offset = col->offset;
+	index->fieldSize = col->type == COLUMN_INT ? (int)sizeof(int64_t) : col->size + 1;
+	index->level = 1;
+	index->random = 2463534242u;
+	index->mask = CI_MIN_BUCKETS - 1;
+	index->buckets = (IndexNode **)calloc(CI_MIN_BUCKETS, sizeof(IndexNode *));
+	if (col->type == COLUMN_INT)
+		index->head = (SkipNode *)calloc(1, sizeof(SkipNode) + sizeof(SkipNode *) * CI_MAX_LEVEL);
+	if (index->buckets == NULL || (col->type == COLUMN_INT && index->head == NULL)) {
+		free(index->buckets);
+		free(index->head);
+		free(index);
+		return NULL;
+	}
+	pthread_rwlock_init(&index->lock, NULL);
+	return index;
+}
+
+int ci_insert(ColumnIndex *index, const char *row, const char *key)
+{
+	const char *field = row + index->offset;
+	size_t length = ci_fieldLength(index, field);
+	uint64_t hash = ht_hashKey(field, length);
+	int status = 0;
+
+	IndexNode *node = (IndexNode *)malloc(sizeof(IndexNode) + length);
+	if (node == NULL || (node->key = myStrDup(key)) == NULL) {
+		free(node);
+		return -1;
+	}
+	node->hash = hash;
+	memcpy(node->field, field, length);
+
+	pthread_rwlock_wrlock(&index->lock);
+	if (index->head != NULL) {
+		int64_t number;
+		memcpy(&number, field, sizeof(number));
+		status = ci_skipInsert(index, number, key);
+	}
+	if (status == 0) {
+		IndexNode **bucket = &index->buckets[hash & index->mask];
+		node->next = *bucket;
+		*bucket = node;
+		if (++index->count > index->mask + 1)
+			ci_grow(index);
+	}
+	pthread_rwlock_unlock(&index->lock);
+
+	if (status != 0) {
+		free(node->key);
+		free(node);
+	}
+	return status;
+}
+
+void ci_remove(ColumnIndex *index, const char *row, const char *key)
+{
+	const char *field = row + index->offset;
+	size_t length = ci_fieldLength(index, field);
+	uint64_t hash = ht_hashKey(field, length);
+	IndexNode *found = NULL;
+
+	pthread_rwlock_wrlock(&index->lock);
+	if (index->head != NULL) {
+		int64_t number;
+		memcpy(&number, field, sizeof(number));
+		ci_skipRemove(index, number, key);
+	}
+
+	IndexNode **link = ci_hashFind(index, hash, field, length, key);
+	if (*link != NULL) {
+		found = *link;
+		*link = found->next;
+		index->count--;
+	}
+	pthread_rwlock_unlock(&index->lock);
+
+	if (found != NULL) {
+		free(found->key);
+		free(found);
+	}
+}
+
+bool ci_supports(ColumnIndex *index, const QueryStep *step)
+{
+	if (index == NULL || step->column != index->column)
+		return false;
+	if (step->op == '=')
+		return true;
+	return (step->op == '<' || step->op == '>') && index->head != NULL;
+}
+
+int ci_find(ColumnIndex *index, const QueryStep *step, char ***keys)
+{
+	int count = 0;
+	int capacity = 0;
+	int status = 0;
+	*keys = NULL;
+
+	pthread_rwlock_rdlock(&index->lock);
+	if (step->op == '=') {
+		/* The constant laid out as the field is in a row. */
+		const char *field = index->type == COLUMN_INT ? (const char *)&step->number : step->string;
+		size_t length = ci_fieldLength(index, field);
+		uint64_t hash = ht_hashKey(field, length);
+		IndexNode *node;
+		for (node = index->buckets[hash & index->mask]; node != NULL && status == 0; node = node->next) {
+			if (node->hash == hash && memcmp(node->field, field, length) == 0)
+				status = ht_collectKey(keys, &count, &capacity, node->key);
+		}
+	}
+	else {
+		SkipNode *node = index->head->next[0];
+		int i;
+
+		/* For '>', skip to the first value above the constant. */
+		if (step->op == '>') {
+			node = index->head;
+			for (i = index->level - 1; i >= 0; i--) {
+				while (node->next[i] != NULL && node->next[i]->number <= step->number)
+					node = node->next[i];
+			}
+			node = node->next[0];
+		}
+		for (; node != NULL && status == 0; node = node->next[0]) {
+			if (step->op == '<' && node->number >= step->number)
+				break;
+			status = ht_collectKey(keys, &count, &capacity, node->key);
+		}
+	}
+	pthread_rwlock_unlock(&index->lock);
+
+	if (status != 0) {
+		while (count > 0)
+			free((*keys)[--count]);
+		free(*keys);
+		*keys = NULL;
+		return -1;
+	}
+	return count;
+}
+
+void ci_destroy(ColumnIndex *index)
+{
+	uint32_t i;
+	for (i = 0; i <= index->mask; i++) {
+		IndexNode *node = index->buckets[i];
+		while (node != NULL) {
+			IndexNode *next = node->next;
+			free(node->key);
+			free(node);
+			node = next;
+		}
+	}
+	free(index->buckets);
+
+	if (index->head != NULL) {
+		SkipNode *node = index->head->next[0];
+		while (node != NULL) {
+			SkipNode *next = node->next[0];
+			free(node->key);
+			free(node);
+			node = next;
+		}
+		free(index->head);
+	}
+	pthread_rwlock_destroy(&index->lock);
+	free(index);
+}
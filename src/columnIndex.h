@@ -0,0 +1,120 @@
+/**
+ * @file
+ * @brief This file declares the secondary indexes on table columns.
+ *
+ * A column marked "indexed" in the configuration file gets a
+ * ColumnIndex mapping the column's value to the keys of the records
+ * holding it. The hash table keeps its indexes in step with every set
+ * and remove, and QUERY uses them to visit only candidate records.
+ *
+ * Every index has a hash part, answering '=' predicates on int and
+ * char columns. An index on an int column also has an ordered part, a
+ * skip list, answering '<' and '>' predicates.
+ */
+#ifndef COLUMN_INDEX
+#define COLUMN_INDEX
+
+#include <stdint.h>
+#include <pthread.h>
+#include "utils.h"
+#include "queryPlan.h"
+
+#define CI_MAX_LEVEL 24		///< Maximum height of a skip list node.
+#define CI_MIN_BUCKETS 64	///< Initial buckets of the hash part.
+
+/**
+ * @brief A record in the ordered part of an index.
+ */
+typedef struct skipNode {
+	int64_t number;		///< The value of the column.
+	char *key;		///< The key of the record.
+	struct skipNode *next[];	///< One link per level of the node.
+} SkipNode;
+
+/**
+ * @brief A record in the hash part of an index.
+ */
+typedef struct indexNode {
+	uint64_t hash;		///< Hash of the value of the column.
+	char *key;		///< The key of the record.
+	struct indexNode *next;
+	char field[];		///< The value of the column as stored in the row; for char, up to its terminator.
+} IndexNode;
+
+/**
+ * @brief A secondary index on one column of a table.
+ *
+ * All changes take the index lock for writing; lookups take it for
+ * reading and copy out the keys they find.
+ */
+typedef struct columnIndex {
+	int column;		///< Ordinal of the column in the schema.
+	int type;		///< COLUMN_INT or COLUMN_CHAR.
+	int offset;		///< Offset of the column's field in a row.
+	int fieldSize;		///< Bytes of the column's field in a row.
+	pthread_rwlock_t lock;
+
+	SkipNode *head;		///< For COLUMN_INT, the skip list head; NULL otherwise.
+	int level;		///< Levels in use in the skip list.
+	uint32_t random;	///< State of the generator of node heights.
+
+	IndexNode **buckets;
+	uint32_t mask;		///< Number of buckets minus one.
+	uint32_t count;		///< Number of records in the index.
+} ColumnIndex;
+
+/**
+ * @brief Create an empty index on a column.
+ *
+ * @param schema The schema of the table.
+ * @param column The ordinal of the column.
+ * @return Returns the index, or NULL if out of memory.
+ */
+ColumnIndex *ci_create(Schema *schema, int column);
+
+/**
+ * @brief Add a record to an index.
+ *
+ * @param index The index.
+ * @param row The typed row of the record.
+ * @param key The key of the record.
+ * @return Returns 0 on success, -1 if out of memory.
+ */
+int ci_insert(ColumnIndex *index, const char *row, const char *key);
+
+/**
+ * @brief Remove a record from an index.
+ *
+ * @param index The index.
+ * @param row The typed row the record was added with.
+ * @param key The key of the record.
+ */
+void ci_remove(ColumnIndex *index, const char *row, const char *key);
+
+/**
+ * @brief Tell whether an index can answer a step of a plan.
+ *
+ * @param index The index, or NULL.
+ * @param step The step.
+ * @return true if the index holds exactly the records the step can match.
+ */
+bool ci_supports(ColumnIndex *index, const QueryStep *step);
+
+/**
+ * @brief Find the keys of the records that may match a step.
+ *
+ * @param index The index.
+ * @param step A step the index supports.
+ * @param keys Set to a malloc'ed array of copies of the keys; free both.
+ * @return Returns the number of keys, or -1 if out of memory.
+ */
+int ci_find(ColumnIndex *index, const QueryStep *step, char ***keys);
+
+/**
+ * @brief Free an index.
+ *
+ * @param index The index.
+ */
+void ci_destroy(ColumnIndex *index);
+
+#endif
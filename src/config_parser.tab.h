@@ -1,21 +1,22 @@
-/* A Bison parser, made by GNU Bison 2.5.  */
+/* A Bison parser, made by GNU Bison 3.8.2.  */
 
 /* Bison interface for Yacc-like parsers in C
-   
-      Copyright (C) 1984, 1989-1990, 2000-2011 Free Software Foundation, Inc.
-   
+
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
+   Inc.
+
    This program is free software: you can redistribute it and/or modify
    it under the terms of the GNU General Public License as published by
    the Free Software Foundation, either version 3 of the License, or
    (at your option) any later version.
-   
+
    This program is distributed in the hope that it will be useful,
    but WITHOUT ANY WARRANTY; without even the implied warranty of
    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
    GNU General Public License for more details.
-   
+
    You should have received a copy of the GNU General Public License
-   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
 
 /* As a special exception, you may create a larger work that contains
    part or all of the Bison parser skeleton and distribute that work
@@ -26,57 +27,82 @@
    special exception, which will cause the skeleton and the resulting
    Bison output files to be licensed under the GNU General Public
    License without this special exception.
-   
+
    This special exception was added by the Free Software Foundation in
    version 2.2 of Bison.  */
 
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
+
+#ifndef YY_YY_CONFIG_PARSER_TAB_H_INCLUDED
+# define YY_YY_CONFIG_PARSER_TAB_H_INCLUDED
+/* Debug traces.  */
+#ifndef YYDEBUG
+# define YYDEBUG 0
+#endif
+#if YYDEBUG
+extern int yydebug;
+#endif
 
-/* Tokens.  */
+/* Token kinds.  */
 #ifndef YYTOKENTYPE
 # define YYTOKENTYPE
-   /* Put the tokens into the symbol table, so that GDB and other debuggers
-      know about them.  */
-   enum yytokentype {
-     STRING = 258,
-     SIZE = 259,
-     CHAR = 260,
-     INT = 261,
-     passString = 262,
-     NUMBER = 263,
-     HOST_PROPERTY = 264,
-     PORT_PROPERTY = 265,
-     DDIR_PROPERTY = 266,
-     TABLE = 267,
-     USER_NAME = 268,
-     PASSWORD = 269,
-     NEWLINE = 270,
-     TABLE_INVALID = 271,
-     CONCURRENCY = 272
-   };
+  enum yytokentype
+  {
+    YYEMPTY = -2,
+    YYEOF = 0,                     /* "end of file"  */
+    YYerror = 256,                 /* error  */
+    YYUNDEF = 257,                 /* "invalid token"  */
+    STRING = 258,                  /* STRING  */
+    SIZE = 259,                    /* SIZE  */
+    CHAR = 260,                    /* CHAR  */
+    INT = 261,                     /* INT  */
+    passString = 262,              /* passString  */
+    PATH = 263,                    /* PATH  */
+    NUMBER = 264,                  /* NUMBER  */
+    HOST_PROPERTY = 265,           /* HOST_PROPERTY  */
+    PORT_PROPERTY = 266,           /* PORT_PROPERTY  */
+    DDIR_PROPERTY = 267,           /* DDIR_PROPERTY  */
+    TABLE = 268,                   /* TABLE  */
+    USER_NAME = 269,               /* USER_NAME  */
+    PASSWORD = 270,                /* PASSWORD  */
+    NEWLINE = 271,                 /* NEWLINE  */
+    TABLE_INVALID = 272,           /* TABLE_INVALID  */
+    CONCURRENCY = 273,             /* CONCURRENCY  */
+    WORKER_THREADS = 274,          /* WORKER_THREADS  */
+    BUCKETS = 275,                 /* BUCKETS  */
+    ENGINE = 276,                  /* ENGINE  */
+    INDEXED = 277,                 /* INDEXED  */
+    PARALLEL_SCAN_THRESHOLD = 278, /* PARALLEL_SCAN_THRESHOLD  */
+    DURABILITY = 279,              /* DURABILITY  */
+    SNAPSHOT_INTERVAL = 280        /* SNAPSHOT_INTERVAL  */
+  };
+  typedef enum yytokentype yytoken_kind_t;
 #endif
 
-
-
+/* Value type.  */
 #if ! defined YYSTYPE && ! defined YYSTYPE_IS_DECLARED
-typedef union YYSTYPE
+union YYSTYPE
 {
-
-/* Line 2068 of yacc.c  */
-#line 23 "config_parser.y"
+#line 30 "config_parser.y"
 
 	char *sval;	//String value (user defined)
 	int pval;	// Port number value (user defined)
 
+#line 94 "config_parser.tab.h"
 
-
-/* Line 2068 of yacc.c  */
-#line 74 "config_parser.tab.h"
-} YYSTYPE;
+};
+typedef union YYSTYPE YYSTYPE;
 # define YYSTYPE_IS_TRIVIAL 1
-# define yystype YYSTYPE /* obsolescent; will be withdrawn */
 # define YYSTYPE_IS_DECLARED 1
 #endif
 
+
 extern YYSTYPE yylval;
 
 
+int yyparse (void);
+
+
+#endif /* !YY_YY_CONFIG_PARSER_TAB_H_INCLUDED  */
@@ -4,6 +4,7 @@
 #include "utils.h"
 #include "storage.h"
 #include "hashTable.h"
+#include "wal.h"
 
 struct configuration {
 	char *host;
@@ -18,6 +19,12 @@ struct configuration {
 struct config_params params;
 struct config_params census_params;
 HashTable *ourHashTable[MAX_TABLES];
+
+void updateTableName(char *table_name, int size, int engine);
+void updateTableChar(char *column_name, char *size, int indexed);
+void updateTableInt(char *column_name, int indexed);
+
+static int columnCount;	// Columns of the table being parsed so far.
 %}
 
 %union {
@@ -25,9 +32,11 @@ HashTable *ourHashTable[MAX_TABLES];
 	int pval;	// Port number value (user defined)
 }
 
-%token <sval> STRING SIZE CHAR INT passString
+%token <sval> STRING SIZE CHAR INT passString PATH
 %token <pval> NUMBER
-%token HOST_PROPERTY PORT_PROPERTY DDIR_PROPERTY TABLE USER_NAME PASSWORD NEWLINE TABLE_INVALID CONCURRENCY
+%token HOST_PROPERTY PORT_PROPERTY DDIR_PROPERTY TABLE USER_NAME PASSWORD NEWLINE TABLE_INVALID CONCURRENCY WORKER_THREADS BUCKETS ENGINE INDEXED PARALLEL_SCAN_THRESHOLD DURABILITY SNAPSHOT_INTERVAL
+%type <pval> buckets engine indexed
+%type <sval> path
 
 %%
 
@@ -42,6 +51,11 @@ line    : serverhost NEWLINE
 		| username NEWLINE		
 		| password NEWLINE
 		| concurrency NEWLINE	 				
+		| workerthreads NEWLINE
+		| parallelscan NEWLINE
+		| datadir NEWLINE
+		| durability NEWLINE
+		| snapshotinterval NEWLINE
 		| NEWLINE 
 		;
 
@@ -74,34 +88,99 @@ concurrency: CONCURRENCY NUMBER     {
 									params.concurrencyMode = $2;
 									}
 
+workerthreads: WORKER_THREADS NUMBER {
+									params.workerThreads = $2;
+									}
+
+parallelscan: PARALLEL_SCAN_THRESHOLD NUMBER {
+									params.parallelScanThreshold = $2;
+									}
+
+datadir: DDIR_PROPERTY path			{
+									if (strlen($2) >= MAX_PATH_LEN) {
+										free($2);
+										return -1;
+									}
+									strcpy(params.data_directory, $2);
+									free($2);
+									}
+
+path	: PATH
+		| STRING
+		| passString
+		;
+
+durability: DURABILITY NUMBER		{
+									params.durability = $2;
+									}
+		| DURABILITY STRING			{
+									if (strcmp($2, "none") == 0)
+										params.durability = WAL_SYNC_NONE;
+									else if (strcmp($2, "commit") == 0)
+										params.durability = WAL_SYNC_COMMIT;
+									else {
+										free($2);
+										return -1;
+									}
+									free($2);
+									}
+		;
+
+snapshotinterval: SNAPSHOT_INTERVAL NUMBER {
+									params.snapshotInterval = $2;
+									}
+		;
+
 
-table : TABLE STRING exp  {	if (params.table_number >= MAX_TABLES) return -1;
+table : TABLE STRING exp buckets engine {	if (params.table_number >= MAX_TABLES || $4 < 1) return -1;
 							int table_index = isTableNameExist ($2, &params);
 							if (table_index != -1) {
 							return -1;
 							free($2);
 							}
 							printf("table number is %d\n", params.table_number);
-							 updateTableName ($2);  
+							 updateTableName ($2, $4, $5);  
 							free($2);}
 		;
 
+buckets : /* empty */				{ $$ = HT_DEFAULT_SIZE; }
+		| BUCKETS NUMBER			{ $$ = $2; }
+		;
+
+engine	: /* empty */				{ $$ = HT_ENGINE_CHAINED; }
+		| ENGINE STRING				{
+									if (strcmp($2, "chained") == 0)
+										$$ = HT_ENGINE_CHAINED;
+									else if (strcmp($2, "open") == 0)
+										$$ = HT_ENGINE_OPEN;
+									else {
+										free($2);
+										return -1;
+									}
+									free($2);
+									}
+		;
+
 
 exp   : term	
 	  | exp ',' term  
 	  ;	
 
-term	: STRING ':' CHAR SIZE 		{updateTableChar ($1,$4);
+term	: STRING ':' CHAR SIZE indexed	{updateTableChar ($1,$4,$5);
 									//free($4);
 									free($1);
 									//free($3);
 									}
-		| STRING ':' INT			{ 
-									updateTableInt ($1);
+		| STRING ':' INT indexed	{ 
+									updateTableInt ($1, $4);
 									//free($3);
 									free($1);}
 		;  
 
+indexed	: /* empty */				{ $$ = 0; }
+		| INDEXED					{ $$ = 1; }
+		;
+
 %%
 
 int parse (char * config_file, struct config_params* params ) {
@@ -132,31 +211,40 @@ void yyerror (char *s) {fprintf (stderr, "%s\n", s);}
 
 
 
-void updateTableName(char *table_name)
+void updateTableName(char *table_name, int size, int engine)
 {
 
 	strcpy(params.table_names[params.table_number].tablename, table_name);
-	ourHashTable[params.table_number] = ht_create(2000);
+	ourHashTable[params.table_number] = ht_createEngine(size, engine);
+	if (ourHashTable[params.table_number] != NULL)
+		ourHashTable[params.table_number]->schema = &params.table_names[params.table_number].schema;
 	params.table_number ++;
+	columnCount = 0;
 
 }
 
-void updateTableChar(char *column_name, char *size) {
+void updateTableChar(char *column_name, char *size, int indexed) {
 
 	char temp_pointer[MAX_STRING_SIZE];
 	snprintf(temp_pointer, sizeof temp_pointer, "%s#char#%s#",column_name, size);
 
 	char *temp = params.table_names[params.table_number].column_info;
 	temp = strcat(temp, temp_pointer);
+	if (indexed && columnCount < MAX_COLUMNS_PER_TABLE)
+		params.table_names[params.table_number].indexedColumns |= 1u << columnCount;
+	columnCount++;
 
 }
 
-void updateTableInt(char *column_name) {
+void updateTableInt(char *column_name, int indexed) {
 	char temp_pointer[MAX_STRING_SIZE];
 	snprintf(temp_pointer, sizeof temp_pointer, "%s#int#",column_name);
 
 	char *temp = params.table_names[params.table_number].column_info;
 	temp = strcat(temp, temp_pointer);
+	if (indexed && columnCount < MAX_COLUMNS_PER_TABLE)
+		params.table_names[params.table_number].indexedColumns |= 1u << columnCount;
+	columnCount++;
 	
 }
 
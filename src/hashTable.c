@@ -9,7 +9,53 @@
  * Additional features and modifications were made the ECE297 team.
  * 
  */
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
 #include "hashTable.h"
+#include "openTable.h"
+#include "workQueue.h"
+
+#define HT_WY0 0xa0761d6478bd642fULL
+#define HT_WY1 0xe7037ed1a0b428dbULL
+
+/* Random per process, so clients cannot choose keys that share a bucket. */
+static uint64_t ht_seed;
+static pthread_once_t ht_seedOnce = PTHREAD_ONCE_INIT;
+static void ht_initSeed( void );
+
+/* Parallel scans; see ht_startParallelScan(). */
+static WorkQueue *ht_scanQueue;
+static int ht_scanParts;
+static int ht_scanThreshold;
+static int ht_scanStripes( HashTable *hashtable, QueryPlan *plan, int first, int last, KeySink *sink );
+static int ht_parallelQuery( HashTable *hashtable, QueryPlan *plan, KeySink *sink );
+
+/**
+ * @brief A parallel scan in progress.
+ */
+typedef struct scan {
+	pthread_mutex_t lock;
+	pthread_cond_t done;
+	int pending;		///< Parts not finished yet.
+} Scan;
+
+/**
+ * @brief One part of a parallel scan: a range of lock stripes, or of
+ * shards for an open table.
+ */
+typedef struct scanPart {
+	HashTable *hashtable;
+	QueryPlan *plan;
+	int first;
+	int last;		///< One past the last stripe or shard.
+	KeySink sink;		///< Keeps the keys found in keysFound, by ht_partKey().
+	char **keysFound;	///< Copies of the first matching keys, as many as the query sends.
+	int numKept;
+	int capacity;
+	int numKeysFound;	///< Number of matching records.
+	Scan *scan;
+} ScanPart;
 /**
  * @brief Creates a copy of a given string.
  *
@@ -29,32 +75,164 @@ char *myStrDup (const char *s) {
 /**
  * @brief Creates the hash table data structure.
  *
- * @param size The size of the hash table.
+ * @param size The initial number of buckets; rounded up to a power of two of at least HT_LOCK_STRIPES.
  * @return Returns a pointer to the created hash table if successful, NULL otherwise.
  */
 HashTable *ht_create( int size ) {
+	return ht_createEngine( size, HT_ENGINE_CHAINED );
+}
+
+/**
+ * @brief Creates a hash table stored by the given engine.
+ *
+ * @param size The initial number of buckets, or for HT_ENGINE_OPEN the expected number of records.
+ * @param engine HT_ENGINE_CHAINED or HT_ENGINE_OPEN.
+ * @return Returns a pointer to the created hash table if successful, NULL otherwise.
+ */
+HashTable *ht_createEngine( int size, int engine ) {
 	HashTable *hashtable = NULL;
 	int i;
+	int buckets = HT_LOCK_STRIPES;
  
-	if( size < 1 ) return NULL;
+	if( size < 1 || size > INT_MAX / 2 ) return NULL;
+	if( engine != HT_ENGINE_CHAINED && engine != HT_ENGINE_OPEN ) return NULL;
+	while( buckets < size )
+		buckets *= 2;
+	size = buckets;
+	pthread_once( &ht_seedOnce, ht_initSeed );
  
 	/* Allocate the table itself. */
 	if( ( hashtable = malloc( sizeof( HashTable ) ) ) == NULL ) {
 		return NULL;
 	}
- 
+	hashtable->engine = engine;
+	hashtable->schema = NULL;
+	memset( hashtable->indexes, 0, sizeof( hashtable->indexes ) );
+	hashtable->open = NULL;
+	hashtable->table = NULL;
+
+	if( engine == HT_ENGINE_OPEN ) {
+		hashtable->open = ot_create( size );
+		if( hashtable->open == NULL ) {
+			free( hashtable );
+			return NULL;
+		}
+		hashtable->open->owner = hashtable;
+
 	/* Allocate pointers to the head nodes. */
-	if( ( hashtable->table = malloc( sizeof( Entry * ) * size ) ) == NULL ) {
+	} else if( ( hashtable->table = calloc( size, sizeof( Entry * ) ) ) == NULL ) {
+		free( hashtable );
 		return NULL;
 	}
-	for( i = 0; i < size; i++ ) {
-		hashtable->table[i] = NULL;
-	}
 	hashtable->size = size;
+	hashtable->oldTable = NULL;
+	hashtable->oldSize = 0;
+	hashtable->rehashIndex = 0;
+	hashtable->rehashDone = 0;
+	hashtable->count = 0;
+	slab_init( &hashtable->slab );
+
+	pthread_rwlock_init( &hashtable->resizeLock, NULL );
+	for( i = 0; i < HT_LOCK_STRIPES; i++ ) {
+		pthread_rwlock_init( &hashtable->locks[i], NULL );
+		zm_reset( &hashtable->zones[i] );
+	}
  
 	return hashtable;	
 }
- 
+
+/**
+ * @brief Picks the hash seed, once per process.
+ */
+static void ht_initSeed( void ) {
+	int fd = open( "/dev/urandom", O_RDONLY );
+	if( fd < 0 || read( fd, &ht_seed, sizeof( ht_seed ) ) != sizeof( ht_seed ) )
+		ht_seed = (uint64_t) time( NULL ) ^ ( (uint64_t) getpid() << 32 );
+	if( fd >= 0 )
+		close( fd );
+}
+
+/**
+ * @brief Multiplies two words and folds the 128-bit product.
+ */
+static uint64_t ht_mix( uint64_t a, uint64_t b ) {
+	__uint128_t product = (__uint128_t) a * b;
+	return (uint64_t) product ^ (uint64_t) ( product >> 64 );
+}
+
+static uint64_t ht_read8( const unsigned char *p ) {
+	uint64_t v;
+	memcpy( &v, p, 8 );
+	return v;
+}
+
+static uint64_t ht_read4( const unsigned char *p ) {
+	uint32_t v;
+	memcpy( &v, p, 4 );
+	return v;
+}
+
+/**
+ * @brief Returns the full hash value of a key.
+ *
+ * A seeded hash in the style of wyhash: the key is read eight or
+ * sixteen bytes at a time and folded with 64x64->128 bit multiplies.
+ * Every bit of the result depends on every byte of the key, so bucket
+ * indexes can simply take the low bits.
+ *
+ * @param key The key to hash.
+ * @param len The length of the key.
+ * @return Returns the hash value, before reduction to a bucket index.
+ */
+uint64_t ht_hashKey( const char *key, size_t len ) {
+	const unsigned char *p = (const unsigned char *) key;
+	uint64_t seed = ht_seed ^ ht_mix( ht_seed ^ HT_WY0, HT_WY1 );
+	uint64_t a, b;
+
+	if( len <= 16 ) {
+		if( len >= 4 ) {
+			a = ( ht_read4( p ) << 32 ) | ht_read4( p + ( ( len >> 3 ) << 2 ) );
+			b = ( ht_read4( p + len - 4 ) << 32 ) | ht_read4( p + len - 4 - ( ( len >> 3 ) << 2 ) );
+		} else if( len > 0 ) {
+			a = ( (uint64_t) p[0] << 16 ) | ( (uint64_t) p[len >> 1] << 8 ) | p[len - 1];
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		size_t i = len;
+		while( i > 16 ) {
+			seed = ht_mix( ht_read8( p ) ^ HT_WY1, ht_read8( p + 8 ) ^ seed );
+			p += 16;
+			i -= 16;
+		}
+		a = ht_read8( p + i - 16 );
+		b = ht_read8( p + i - 8 );
+	}
+
+	return ht_mix( HT_WY1 ^ len, ht_mix( a ^ HT_WY1, b ^ seed ) );
+}
+
+/**
+ * @brief Returns the lock guarding a key or bucket.
+ *
+ * Bucket counts are powers of two of at least HT_LOCK_STRIPES, so a
+ * hash value and every bucket it can be stored in map to the same lock.
+ *
+ * @param hashtable A pointer to the hash table.
+ * @param hashval The hash value of a key, or a bucket index.
+ * @return Returns a pointer to the reader-writer lock.
+ */
+static pthread_rwlock_t *ht_lock( HashTable *hashtable, uint64_t hashval ) {
+	return &hashtable->locks[ hashval & ( HT_LOCK_STRIPES - 1 ) ];
+}
+
+/**
+ * @brief Returns the zone map of the stripe a hash value falls in.
+ */
+static ZoneMap *ht_zone( HashTable *hashtable, uint64_t hashval ) {
+	return &hashtable->zones[ hashval & ( HT_LOCK_STRIPES - 1 ) ];
+}
 
 /**
  * @brief Returns the hashing index 
@@ -64,133 +242,465 @@ HashTable *ht_create( int size ) {
  * @return Returns an integer hashing index which is used to locate a specific key.
  */
 int ht_hash( HashTable *hashtable,  char *key ) {
-
-	unsigned long int hashval;
-	hashval = 0;
-	int length = strlen( key );
-	int i = 0;
-	for (i = 0; i < length; i++)
- 		hashval = hashval * 127 + key[i];
- 	
-	return hashval % hashtable->size;
+	return ht_hashKey( key, strlen( key ) ) & ( hashtable->size - 1 );
 }
  
-
 /**
  * @brief Creates a pairing of Key and Value.
  *
+ * The entry, the key and the value are copied into one block of the
+ * table's slab; the rest of the block is room for the value to grow.
+ *
+ * @param hashtable A pointer to the hash table the entry is for.
  * @param key The string that saves the key.
  * @param value The string that saves the value.
+ * @param hash The hash value of the key.
  * @return Returns an Entry struct that contains a key and a value.
  */
-Entry *ht_newpair( char *key, char *value ) {
+Entry *ht_newpair( HashTable *hashtable, char *key, char *value, uint64_t hash ) {
 	Entry *newpair;
- 
- 	/* Create a new Entry to store a key and value */
-	if( ( newpair = malloc( sizeof( Entry ) ) ) == NULL ) {
-		return NULL;
-	}
- 
- 	/* A pointer to a new char* is returned containing a copy of the input string */
-	if( ( newpair->key = myStrDup(key ) ) == NULL ) {
+	size_t keyLen = strlen( key ) + 1;
+	size_t valueLen = strlen( value ) + 1;
+	size_t size = slab_blockSize( sizeof( Entry ) + keyLen + valueLen );
+
+	if( size > UINT32_MAX )
 		return NULL;
-	}
  
- 	/* A pointer to a new char* is returned containing a copy of the input string */
-	if( ( newpair->value = myStrDup(value ) ) == NULL ) {
+ 	/* Create a new Entry to store a key and value */
+	if( ( newpair = slab_alloc( &hashtable->slab, size ) ) == NULL ) {
 		return NULL;
 	}
+	newpair->key = (char *)( newpair + 1 );
+	newpair->value = newpair->key + keyLen;
+	newpair->size = (uint32_t) size;
+	memcpy( newpair->key, key, keyLen );
+	memcpy( newpair->value, value, valueLen );
  
  	/*When creating the new data initialize the metadata to */
  	newpair-> metadata = rand();
+	newpair->hash = hash;
+	newpair->row = NULL;
 	newpair->next = NULL;
  
 	return newpair;
 }
  
 
+
+/**
+ * @brief Tells whether a new value of an entry fits in its block, or in
+ * the block its old value was moved to.
+ *
+ * @param entry The entry.
+ * @param valueLen The size of the new value, with its terminating null.
+ * @return Returns true if ht_storeValue() needs no block for it.
+ */
+static bool ht_valueFits( Entry *entry, size_t valueLen ) {
+	char *inlineValue = entry->key + strlen( entry->key ) + 1;
+
+	if( valueLen <= (size_t) ( (char *) entry + entry->size - inlineValue ) )
+		return true;
+	return entry->value != inlineValue
+			&& slab_blockSize( strlen( entry->value ) + 1 ) == slab_blockSize( valueLen );
+}
+
+/**
+ * @brief Replaces the value of an entry, in its block if it fits.
+ *
+ * @param hashtable A pointer to the hash table of the entry.
+ * @param entry The entry.
+ * @param value The new value.
+ * @param copy Unless ht_valueFits(), a block of the table's slab with
+ * room for the value, allocated beforehand so nothing can fail here.
+ */
+static void ht_storeValue( HashTable *hashtable, Entry *entry, const char *value, char *copy ) {
+	size_t valueLen = strlen( value ) + 1;
+	char *inlineValue = entry->key + strlen( entry->key ) + 1;
+
+	if( valueLen <= (size_t) ( (char *) entry + entry->size - inlineValue ) ) {
+		if( entry->value != inlineValue )
+			slab_free( &hashtable->slab, entry->value, strlen( entry->value ) + 1 );
+		memcpy( inlineValue, value, valueLen );
+		entry->value = inlineValue;
+	} else if( copy == NULL ) {
+		memcpy( entry->value, value, valueLen );
+	} else {
+		memcpy( copy, value, valueLen );
+		if( entry->value != inlineValue )
+			slab_free( &hashtable->slab, entry->value, strlen( entry->value ) + 1 );
+		entry->value = copy;
+	}
+}
+
+/**
+ * @brief Returns an entry, its value and its row to the table's slab.
+ *
+ * @param hashtable A pointer to the hash table of the entry.
+ * @param entry The entry, unlinked.
+ */
+static void ht_freeEntry( HashTable *hashtable, Entry *entry ) {
+	if( entry->value != entry->key + strlen( entry->key ) + 1 )
+		slab_free( &hashtable->slab, entry->value, strlen( entry->value ) + 1 );
+	if( entry->row != NULL )
+		slab_free( &hashtable->slab, entry->row, hashtable->schema->rowSize );
+	slab_free( &hashtable->slab, entry, entry->size );
+}
+
+/**
+ * @brief Finds the place of a key in a sorted chain.
+ *
+ * Chains are ordered by hash value and then by key, so the key strings
+ * are only compared when the hash values are equal.
+ *
+ * @param head The head link of the chain.
+ * @param hashval The hash value of the key.
+ * @param key The key to look for.
+ * @return Returns the link that points to the entry with the key, or
+ * to where such an entry would be inserted.
+ */
+static Entry **ht_chainFind( Entry **head, uint64_t hashval, char *key ) {
+	Entry **link = head;
+	while( *link != NULL && ( (*link)->hash < hashval
+			|| ( (*link)->hash == hashval && strcmp( key, (*link)->key ) > 0 ) ) ) {
+		link = &(*link)->next;
+	}
+	return link;
+}
+
+/**
+ * @brief Tells whether an entry holds the given key.
+ */
+static bool ht_matches( Entry *entry, uint64_t hashval, char *key ) {
+	return entry != NULL && entry->hash == hashval && strcmp( key, entry->key ) == 0;
+}
+
+/**
+ * @brief Finds a key in either bucket array.
+ *
+ * The caller holds the key's stripe lock.
+ *
+ * @param hashtable A pointer to the hash table.
+ * @param hashval The hash value of the key.
+ * @param key The key to look for.
+ * @return Returns the link that points to the entry with the key, or to
+ * where a new entry belongs in the current bucket array.
+ */
+static Entry **ht_locate( HashTable *hashtable, uint64_t hashval, char *key ) {
+	Entry **link;
+
+	/* Not yet migrated entries are still in the old buckets. */
+	if( hashtable->oldTable != NULL ) {
+		link = ht_chainFind( &hashtable->oldTable[ hashval & ( hashtable->oldSize - 1 ) ], hashval, key );
+		if( ht_matches( *link, hashval, key ) )
+			return link;
+	}
+
+	return ht_chainFind( &hashtable->table[ hashval & ( hashtable->size - 1 ) ], hashval, key );
+}
+
+/**
+ * @brief Moves a few old buckets into the current bucket array.
+ *
+ * Called by every get and set while the table grows, so the cost of
+ * rehashing is spread over many operations. The caller holds
+ * resizeLock shared and no stripe lock.
+ *
+ * @param hashtable A pointer to the hash table.
+ */
+static void ht_rehashStep( HashTable *hashtable ) {
+	int i;
+	for( i = 0; i < HT_REHASH_STEP; i++ ) {
+		int bin = __sync_fetch_and_add( &hashtable->rehashIndex, 1 );
+		if( bin >= hashtable->oldSize )
+			return;
+
+		/* Every entry of the old bucket and its new bucket share this lock. */
+		pthread_rwlock_wrlock( ht_lock( hashtable, bin ) );
+		Entry *entry = hashtable->oldTable[ bin ];
+		hashtable->oldTable[ bin ] = NULL;
+		while( entry != NULL ) {
+			Entry *next = entry->next;
+			Entry **link = ht_chainFind( &hashtable->table[ entry->hash & ( hashtable->size - 1 ) ], entry->hash, entry->key );
+			entry->next = *link;
+			*link = entry;
+			entry = next;
+		}
+		pthread_rwlock_unlock( ht_lock( hashtable, bin ) );
+
+		__sync_fetch_and_add( &hashtable->rehashDone, 1 );
+	}
+}
+
+/**
+ * @brief Tells whether the bucket arrays need to be swapped.
+ *
+ * The caller holds resizeLock shared.
+ *
+ * @param hashtable A pointer to the hash table.
+ * @return Returns true if the table should start or finish growing.
+ */
+static bool ht_needsResize( HashTable *hashtable ) {
+	if( hashtable->oldTable != NULL )
+		return __atomic_load_n( &hashtable->rehashDone, __ATOMIC_RELAXED ) >= hashtable->oldSize;
+	return __atomic_load_n( &hashtable->count, __ATOMIC_RELAXED ) > hashtable->size * HT_MAX_LOAD;
+}
+
+/**
+ * @brief Starts or finishes growing the table.
+ *
+ * Takes resizeLock exclusively, but only to swap or free a bucket
+ * array; the entries are moved later by ht_rehashStep().
+ *
+ * @param hashtable A pointer to the hash table.
+ */
+static void ht_resize( HashTable *hashtable ) {
+	pthread_rwlock_wrlock( &hashtable->resizeLock );
+
+	/* Every old bucket has been migrated. */
+	if( hashtable->oldTable != NULL && hashtable->rehashDone >= hashtable->oldSize ) {
+		free( hashtable->oldTable );
+		hashtable->oldTable = NULL;
+		hashtable->oldSize = 0;
+	}
+
+	/* Too many entries per bucket: start migrating to twice as many buckets. */
+	if( hashtable->oldTable == NULL && hashtable->count > hashtable->size * HT_MAX_LOAD ) {
+		Entry **table = calloc( (size_t) hashtable->size * 2, sizeof( Entry * ) );
+		if( table != NULL ) {
+			hashtable->oldTable = hashtable->table;
+			hashtable->oldSize = hashtable->size;
+			hashtable->table = table;
+			hashtable->size *= 2;
+			hashtable->rehashIndex = 0;
+			hashtable->rehashDone = 0;
+		}
+	}
+
+	pthread_rwlock_unlock( &hashtable->resizeLock );
+}
+
+/**
+ * @brief Creates the secondary indexes of the indexed columns of the schema.
+ *
+ * Called once the schema is known and before any record is stored.
+ *
+ * @param hashtable A pointer to the hash table.
+ * @return Returns 0 on success, -1 if out of memory.
+ */
+int ht_createIndexes( HashTable *hashtable ) {
+	int i;
+	for( i = 0; hashtable->schema != NULL && i < hashtable->schema->numColumns; i++ ) {
+		if( !hashtable->schema->columns[i].indexed || hashtable->indexes[i] != NULL )
+			continue;
+		if( ( hashtable->indexes[i] = ci_create( hashtable->schema, i ) ) == NULL )
+			return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Moves a record between the entries of the secondary indexes.
+ *
+ * The caller holds the record's write lock, so the indexes change in
+ * the same order as the record.
+ *
+ * @param hashtable A pointer to the hash table.
+ * @param key The key of the record.
+ * @param oldRow The row the record had, or NULL if it was absent or untyped.
+ * @param newRow The row the record gets, or NULL if it is removed or untyped.
+ */
+void ht_indexRecord( HashTable *hashtable, const char *key, const char *oldRow, const char *newRow ) {
+	int i;
+	for( i = 0; hashtable->schema != NULL && i < hashtable->schema->numColumns; i++ ) {
+		ColumnIndex *index = hashtable->indexes[i];
+		if( index == NULL )
+			continue;
+		/* The field did not change. */
+		if( oldRow != NULL && newRow != NULL
+				&& memcmp( oldRow + index->offset, newRow + index->offset, index->fieldSize ) == 0 )
+			continue;
+		if( oldRow != NULL )
+			ci_remove( index, oldRow, key );
+		if( newRow != NULL )
+			ci_insert( index, newRow, key );
+	}
+}
+
 /**
  * @brief Sets the Key and Value into the hashtable.
  *
  * @param hashtable A pointer to the hash table.
  * @param key The string that stores the key.
  * @param value The string that stores the value.
- * @return No return value.
+ * @return Returns HASH_SET_INSERT, HASH_SET_UPDATE or HASH_SET_FAIL.
  */
 int ht_set( HashTable *hashtable, char *key, char *value ) {
-	int bin = 0;
+	return ht_setVersion( hashtable, key, value, NULL, 0, NULL );
+}
+
+/**
+ * @brief Sets the Key and Value if the record still has the given metadata.
+ *
+ * The check and the update happen under the key's write lock, so no
+ * other thread can change the record in between.
+ *
+ * @param hashtable A pointer to the hash table.
+ * @param key The string that stores the key.
+ * @param value The string that stores the value.
+ * @param row The value parsed by parseRow() against the table's schema,
+ * or NULL to store the record untyped.
+ * @param metadata The expected metadata of the record, or 0 to set unconditionally.
+ * @param version If not NULL, set to the metadata of the record after
+ * the set; if it points to a non-zero value, the record is given that
+ * metadata instead, as when replaying the write-ahead log.
+ * @return Returns HASH_SET_INSERT, HASH_SET_UPDATE, HASH_SET_FAIL, or
+ * HASH_SET_ABORT if metadata is non-zero and does not match the record.
+ */
+int ht_setVersion( HashTable *hashtable, char *key, char *value, char *row, uintptr_t metadata, uintptr_t *version ) {
+	return ht_setLogged( hashtable, key, value, row, metadata, version, NULL, NULL );
+}
+
+/**
+ * @brief Sets the Key and Value as ht_setVersion(), telling log first.
+ *
+ * log is called under the key's write lock once the set is sure to be
+ * made but before it is, so a change it records is never lost to a
+ * failed set, and the changes to a key reach it in order.
+ *
+ * @param hashtable A pointer to the hash table.
+ * @param key The string that stores the key.
+ * @param value The string that stores the value.
+ * @param row The value parsed against the table's schema, or NULL.
+ * @param metadata The expected metadata of the record, or 0 to set unconditionally.
+ * @param version As ht_setVersion().
+ * @param log If not NULL, called with the metadata the record will have.
+ * @param arg Passed to log.
+ * @return Returns the same as ht_setVersion(); HASH_SET_FAIL also if log
+ * gave the set up.
+ */
+int ht_setLogged( HashTable *hashtable, char *key, char *value, char *row, uintptr_t metadata, uintptr_t *version,
+		HtLogChange log, void *arg ) {
+	int status;
 	Entry *newpair = NULL;
 	Entry *next = NULL;
-	Entry *last = NULL;
- 
-	bin = ht_hash( hashtable, key );
+	int rowSize = hashtable->schema != NULL ? hashtable->schema->rowSize : 0;
 
-	next = hashtable->table[ bin ];
-	while( next != NULL && next->key != NULL && strcmp( key, next->key ) > 0 ) {
-		last = next;
-		next = next->next;
-	}
+	if( rowSize == 0 )
+		row = NULL;
+	if( hashtable->engine == HT_ENGINE_OPEN )
+		return ot_set( hashtable->open, key, value, row, rowSize, metadata, version, log, arg );
+
+	uint64_t hashval = ht_hashKey( key, strlen( key ) );
+
+	pthread_rwlock_rdlock( &hashtable->resizeLock );
+	if( hashtable->oldTable != NULL )
+		ht_rehashStep( hashtable );
+	pthread_rwlock_wrlock( ht_lock( hashtable, hashval ) );
+
+	Entry **link = ht_locate( hashtable, hashval, key );
+	next = *link;
  
 	/* There's already a pair.  Let's replace that string. */
-	if( next != NULL && next->key != NULL && strcmp( key, next->key ) == 0 ) {
+	if( ht_matches( next, hashval, key ) ) {
+		char *oldRow = next->row;
+		char *newRow = NULL;
+		char *copy = NULL;
+		size_t valueLen = strlen( value ) + 1;
  	
+		if( metadata != 0 && next->metadata != metadata ) {
+			status = HASH_SET_ABORT;
+		} else if( ( row != NULL && oldRow == NULL && ( newRow = slab_alloc( &hashtable->slab, rowSize ) ) == NULL )
+				|| ( !ht_valueFits( next, valueLen ) && ( copy = slab_alloc( &hashtable->slab, valueLen ) ) == NULL )
+				|| ( log != NULL && log( version != NULL && *version != 0 ? *version : next->metadata + 1, arg ) != 0 ) ) {
+			slab_free( &hashtable->slab, newRow, rowSize );
+			slab_free( &hashtable->slab, copy, valueLen );
+			status = HASH_SET_FAIL;
+		} else {
+			ht_storeValue( hashtable, next, value, copy );
+			/* Before the old row is overwritten. */
+			ht_indexRecord( hashtable, key, oldRow, row );
+			zm_loosen( ht_zone( hashtable, hashval ) );
+			zm_add( ht_zone( hashtable, hashval ), hashtable->schema, row );
+			if( row != NULL ) {
+				if( newRow != NULL )
+					next->row = newRow;
+				memcpy( next->row, row, rowSize );
+			} else if( oldRow != NULL ) {
+				slab_free( &hashtable->slab, oldRow, hashtable->schema->rowSize );
+				next->row = NULL;
+			}
+			next->metadata += 1;
+			if( version != NULL ) {
+				if( *version != 0 )
+					next->metadata = *version;
+				*version = next->metadata;
+			}
+			status = HASH_SET_UPDATE;
+		}
 
+	/* A versioned set of a record that does not exist. */
+	} else if( metadata != 0 ) {
+		status = HASH_SET_ABORT;
 
-		free( next->value );
-		next->value = myStrDup( value );
-		next->metadata += 1;
-		return HASH_SET_UPDATE;
 	/* Nope, could't find it.  Time to grow a pair. */
-	} else {
-
-		newpair = ht_newpair( key, value );
-
-		/* Ensure we have not run out of memory */
-		if (newpair == NULL)
-			return HASH_SET_FAIL;
-
-		/* We're at the start of the linked list in this bin. */
-		if( next == hashtable->table[ bin ] ) {
-			newpair->next = next;
-			hashtable->table[ bin ] = newpair;
-		/* We're at the end of the linked list in this bin. */
-		} else if ( next == NULL ) {
-			last->next = newpair;
-	
-		/* We're in the middle of the list. */
-		} else  {
-			newpair->next = next;
-			last->next = newpair;
+	} else if( ( newpair = ht_newpair( hashtable, key, value, hashval ) ) == NULL
+			|| ( row != NULL && ( newpair->row = slab_alloc( &hashtable->slab, rowSize ) ) == NULL )
+			|| ( log != NULL && log( version != NULL && *version != 0 ? *version : newpair->metadata, arg ) != 0 ) ) {
+		/* We have run out of memory, or the set was given up */
+		if( newpair != NULL ) {
+			slab_free( &hashtable->slab, newpair->row, rowSize );
+			slab_free( &hashtable->slab, newpair, newpair->size );
 		}
+		status = HASH_SET_FAIL;
 
-		/* We have successfully inserted */
-		return HASH_SET_INSERT;
+	} else {
+		if( row != NULL )
+			memcpy( newpair->row, row, rowSize );
+		if( version != NULL ) {
+			if( *version != 0 )
+				newpair->metadata = *version;
+			*version = newpair->metadata;
+		}
+		ht_indexRecord( hashtable, key, NULL, row );
+		zm_add( ht_zone( hashtable, hashval ), hashtable->schema, row );
+		/* Link it in front of the first larger key. */
+		newpair->next = next;
+		*link = newpair;
+		__sync_fetch_and_add( &hashtable->count, 1 );
+		status = HASH_SET_INSERT;
 	}
-	return 0; // success
+
+	pthread_rwlock_unlock( ht_lock( hashtable, hashval ) );
+	bool resize = ht_needsResize( hashtable );
+	pthread_rwlock_unlock( &hashtable->resizeLock );
+
+	if( resize )
+		ht_resize( hashtable );
+	return status;
 }
  
 
  /**
  * @brief Retrieve a value corresponding to a given Key.
  *
+ * Takes no lock: the entry may be changed or freed by another thread
+ * at any time. Use ht_getRecord() when other threads use the table.
+ * For an HT_ENGINE_OPEN table the entry is a per-thread view that the
+ * next call overwrites.
+ *
  * @param hashtable A pointer to the hash table.
  * @param key The string that stores the key.
- * @param value The string that stores the value.
  * @returns an entry pointer.
  */
 Entry *ht_get( HashTable *hashtable, char *key ) {
-	int bin = 0;
-	Entry *pair;
- 
-	bin = ht_hash( hashtable, key );
-	/* Step through the bin, looking for our value. */
-	pair = hashtable->table[ bin ];
-	while( pair != NULL && pair->key != NULL && strcmp( key, pair->key ) > 0 ) {
-		pair = pair->next;
-	}
+	if( hashtable->engine == HT_ENGINE_OPEN )
+		return ot_get( hashtable->open, key );
+
+	uint64_t hashval = ht_hashKey( key, strlen( key ) );
+	Entry *pair = *ht_locate( hashtable, hashval, key );
  
 	/* Did we actually find anything? */
-	if( pair == NULL || pair->key == NULL || strcmp( key, pair->key ) != 0 ) {
+	if( !ht_matches( pair, hashval, key ) ) {
 		return NULL;
  
 	} else {
@@ -200,33 +710,178 @@ Entry *ht_get( HashTable *hashtable, char *key ) {
 }
 
  /**
- * @brief Iterates through entire hashtable and removes everything
+ * @brief Copy out the value and metadata stored for a given Key.
+ *
+ * @param hashtable A pointer to the hash table.
+ * @param key The string that stores the key.
+ * @param value Set to a copy of the value, which the caller must free.
+ * @param metadata Set to the metadata of the record.
+ * @return Returns 0 on success, KEY_NOT_FOUND if there is no such key,
+ * -1 if out of memory.
+ */
+int ht_getRecord( HashTable *hashtable, char *key, char **value, uintptr_t *metadata ) {
+	int status = KEY_NOT_FOUND;
+
+	if( hashtable->engine == HT_ENGINE_OPEN )
+		return ot_getRecord( hashtable->open, key, value, metadata );
+
+	uint64_t hashval = ht_hashKey( key, strlen( key ) );
+
+	pthread_rwlock_rdlock( &hashtable->resizeLock );
+	if( hashtable->oldTable != NULL )
+		ht_rehashStep( hashtable );
+	pthread_rwlock_rdlock( ht_lock( hashtable, hashval ) );
+
+	Entry *pair = *ht_locate( hashtable, hashval, key );
+	if( ht_matches( pair, hashval, key ) ) {
+		*value = myStrDup( pair->value );
+		*metadata = pair->metadata;
+		status = *value != NULL ? 0 : -1;
+	}
+
+	pthread_rwlock_unlock( ht_lock( hashtable, hashval ) );
+	bool resize = ht_needsResize( hashtable );
+	pthread_rwlock_unlock( &hashtable->resizeLock );
+
+	if( resize )
+		ht_resize( hashtable );
+	return status;
+}
+
+/**
+ * @brief Grows a table at once to hold a number of records, rather than
+ * a step at a time as they are set; used before loading a snapshot.
+ *
+ * @param hashtable A pointer to the hash table.
+ * @param count The number of records to make room for.
+ * @return Returns 0 on success, -1 if out of memory.
+ */
+int ht_reserve( HashTable *hashtable, int count ) {
+	int status = 0;
+	int size;
+	int x;
+
+	if( hashtable->engine == HT_ENGINE_OPEN )
+		return ot_reserve( hashtable->open, count );
+
+	pthread_rwlock_wrlock( &hashtable->resizeLock );
+	size = hashtable->size;
+	while( size <= INT_MAX / 4 && (int64_t) size * HT_MAX_LOAD < count )
+		size *= 2;
+	/* Leave a table that is growing already to ht_rehashStep(). */
+	if( hashtable->oldTable == NULL && size > hashtable->size ) {
+		Entry **table = calloc( (size_t) size, sizeof( Entry * ) );
+		if( table == NULL )
+			status = -1;
+		else {
+			for( x = 0; x < hashtable->size; x++ ) {
+				Entry *entry = hashtable->table[ x ];
+				while( entry != NULL ) {
+					Entry *next = entry->next;
+					Entry **link = ht_chainFind( &table[ entry->hash & ( size - 1 ) ], entry->hash, entry->key );
+					entry->next = *link;
+					*link = entry;
+					entry = next;
+				}
+			}
+			free( hashtable->table );
+			hashtable->table = table;
+			hashtable->size = size;
+		}
+	}
+	pthread_rwlock_unlock( &hashtable->resizeLock );
+	return status;
+}
+
+/**
+ * @brief Blocks every operation on a table, so it holds still while the
+ * process forks. Lookups change the table too: they migrate buckets.
+ *
+ * @param hashtable A pointer to the hash table.
+ */
+void ht_freeze( HashTable *hashtable ) {
+	if( hashtable->engine == HT_ENGINE_OPEN )
+		ot_freeze( hashtable->open );
+	else
+		pthread_rwlock_wrlock( &hashtable->resizeLock );
+}
+
+/**
+ * @brief Releases a table frozen by ht_freeze().
+ *
+ * @param hashtable A pointer to the hash table.
+ */
+void ht_thaw( HashTable *hashtable ) {
+	if( hashtable->engine == HT_ENGINE_OPEN )
+		ot_thaw( hashtable->open );
+	else
+		pthread_rwlock_unlock( &hashtable->resizeLock );
+}
+
+/**
+ * @brief Visits every entry of a table without locking.
+ *
+ * @param hashtable A pointer to the hash table, frozen or used by no other thread.
+ * @param visit Called with each entry; a nonzero return stops the walk.
+ * @param arg Passed to visit.
+ * @return Returns 0, or the nonzero value returned by visit.
+ */
+int ht_forEach( HashTable *hashtable, int (*visit)( Entry *entry, void *arg ), void *arg ) {
+	int status = 0;
+	int x;
+
+	if( hashtable->engine == HT_ENGINE_OPEN )
+		return ot_forEach( hashtable->open, visit, arg );
+
+	/* While growing, the entries not yet migrated are in the old buckets. */
+	for( x = 0; status == 0 && x < hashtable->size; x++ ) {
+		Entry *pair;
+		for( pair = hashtable->table[ x ]; status == 0 && pair != NULL; pair = pair->next )
+			status = visit( pair, arg );
+	}
+	for( x = 0; status == 0 && hashtable->oldTable != NULL && x < hashtable->oldSize; x++ ) {
+		Entry *pair;
+		for( pair = hashtable->oldTable[ x ]; status == 0 && pair != NULL; pair = pair->next )
+			status = visit( pair, arg );
+	}
+	return status;
+}
+
+ /**
+ * @brief Removes everything from the hashtable
+ *
+ * The entries are not visited: their slab is freed at once.
  *
  * @param hashtable A pointer to the hash table.
  * @return VOID.
  */
 void ht_removeAll (HashTable *hashtable){
-		Entry *Head = NULL;
-		Entry *temp = NULL;
-		int x = 0;
-		for (x = 0; x < hashtable->size; x++){ 	
-			Head = hashtable->table[ x ];
-			while (Head != NULL) {
-			    temp = Head;
-			    Head = temp->next;
-			  		free (temp ->key);
-			  		free (temp->value);
-			    free(temp);
-			    temp = NULL;
-			}
-			hashtable->table[x] = NULL;
+		int x;
+		for (x = 0; x < MAX_COLUMNS_PER_TABLE; x++){
+			if (hashtable->indexes[x] != NULL)
+				ci_destroy (hashtable->indexes[x]);
+			hashtable->indexes[x] = NULL;
+		}
+		if (hashtable->engine == HT_ENGINE_OPEN) {
+			ot_destroy (hashtable->open);
+			hashtable->open = NULL;
 		}
-		hashtable->size = 0;
 		free (hashtable->table);
+		free (hashtable->oldTable);
+		slab_destroy (&hashtable->slab);
+		hashtable->table = NULL;
+		hashtable->oldTable = NULL;
+		hashtable->size = 0;
+		hashtable->oldSize = 0;
+		hashtable->count = 0;
+		pthread_rwlock_destroy (&hashtable->resizeLock);
+		for (x = 0; x < HT_LOCK_STRIPES; x++)
+			pthread_rwlock_destroy (&hashtable->locks[x]);
 }
 
 
 
+
 char whatDataType (char* startIndex){
 	int i = 0;
 	while (startIndex[i] != '#'){
@@ -251,50 +906,56 @@ bool bootlegEqualTo (char * predValue, char *hashTableValue){
 	return true;
 }
 
+/*
+ * The record's value ends at its '#', where strtol() stops, so it is
+ * read in place: scans call these from several threads at once.
+ */
 bool bootlegGreaterThan ( char * predValue, char * hashTableValue){
-
-	printf ("fails Here \n");
-
-	char * temp = myStrDup (hashTableValue);
-	temp = strtok (temp, "#");
-
-	//	int i = 0;
-	//char * theHashTableValue =  strtok(hashTableValue, '#');
-	//	char *theHashTableValue = "1234999999";
 	char *p;
 
-	int pred_number = strtol( predValue, &p, 10 );
-	int ht_number = strtol(  temp, &p, 10 );
-
-	free (temp);
-	if (ht_number > pred_number){
-
-		return true;
-	}
-
-	return false;
+	long int pred_number = strtol( predValue, &p, 10 );
+	long int ht_number = strtol( hashTableValue, &p, 10 );
 
+	return ht_number > pred_number;
 }
 
 bool bootlegLessThan (char * predValue, char * hashTableValue){
-
-	char * temp = myStrDup (hashTableValue);
-	temp = strtok (temp, "#");
-
-	//char * theHashTableValue =  strtok(hashTableValue, '#');
-	//char *theHashTableValue = "1234999999";
 	char *p;
 
 	long int pred_number = strtol( predValue, &p , 10 );
-	long int ht_number = strtol(  temp, &p , 10 );
-	free (temp);
-	if ( ht_number < pred_number )
-		return true;
-	return false;
+	long int ht_number = strtol( hashTableValue, &p , 10 );
+
+	return ht_number < pred_number;
 }
 
 
 
+/**
+ * @brief Finds a column of an untyped record.
+ *
+ * The name must match the whole column name, so "age" does not find
+ * "page", nor "name" find a value containing it.
+ *
+ * @param fields The record as createMessage() encodes it: for each
+ * column, its name, its type symbol, its value and '#'.
+ * @param column The column name.
+ * @return Returns a pointer to the type symbol of the column, NULL if
+ * the record has no such column.
+ */
+static char *entry_findColumn (char *fields, const char *column){
+	size_t length = strlen (column);
+
+	while (fields != NULL && *fields != '\0'){
+		if (strncmp (fields, column, length) == 0
+				&& (fields[length] == STRING_SYMBOL || fields[length] == INTEGER_SYMBOL))
+			return fields + length;
+		fields = strchr (fields, '#');
+		if (fields != NULL)
+			fields++;
+	}
+	return NULL;
+}
+
 //This will segfault if the formatting isn't correct
 bool entry_query (Entry * entry, Predicate * predicates, int numPredicates ){
 		int i = 0;
@@ -307,19 +968,15 @@ bool entry_query (Entry * entry, Predicate * predicates, int numPredicates ){
 			//We are looking for a matching string
 
 			if ( predicates[i].op == '='){
-				char * temp = strstr(newValue, predicates[i].column);
-				char operatorSymbol = whatDataType(temp);
+				char * temp = entry_findColumn(newValue, predicates[i].column);
+				char operatorSymbol = temp != NULL ? *temp : '\0';
 
 				if (operatorSymbol != STRING_SYMBOL && operatorSymbol != INTEGER_SYMBOL){
 					free (newValue);
 					return false;	//Wrong Data Type - Big NoNo!
 				}
 					
-				//Now lets find the starting position for the value of the predicate
-				
-				temp = strchr (temp, operatorSymbol);
 				//Now move to where the item should be!
-
 				temp++;
 
 
@@ -333,14 +990,12 @@ bool entry_query (Entry * entry, Predicate * predicates, int numPredicates ){
 			//We ae looking for a < integer
 			} else if (predicates[i].op == '<'){
 
-				char * temp = strstr(newValue, predicates[i].column);
-				if (whatDataType(temp) != INTEGER_SYMBOL){
+				char * temp = entry_findColumn(newValue, predicates[i].column);
+				if (temp == NULL || *temp != INTEGER_SYMBOL){
 					free (newValue);
 					return false;	//Wrong Data Type - Big NoNo!
 				}
 
-				//Now lets find the starting position for the value of the predicate
-				temp = strchr (temp, INTEGER_SYMBOL);
 				//Now move to where the item should be!
 				temp++;
 				//Compare to see if the value is actually less than predicate value
@@ -355,14 +1010,12 @@ bool entry_query (Entry * entry, Predicate * predicates, int numPredicates ){
 			//We are looking for a > integer
 			} else {
 
-				char * temp = strstr(newValue, predicates[i].column);
-				if (whatDataType(temp) != INTEGER_SYMBOL){
+				char * temp = entry_findColumn(newValue, predicates[i].column);
+				if (temp == NULL || *temp != INTEGER_SYMBOL){
 					free (newValue);
 					return false;	//Wrong Data Type - Big NoNo!					
 				}
 
-				//Now lets find the starting position for the value of the predicate
-				temp = strchr (temp, INTEGER_SYMBOL);
 				//Now move to where the item should be!
 				temp++;
 
@@ -378,93 +1031,618 @@ bool entry_query (Entry * entry, Predicate * predicates, int numPredicates ){
 	return true;
 }
 
+
+/**
+ * @brief Tells whether a record matches a query.
+ *
+ * Typed records are matched on their row; untyped ones, such as
+ * uploaded census records, are parsed from their value.
+ *
+ * @param entry The record.
+ * @param plan The compiled query.
+ * @return true if the record matches.
+ */
+bool record_query (Entry *entry, QueryPlan *plan){
+	if (entry->row != NULL)
+		return qp_matchRow (plan, entry->row);
+	return entry_query (entry, plan->predicates, plan->numPredicates);
+}
+
+
+/**
+ * @brief Tells whether the record with a given key matches a query.
+ *
+ * @param hashtable A pointer to the hash table.
+ * @param key The key of the record.
+ * @param plan The compiled query.
+ * @return true if the record exists and matches.
+ */
+static bool ht_matchKey (HashTable *hashtable, char *key, QueryPlan *plan){
+	if (hashtable->engine == HT_ENGINE_OPEN)
+		return ot_matchKey (hashtable->open, key, plan);
+
+	uint64_t hashval = ht_hashKey( key, strlen( key ) );
+	pthread_rwlock_rdlock( &hashtable->resizeLock );
+	pthread_rwlock_rdlock( ht_lock( hashtable, hashval ) );
+	Entry *entry = *ht_locate( hashtable, hashval, key );
+	bool matches = ht_matches( entry, hashval, key ) && record_query( entry, plan );
+	pthread_rwlock_unlock( ht_lock( hashtable, hashval ) );
+	pthread_rwlock_unlock( &hashtable->resizeLock );
+	return matches;
+}
+
+/**
+ * @brief Passes a matching key to a sink, unless it has all it takes.
+ */
+static void ht_sinkKey (KeySink *sink, const char *key){
+	if (sink->failed || sink->numKeys >= sink->maxKeys)
+		return;
+	if (sink->visit (key, sink->arg) != 0)
+		sink->failed = true;
+	else
+		sink->numKeys++;
+}
+
 /**
- * @brief Queries the hashtable and updates the array of strings called keysFound
+ * @brief Answers a query from a secondary index.
+ *
+ * The index gives the keys of the records that may match; each one is
+ * then checked against the whole plan, as the record may have changed
+ * since the index was read.
  *
  * @param hashtable A pointer to the hash table.
- * @param operator The operator to determine what component to query.
- * @param predicate	The criteria to search for using the operator.
- * @param keysFound	The array of strings that contains all the keys that match the predicate and operation.
+ * @param plan The compiled query.
+ * @param index The index on the column of the plan's indexStep.
+ * @param sink Gets the keys of the matching records.
  * @return Returns the number of items found if successful, -1 if otherwise.
  */
-int ht_query (HashTable *hashtable, Predicate * predicates, int numPredicates, char ** keysFound, int maxKeysFound){
+static int ht_queryIndex (HashTable *hashtable, QueryPlan *plan, ColumnIndex *index, KeySink *sink){
+	char **candidates;
+	int numCandidates = ci_find (index, &plan->steps[plan->indexStep], &candidates);
+	int numKeysFound = 0;
+	int i;
+
+	if (numCandidates < 0)
+		return -1;
+	for (i = 0; i < numCandidates; i++){
+		if (ht_matchKey (hashtable, candidates[i], plan)){
+			ht_sinkKey (sink, candidates[i]);
+			numKeysFound++;
+		}
+		free (candidates[i]);
+	}
+	free (candidates);
+	return numKeysFound;
+}
+
+/**
+ * @brief Queries the hashtable, passing the matching keys to a sink as they are found
+ *
+ * The table is scanned one stripe at a time under its read lock: the
+ * buckets of a stripe, old and new, are read together, so an entry
+ * being migrated is seen exactly once.
+ *
+ * A secondary index answers the query if one applies; otherwise tables
+ * of at least the parallel scan threshold are scanned on the scan pool.
+ *
+ * @param hashtable A pointer to the hash table.
+ * @param plan The compiled query, from qp_get().
+ * @param sink Gets the keys of the matching records.
+ * @return Returns the number of items found if successful, -1 if otherwise.
+ */
+int ht_query (HashTable *hashtable, QueryPlan *plan, KeySink *sink){
+	int numKeysFound;
+
+	if (plan->indexStep >= 0){
+		ColumnIndex *index = hashtable->indexes[plan->steps[plan->indexStep].column];
+		if (ci_supports (index, &plan->steps[plan->indexStep])){
+			numKeysFound = ht_queryIndex (hashtable, plan, index, sink);
+			return sink->failed ? -1 : numKeysFound;
+		}
+	}
+
+	/* A parallel scan fails before passing any key, so a serial one can follow. */
+	if (ht_scanQueue != NULL && ht_count (hashtable) >= ht_scanThreshold){
+		numKeysFound = ht_parallelQuery (hashtable, plan, sink);
+		if (numKeysFound >= 0)
+			return sink->failed ? -1 : numKeysFound;
+	}
+
+	if (hashtable->engine == HT_ENGINE_OPEN)
+		numKeysFound = ot_query (hashtable->open, plan, sink);
+	else {
+		pthread_rwlock_rdlock( &hashtable->resizeLock );
+		numKeysFound = ht_scanStripes (hashtable, plan, 0, HT_LOCK_STRIPES, sink);
+		pthread_rwlock_unlock( &hashtable->resizeLock );
+	}
+
+	return sink->failed ? -1 : numKeysFound;
+}
+
+/**
+ * @brief Scans a range of lock stripes of a chained table.
+ *
+ * The caller holds the resize lock for reading.
+ *
+ * @param hashtable A pointer to the hash table.
+ * @param plan The compiled query.
+ * @param first The first stripe.
+ * @param last One past the last stripe.
+ * @param sink Gets the keys of the matching records.
+ * @return Returns the number of matching records.
+ */
+static int ht_scanStripes (HashTable *hashtable, QueryPlan *plan, int first, int last, KeySink *sink){
 	int numKeysFound = 0;
 	Entry *temp = NULL;
-	int x;
-	int length = hashtable->size;
-	for (x = 0; x < length; x++){ 	
-		//fprintf(stderr, "X- ENTER: %d\n", x);
-		temp = hashtable->table[ x ];
-		while (temp != NULL) {
-		    if (entry_query(temp, predicates, numPredicates)){
-		    	if (numKeysFound < maxKeysFound){
-		    		keysFound[numKeysFound] = myStrDup(temp->key);
-		    	}
-		    	numKeysFound++;
-		    }
-		    temp = temp->next;
+	ScanBatch batch;
+	int stripe, x;
+
+	batch.count = 0;
+	for (stripe = first; stripe < last; stripe++){
+		ZoneMap *zone = ht_zone( hashtable, stripe );
+		ZoneMap bounds;
+		bool tighten;
+
+		pthread_rwlock_rdlock( ht_lock( hashtable, stripe ) );
+		if (zm_excludes (zone, plan)){
+			pthread_rwlock_unlock( ht_lock( hashtable, stripe ) );
+			continue;
+		}
+		/* Reading the whole stripe anyway, recompute loose bounds. */
+		tighten = zm_isLoose (zone);
+		if (tighten)
+			zm_reset (&bounds);
+		Entry **tables[2] = { hashtable->oldTable, hashtable->table };
+		int sizes[2] = { hashtable->oldSize, hashtable->size };
+		int t;
+		for (t = 0; t < 2; t++){
+			for (x = stripe; tables[t] != NULL && x < sizes[t]; x += HT_LOCK_STRIPES){ 	
+				temp = tables[t][ x ];
+				while (temp != NULL) {
+				    if (tighten)
+				    	zm_add (&bounds, hashtable->schema, temp->row);
+				    batch.entries[batch.count++] = *temp;
+				    if (batch.count == QP_BATCH)
+				    	numKeysFound = ht_flushBatch (&batch, plan, sink, numKeysFound);
+				    temp = temp->next;
+				}
+			}
+		}
+		/* The batch points into the stripe. */
+		numKeysFound = ht_flushBatch (&batch, plan, sink, numKeysFound);
+		if (tighten)
+			zm_publish (zone, &bounds);
+		pthread_rwlock_unlock( ht_lock( hashtable, stripe ) );
+	}
+
+	return numKeysFound;
+}
+
+/**
+ * @brief Matches the records gathered by a scan and empties the batch.
+ *
+ * Typed rows are matched together by qp_matchBatch(); untyped records
+ * one by one. Keys go to the sink in the order the records were gathered.
+ *
+ * @param batch The gathered records.
+ * @param plan The compiled query.
+ * @param sink Gets the keys of the matching records.
+ * @param numKeysFound The number of matching records found before the batch.
+ * @return Returns numKeysFound plus the number of matching records in the batch.
+ */
+int ht_flushBatch (ScanBatch *batch, QueryPlan *plan, KeySink *sink, int numKeysFound){
+	const char *rows[QP_BATCH];
+	int i;
+
+	for (i = 0; i < batch->count; i++)
+		rows[i] = batch->entries[i].row;
+	uint64_t matches = qp_matchBatch (plan, rows, batch->count);
+
+	for (i = 0; i < batch->count; i++){
+		Entry *entry = &batch->entries[i];
+		if (entry->row != NULL ? ( matches >> i & 1 ) : entry_query (entry, plan->predicates, plan->numPredicates)){
+			ht_sinkKey (sink, entry->key);
+			numKeysFound++;
+		}
+	}
+	batch->count = 0;
+	return numKeysFound;
+}
+
+/**
+ * @brief Returns the number of records of a table.
+ */
+int ht_count (HashTable *hashtable){
+	if (hashtable->engine == HT_ENGINE_OPEN)
+		return __atomic_load_n( &hashtable->open->count, __ATOMIC_RELAXED );
+	return __atomic_load_n( &hashtable->count, __ATOMIC_RELAXED );
+}
+
+/**
+ * @brief Returns the memory of the entries, values and rows of a table.
+ *
+ * @param hashtable A pointer to the hash table.
+ * @param inUse Set to the bytes of the records.
+ * @param reserved Set to the bytes taken from the system for them.
+ */
+void ht_memoryUsage (HashTable *hashtable, size_t *inUse, size_t *reserved){
+	slab_usage (&hashtable->slab, inUse, reserved);
+}
+
+/**
+ * @brief Runs one part of a parallel scan on a worker of the scan pool.
+ */
+static void ht_scanPart (void *arg){
+	ScanPart *part = (ScanPart *) arg;
+	HashTable *hashtable = part->hashtable;
+
+	if (hashtable->engine == HT_ENGINE_OPEN)
+		part->numKeysFound = ot_queryShards (hashtable->open, part->plan, part->first, part->last, &part->sink);
+	else
+		part->numKeysFound = ht_scanStripes (hashtable, part->plan, part->first, part->last, &part->sink);
+
+	pthread_mutex_lock (&part->scan->lock);
+	if (--part->scan->pending == 0)
+		pthread_cond_signal (&part->scan->done);
+	pthread_mutex_unlock (&part->scan->lock);
+}
+
+/**
+ * @brief Keeps a key found by one part of a parallel scan.
+ */
+static int ht_partKey (const char *key, void *arg){
+	ScanPart *part = (ScanPart *) arg;
+
+	return ht_collectKey (&part->keysFound, &part->numKept, &part->capacity, key);
+}
+
+/**
+ * @brief Scans a table on the workers of the scan pool.
+ *
+ * The stripes (or shards) are split into consecutive ranges, one per
+ * part, and the keys of the parts are passed on in order, so the sink
+ * gets the keys a scan on one thread would pass it. Each part keeps no
+ * more keys than the sink takes.
+ *
+ * @param hashtable A pointer to the hash table.
+ * @param plan The compiled query.
+ * @param sink Gets the keys of the matching records.
+ * @return Returns the number of matching records, -1 if out of memory,
+ * before any key was passed to the sink.
+ */
+static int ht_parallelQuery (HashTable *hashtable, QueryPlan *plan, KeySink *sink){
+	int total = hashtable->engine == HT_ENGINE_OPEN ? OT_SHARDS : HT_LOCK_STRIPES;
+	int numParts = ht_scanParts < total ? ht_scanParts : total;
+	ScanPart *parts = (ScanPart *) calloc (numParts, sizeof(ScanPart));
+	int numKeysFound = 0;
+	bool failed = false;
+	Scan scan;
+	int p, i;
+
+	if (parts == NULL)
+		return -1;
+
+	pthread_mutex_init (&scan.lock, NULL);
+	pthread_cond_init (&scan.done, NULL);
+	scan.pending = numParts;
+
+	if (hashtable->engine != HT_ENGINE_OPEN)
+		pthread_rwlock_rdlock( &hashtable->resizeLock );
+	for (p = 0; p < numParts; p++){
+		parts[p].hashtable = hashtable;
+		parts[p].plan = plan;
+		parts[p].first = total * p / numParts;
+		parts[p].last = total * (p + 1) / numParts;
+		parts[p].sink.visit = ht_partKey;
+		parts[p].sink.arg = &parts[p];
+		parts[p].sink.maxKeys = sink->maxKeys - sink->numKeys;
+		parts[p].scan = &scan;
+		if (wq_push (ht_scanQueue, ht_scanPart, &parts[p]) != 0)
+			ht_scanPart (&parts[p]);
+	}
+	pthread_mutex_lock (&scan.lock);
+	while (scan.pending > 0)
+		pthread_cond_wait (&scan.done, &scan.lock);
+	pthread_mutex_unlock (&scan.lock);
+	if (hashtable->engine != HT_ENGINE_OPEN)
+		pthread_rwlock_unlock( &hashtable->resizeLock );
+
+	for (p = 0; p < numParts; p++)
+		failed = failed || parts[p].sink.failed;
+	for (p = 0; p < numParts; p++){
+		for (i = 0; i < parts[p].numKept; i++){
+			if (!failed)
+				ht_sinkKey (sink, parts[p].keysFound[i]);
+			free (parts[p].keysFound[i]);
+		}
+		numKeysFound += parts[p].numKeysFound;
+		free (parts[p].keysFound);
+	}
+	free (parts);
+	pthread_cond_destroy (&scan.done);
+	pthread_mutex_destroy (&scan.lock);
+	return failed ? -1 : numKeysFound;
+}
+
+/**
+ * @brief Appends a copy of a key to a growable array.
+ *
+ * @param keys The array, NULL at first; grown with realloc.
+ * @param count The number of keys in the array.
+ * @param capacity The allocated size of the array.
+ * @param key The key.
+ * @return Returns 0 on success, -1 if out of memory.
+ */
+int ht_collectKey (char ***keys, int *count, int *capacity, const char *key){
+	if (*count == *capacity){
+		int size = *capacity > 0 ? *capacity * 2 : 16;
+		char **grown = (char **) realloc (*keys, sizeof(char *) * size);
+		if (grown == NULL)
+			return -1;
+		*keys = grown;
+		*capacity = size;
+	}
+	if (((*keys)[*count] = myStrDup (key)) == NULL)
+		return -1;
+	(*count)++;
+	return 0;
+}
+
+/**
+ * @brief Returns the next bucket of a reverse-bit cursor.
+ *
+ * The bits of the bucket under the mask are incremented from the top
+ * down, so the cursor is 0 again once every bucket was visited.
+ *
+ * @param bucket The bucket cursor.
+ * @param mask The bucket count minus one.
+ * @return The next bucket cursor.
+ */
+uint64_t ht_cursorAdvance (uint64_t bucket, uint64_t mask){
+	int i;
+	uint64_t reversed = 0;
+
+	bucket |= ~mask;
+	for (i = 0; i < 64; i++)
+		reversed |= ( ( bucket >> i ) & 1 ) << ( 63 - i );
+	reversed++;
+	bucket = 0;
+	for (i = 0; i < 64; i++)
+		bucket |= ( ( reversed >> i ) & 1 ) << ( 63 - i );
+	return bucket;
+}
+
+/**
+ * @brief Finds the matching records of a bucket of a chained table.
+ *
+ * While the table grows, the bucket is taken in the smaller, old array
+ * together with every bucket of the new array it splits into. They all
+ * fall in the same lock stripe.
+ *
+ * @param hashtable A pointer to the hash table.
+ * @param plan The compiled query.
+ * @param bucket The bucket cursor.
+ * @param keysFound Set to a malloc'ed array of copies of the keys; free both.
+ * @param mask Set to the mask the cursor advances with.
+ * @return Returns the number of keys, or -1 if out of memory.
+ */
+static int ht_queryBucket (HashTable *hashtable, QueryPlan *plan, uint64_t bucket, char *** keysFound, uint64_t *mask){
+	int numKeysFound = 0;
+	int capacity = 0;
+	int status = 0;
+	Entry *temp;
+
+	*keysFound = NULL;
+	pthread_rwlock_rdlock( &hashtable->resizeLock );
+	pthread_rwlock_rdlock( ht_lock( hashtable, bucket ) );
+	if (hashtable->oldTable != NULL){
+		uint64_t small = hashtable->oldSize - 1;
+		uint64_t large = hashtable->size - 1;
+		uint64_t x = bucket & small;
+
+		*mask = small;
+		for (temp = hashtable->oldTable[x]; status == 0 && temp != NULL; temp = temp->next){
+			if (record_query (temp, plan))
+				status = ht_collectKey (keysFound, &numKeysFound, &capacity, temp->key);
+		}
+		/* Every bucket of the new array with the same low bits. */
+		do {
+			for (temp = hashtable->table[x & large]; status == 0 && temp != NULL; temp = temp->next){
+				if (record_query (temp, plan))
+					status = ht_collectKey (keysFound, &numKeysFound, &capacity, temp->key);
+			}
+			x = ( ( ( x | small ) + 1 ) & ~small ) | ( bucket & small );
+		} while (x & ( small ^ large ));
+	}
+	else {
+		*mask = hashtable->size - 1;
+		for (temp = hashtable->table[bucket & *mask]; status == 0 && temp != NULL; temp = temp->next){
+			if (record_query (temp, plan))
+				status = ht_collectKey (keysFound, &numKeysFound, &capacity, temp->key);
 		}
 	}
-	//if (numKeysFound == 0)
-	//	return ;
+	pthread_rwlock_unlock( ht_lock( hashtable, bucket ) );
+	pthread_rwlock_unlock( &hashtable->resizeLock );
 
+	if (status != 0){
+		while (numKeysFound > 0)
+			free ((*keysFound)[--numKeysFound]);
+		free (*keysFound);
+		*keysFound = NULL;
+		return -1;
+	}
 	return numKeysFound;
 }
 
+static int ht_compareKeys (const void *a, const void *b){
+	return strcmp (*(char * const *) a, *(char * const *) b);
+}
+
+/**
+ * @brief Opens a cursor over the records matching a query.
+ *
+ * @param hashtable A pointer to the hash table.
+ * @param plan The compiled query; the cursor keeps the caller's reference.
+ * @return Returns the cursor, or NULL if out of memory.
+ */
+QueryCursor *ht_queryOpen (HashTable *hashtable, QueryPlan *plan){
+	QueryCursor *cursor = (QueryCursor *) calloc (1, sizeof(QueryCursor));
+	if (cursor == NULL)
+		return NULL;
+	cursor->hashtable = hashtable;
+	cursor->plan = plan;
+	return cursor;
+}
+
+/**
+ * @brief Returns the next page of keys of a cursor.
+ *
+ * A page is short only when the cursor reaches the end. Records set
+ * while the cursor is open may or may not be returned, and a record
+ * may come twice if the table grows in between.
+ *
+ * @param cursor The cursor.
+ * @param keysFound	Set to copies of up to maxKeysFound matching keys.
+ * @param maxKeysFound The size of keysFound.
+ * @return Returns the number of keys, 0 at the end, -1 if out of memory.
+ */
+int ht_queryNext (QueryCursor *cursor, char ** keysFound, int maxKeysFound){
+	HashTable *hashtable = cursor->hashtable;
+	int numKeysFound = 0;
+
+	while (!cursor->done && numKeysFound < maxKeysFound){
+		char **candidates;
+		uint64_t mask;
+		int numCandidates, i;
+		bool finished = true;
+
+		if (hashtable->engine == HT_ENGINE_OPEN)
+			numCandidates = ot_queryBucket (hashtable->open, cursor->plan, cursor->group, cursor->bucket, &candidates, &mask);
+		else
+			numCandidates = ht_queryBucket (hashtable, cursor->plan, cursor->bucket, &candidates, &mask);
+		if (numCandidates < 0){
+			while (numKeysFound > 0)
+				free (keysFound[--numKeysFound]);
+			return -1;
+		}
+
+		/* Resume the bucket after the last key returned from it. */
+		qsort (candidates, numCandidates, sizeof(char *), ht_compareKeys);
+		for (i = 0; i < numCandidates; i++){
+			if (cursor->lastKey != NULL && strcmp (candidates[i], cursor->lastKey) <= 0)
+				free (candidates[i]);
+			else if (numKeysFound == maxKeysFound){
+				finished = false;
+				free (candidates[i]);
+			}
+			else
+				keysFound[numKeysFound++] = candidates[i];
+		}
+		free (candidates);
+
+		free (cursor->lastKey);
+		cursor->lastKey = NULL;
+		if (!finished){
+			cursor->lastKey = myStrDup (keysFound[numKeysFound - 1]);
+			if (cursor->lastKey == NULL){
+				while (numKeysFound > 0)
+					free (keysFound[--numKeysFound]);
+				return -1;
+			}
+		}
+		else {
+			cursor->bucket = ht_cursorAdvance (cursor->bucket, mask);
+			if (cursor->bucket == 0 && (hashtable->engine != HT_ENGINE_OPEN || ++cursor->group == OT_SHARDS))
+				cursor->done = true;
+		}
+	}
+	return numKeysFound;
+}
+
+/**
+ * @brief Closes a cursor and releases its plan.
+ *
+ * @param cursor The cursor.
+ */
+void ht_queryClose (QueryCursor *cursor){
+	qp_release (cursor->plan);
+	free (cursor->lastKey);
+	free (cursor);
+}
+
+/**
+ * @brief Lets queries without an index scan large tables on several threads.
+ *
+ * @param threshold The number of records from which a table is scanned in parallel.
+ * @param numThreads The number of scan threads; 0 for one per CPU.
+ * @return Returns 0 on success, -1 if the threads could not be started.
+ */
+int ht_startParallelScan (int threshold, int numThreads){
+	if (numThreads <= 0)
+		numThreads = (int) sysconf (_SC_NPROCESSORS_ONLN);
+	if (numThreads <= 0)
+		numThreads = 1;
+
+	/* Room for the parts of several queries at once. */
+	ht_scanQueue = wq_create (numThreads, numThreads * HT_LOCK_STRIPES);
+	if (ht_scanQueue == NULL)
+		return -1;
+	ht_scanParts = numThreads;
+	ht_scanThreshold = threshold;
+	return 0;
+}
+
 
 /**
  * @brief Removes an item given a specific key
  *
  * @param hashtable A pointer to the hash table.
  * @param Key A pointer to the key to delete.
- * @return Returns the status of the removal, whether it was successful or not.
+ * @return Returns HASH_SET_DELETE if the item was removed, KEY_NOT_FOUND otherwise.
  */
 int ht_removeItem ( HashTable *hashtable, char *key  ){
-	Entry *curr = NULL;
-	Entry *last = NULL;
- 
-	int bin = ht_hash( hashtable, key );
-	curr = hashtable->table[ bin ];
-	
-	/* Key does not exist */
-	if (curr == NULL)
-		return KEY_NOT_FOUND;
-
- 	/* Iterate through until we hit the end or find the key */
-	while( curr->next != NULL && strcmp( key, curr->key ) != 0 ) {
-		last = curr;
-		curr = curr->next;
-	}
-
-	/* We hit the end and yet no key was found */
-	if (strcmp (key, curr->key) != 0)
-		return KEY_NOT_FOUND;
-
-	/* Item was found! */
-	/* We're at the start of the linked list in this bin. */
-	if (curr == hashtable->table[bin]){
-		Entry * temp = curr;
-		curr = curr -> next;
-			free (temp->key);
-			free (temp->value);
-			temp->next = NULL;
-			free (temp);
-			hashtable->table[bin] = curr;
-			
-		return HASH_SET_DELETE;
-	/* We are at the end of the list in this bin */
-	} else if ( curr->next == NULL ){
-		free (curr->key);
-		free (curr->value);
-		free (curr);
-		last->next = NULL;
-		return HASH_SET_DELETE;
-	/* We're in the middle of the list. */
-	} else {
-		last->next = curr-> next;
-		free (curr->key);
-		free (curr->value);
-		free (curr);
-		return HASH_SET_DELETE;
+	return ht_removeLogged (hashtable, key, NULL, NULL);
+}
+
+/**
+ * @brief Removes an item as ht_removeItem(), telling log first as
+ * ht_setLogged() does.
+ *
+ * @param hashtable A pointer to the hash table.
+ * @param Key A pointer to the key to delete.
+ * @param log If not NULL, called with 0 once the item is found.
+ * @param arg Passed to log.
+ * @return Returns HASH_SET_DELETE if the item was removed, HASH_SET_FAIL
+ * if log gave it up, KEY_NOT_FOUND otherwise.
+ */
+int ht_removeLogged ( HashTable *hashtable, char *key, HtLogChange log, void *arg ){
+	int status = KEY_NOT_FOUND;
+
+	if (hashtable->engine == HT_ENGINE_OPEN)
+		return ot_removeItem (hashtable->open, key, log, arg);
+
+	uint64_t hashval = ht_hashKey( key, strlen( key ) );
+
+	pthread_rwlock_rdlock( &hashtable->resizeLock );
+	pthread_rwlock_wrlock( ht_lock( hashtable, hashval ) );
+
+	Entry **link = ht_locate( hashtable, hashval, key );
+	Entry *curr = *link;
+
+	if (ht_matches (curr, hashval, key) && log != NULL && log (0, arg) != 0) {
+		status = HASH_SET_FAIL;
+
+	/* Item was found! Unlink it from its bucket. */
+	} else if (ht_matches (curr, hashval, key)) {
+		*link = curr->next;
+		ht_indexRecord (hashtable, key, curr->row, NULL);
+		zm_loosen (ht_zone (hashtable, hashval));
+		ht_freeEntry (hashtable, curr);
+		__sync_fetch_and_sub( &hashtable->count, 1 );
+		status = HASH_SET_DELETE;
 	}
-}
\ No newline at end of file
+
+	pthread_rwlock_unlock( ht_lock( hashtable, hashval ) );
+	pthread_rwlock_unlock( &hashtable->resizeLock );
+	return status;
+}
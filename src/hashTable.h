@@ -17,38 +17,122 @@
 #include <limits.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
 #include "utils.h"
+#include "queryPlan.h"
+#include "columnIndex.h"
+#include "zoneMap.h"
+#include "slab.h"
 
 #define KEY_NOT_FOUND -127
 #define HASH_SET_INSERT 147
 #define HASH_SET_DELETE 157
 #define HASH_SET_UPDATE 167
 #define HASH_SET_FAIL 177
+#define HASH_SET_ABORT 207
 #define QUERY_FAIL	187
 #define QUERY_SUCCESS 197
 #define STRING_SYMBOL '/'
 #define INTEGER_SYMBOL '!'
+#define HT_LOCK_STRIPES 64	///< Reader-writer locks per table, a power of two; bucket i uses lock i % HT_LOCK_STRIPES.
+#define HT_DEFAULT_SIZE 2000	///< Initial bucket count of a table unless its config line sets one.
+#define HT_MAX_LOAD 1		///< Entries per bucket above which the table doubles.
+#define HT_REHASH_STEP 2	///< Old buckets each operation migrates while the table grows.
+#define HT_ENGINE_CHAINED 0	///< Buckets of linked entries, grown incrementally.
+#define HT_ENGINE_OPEN 1	///< Open addressing; see openTable.h.
+
+/**
+ * @brief Called under the write lock of a record, just before a change
+ * to it is made, so the changes to a key are seen in the order made.
+ *
+ * @param version The metadata of the record after a set, 0 for a delete.
+ * @param arg The argument passed with the change.
+ * @return Returns 0 to make the change, nonzero to give it up.
+ */
+typedef int (*HtLogChange)( uintptr_t version, void *arg );
 
 /**
  * @brief Encapsulate each entry to the hash table.
  *
+ * An entry of an HT_ENGINE_CHAINED table is one block of the table's
+ * slab: the entry, then its key, then its value, unless the value grew
+ * past the block and was moved to a block of its own.
  */
 typedef struct entry {
     char* key;
     char* value;
+    uint32_t size;	///< Bytes of the block holding the entry, its key and value.
 
     uintptr_t metadata;
+    uint64_t hash;	///< ht_hashKey() of the key; chains are sorted by it.
+    char *row;		///< The value parsed against the table's Schema, or NULL if untyped.
 
     struct entry *next;
 }Entry;
 
+/**
+ * @brief Records gathered by a scan, to be matched together.
+ */
+typedef struct scanBatch {
+	int count;
+	Entry entries[QP_BATCH];
+} ScanBatch;
+
+/**
+ * @brief Where a query puts the keys of the matching records.
+ *
+ * Each of the first maxKeys keys is passed to visit as the query finds
+ * it; the keys past maxKeys are only counted. A scan calls visit with
+ * its records locked, so visit must not block.
+ */
+typedef struct keySink {
+	int (*visit)( const char *key, void *arg );	///< Returns 0, or -1 to fail the query.
+	void *arg;
+	int maxKeys;
+	int numKeys;		///< Keys passed to visit so far.
+	bool failed;		///< Set once visit failed; no key is passed after.
+} KeySink;
+
+/**
+ * @brief The position of a paginated query; see ht_queryNext().
+ *
+ * Buckets are visited in reverse-bit order of their index, so when the
+ * table grows the halves of a bucket already visited are not visited
+ * again, and a record present all along is never missed. The records
+ * of one bucket are returned in key order, resuming after lastKey.
+ */
+typedef struct queryCursor {
+	struct hashtable *hashtable;
+	QueryPlan *plan;	///< Held until the cursor is closed.
+	int group;		///< For an open table, the shard being visited.
+	uint64_t bucket;	///< The reverse-bit bucket cursor.
+	char *lastKey;		///< The last key returned from the current bucket, or NULL.
+	bool done;		///< Every bucket was visited.
+} QueryCursor;
+
 /**
  * @brief Encapsulate the hash table
  *
+ * Bucket counts are powers of two of at least HT_LOCK_STRIPES, so a key
+ * maps to the same stripe lock in both bucket arrays while the table grows.
  */
 typedef struct hashtable{
+	int engine;		///< HT_ENGINE_CHAINED or HT_ENGINE_OPEN.
+	Schema *schema;		///< Layout of the rows of typed records; NULL if the table is untyped.
+	ColumnIndex *indexes[MAX_COLUMNS_PER_TABLE];	///< Secondary index of each column, or NULL.
+	struct openTable *open;	///< The records of an HT_ENGINE_OPEN table; the fields below are unused.
 	int size;
 	struct entry **table;	
+	struct entry **oldTable;	///< While growing, the previous buckets; NULL otherwise.
+	int oldSize;
+	int rehashIndex;	///< Next old bucket to migrate.
+	int rehashDone;		///< Old buckets migrated so far.
+	int count;		///< Number of entries.
+	pthread_rwlock_t resizeLock;	///< Shared by every operation; exclusive to swap bucket arrays.
+	pthread_rwlock_t locks[HT_LOCK_STRIPES];	///< Guard the buckets; see HT_LOCK_STRIPES.
+	ZoneMap zones[HT_LOCK_STRIPES];	///< Bounds of the records under each lock stripe.
+	Slab slab;		///< The entries, values and rows of an HT_ENGINE_CHAINED table.
 }HashTable;
  
 
@@ -56,22 +140,67 @@ typedef struct hashtable{
 
  HashTable *ht_create( int size );
 
+ HashTable *ht_createEngine( int size, int engine );
+
+ int ht_createIndexes( HashTable *hashtable );
+
+ void ht_indexRecord( HashTable *hashtable, const char *key, const char *oldRow, const char *newRow );
+
+ uint64_t ht_hashKey( const char *key, size_t len );
+
  int ht_hash( HashTable *hashtable, char *key );
 
- Entry *ht_newpair( char *key, char *value );
+ Entry *ht_newpair( HashTable *hashtable, char *key, char *value, uint64_t hash );
 
  int ht_set( HashTable *hashtable, char *key, char *value );
 
+ int ht_setVersion( HashTable *hashtable, char *key, char *value, char *row, uintptr_t metadata, uintptr_t *version );
+
+ int ht_setLogged( HashTable *hashtable, char *key, char *value, char *row, uintptr_t metadata, uintptr_t *version,
+		HtLogChange log, void *arg );
+
  Entry *ht_get( HashTable *hashtable, char *key );
 
+ int ht_getRecord( HashTable *hashtable, char *key, char **value, uintptr_t *metadata );
+
+ int ht_count( HashTable *hashtable );
+
+ void ht_memoryUsage( HashTable *hashtable, size_t *inUse, size_t *reserved );
+
+ int ht_reserve( HashTable *hashtable, int count );
+
+ void ht_freeze( HashTable *hashtable );
+
+ void ht_thaw( HashTable *hashtable );
+
+ int ht_forEach( HashTable *hashtable, int (*visit)( Entry *entry, void *arg ), void *arg );
+
  void ht_removeAll ( HashTable *hashtable );
  
  int ht_removeItem ( HashTable *hashtable, char *key  );
 
- int ht_query (HashTable *hashtable, Predicate * predicates, int numPredicates, char ** keysFound, int maxKeysFound);
+ int ht_removeLogged ( HashTable *hashtable, char *key, HtLogChange log, void *arg );
+
+ int ht_query (HashTable *hashtable, QueryPlan *plan, KeySink *sink);
+
+ int ht_startParallelScan (int threshold, int numThreads);
+
+ QueryCursor *ht_queryOpen (HashTable *hashtable, QueryPlan *plan);
+
+ int ht_queryNext (QueryCursor *cursor, char ** keysFound, int maxKeysFound);
+
+ void ht_queryClose (QueryCursor *cursor);
+
+ uint64_t ht_cursorAdvance (uint64_t bucket, uint64_t mask);
+
+ int ht_collectKey (char ***keys, int *count, int *capacity, const char *key);
 
  bool entry_query (Entry * entry, Predicate * predicates, int numPredicates );
 
+ bool record_query (Entry *entry, QueryPlan *plan);
+
+ int ht_flushBatch (ScanBatch *batch, QueryPlan *plan, KeySink *sink, int numKeysFound);
+
  char whatDataType (char* startIndex);
 
  bool bootlegEqualTo (char * predValue, char *hashTableValue);
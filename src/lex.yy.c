@@ -368,8 +368,8 @@ static void yy_fatal_error (yyconst char msg[]  );
 	*yy_cp = '\0'; \
 	(yy_c_buf_p) = yy_cp;
 
-#define YY_NUM_RULES 24
-#define YY_END_OF_BUFFER 25
+#define YY_NUM_RULES 32
+#define YY_END_OF_BUFFER 33
 /* This struct is not used in this scanner,
    but its presence is necessary. */
 struct yy_trans_info
@@ -377,20 +377,28 @@ struct yy_trans_info
 	flex_int32_t yy_verify;
 	flex_int32_t yy_nxt;
 	};
-static yyconst flex_int16_t yy_accept[109] =
+static yyconst flex_int16_t yy_accept[189] =
     {   0,
-       18,   18,   25,   23,   15,   16,   15,   23,   23,   19,
-       17,   23,   18,   23,   18,   18,   18,   18,   18,   18,
-       18,   15,   15,    1,    0,    0,    5,    0,    0,   19,
-        0,   17,   18,    0,    0,   18,   18,   18,   18,   18,
-       18,   18,   18,    0,   20,   21,    0,    0,   22,   18,
-       18,   18,    7,   18,   18,   18,   18,    4,    0,    0,
-        6,   18,   18,   18,   18,   18,   18,    0,    3,   18,
-        0,   18,   18,   11,   18,    2,   18,    0,   18,   18,
-       18,   18,    0,   18,    0,   18,   18,    0,   13,    0,
-        0,   12,   18,    0,    0,    0,   18,    0,    0,    0,
-
-        8,    0,    9,   10,    0,    0,   14,    0
+       25,   25,   33,   31,   22,   23,   22,   31,   31,   27,
+       26,   24,   31,   25,   31,   25,   25,   25,   25,   25,
+       25,   25,   25,   25,   25,   22,   22,    1,    0,    0,
+        5,    0,    0,   27,   26,    0,   24,   25,    0,    0,
+       25,   25,   25,   25,   25,   25,   25,   25,   25,   25,
+       25,   25,   25,    0,   28,   29,    0,    0,   30,   25,
+       25,   25,   25,   25,   25,   25,    7,   25,   25,   25,
+       25,   25,   25,   25,    4,    0,    0,   25,    6,   25,
+       25,   25,   25,   25,   25,   25,   25,   25,   25,   25,
+       25,    0,    3,   25,   25,   27,   25,   25,   25,   25,
+
+       25,   25,   25,   18,   25,   25,    2,   25,   25,   27,
+       25,   14,   25,   25,   25,   25,   25,   25,   25,   13,
+       25,   27,   25,   15,   25,   25,   27,   25,   25,   27,
+       25,   27,   25,   25,   20,   27,   27,   25,   19,   27,
+       25,   27,   25,   27,   27,   27,   27,   27,   25,   27,
+       11,   27,   27,   27,   27,   27,    8,   27,   27,   16,
+       17,   27,   27,   27,   27,   27,   27,   27,   27,   27,
+       27,   21,   27,   27,    9,   27,   27,   27,   27,   27,
+       12,   27,   27,   27,   27,   27,   10,    0
     } ;
 
 static yyconst flex_int32_t yy_ec[256] =
@@ -399,16 +407,16 @@ static yyconst flex_int32_t yy_ec[256] =
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    4,    1,    1,    5,    1,    1,    1,    6,    1,
-        1,    1,    1,    7,    1,    8,    1,    9,    9,    9,
-        9,    9,    9,    9,    9,    9,    9,   10,    1,    1,
-        1,    1,    1,    1,   11,   11,   11,   11,   11,   11,
-       11,   11,   11,   11,   11,   11,   11,   11,   11,   11,
-       11,   11,   11,   11,   11,   11,   11,   11,   11,   11,
-       12,    1,   13,    1,   14,    1,   15,   16,   17,   18,
-
-       19,   11,   11,   20,   21,   11,   11,   22,   23,   24,
-       25,   26,   11,   27,   28,   29,   30,   31,   32,   11,
-       33,   11,    1,    1,    1,    1,    1,    1,    1,    1,
+        1,    1,    1,    7,    8,    9,    8,   10,   10,   10,
+       10,   10,   10,   10,   10,   10,   10,   11,    1,    1,
+        1,    1,    1,    1,   12,   12,   12,   12,   12,   12,
+       12,   12,   12,   12,   12,   12,   12,   12,   12,   12,
+       12,   12,   12,   12,   12,   12,   12,   12,   12,   12,
+       13,    1,   14,    1,   15,    1,   16,   17,   18,   19,
+
+       20,   12,   21,   22,   23,   12,   24,   25,   26,   27,
+       28,   29,   12,   30,   31,   32,   33,   34,   35,   36,
+       37,   12,    1,    1,    1,    8,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
@@ -425,116 +433,144 @@ static yyconst flex_int32_t yy_ec[256] =
         1,    1,    1,    1,    1
     } ;
 
-static yyconst flex_int32_t yy_meta[34] =
+static yyconst flex_int32_t yy_meta[38] =
     {   0,
-        1,    1,    1,    2,    1,    1,    1,    3,    3,    1,
-        3,    1,    1,    1,    3,    3,    3,    3,    3,    3,
-        3,    3,    3,    3,    3,    3,    3,    3,    3,    3,
-        3,    3,    3
+        1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
+        1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
+        1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
+        1,    1,    1,    1,    1,    1,    1
     } ;
 
-static yyconst flex_int16_t yy_base[112] =
+static yyconst flex_int16_t yy_base[189] =
     {   0,
-        0,    0,  235,  253,   32,  253,   33,  231,   31,    0,
-       38,  229,   36,  223,   44,   45,   46,   47,   53,   59,
-       67,   54,   74,  253,  222,  227,  253,  222,  221,    0,
-       55,   73,   75,   76,   76,   83,   84,   86,   92,   95,
-       97,   98,  103,  100,  253,  253,  204,  199,  253,  108,
-      121,  122,  123,  124,  132,  135,  137,  253,  193,  176,
-      138,  140,  145,  143,  146,  152,  154,  176,  253,  164,
-      169,  165,  172,  173,  178,  253,  175,  153,  180,  181,
-      188,  190,  140,  196,   84,  193,  202,  147,  209,  136,
-      130,  211,  212,  117,  105,   93,  214,   90,   89,   88,
-
-      217,   48,  253,  253,   41,   33,  253,  253,  247,   36,
-      249
+        0,    0,   38,  312,   37,  312,   36,   49,   35,   79,
+      108,  142,   39,   34,   35,   15,  125,  164,   63,   65,
+       77,  128,  103,   90,   94,    0,    0,  312,  113,    0,
+      312,  143,  144,    0,    0,  177,    0,    0,  133,  143,
+      164,  167,  157,  153,  156,  166,  170,  160,  162,  177,
+      177,  175,  166,  184,  312,  312,  177,  173,  312,  177,
+      173,  186,  189,  190,  184,  188,    0,  193,  179,  177,
+      183,  188,  184,  191,  312,  200,  185,  198,    0,  186,
+      205,  204,  195,  187,  199,  190,  206,  196,  208,  202,
+      210,  201,  312,  200,  203,  215,  212,  216,  217,  213,
+
+      211,  210,  219,    0,  226,  213,  312,  213,  215,  223,
+      222,    0,  229,  229,  220,  236,  224,  227,  239,    0,
+      235,  226,  234,    0,  233,  240,  238,  229,  242,  231,
+      237,  245,  234,  253,    0,  241,  242,  256,    0,  250,
+      255,  256,  238,  245,  246,  248,  256,  250,  244,  250,
+        0,  265,  252,  253,  259,  267,    0,  260,  273,    0,
+        0,  258,  275,  262,  266,  274,  276,  259,  282,  268,
+      268,    0,  268,  267,    0,  280,  287,  274,  280,  286,
+        0,  276,  286,  281,  285,  292,    0,  312
     } ;
 
-static yyconst flex_int16_t yy_def[112] =
+static yyconst flex_int16_t yy_def[189] =
     {   0,
-      108,    1,  108,  108,  108,  108,  108,  109,  108,  110,
-      111,  108,  111,  108,  111,  111,  111,  111,  111,  111,
-      111,  108,  108,  108,  108,  109,  108,  108,  108,  110,
-      108,  111,  111,  108,  108,  111,  111,  111,  111,  111,
-      111,  111,  111,  108,  108,  108,  108,  108,  108,  111,
-      111,  111,  111,  111,  111,  111,  111,  108,  108,  108,
-      111,  111,  111,  111,  111,  111,  111,  108,  108,  111,
-      108,  111,  111,  111,  111,  108,  111,  108,  111,  111,
-      111,  111,  108,  111,  108,  111,  111,  108,  111,  108,
-      108,  111,  111,  108,  108,  108,  111,  108,  108,  108,
-
-      111,  108,  108,  108,  108,  108,  108,    0,  108,  108,
-      108
+      188,    1,  188,  188,  188,  188,    5,  188,  188,  188,
+       10,   11,  188,   12,  188,   14,   14,   14,   14,   14,
+       14,   14,   14,   14,   14,    5,    7,  188,  188,    8,
+      188,  188,  188,   10,   11,  188,   12,   14,   13,   15,
+       14,   14,   14,   14,   14,   14,   14,   14,   14,   14,
+       14,   14,   14,   29,  188,  188,  188,  188,  188,   14,
+       14,   14,   14,   14,   14,   14,   14,   14,   14,   14,
+       14,   14,   14,   14,  188,  188,  188,   14,   14,   14,
+       14,   14,   14,   14,   14,   14,   14,   14,   14,   14,
+       14,  188,  188,   14,   14,   10,   14,   14,   14,   14,
+
+       14,   14,   14,   14,   14,   14,  188,   14,   14,   10,
+       14,   14,   14,   14,   14,   14,   14,   14,   14,   14,
+       14,   10,   14,   14,   14,   14,   10,   14,   14,   10,
+       14,   10,   14,   14,   14,   10,   10,   14,   14,   10,
+       14,   10,   14,   10,   10,   10,   10,   10,   14,   10,
+       14,   10,   10,   10,   10,   10,   14,   10,   10,   10,
+       10,   10,   10,   10,   10,   10,   10,   10,   10,   10,
+       10,   10,   10,   10,   10,   10,   10,   10,   10,   10,
+       10,   10,   10,   10,   10,   10,   10,  188
     } ;
 
-static yyconst flex_int16_t yy_nxt[287] =
+static yyconst flex_int16_t yy_nxt[350] =
     {   0,
         4,    5,    6,    7,    8,    9,    4,   10,   11,   12,
-       13,   14,    4,    4,   13,   13,   15,   16,   13,   13,
-       17,   13,   13,   13,   13,   18,   13,   19,   20,   21,
-       13,   13,   13,   22,   22,   22,   23,   28,   30,   31,
-       29,   31,   24,   30,   25,   30,   32,   31,   31,   31,
-       31,   30,   30,   30,   30,   22,   31,   22,   31,   38,
-       30,   40,   31,   36,   24,  107,   30,  106,   37,   39,
-       31,   41,  105,   42,   30,   22,   31,   23,   31,   34,
-       30,   32,   30,   24,   35,   25,   31,   31,   49,   31,
-       30,   30,   47,   30,   43,   31,   48,   50,   31,   30,
-
-       31,   31,   30,   90,   30,   30,   31,   51,   44,   91,
-       30,   31,   58,   56,   52,   30,  104,  103,  102,  100,
-       53,   57,   54,   55,   31,   31,   31,   31,   30,   30,
-       30,   30,   99,   98,   61,   31,   63,   62,   31,   30,
-       31,   31,   30,   31,   30,   30,   31,   30,   31,   31,
-       30,   64,   30,   30,   96,   31,   66,   31,   71,   30,
-       95,   30,   65,   67,   73,   94,   88,   31,   31,   70,
-       74,   30,   30,   83,   72,   31,   31,   75,   31,   30,
-       30,   31,   30,   31,   31,   30,   78,   30,   30,   79,
-       77,   31,   81,   31,   85,   30,   31,   30,   80,   31,
-
-       30,   82,   76,   30,   69,   31,   84,   68,   87,   30,
-       86,   92,   31,   89,   31,   31,   30,   31,   30,   30,
-       31,   30,   60,   59,   30,   93,   46,   45,   97,   27,
-       44,   35,   34,   27,  108,  108,  108,  108,  108,  108,
-      108,  108,  108,  108,  108,  108,  101,   26,   26,   26,
-       33,   33,    3,  108,  108,  108,  108,  108,  108,  108,
-      108,  108,  108,  108,  108,  108,  108,  108,  108,  108,
-      108,  108,  108,  108,  108,  108,  108,  108,  108,  108,
-      108,  108,  108,  108,  108,  108
+       13,   14,   15,    4,   10,   14,   16,   17,   18,   19,
+       14,   14,   20,   14,   14,   14,   14,   14,   21,   14,
+       22,   23,   24,   14,   25,   14,   14,  188,   26,   27,
+       26,   32,   39,   38,   40,   33,   28,   41,   29,   30,
+       30,   31,   30,   30,   30,   30,   30,   30,   30,   30,
+       30,   30,   30,   30,   30,   30,   30,   30,   30,   30,
+       30,   30,   30,   30,   30,   30,   30,   30,   30,   30,
+       30,   30,   30,   30,   30,   30,   34,   34,   34,   46,
+       34,   47,   48,   34,   34,   34,   34,   34,   34,   34,
+
+       34,   34,   34,   34,   34,   34,   34,   34,   34,   34,
+       34,   34,   34,   34,   34,   34,   35,   35,   51,   35,
+       52,   53,   54,   35,   35,   35,   35,   35,   35,   35,
+       35,   35,   35,   35,   35,   35,   35,   35,   35,   35,
+       35,   35,   35,   35,   35,   36,   42,   49,   55,   56,
+       57,   37,   43,   38,   50,   58,   59,   38,   38,   38,
+       38,   38,   38,   38,   38,   38,   38,   38,   38,   38,
+       38,   38,   38,   38,   38,   38,   38,   38,   38,   44,
+       36,   60,   61,   62,   63,   64,   65,   28,   66,   68,
+       69,   70,   71,   72,   73,   74,   45,   75,   76,   77,
+
+       78,   67,   79,   80,   81,   82,   83,   84,   85,   86,
+       87,   88,   89,   90,   91,   92,   93,   94,   95,   96,
+       97,   98,   99,  100,  101,  102,  103,  104,  105,  106,
+      107,  108,  109,  110,  111,  112,  113,  114,  115,  116,
+      117,  118,  119,  120,  121,  122,  123,  124,  125,  126,
+      127,  128,  129,  130,  131,  132,  133,  134,  135,  136,
+      138,  139,  140,  141,  142,  143,  137,  144,  145,  146,
+      147,  148,  149,  150,  151,  152,  153,  154,  155,  156,
+      157,  158,  159,  160,  161,  162,  163,  164,  165,  166,
+      167,  168,  169,  170,  171,  172,  173,  174,  175,  176,
+
+      177,  178,  179,  180,  181,  182,  183,  184,  185,  186,
+      187,    3,  188,  188,  188,  188,  188,  188,  188,  188,
+      188,  188,  188,  188,  188,  188,  188,  188,  188,  188,
+      188,  188,  188,  188,  188,  188,  188,  188,  188,  188,
+      188,  188,  188,  188,  188,  188,  188,  188,  188
     } ;
 
-static yyconst flex_int16_t yy_chk[287] =
+static yyconst flex_int16_t yy_chk[350] =
     {   0,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
-        1,    1,    1,    5,    7,    5,    7,    9,  110,   13,
-        9,   11,    7,   13,    7,   11,   11,   15,   16,   17,
-       18,   15,   16,   17,   18,   22,   19,   22,   31,   16,
-       19,   18,   20,   15,   31,  106,   20,  105,   15,   17,
-       21,   19,  102,   20,   21,   23,   32,   23,   33,   34,
-       32,   32,   33,   23,   35,   23,   36,   37,   35,   38,
-       36,   37,   34,   38,   21,   39,   34,   36,   40,   39,
-
-       41,   42,   40,   85,   41,   42,   43,   37,   44,   85,
-       43,   50,   44,   42,   38,   50,  100,   99,   98,   96,
-       39,   43,   40,   41,   51,   52,   53,   54,   51,   52,
-       53,   54,   95,   94,   50,   55,   52,   51,   56,   55,
-       57,   61,   56,   62,   57,   61,   64,   62,   63,   65,
-       64,   54,   63,   65,   91,   66,   56,   67,   63,   66,
-       90,   67,   55,   57,   65,   88,   83,   70,   72,   62,
-       66,   70,   72,   78,   64,   73,   74,   67,   77,   73,
-       74,   75,   77,   79,   80,   75,   71,   79,   80,   72,
-       70,   81,   75,   82,   80,   81,   86,   82,   73,   84,
-
-       86,   77,   68,   84,   60,   87,   79,   59,   82,   87,
-       81,   86,   89,   84,   92,   93,   89,   97,   92,   93,
-      101,   97,   48,   47,  101,   87,   29,   28,   93,   26,
-       25,   14,   12,    8,    3,    0,    0,    0,    0,    0,
-        0,    0,    0,    0,    0,    0,   97,  109,  109,  109,
-      111,  111,  108,  108,  108,  108,  108,  108,  108,  108,
-      108,  108,  108,  108,  108,  108,  108,  108,  108,  108,
-      108,  108,  108,  108,  108,  108,  108,  108,  108,  108,
-      108,  108,  108,  108,  108,  108
+        1,    1,    1,    1,    1,    1,    1,    3,    5,    7,
+        5,    9,   13,   14,   15,    9,    7,   16,    7,    8,
+        8,    8,    8,    8,    8,    8,    8,    8,    8,    8,
+        8,    8,    8,    8,    8,    8,    8,    8,    8,    8,
+        8,    8,    8,    8,    8,    8,    8,    8,    8,    8,
+        8,    8,    8,    8,    8,    8,   10,   10,   10,   19,
+       10,   20,   21,   10,   10,   10,   10,   10,   10,   10,
+
+       10,   10,   10,   10,   10,   10,   10,   10,   10,   10,
+       10,   10,   10,   10,   10,   10,   11,   11,   23,   11,
+       24,   25,   29,   11,   11,   11,   11,   11,   11,   11,
+       11,   11,   11,   11,   11,   11,   11,   11,   11,   11,
+       11,   11,   11,   11,   11,   12,   17,   22,   32,   33,
+       39,   12,   17,   12,   22,   39,   40,   12,   12,   12,
+       12,   12,   12,   12,   12,   12,   12,   12,   12,   12,
+       12,   12,   12,   12,   12,   12,   12,   12,   12,   18,
+       36,   41,   42,   43,   44,   45,   46,   36,   47,   48,
+       48,   49,   50,   51,   52,   53,   18,   54,   57,   58,
+
+       60,   47,   61,   62,   63,   64,   65,   66,   68,   69,
+       70,   71,   72,   73,   74,   76,   77,   78,   80,   81,
+       82,   83,   84,   85,   86,   87,   88,   89,   90,   91,
+       92,   94,   95,   96,   97,   98,   99,  100,  101,  102,
+      103,  105,  106,  108,  109,  110,  111,  113,  114,  115,
+      116,  117,  118,  119,  121,  122,  123,  125,  126,  127,
+      128,  129,  130,  131,  132,  133,  127,  134,  136,  137,
+      138,  140,  141,  142,  143,  144,  145,  146,  147,  148,
+      149,  150,  152,  153,  154,  155,  156,  158,  159,  162,
+      163,  164,  165,  166,  167,  168,  169,  170,  171,  173,
+
+      174,  176,  177,  178,  179,  180,  182,  183,  184,  185,
+      186,  188,  188,  188,  188,  188,  188,  188,  188,  188,
+      188,  188,  188,  188,  188,  188,  188,  188,  188,  188,
+      188,  188,  188,  188,  188,  188,  188,  188,  188,  188,
+      188,  188,  188,  188,  188,  188,  188,  188,  188
     } ;
 
 static yy_state_type yy_last_accepting_state;
@@ -560,7 +596,7 @@ char *yytext;
 	#include "config_parser.tab.h"
 	//extern int yylval;
 
-#line 564 "lex.yy.c"
+#line 600 "lex.yy.c"
 
 #define INITIAL 0
 
@@ -747,9 +783,9 @@ YY_DECL
 	register char *yy_cp, *yy_bp;
 	register int yy_act;
     
-#line 16 "config_parser.l"
+#line 17 "config_parser.l"
 
-#line 753 "lex.yy.c"
+#line 789 "lex.yy.c"
 
 	if ( !(yy_init) )
 		{
@@ -802,13 +838,13 @@ yy_match:
 			while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 				{
 				yy_current_state = (int) yy_def[yy_current_state];
-				if ( yy_current_state >= 109 )
+				if ( yy_current_state >= 189 )
 					yy_c = yy_meta[(unsigned int) yy_c];
 				}
 			yy_current_state = yy_nxt[yy_base[yy_current_state] + (unsigned int) yy_c];
 			++yy_cp;
 			}
-		while ( yy_base[yy_current_state] != 253 );
+		while ( yy_base[yy_current_state] != 312 );
 
 yy_find_action:
 		yy_act = yy_accept[yy_current_state];
@@ -834,116 +870,156 @@ do_action:	/* This label is used only to access EOF actions. */
 
 case 1:
 YY_RULE_SETUP
-#line 17 "config_parser.l"
+#line 18 "config_parser.l"
 { return TABLE_INVALID;}
 	YY_BREAK
 case 2:
 YY_RULE_SETUP
-#line 18 "config_parser.l"
+#line 19 "config_parser.l"
 { return TABLE_INVALID;}
 	YY_BREAK
 case 3:
 YY_RULE_SETUP
-#line 19 "config_parser.l"
+#line 20 "config_parser.l"
 { return TABLE_INVALID;}
 	YY_BREAK
 case 4:
 YY_RULE_SETUP
-#line 20 "config_parser.l"
+#line 21 "config_parser.l"
 {return TABLE_INVALID;}
 	YY_BREAK
 case 5:
 /* rule 5 can match eol */
 YY_RULE_SETUP
-#line 21 "config_parser.l"
+#line 22 "config_parser.l"
 { 	  }
 	YY_BREAK
 case 6:
 YY_RULE_SETUP
-#line 23 "config_parser.l"
+#line 24 "config_parser.l"
 { return CHAR; }
 	YY_BREAK
 case 7:
 YY_RULE_SETUP
-#line 24 "config_parser.l"
+#line 25 "config_parser.l"
 { return INT; }
 	YY_BREAK
 case 8:
 YY_RULE_SETUP
-#line 25 "config_parser.l"
+#line 26 "config_parser.l"
 { return CONCURRENCY;}
 	YY_BREAK
 case 9:
 YY_RULE_SETUP
-#line 26 "config_parser.l"
-{ return HOST_PROPERTY; }
+#line 27 "config_parser.l"
+{ return WORKER_THREADS;}
 	YY_BREAK
 case 10:
 YY_RULE_SETUP
-#line 27 "config_parser.l"
-{ return PORT_PROPERTY; }
+#line 28 "config_parser.l"
+{ return PARALLEL_SCAN_THRESHOLD;}
 	YY_BREAK
 case 11:
 YY_RULE_SETUP
-#line 28 "config_parser.l"
-{ return TABLE; }
+#line 29 "config_parser.l"
+{ return DURABILITY;}
 	YY_BREAK
 case 12:
 YY_RULE_SETUP
-#line 29 "config_parser.l"
-{ return USER_NAME;}
+#line 30 "config_parser.l"
+{ return SNAPSHOT_INTERVAL;}
 	YY_BREAK
 case 13:
 YY_RULE_SETUP
-#line 30 "config_parser.l"
-{ return PASSWORD;}
+#line 31 "config_parser.l"
+{ return BUCKETS;}
 	YY_BREAK
 case 14:
 YY_RULE_SETUP
-#line 31 "config_parser.l"
-{ return DDIR_PROPERTY; }
+#line 32 "config_parser.l"
+{ return ENGINE;}
 	YY_BREAK
 case 15:
 YY_RULE_SETUP
 #line 33 "config_parser.l"
-{              }
+{ return INDEXED;}
 	YY_BREAK
 case 16:
-/* rule 16 can match eol */
 YY_RULE_SETUP
 #line 34 "config_parser.l"
-{return NEWLINE;}
+{ return HOST_PROPERTY; }
 	YY_BREAK
 case 17:
 YY_RULE_SETUP
+#line 35 "config_parser.l"
+{ return PORT_PROPERTY; }
+	YY_BREAK
+case 18:
+YY_RULE_SETUP
 #line 36 "config_parser.l"
+{ return TABLE; }
+	YY_BREAK
+case 19:
+YY_RULE_SETUP
+#line 37 "config_parser.l"
+{ return USER_NAME;}
+	YY_BREAK
+case 20:
+YY_RULE_SETUP
+#line 38 "config_parser.l"
+{ return PASSWORD;}
+	YY_BREAK
+case 21:
+YY_RULE_SETUP
+#line 39 "config_parser.l"
+{ return DDIR_PROPERTY; }
+	YY_BREAK
+case 22:
+YY_RULE_SETUP
+#line 41 "config_parser.l"
+{              }
+	YY_BREAK
+case 23:
+/* rule 23 can match eol */
+YY_RULE_SETUP
+#line 42 "config_parser.l"
+{return NEWLINE;}
+	YY_BREAK
+case 24:
+YY_RULE_SETUP
+#line 44 "config_parser.l"
 { yylval.pval = (int) atoi(yytext);
                    return NUMBER; }
 	YY_BREAK
-case 18:
+case 25:
 YY_RULE_SETUP
-#line 38 "config_parser.l"
+#line 46 "config_parser.l"
 { yylval.sval = strdup(yytext);
 	  	     return STRING; }
 	YY_BREAK
-case 19:
+case 26:
 YY_RULE_SETUP
-#line 40 "config_parser.l"
+#line 48 "config_parser.l"
 {yylval.sval = strdup(yytext); return passString;}	  	     
 	YY_BREAK
-case 20:
+case 27:
 YY_RULE_SETUP
-#line 41 "config_parser.l"
+#line 49 "config_parser.l"
+{ yylval.sval = strdup(yytext); return PATH; }
+	YY_BREAK
+case 28:
+YY_RULE_SETUP
+#line 50 "config_parser.l"
 { return ',';}		
 	YY_BREAK
-case 21:
+case 29:
 YY_RULE_SETUP
-#line 42 "config_parser.l"
+#line 51 "config_parser.l"
 { return ':';}
 	YY_BREAK
-case 22:
+case 30:
 YY_RULE_SETUP
-#line 43 "config_parser.l"
+#line 52 "config_parser.l"
 {    char * text = strdup(yytext+1);
 				 char * pch = strchr(text,']');
 				 int length = pch-text;
@@ -951,22 +1027,22 @@ YY_RULE_SETUP
 				 pch[length] = NULL;
 				 yylval.sval = pch; return SIZE;}
 	YY_BREAK
-case 23:
+case 31:
 YY_RULE_SETUP
-#line 51 "config_parser.l"
+#line 60 "config_parser.l"
 { return yytext[0]; }
 	YY_BREAK
 case YY_STATE_EOF(INITIAL):
-#line 52 "config_parser.l"
+#line 61 "config_parser.l"
 { static int once;
           return once++ ? 0 : NEWLINE; }
 	YY_BREAK
-case 24:
+case 32:
 YY_RULE_SETUP
-#line 55 "config_parser.l"
+#line 64 "config_parser.l"
 ECHO;
 	YY_BREAK
-#line 970 "lex.yy.c"
+#line 1046 "lex.yy.c"
 
 	case YY_END_OF_BUFFER:
 		{
@@ -1256,7 +1332,7 @@ static int yy_get_next_buffer (void)
 		while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 			{
 			yy_current_state = (int) yy_def[yy_current_state];
-			if ( yy_current_state >= 109 )
+			if ( yy_current_state >= 189 )
 				yy_c = yy_meta[(unsigned int) yy_c];
 			}
 		yy_current_state = yy_nxt[yy_base[yy_current_state] + (unsigned int) yy_c];
@@ -1284,11 +1360,11 @@ static int yy_get_next_buffer (void)
 	while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 		{
 		yy_current_state = (int) yy_def[yy_current_state];
-		if ( yy_current_state >= 109 )
+		if ( yy_current_state >= 189 )
 			yy_c = yy_meta[(unsigned int) yy_c];
 		}
 	yy_current_state = yy_nxt[yy_base[yy_current_state] + (unsigned int) yy_c];
-	yy_is_jam = (yy_current_state == 108);
+	yy_is_jam = (yy_current_state == 188);
 
 	return yy_is_jam ? 0 : yy_current_state;
 }
@@ -1962,7 +2038,7 @@ void yyfree (void * ptr )
 
 #define YYTABLES_NAME "yytables"
 
-#line 55 "config_parser.l"
+#line 64 "config_parser.l"
 
 
 
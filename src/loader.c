@@ -0,0 +1,296 @@
+/**
+ * @file
+ * @brief This file implements the bulk loader of the storage server.
+ *
+ * The file is mapped read-only; each line is copied to a buffer on the
+ * stack to be split and '\0' ended, which costs little next to setting
+ * the record. The chunks are run on a worker pool created for the load.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "loader.h"
+#include "workQueue.h"
+
+#define LOADER_MIN_PART (64 * 1024)	///< Bytes below which a file is not split further.
+
+/**
+ * @brief A pass over the chunks of a file in progress.
+ */
+typedef struct loadPass {
+	pthread_mutex_t lock;
+	pthread_cond_t done;
+	int pending;		///< Chunks not finished yet.
+} LoadPass;
+
+/**
+ * @brief One chunk of the file: whole lines, from start to end.
+ */
+typedef struct loadPart {
+	HashTable *hashtable;
+	Schema *schema;
+	const char *start;
+	const char *end;
+	int lines;		///< Lines in the chunk, once counted.
+	const LoadLog *log;
+	LoadStats stats;
+	bool failed;		///< Out of memory, or the log failed, setting a record.
+	LoadPass *pass;
+} LoadPart;
+
+/**
+ * @brief A record being set, for logRecord().
+ */
+typedef struct loadRecord {
+	const LoadLog *log;
+	const char *key;
+	const char *value;
+} LoadRecord;
+
+/**
+ * @brief Tells the pass that a chunk is done.
+ */
+static void finishPart(LoadPart *part)
+{
+	pthread_mutex_lock(&part->pass->lock);
+	if (--part->pass->pending == 0)
+		pthread_cond_signal(&part->pass->done);
+	pthread_mutex_unlock(&part->pass->lock);
+}
+
+/**
+ * @brief Counts the lines of a chunk.
+ */
+static void countPart(void *arg)
+{
+	LoadPart *part = (LoadPart *)arg;
+	const char *p = part->start;
+
+	part->lines = 0;
+	while (p < part->end) {
+		const char *newline = (const char *)memchr(p, '\n', (size_t)(part->end - p));
+		part->lines++;
+		p = newline != NULL ? newline + 1 : part->end;
+	}
+	finishPart(part);
+}
+
+/**
+ * @brief Tells whether a key is one SET would accept.
+ */
+static bool validKey(const char *key)
+{
+	size_t len = 0;
+
+	for (; key[len] != '\0'; len++) {
+		char c = key[len];
+		if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')))
+			return false;
+	}
+	return len > 0 && len <= MAX_KEY_LEN;
+}
+
+/**
+ * @brief Hands a record about to be set to the log of the load.
+ */
+static int logRecord(uintptr_t version, void *arg)
+{
+	LoadRecord *record = (LoadRecord *)arg;
+
+	return record->log->append(record->key, record->value, version, record->log->arg);
+}
+
+/**
+ * @brief Parses, checks and sets the records of a chunk.
+ */
+static void loadPart(void *arg)
+{
+	LoadPart *part = (LoadPart *)arg;
+	Schema *schema = part->schema;
+	char line[MAX_KEY_LEN + MAX_VALUE_LEN + 2];
+	char row[MAX_ROW_SIZE];
+	const char *p = part->start;
+	int uncommitted = 0;
+
+	while (p < part->end && !part->failed) {
+		const char *newline = (const char *)memchr(p, '\n', (size_t)(part->end - p));
+		const char *lineEnd = newline != NULL ? newline : part->end;
+		size_t len = (size_t)(lineEnd - p);
+		const char *next = newline != NULL ? newline + 1 : part->end;
+
+		if (len > 0 && p[len - 1] == '\r')
+			len--;
+		if (len == 0) {
+			p = next;
+			continue;
+		}
+		if (len >= sizeof line) {
+			part->stats.rejected++;
+			p = next;
+			continue;
+		}
+		memcpy(line, p, len);
+		line[len] = '\0';
+		p = next;
+
+		char *comma = strchr(line, ',');
+		if (comma == NULL || comma[1] == '\0') {
+			part->stats.rejected++;
+			continue;
+		}
+		*comma = '\0';
+		char *value = comma + 1;
+		if (!validKey(line) || strlen(value) >= MAX_VALUE_LEN
+				|| (schema->numColumns > 0 && !parseRow(schema, value, row))) {
+			part->stats.rejected++;
+			continue;
+		}
+
+		LoadRecord record = { part->log, line, value };
+		int status = ht_setLogged(part->hashtable, line, value, schema->numColumns > 0 ? row : NULL, 0, NULL,
+				part->log != NULL ? logRecord : NULL, &record);
+		if (status == HASH_SET_INSERT || status == HASH_SET_UPDATE)
+			part->stats.loaded++;
+		else {
+			part->stats.rejected++;
+			part->failed = true;
+		}
+
+		if (part->log != NULL && ++uncommitted == LOADER_COMMIT_RECORDS) {
+			uncommitted = 0;
+			if (part->log->commit(part->log->arg) != 0)
+				part->failed = true;
+		}
+	}
+	if (part->log != NULL && uncommitted > 0 && part->log->commit(part->log->arg) != 0)
+		part->failed = true;
+
+	/* The lines left after an error are not set. */
+	while (p < part->end) {
+		const char *newline = (const char *)memchr(p, '\n', (size_t)(part->end - p));
+		size_t len = (size_t)((newline != NULL ? newline : part->end) - p);
+		if (len > 0 && p[len - 1] == '\r')
+			len--;
+		if (len > 0)
+			part->stats.rejected++;
+		p = newline != NULL ? newline + 1 : part->end;
+	}
+	finishPart(part);
+}
+
+/**
+ * @brief Runs a function on every chunk and waits for them all.
+ *
+ * @param queue The pool, or NULL to run on this thread.
+ */
+static void runPass(WorkQueue *queue, LoadPart *parts, int numParts, void (*run)(void *arg))
+{
+	LoadPass pass;
+	int p;
+
+	pthread_mutex_init(&pass.lock, NULL);
+	pthread_cond_init(&pass.done, NULL);
+	pass.pending = numParts;
+	for (p = 0; p < numParts; p++) {
+		parts[p].pass = &pass;
+		if (queue == NULL || wq_push(queue, run, &parts[p]) != 0)
+			run(&parts[p]);
+	}
+	pthread_mutex_lock(&pass.lock);
+	while (pass.pending > 0)
+		pthread_cond_wait(&pass.done, &pass.lock);
+	pthread_mutex_unlock(&pass.lock);
+	pthread_mutex_destroy(&pass.lock);
+	pthread_cond_destroy(&pass.done);
+}
+
+int loader_load(HashTable *hashtable, Schema *schema, const char *path, int numThreads, const LoadLog *log,
+		LoadStats *stats)
+{
+	struct stat st;
+	int status = 0;
+	int p;
+
+	stats->loaded = 0;
+	stats->rejected = 0;
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return -1;
+	}
+	if (st.st_size == 0) {
+		close(fd);
+		return 0;
+	}
+	size_t size = (size_t)st.st_size;
+	char *data = (char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return -1;
+	madvise(data, size, MADV_SEQUENTIAL);
+
+	if (numThreads <= 0)
+		numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (numThreads <= 0)
+		numThreads = 1;
+	int numParts = numThreads * LOADER_PARTS_PER_THREAD;
+	if ((size_t)numParts > size / LOADER_MIN_PART + 1)
+		numParts = (int)(size / LOADER_MIN_PART + 1);
+	LoadPart *parts = (LoadPart *)calloc((size_t)numParts, sizeof(LoadPart));
+	if (parts == NULL) {
+		munmap(data, size);
+		return -1;
+	}
+
+	/* Each chunk starts after the newline at or past its share of the file. */
+	const char *start = data;
+	for (p = 0; p < numParts; p++) {
+		const char *end = data + size;
+		if (p + 1 < numParts) {
+			const char *cut = data + size / numParts * (p + 1);
+			if (cut < start)
+				cut = start;
+			const char *newline = (const char *)memchr(cut, '\n', (size_t)(data + size - cut));
+			end = newline != NULL ? newline + 1 : data + size;
+		}
+		parts[p].hashtable = hashtable;
+		parts[p].schema = schema;
+		parts[p].log = log;
+		parts[p].start = start;
+		parts[p].end = end;
+		start = end;
+	}
+
+	WorkQueue *queue = numThreads > 1 && numParts > 1 ? wq_create(numThreads, numParts) : NULL;
+
+	/* Grow the table once for every line, rather than a step at a time. */
+	runPass(queue, parts, numParts, countPart);
+	int64_t lines = ht_count(hashtable);
+	for (p = 0; p < numParts; p++)
+		lines += parts[p].lines;
+	if (ht_reserve(hashtable, lines < INT_MAX ? (int)lines : INT_MAX) != 0)
+		status = -1;
+
+	if (status == 0)
+		runPass(queue, parts, numParts, loadPart);
+	if (queue != NULL)
+		wq_destroy(queue);
+
+	for (p = 0; p < numParts; p++) {
+		stats->loaded += parts[p].stats.loaded;
+		stats->rejected += parts[p].stats.rejected;
+		if (parts[p].failed)
+			status = -1;
+	}
+	if (status != 0)
+		errno = ENOMEM;
+	free(parts);
+	munmap(data, size);
+	return status;
+}
@@ -0,0 +1,61 @@
+/**
+ * @file
+ * @brief This file declares the bulk loader of the storage server.
+ *
+ * A CSV file of "key,value" lines, local to the server, is mapped into
+ * memory and split into chunks on line boundaries. The lines are
+ * counted first, so the table grows once to hold them all, then the
+ * chunks are parsed, checked against the schema of the table and set on
+ * several threads at once. Each record set can be logged first, as SET
+ * logs its change.
+ */
+#ifndef LOADER_H
+#define LOADER_H
+
+#include "hashTable.h"
+
+#define LOADER_PARTS_PER_THREAD 4	///< Chunks per thread, so the threads finish together.
+#define LOADER_COMMIT_RECORDS 4096	///< Records a chunk sets between commits of the log.
+
+/**
+ * @brief What a load did.
+ */
+typedef struct loadStats {
+	int loaded;		///< Records set.
+	int rejected;		///< Lines not set: a bad key, a value not fitting the schema, or left after an error.
+} LoadStats;
+
+/**
+ * @brief Where a load logs the records it sets.
+ */
+typedef struct loadLog {
+	/// Called under the lock of a record just before it is set, as ht_setLogged()
+	/// calls its log; nonzero gives the record up and stops its chunk.
+	int (*append)(const char *key, const char *value, uintptr_t version, void *arg);
+	/// Called every LOADER_COMMIT_RECORDS records a chunk sets and when it
+	/// ends, without locks, to make them durable; nonzero stops the chunk.
+	int (*commit)(void *arg);
+	void *arg;		///< Passed to append and commit.
+} LoadLog;
+
+/**
+ * @brief Load the records of a CSV file into a table.
+ *
+ * Each line is a key, a comma and a value. A key must be alphanumeric
+ * and a value must fit the schema of the table; other lines are
+ * skipped. Records already in the table are replaced.
+ *
+ * @param hashtable The table.
+ * @param schema The schema of the table; one with no columns for an untyped table.
+ * @param path The file.
+ * @param numThreads The number of threads to parse and set on; 0 for one per CPU.
+ * @param log Where to log each record set, or NULL.
+ * @param stats Set to the records loaded and the lines skipped, also on
+ * error: the records loaded stay set, and logged.
+ * @return Returns 0 on success, -1 if the file could not be read,
+ * memory ran out or a record could not be logged.
+ */
+int loader_load(HashTable *hashtable, Schema *schema, const char *path, int numThreads, const LoadLog *log,
+		LoadStats *stats);
+
+#endif
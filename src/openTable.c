@@ -0,0 +1,498 @@
+/**
+ * @file
+ * @brief This file implements the open-addressing table engine.
+ *
+ * Each shard is a power-of-two array of slots probed linearly with
+ * Robin Hood hashing: a record being inserted takes the slot of any
+ * record that is closer to its own home slot, which keeps probe
+ * sequences short and lets a failed lookup stop early. Removal shifts
+ * the following records back, so there are no tombstones.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "openTable.h"
+
+/**
+ * @brief Returns the shard a hash value belongs to.
+ */
+static OtShard *ot_shard(OpenTable *table, uint64_t hash)
+{
+	return &table->shards[hash >> (64 - OT_SHARD_BITS)];
+}
+
+/**
+ * @brief Returns the schema of the rows of a table, or NULL if unknown.
+ */
+static Schema *ot_schema(OpenTable *table)
+{
+	return table->owner != NULL ? table->owner->schema : NULL;
+}
+
+/**
+ * @brief Returns the key stored in a used slot.
+ */
+static char *ot_slotKey(OtSlot *slot)
+{
+	return slot->keyLen < OT_INLINE_KEY ? slot->key.inlineKey : slot->key.heapKey;
+}
+
+/**
+ * @brief Finds the slot of a key in a shard.
+ *
+ * The caller holds the shard lock.
+ *
+ * @return Returns the slot index, or -1 if the key is not in the shard.
+ */
+static int ot_find(OtShard *shard, uint32_t hash, const char *key, size_t len)
+{
+	uint32_t i = hash & shard->mask;
+	uint32_t dist = 1;
+
+	for (;;) {
+		OtSlot *slot = &shard->slots[i];
+		/* The key would have displaced any record closer to its home slot. */
+		if (slot->dist < dist)
+			return -1;
+		if (slot->hash == hash && slot->keyLen == len && memcmp(ot_slotKey(slot), key, len) == 0)
+			return (int)i;
+		i = (i + 1) & shard->mask;
+		dist++;
+	}
+}
+
+/**
+ * @brief Puts a record into a shard that does not contain its key.
+ *
+ * The caller holds the shard lock for writing and has made room.
+ */
+static void ot_place(OtShard *shard, OtSlot carry)
+{
+	uint32_t i = carry.hash & shard->mask;
+	carry.dist = 1;
+
+	for (;;) {
+		OtSlot *slot = &shard->slots[i];
+		if (slot->dist == 0) {
+			*slot = carry;
+			return;
+		}
+		/* Take the slot from a record that is closer to home. */
+		if (slot->dist < carry.dist) {
+			OtSlot displaced = *slot;
+			*slot = carry;
+			carry = displaced;
+		}
+		i = (i + 1) & shard->mask;
+		carry.dist++;
+	}
+}
+
+/**
+ * @brief Doubles the slot array of a shard.
+ *
+ * The caller holds the shard lock for writing.
+ *
+ * @return Returns 0 on success, -1 if out of memory.
+ */
+static int ot_grow(OtShard *shard)
+{
+	OtSlot *old = shard->slots;
+	uint32_t oldSlots = shard->mask + 1;
+	OtSlot *slots = (OtSlot *)calloc((size_t)oldSlots * 2, sizeof(OtSlot));
+	if (slots == NULL)
+		return -1;
+
+	shard->slots = slots;
+	shard->mask = oldSlots * 2 - 1;
+	uint32_t i;
+	for (i = 0; i < oldSlots; i++) {
+		if (old[i].dist != 0)
+			ot_place(shard, old[i]);
+	}
+	free(old);
+	return 0;
+}
+
+/**
+ * @brief Frees the key and value of a used slot.
+ */
+static void ot_freeSlot(OtSlot *slot)
+{
+	if (slot->keyLen >= OT_INLINE_KEY)
+		free(slot->key.heapKey);
+	free(slot->value);
+	free(slot->row);
+}
+
+OpenTable *ot_create(int size)
+{
+	if (size < 1)
+		return NULL;
+
+	OpenTable *table = (OpenTable *)malloc(sizeof(OpenTable));
+	if (table == NULL)
+		return NULL;
+
+	/* Enough slots per shard to hold its share of size records under OT_MAX_LOAD. */
+	uint64_t wanted = (uint64_t)size * 100 / OT_MAX_LOAD / OT_SHARDS + 1;
+	uint32_t slots = OT_MIN_SLOTS;
+	while (slots < wanted)
+		slots *= 2;
+
+	table->owner = NULL;
+	table->count = 0;
+	int i;
+	for (i = 0; i < OT_SHARDS; i++) {
+		OtShard *shard = &table->shards[i];
+		shard->slots = (OtSlot *)calloc(slots, sizeof(OtSlot));
+		shard->mask = slots - 1;
+		shard->count = 0;
+		zm_reset(&shard->zone);
+		pthread_rwlock_init(&shard->lock, NULL);
+		if (shard->slots == NULL) {
+			pthread_rwlock_destroy(&shard->lock);
+			while (--i >= 0) {
+				free(table->shards[i].slots);
+				pthread_rwlock_destroy(&table->shards[i].lock);
+			}
+			free(table);
+			return NULL;
+		}
+	}
+	return table;
+}
+
+int ot_set(OpenTable *table, char *key, char *value, char *row, int rowSize, uintptr_t metadata, uintptr_t *version,
+		HtLogChange log, void *arg)
+{
+	size_t len = strlen(key);
+	if (len > UINT16_MAX)
+		return HASH_SET_FAIL;
+	uint64_t hash = ht_hashKey(key, len);
+	OtShard *shard = ot_shard(table, hash);
+	int status;
+
+	pthread_rwlock_wrlock(&shard->lock);
+	int i = ot_find(shard, (uint32_t)hash, key, len);
+
+	/* There's already a record.  Replace its value. */
+	if (i != -1) {
+		OtSlot *slot = &shard->slots[i];
+		char *oldRow = slot->row;
+		char *newRow = NULL;
+		char *copy = NULL;
+		if (metadata != 0 && slot->metadata != metadata) {
+			status = HASH_SET_ABORT;
+		} else if ((row != NULL && oldRow == NULL && (newRow = (char *)malloc(rowSize)) == NULL)
+				|| (copy = myStrDup(value)) == NULL
+				|| (log != NULL && log(version != NULL && *version != 0 ? *version : slot->metadata + 1, arg) != 0)) {
+			free(newRow);
+			free(copy);
+			status = HASH_SET_FAIL;
+		} else {
+			/* Before the old row is overwritten. */
+			if (table->owner != NULL)
+				ht_indexRecord(table->owner, key, oldRow, row);
+			zm_loosen(&shard->zone);
+			zm_add(&shard->zone, ot_schema(table), row);
+			free(slot->value);
+			slot->value = copy;
+			if (row != NULL) {
+				if (newRow != NULL)
+					slot->row = newRow;
+				memcpy(slot->row, row, rowSize);
+			} else {
+				free(slot->row);
+				slot->row = NULL;
+			}
+			slot->metadata += 1;
+			if (version != NULL) {
+				if (*version != 0)
+					slot->metadata = *version;
+				*version = slot->metadata;
+			}
+			status = HASH_SET_UPDATE;
+		}
+
+	/* A versioned set of a record that does not exist. */
+	} else if (metadata != 0) {
+		status = HASH_SET_ABORT;
+
+	} else {
+		OtSlot carry;
+		memset(&carry, 0, sizeof(carry));
+		carry.hash = (uint32_t)hash;
+		carry.keyLen = (uint16_t)len;
+		carry.metadata = version != NULL && *version != 0 ? *version : rand();
+		carry.value = myStrDup(value);
+		if (row != NULL && (carry.row = (char *)malloc(rowSize)) != NULL)
+			memcpy(carry.row, row, rowSize);
+		if (len < OT_INLINE_KEY)
+			memcpy(carry.key.inlineKey, key, len + 1);
+		else
+			carry.key.heapKey = myStrDup(key);
+
+		if (carry.value == NULL || (row != NULL && carry.row == NULL) || (len >= OT_INLINE_KEY && carry.key.heapKey == NULL)
+				|| ((uint64_t)(shard->count + 1) * 100 > (uint64_t)(shard->mask + 1) * OT_MAX_LOAD
+					&& ot_grow(shard) != 0)
+				|| (log != NULL && log(carry.metadata, arg) != 0)) {
+			/* We have run out of memory, or the change was given up */
+			ot_freeSlot(&carry);
+			status = HASH_SET_FAIL;
+		} else {
+			if (version != NULL)
+				*version = carry.metadata;
+			ot_place(shard, carry);
+			shard->count++;
+			__sync_fetch_and_add(&table->count, 1);
+			if (table->owner != NULL)
+				ht_indexRecord(table->owner, key, NULL, row);
+			zm_add(&shard->zone, ot_schema(table), row);
+			status = HASH_SET_INSERT;
+		}
+	}
+
+	pthread_rwlock_unlock(&shard->lock);
+	return status;
+}
+
+Entry *ot_get(OpenTable *table, char *key)
+{
+	static __thread Entry view;
+	size_t len = strlen(key);
+	uint64_t hash = ht_hashKey(key, len);
+	OtShard *shard = ot_shard(table, hash);
+
+	int i = ot_find(shard, (uint32_t)hash, key, len);
+	if (i == -1)
+		return NULL;
+
+	OtSlot *slot = &shard->slots[i];
+	view.key = ot_slotKey(slot);
+	view.value = slot->value;
+	view.metadata = slot->metadata;
+	view.hash = hash;
+	view.row = slot->row;
+	view.next = NULL;
+	return &view;
+}
+
+int ot_getRecord(OpenTable *table, char *key, char **value, uintptr_t *metadata)
+{
+	size_t len = strlen(key);
+	uint64_t hash = ht_hashKey(key, len);
+	OtShard *shard = ot_shard(table, hash);
+	int status = KEY_NOT_FOUND;
+
+	pthread_rwlock_rdlock(&shard->lock);
+	int i = ot_find(shard, (uint32_t)hash, key, len);
+	if (i != -1) {
+		*value = myStrDup(shard->slots[i].value);
+		*metadata = shard->slots[i].metadata;
+		status = *value != NULL ? 0 : -1;
+	}
+	pthread_rwlock_unlock(&shard->lock);
+	return status;
+}
+
+int ot_removeItem(OpenTable *table, char *key, HtLogChange log, void *arg)
+{
+	size_t len = strlen(key);
+	uint64_t hash = ht_hashKey(key, len);
+	OtShard *shard = ot_shard(table, hash);
+	int status = KEY_NOT_FOUND;
+
+	pthread_rwlock_wrlock(&shard->lock);
+	int found = ot_find(shard, (uint32_t)hash, key, len);
+	if (found != -1 && log != NULL && log(0, arg) != 0) {
+		status = HASH_SET_FAIL;
+	} else if (found != -1) {
+		uint32_t i = (uint32_t)found;
+		uint32_t next = (i + 1) & shard->mask;
+		if (table->owner != NULL)
+			ht_indexRecord(table->owner, key, shard->slots[i].row, NULL);
+		zm_loosen(&shard->zone);
+		ot_freeSlot(&shard->slots[i]);
+
+		/* Shift the following displaced records one slot closer to home. */
+		while (shard->slots[next].dist > 1) {
+			shard->slots[i] = shard->slots[next];
+			shard->slots[i].dist--;
+			i = next;
+			next = (next + 1) & shard->mask;
+		}
+		memset(&shard->slots[i], 0, sizeof(OtSlot));
+		shard->count--;
+		__sync_fetch_and_sub(&table->count, 1);
+		status = HASH_SET_DELETE;
+	}
+	pthread_rwlock_unlock(&shard->lock);
+	return status;
+}
+
+int ot_query(OpenTable *table, QueryPlan *plan, KeySink *sink)
+{
+	return ot_queryShards(table, plan, 0, OT_SHARDS, sink);
+}
+
+int ot_queryShards(OpenTable *table, QueryPlan *plan, int first, int last, KeySink *sink)
+{
+	int numKeysFound = 0;
+	ScanBatch batch;
+	int s;
+
+	batch.count = 0;
+	for (s = first; s < last; s++) {
+		OtShard *shard = &table->shards[s];
+		ZoneMap bounds;
+		bool tighten;
+		uint32_t i;
+
+		pthread_rwlock_rdlock(&shard->lock);
+		if (zm_excludes(&shard->zone, plan)) {
+			pthread_rwlock_unlock(&shard->lock);
+			continue;
+		}
+		/* Reading the whole shard anyway, recompute loose bounds. */
+		tighten = zm_isLoose(&shard->zone);
+		if (tighten)
+			zm_reset(&bounds);
+		for (i = 0; i <= shard->mask; i++) {
+			OtSlot *slot = &shard->slots[i];
+			if (slot->dist == 0)
+				continue;
+			if (tighten)
+				zm_add(&bounds, ot_schema(table), slot->row);
+
+			Entry *entry = &batch.entries[batch.count++];
+			entry->key = ot_slotKey(slot);
+			entry->value = slot->value;
+			entry->metadata = slot->metadata;
+			entry->row = slot->row;
+			if (batch.count == QP_BATCH)
+				numKeysFound = ht_flushBatch(&batch, plan, sink, numKeysFound);
+		}
+		/* The batch points into the shard. */
+		numKeysFound = ht_flushBatch(&batch, plan, sink, numKeysFound);
+		if (tighten)
+			zm_publish(&shard->zone, &bounds);
+		pthread_rwlock_unlock(&shard->lock);
+	}
+	return numKeysFound;
+}
+
+int ot_queryBucket(OpenTable *table, QueryPlan *plan, int shard, uint64_t bucket, char ***keysFound, uint64_t *mask)
+{
+	OtShard *s = &table->shards[shard];
+	int numKeysFound = 0;
+	int capacity = 0;
+	int status = 0;
+	uint32_t i, dist;
+
+	*keysFound = NULL;
+	pthread_rwlock_rdlock(&s->lock);
+	*mask = s->mask;
+
+	/* Records of a home slot follow it, before any record of a later home. */
+	i = (uint32_t)bucket & s->mask;
+	for (dist = 1; status == 0 && s->slots[i].dist >= dist; dist++) {
+		OtSlot *slot = &s->slots[i];
+		Entry entry = { .key = ot_slotKey(slot), .value = slot->value, .metadata = slot->metadata, .row = slot->row };
+		if (slot->dist == dist && record_query(&entry, plan))
+			status = ht_collectKey(keysFound, &numKeysFound, &capacity, entry.key);
+		i = (i + 1) & s->mask;
+	}
+	pthread_rwlock_unlock(&s->lock);
+
+	if (status != 0) {
+		while (numKeysFound > 0)
+			free((*keysFound)[--numKeysFound]);
+		free(*keysFound);
+		*keysFound = NULL;
+		return -1;
+	}
+	return numKeysFound;
+}
+
+bool ot_matchKey(OpenTable *table, char *key, QueryPlan *plan)
+{
+	size_t len = strlen(key);
+	uint64_t hash = ht_hashKey(key, len);
+	OtShard *shard = ot_shard(table, hash);
+	bool matches = false;
+
+	pthread_rwlock_rdlock(&shard->lock);
+	int i = ot_find(shard, (uint32_t)hash, key, len);
+	if (i != -1) {
+		OtSlot *slot = &shard->slots[i];
+		Entry entry = { .key = ot_slotKey(slot), .value = slot->value, .metadata = slot->metadata, .row = slot->row };
+		matches = record_query(&entry, plan);
+	}
+	pthread_rwlock_unlock(&shard->lock);
+	return matches;
+}
+
+int ot_reserve(OpenTable *table, int count)
+{
+	uint64_t wanted = (uint64_t)count * 100 / OT_MAX_LOAD / OT_SHARDS + 1;
+	int status = 0;
+	int s;
+
+	for (s = 0; s < OT_SHARDS && status == 0; s++) {
+		OtShard *shard = &table->shards[s];
+		pthread_rwlock_wrlock(&shard->lock);
+		while (status == 0 && (uint64_t)shard->mask + 1 < wanted)
+			status = ot_grow(shard);
+		pthread_rwlock_unlock(&shard->lock);
+	}
+	return status;
+}
+
+void ot_freeze(OpenTable *table)
+{
+	int s;
+	for (s = 0; s < OT_SHARDS; s++)
+		pthread_rwlock_wrlock(&table->shards[s].lock);
+}
+
+void ot_thaw(OpenTable *table)
+{
+	int s;
+	for (s = OT_SHARDS - 1; s >= 0; s--)
+		pthread_rwlock_unlock(&table->shards[s].lock);
+}
+
+int ot_forEach(OpenTable *table, int (*visit)(Entry *entry, void *arg), void *arg)
+{
+	int s;
+	for (s = 0; s < OT_SHARDS; s++) {
+		OtShard *shard = &table->shards[s];
+		uint32_t i;
+		for (i = 0; i <= shard->mask; i++) {
+			OtSlot *slot = &shard->slots[i];
+			if (slot->dist == 0)
+				continue;
+			Entry entry = { .key = ot_slotKey(slot), .value = slot->value, .metadata = slot->metadata, .row = slot->row };
+			int status = visit(&entry, arg);
+			if (status != 0)
+				return status;
+		}
+	}
+	return 0;
+}
+
+void ot_destroy(OpenTable *table)
+{
+	int s;
+	for (s = 0; s < OT_SHARDS; s++) {
+		OtShard *shard = &table->shards[s];
+		uint32_t i;
+		for (i = 0; i <= shard->mask; i++) {
+			if (shard->slots[i].dist != 0)
+				ot_freeSlot(&shard->slots[i]);
+		}
+		free(shard->slots);
+		pthread_rwlock_destroy(&shard->lock);
+	}
+	free(table);
+}
@@ -0,0 +1,212 @@
+/**
+ * @file
+ * @brief This file declares the open-addressing table engine.
+ *
+ * An alternative to the chained buckets of hashTable.c, selected per
+ * table with "engine open" in the configuration file. Records live in
+ * flat slot arrays probed with Robin Hood hashing, the hash of each
+ * key is kept in its slot and short keys are stored inline, so a
+ * lookup usually touches one or two cache lines instead of following
+ * three separately allocated blocks.
+ *
+ * The table is split into OT_SHARDS shards by the top bits of the
+ * hash. Each shard has its own slot array and reader-writer lock and
+ * grows on its own.
+ */
+#ifndef OPEN_TABLE
+#define OPEN_TABLE
+
+#include <stdint.h>
+#include <pthread.h>
+#include "hashTable.h"
+
+#define OT_SHARD_BITS 6
+#define OT_SHARDS (1 << OT_SHARD_BITS)	///< Independently locked parts of a table.
+#define OT_INLINE_KEY 24	///< Keys shorter than this are stored in the slot itself.
+#define OT_MAX_LOAD 85		///< Percentage of used slots above which a shard doubles.
+#define OT_MIN_SLOTS 8		///< Smallest slot array of a shard.
+
+/**
+ * @brief A slot of the open-addressing table.
+ */
+typedef struct otSlot {
+	uint32_t hash;		///< Low bits of the hash of the key.
+	uint16_t dist;		///< One plus the distance from the home slot; 0 if empty.
+	uint16_t keyLen;
+	uintptr_t metadata;
+	char *value;
+	char *row;		///< The typed row, or NULL if the record is untyped.
+	union {
+		char inlineKey[OT_INLINE_KEY];	///< The key, if keyLen < OT_INLINE_KEY.
+		char *heapKey;			///< Otherwise, a copy of the key.
+	} key;
+} OtSlot;
+
+/**
+ * @brief One independently locked and resized part of a table.
+ */
+typedef struct otShard {
+	OtSlot *slots;
+	uint32_t mask;		///< Number of slots minus one; the number of slots is a power of two.
+	uint32_t count;		///< Number of used slots.
+	pthread_rwlock_t lock;
+	ZoneMap zone;		///< Bounds of the records of the shard.
+} OtShard;
+
+/**
+ * @brief An open-addressing table.
+ */
+typedef struct openTable {
+	OtShard shards[OT_SHARDS];
+	HashTable *owner;	///< The table whose secondary indexes follow changes, or NULL.
+	int count;		///< Number of records, changed atomically.
+} OpenTable;
+
+/**
+ * @brief Create an empty table.
+ *
+ * @param size The expected number of records.
+ * @return Returns the table, or NULL if out of memory.
+ */
+OpenTable *ot_create(int size);
+
+/**
+ * @brief Set a record, optionally only if it has the given metadata.
+ *
+ * @param table The table.
+ * @param key The key.
+ * @param value The value.
+ * @param row The typed row, or NULL to store the record untyped.
+ * @param rowSize The size of a row.
+ * @param metadata The expected metadata of the record, or 0 to set unconditionally.
+ * @param version If not NULL, the metadata given to and set from the record, as ht_setVersion().
+ * @param log If not NULL, called before the change is made, as ht_setLogged().
+ * @param arg Passed to log.
+ * @return Returns HASH_SET_INSERT, HASH_SET_UPDATE, HASH_SET_FAIL or HASH_SET_ABORT,
+ * as ht_setVersion().
+ */
+int ot_set(OpenTable *table, char *key, char *value, char *row, int rowSize, uintptr_t metadata, uintptr_t *version,
+		HtLogChange log, void *arg);
+
+/**
+ * @brief Look up a record without locking.
+ *
+ * @param table The table.
+ * @param key The key.
+ * @return Returns a per-thread Entry pointing into the table, valid until
+ * the next call or the next change to the table; NULL if there is no such key.
+ */
+Entry *ot_get(OpenTable *table, char *key);
+
+/**
+ * @brief Copy out the value and metadata of a record.
+ *
+ * @param table The table.
+ * @param key The key.
+ * @param value Set to a copy of the value, which the caller must free.
+ * @param metadata Set to the metadata of the record.
+ * @return Returns 0 on success, KEY_NOT_FOUND if there is no such key,
+ * -1 if out of memory.
+ */
+int ot_getRecord(OpenTable *table, char *key, char **value, uintptr_t *metadata);
+
+/**
+ * @brief Remove a record.
+ *
+ * @param table The table.
+ * @param key The key.
+ * @param log If not NULL, called before the record is removed, as ht_removeLogged().
+ * @param arg Passed to log.
+ * @return Returns HASH_SET_DELETE if the record was removed, HASH_SET_FAIL
+ * if log gave it up, KEY_NOT_FOUND otherwise.
+ */
+int ot_removeItem(OpenTable *table, char *key, HtLogChange log, void *arg);
+
+/**
+ * @brief Find the keys of the records matching every predicate.
+ *
+ * @param table The table.
+ * @param plan The compiled query.
+ * @param sink Gets the keys of the matching records.
+ * @return Returns the number of matching records.
+ */
+int ot_query(OpenTable *table, QueryPlan *plan, KeySink *sink);
+
+/**
+ * @brief Find the keys of the matching records in a range of shards.
+ *
+ * @param table The table.
+ * @param plan The compiled query.
+ * @param first The first shard.
+ * @param last One past the last shard.
+ * @param sink Gets the keys of the matching records.
+ * @return Returns the number of matching records.
+ */
+int ot_queryShards(OpenTable *table, QueryPlan *plan, int first, int last, KeySink *sink);
+
+/**
+ * @brief Find the matching records whose home slot is a given bucket.
+ *
+ * @param table The table.
+ * @param plan The compiled query.
+ * @param shard The shard.
+ * @param bucket The bucket cursor; its bits under the shard's mask give the home slot.
+ * @param keysFound Set to a malloc'ed array of copies of the keys; free both.
+ * @param mask Set to the slot mask of the shard, for ht_cursorAdvance().
+ * @return Returns the number of keys, or -1 if out of memory.
+ */
+int ot_queryBucket(OpenTable *table, QueryPlan *plan, int shard, uint64_t bucket, char ***keysFound, uint64_t *mask);
+
+/**
+ * @brief Tell whether the record with a given key matches a query.
+ *
+ * @param table The table.
+ * @param key The key.
+ * @param plan The compiled query.
+ * @return true if the record exists and matches.
+ */
+bool ot_matchKey(OpenTable *table, char *key, QueryPlan *plan);
+
+/**
+ * @brief Grow every shard of a table at once to hold its share of a
+ * number of records.
+ *
+ * @param table The table.
+ * @param count The number of records to make room for.
+ * @return Returns 0 on success, -1 if out of memory.
+ */
+int ot_reserve(OpenTable *table, int count);
+
+/**
+ * @brief Block every change to a table, and every lookup, by taking
+ * each shard lock exclusively.
+ *
+ * @param table The table.
+ */
+void ot_freeze(OpenTable *table);
+
+/**
+ * @brief Release the locks taken by ot_freeze().
+ *
+ * @param table The table.
+ */
+void ot_thaw(OpenTable *table);
+
+/**
+ * @brief Visit every record of a table without locking.
+ *
+ * @param table The table, frozen or used by no other thread.
+ * @param visit Called with a view of each record; a nonzero return stops the walk.
+ * @param arg Passed to visit.
+ * @return Returns 0, or the nonzero value returned by visit.
+ */
+int ot_forEach(OpenTable *table, int (*visit)(Entry *entry, void *arg), void *arg);
+
+/**
+ * @brief Free a table and every record in it.
+ *
+ * @param table The table.
+ */
+void ot_destroy(OpenTable *table);
+
+#endif
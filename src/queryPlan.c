@@ -0,0 +1,286 @@
+/**
+ * @file
+ * @brief This file implements compiled QUERY plans and their cache.
+ *
+ * The cache is direct mapped on the hash of the predicate string. A
+ * plan is reference counted, so a query keeps using its plan while
+ * another thread replaces it in the cache.
+ */
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "queryPlan.h"
+#include "hashTable.h"
+
+static QueryPlan *qp_cache[QP_CACHE_SIZE];
+static pthread_rwlock_t qp_cacheLock = PTHREAD_RWLOCK_INITIALIZER;
+
+/**
+ * @brief Compares count values with a constant; bit i of the result
+ * is set if values[i] op constant holds.
+ */
+typedef uint64_t (*QueryKernel)(const int64_t *values, int count, char op, int64_t constant);
+
+static QueryKernel qp_kernel;
+static pthread_once_t qp_kernelOnce = PTHREAD_ONCE_INIT;
+
+static bool qp_never(const char *row, const QueryStep *step)
+{
+	return false;
+}
+
+static int64_t qp_field(const char *row, const QueryStep *step)
+{
+	int64_t number;
+	memcpy(&number, row + step->offset, sizeof(number));
+	return number;
+}
+
+static bool qp_intEqual(const char *row, const QueryStep *step)
+{
+	return qp_field(row, step) == step->number;
+}
+
+static bool qp_intLess(const char *row, const QueryStep *step)
+{
+	return qp_field(row, step) < step->number;
+}
+
+static bool qp_intGreater(const char *row, const QueryStep *step)
+{
+	return qp_field(row, step) > step->number;
+}
+
+static bool qp_charEqual(const char *row, const QueryStep *step)
+{
+	return strcmp(row + step->offset, step->string) == 0;
+}
+
+static uint64_t qp_kernelScalar(const int64_t *values, int count, char op, int64_t constant)
+{
+	uint64_t bits = 0;
+	int i;
+
+	if (op == '=') {
+		for (i = 0; i < count; i++)
+			bits |= (uint64_t)(values[i] == constant) << i;
+	}
+	else if (op == '<') {
+		for (i = 0; i < count; i++)
+			bits |= (uint64_t)(values[i] < constant) << i;
+	}
+	else {
+		for (i = 0; i < count; i++)
+			bits |= (uint64_t)(values[i] > constant) << i;
+	}
+	return bits;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse4.2")))
+static uint64_t qp_kernelSse42(const int64_t *values, int count, char op, int64_t constant)
+{
+	__m128i c = _mm_set1_epi64x(constant);
+	uint64_t bits = 0;
+	int i;
+
+	for (i = 0; i + 2 <= count; i += 2) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(values + i));
+		__m128i m = op == '=' ? _mm_cmpeq_epi64(v, c) : op == '<' ? _mm_cmpgt_epi64(c, v) : _mm_cmpgt_epi64(v, c);
+		bits |= (uint64_t)_mm_movemask_pd(_mm_castsi128_pd(m)) << i;
+	}
+	if (i < count)
+		bits |= qp_kernelScalar(values + i, count - i, op, constant) << i;
+	return bits;
+}
+
+__attribute__((target("avx2")))
+static uint64_t qp_kernelAvx2(const int64_t *values, int count, char op, int64_t constant)
+{
+	__m256i c = _mm256_set1_epi64x(constant);
+	uint64_t bits = 0;
+	int i;
+
+	for (i = 0; i + 4 <= count; i += 4) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(values + i));
+		__m256i m = op == '=' ? _mm256_cmpeq_epi64(v, c) : op == '<' ? _mm256_cmpgt_epi64(c, v) : _mm256_cmpgt_epi64(v, c);
+		bits |= (uint64_t)_mm256_movemask_pd(_mm256_castsi256_pd(m)) << i;
+	}
+	if (i < count)
+		bits |= qp_kernelScalar(values + i, count - i, op, constant) << i;
+	return bits;
+}
+#endif
+
+/**
+ * @brief Picks the kernel for the CPU we run on.
+ */
+static void qp_pickKernel(void)
+{
+	qp_kernel = qp_kernelScalar;
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		qp_kernel = qp_kernelAvx2;
+	else if (__builtin_cpu_supports("sse4.2"))
+		qp_kernel = qp_kernelSse42;
+#endif
+}
+
+/**
+ * @brief Bind a predicate to its column and pick its comparison.
+ *
+ * Predicates no typed row can satisfy, on a missing column, with a
+ * constant of the wrong type or ordering strings, get qp_never.
+ */
+static void qp_bind(Schema *schema, Predicate *predicate, QueryStep *step)
+{
+	int j;
+
+	memset(step, 0, sizeof(QueryStep));
+	step->match = qp_never;
+	step->column = -1;
+	strcpy(step->string, predicate->value);
+
+	for (j = 0; j < schema->numColumns; j++) {
+		Column *column = &schema->columns[j];
+		if (strcmp(column->name, predicate->column) != 0)
+			continue;
+
+		step->column = j;
+		step->type = column->type;
+		step->offset = column->offset;
+		if (column->type == COLUMN_INT) {
+			char *p;
+			errno = 0;
+			step->number = strtoll(predicate->value, &p, 10);
+			if (p == predicate->value || *p != '\0' || errno != 0)
+				return;
+			if (predicate->op == '=')
+				step->match = qp_intEqual;
+			else if (predicate->op == '<')
+				step->match = qp_intLess;
+			else if (predicate->op == '>')
+				step->match = qp_intGreater;
+		}
+		else if (predicate->op == '=' && strlen(predicate->value) <= (size_t)column->size)
+			step->match = qp_charEqual;
+		if (step->match != qp_never)
+			step->op = predicate->op;
+		return;
+	}
+}
+
+/**
+ * @brief Compile the predicate string of a query.
+ */
+static QueryPlan *qp_compile(struct config_params *params, int tableIndex, char *predicates)
+{
+	Schema *schema = &params->table_names[tableIndex].schema;
+	QueryPlan *plan = (QueryPlan *)calloc(1, sizeof(QueryPlan));
+	if (plan == NULL)
+		return NULL;
+
+	plan->tableIndex = tableIndex;
+	plan->text = myStrDup(predicates);
+	plan->numPredicates = getNumPredicates(predicates);
+	plan->predicates = createPredicateList(plan->numPredicates, predicates);
+	plan->steps = (QueryStep *)malloc(sizeof(QueryStep) * (plan->numPredicates > 0 ? plan->numPredicates : 1));
+	plan->refs = 1;
+	if (plan->text == NULL || (plan->predicates == NULL && plan->numPredicates > 0) || plan->steps == NULL) {
+		qp_release(plan);
+		return NULL;
+	}
+
+	plan->valid = isPredicateValid(plan->predicates, params, tableIndex, plan->numPredicates);
+	int i;
+	for (i = 0; i < plan->numPredicates; i++)
+		qp_bind(schema, &plan->predicates[i], &plan->steps[i]);
+
+	/* Answer from an index on an equality if there is one, else on a range. */
+	plan->indexStep = -1;
+	for (i = 0; i < plan->numPredicates; i++) {
+		QueryStep *step = &plan->steps[i];
+		if (step->op == 0 || !schema->columns[step->column].indexed)
+			continue;
+		if (step->op == '=') {
+			plan->indexStep = i;
+			break;
+		}
+		if (plan->indexStep == -1)
+			plan->indexStep = i;
+	}
+	return plan;
+}
+
+QueryPlan *qp_get(struct config_params *params, int tableIndex, char *predicates)
+{
+	int slot = (ht_hashKey(predicates, strlen(predicates)) + tableIndex) & (QP_CACHE_SIZE - 1);
+	QueryPlan *plan;
+
+	pthread_rwlock_rdlock(&qp_cacheLock);
+	plan = qp_cache[slot];
+	if (plan != NULL && plan->tableIndex == tableIndex && strcmp(plan->text, predicates) == 0)
+		__sync_fetch_and_add(&plan->refs, 1);
+	else
+		plan = NULL;
+	pthread_rwlock_unlock(&qp_cacheLock);
+	if (plan != NULL)
+		return plan;
+
+	plan = qp_compile(params, tableIndex, predicates);
+	if (plan == NULL)
+		return NULL;
+
+	/* One reference for the cache, one for the caller. */
+	plan->refs = 2;
+	pthread_rwlock_wrlock(&qp_cacheLock);
+	QueryPlan *old = qp_cache[slot];
+	qp_cache[slot] = plan;
+	pthread_rwlock_unlock(&qp_cacheLock);
+	if (old != NULL)
+		qp_release(old);
+	return plan;
+}
+
+uint64_t qp_matchBatch(const QueryPlan *plan, const char *const *rows, int count)
+{
+	int64_t values[QP_BATCH];
+	uint64_t bits = count == QP_BATCH ? ~(uint64_t)0 : ((uint64_t)1 << count) - 1;
+	int i, j;
+
+	pthread_once(&qp_kernelOnce, qp_pickKernel);
+	for (i = 0; i < count; i++) {
+		if (rows[i] == NULL)
+			bits &= ~((uint64_t)1 << i);
+	}
+
+	/* Each step narrows the rows still matching. */
+	for (j = 0; j < plan->numPredicates && bits != 0; j++) {
+		const QueryStep *step = &plan->steps[j];
+		if (step->op != 0 && step->type == COLUMN_INT) {
+			for (i = 0; i < count; i++)
+				values[i] = rows[i] != NULL ? qp_field(rows[i], step) : 0;
+			bits &= qp_kernel(values, count, step->op, step->number);
+		}
+		else {
+			for (i = 0; i < count; i++) {
+				if ((bits >> i & 1) && !step->match(rows[i], step))
+					bits &= ~((uint64_t)1 << i);
+			}
+		}
+	}
+	return bits;
+}
+
+void qp_release(QueryPlan *plan)
+{
+	if (__sync_sub_and_fetch(&plan->refs, 1) != 0)
+		return;
+	free(plan->text);
+	free(plan->predicates);
+	free(plan->steps);
+	free(plan);
+}
@@ -0,0 +1,104 @@
+/**
+ * @file
+ * @brief This file declares compiled QUERY plans and their cache.
+ *
+ * A plan is compiled once from the predicate string of a QUERY: each
+ * predicate is resolved to a column of the table schema, its constant
+ * converted to the column type and a comparison function chosen. Plans
+ * are kept in a small cache, so repeating a query skips parsing and
+ * validating its predicates.
+ */
+#ifndef QUERY_PLAN
+#define QUERY_PLAN
+
+#include <stdint.h>
+#include <pthread.h>
+#include "utils.h"
+
+#define QP_CACHE_SIZE 256	///< Slots of the plan cache, a power of two.
+#define QP_BATCH 64		///< Rows qp_matchBatch() takes at once, one bit each.
+
+struct queryStep;
+
+/**
+ * @brief Compares a field of a typed row with the constant of a step.
+ */
+typedef bool (*QueryMatch)(const char *row, const struct queryStep *step);
+
+/**
+ * @brief One predicate of a plan, bound to a column of the schema.
+ */
+typedef struct queryStep {
+	QueryMatch match;
+	char op;		///< '=', '<' or '>'; 0 if no typed row can match.
+	int type;		///< COLUMN_INT or COLUMN_CHAR, the type of the column.
+	int column;		///< Ordinal of the column in the schema, or -1 if there is none.
+	int offset;		///< Offset of the column's field in a row.
+	int64_t number;		///< The constant, for COLUMN_INT.
+	char string[MAX_VALUE_LEN];	///< The constant, for COLUMN_CHAR.
+} QueryStep;
+
+/**
+ * @brief A compiled QUERY.
+ *
+ * Plans are shared between threads and never change once compiled.
+ */
+typedef struct queryPlan {
+	int tableIndex;
+	char *text;		///< The predicate string the plan was compiled from.
+	int valid;		///< VALID or INVALID, as isPredicateValid().
+	int numPredicates;
+	Predicate *predicates;	///< The parsed predicates, for records stored untyped.
+	QueryStep *steps;	///< The predicates bound to the schema.
+	int indexStep;		///< The step to answer with a secondary index, or -1 to scan.
+	int refs;		///< References held by the cache and by running queries.
+} QueryPlan;
+
+/**
+ * @brief Get the plan of a query, compiling it unless it is cached.
+ *
+ * @param params The configuration holding the table schemas.
+ * @param tableIndex The index of the table in params.
+ * @param predicates The predicate string of the query.
+ * @return Returns the plan, to be released with qp_release(), or NULL if out of memory.
+ */
+QueryPlan *qp_get(struct config_params *params, int tableIndex, char *predicates);
+
+/**
+ * @brief Release a plan returned by qp_get().
+ *
+ * @param plan The plan.
+ */
+void qp_release(QueryPlan *plan);
+
+/**
+ * @brief Match up to QP_BATCH typed rows against every predicate of a plan.
+ *
+ * Comparisons on int columns run over the gathered column values with
+ * the widest vector instructions the CPU supports.
+ *
+ * @param plan The plan.
+ * @param rows The rows; NULL entries never match.
+ * @param count The number of rows, at most QP_BATCH.
+ * @return A bitmap with bit i set if rows[i] matches.
+ */
+uint64_t qp_matchBatch(const QueryPlan *plan, const char *const *rows, int count);
+
+/**
+ * @brief Tell whether a typed row matches every predicate of a plan.
+ *
+ * @param plan The plan.
+ * @param row The row.
+ * @return true if the row matches.
+ */
+static inline bool qp_matchRow(const QueryPlan *plan, const char *row)
+{
+	int i;
+	for (i = 0; i < plan->numPredicates; i++) {
+		if (!plan->steps[i].match(row, &plan->steps[i]))
+			return false;
+	}
+	return true;
+}
+
+#endif
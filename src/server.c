@@ -17,14 +17,28 @@
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <netinet/tcp.h>
 #include <string.h>
+#include <inttypes.h>
 #include <assert.h>
 #include <signal.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <sys/epoll.h>
 #include "utils.h"
 #include <time.h>
 #include "hashTable.h"
+#include "workQueue.h"
+#include "wal.h"
+#include "snapshot.h"
+#include "loader.h"
 #include "config_parser.tab.h"
 #define MAX_LISTENQUEUELEN 20	///< The maximum number of queued connections.
+#define MAX_EPOLL_EVENTS 256	///< Events taken per epoll_wait() call.
+#define EPOLL_OUTPUT_HIGH_WATER (1024 * 1024)	///< Unsent bytes after which a client is not read from.
+#define MAX_REPLY_FIELDS (MAX_CMD_LEN / FRAME_FIELD_LEN)	///< Fields that fit in one reply.
 /*
 	LOGGING CONTROL CAPABILITY FOR SERVER REQUESTS
 	0 - NO OUTPUT
@@ -32,34 +46,13 @@
 	2 - PRINTED TO FILE OUTPUT
 */
 #define LOGGING 2
-// don't change it to 10!!!!!!!!!!!!!!!!!!!!!!!!
-// 11 is the right number
-#define MAX_THREADS 11
+#define WORK_QUEUE_CAPACITY 1024	///< Pending jobs before the I/O thread waits for the workers.
+#define UPLOAD_FILE "../data/census/census.csv"	///< The file "SET#<table>#UPLOAD#UPLOAD#" loads.
 
 extern int ThreadCounter;
 
-struct _ThreadInfo { 
-  struct sockaddr_in clientaddr;
-  socklen_t clientaddrlen; 
-  int clientsock; 
-  pthread_t theThread; 
-}; 
-
-typedef struct _ThreadInfo *ThreadInfo; 
-
-/*  Thread buffer, and circular buffer fields */ 
-ThreadInfo runtimeThreads[MAX_THREADS]; 
-unsigned int botRT = 0, topRT = 0;
-
-/* Mutex to guard print statements */ 
-pthread_mutex_t  printMutex    = PTHREAD_MUTEX_INITIALIZER; 
-
-/* Mutex to guard condition -- used in getting/returning from thread pool*/ 
-pthread_mutex_t conditionMutex = PTHREAD_MUTEX_INITIALIZER;
-/* Condition variable -- used to wait for avaiable threads, and signal when available */ 
-pthread_cond_t  conditionCond  = PTHREAD_COND_INITIALIZER;
-
 pthread_mutex_t getMutex = PTHREAD_MUTEX_INITIALIZER;
+/* Serialises bulk loads (UPLOAD and LOAD) and snapshots */
 pthread_mutex_t setMutex = PTHREAD_MUTEX_INITIALIZER;
 //pthread_mutex_t m = PTHREAD_MUTEX_INITIALIZER;
 
@@ -73,24 +66,44 @@ extern HashTable *ourHashTable[MAX_TABLES];
 
 // Read the config file.
 extern struct config_params params;
-extern struct config_params census_params;
 
-//Reading the command line
-char *commandPointer ;
-char *command ;
-char *message ;
 char **keys;
-char tempString[MAX_STRING_SIZE];
+//Log line scratch, per thread since several modes run handlers in parallel.
+__thread char tempString[MAX_STRING_SIZE];
 //Socket Parameter
 //int clientsock;
 int listensock;
 
 //While loop parameters
 int wait_for_connections ;
-int wait_for_commands;
 
 double total_server_process_time;
 
+//The write-ahead log; NULL when no data_directory is configured
+Wal *serverWal;
+
+//Wakes the snapshot thread, for the SNAPSHOT command or to stop
+static pthread_mutex_t snapshotMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t snapshotWake = PTHREAD_COND_INITIALIZER;
+static bool snapshotRequested;
+static bool snapshotStop;
+static pthread_t snapshotThreadId;
+
+
+/**
+ * @brief Turn off Nagle's algorithm on a client socket.
+ *
+ * Replies are written a batch at a time, so a short reply behind an
+ * unacknowledged one would otherwise wait for the client's delayed ACK.
+ *
+ * @param sock The socket connected to the client.
+ * @return Returns 0 on success, -1 otherwise.
+ */
+static int setNoDelay(int sock)
+{
+	int yes = 1;
+	return setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof yes);
+}
 
 /**
  * @brief Process a command from the client.
@@ -102,28 +115,150 @@ double total_server_process_time;
 int handle_command(int sock, char *cmd)
 {
 char tempString [MAX_STRING_SIZE];
-sprintf(tempString, "[LOG] Processing command '%s'\n", cmd);
+snprintf(tempString, sizeof tempString, "[LOG] Processing command '%s'\n", cmd);
 logger(ServerFileLog, tempString); // replace LOG commands with logger() calls
 
-// For now, just send back the command to the client.
-sendall(sock, cmd, strlen(cmd));
-sendall(sock, "\n", 1);
+// One send for the line and its newline, so Nagle never holds back the newline.
+char line[MAX_CMD_LEN + 1];
+size_t len = strlen(cmd);
+if (len > MAX_CMD_LEN - 1)
+	len = MAX_CMD_LEN - 1;
+memcpy(line, cmd, len);
+line[len] = '\n';
+
+return sendall(sock, line, len + 1);
+}
+
+/**
+ * @brief Send a reply frame to a binary client.
+ *
+ * The frame answers the request being served: it carries its opcode
+ * and id, and the error code if the first field is "Error".
+ *
+ * @param session The session the reply is for.
+ * @param numFields The number of fields.
+ * @param fields The fields of the reply.
+ * @param lengths The length of each field.
+ * @return Returns 0 on success, -1 otherwise.
+ */
+static int replyFrame(Session *session, int numFields, const char **fields, const size_t *lengths)
+{
+	char frame[MAX_CMD_LEN];
+	size_t used = FRAME_HEADER_LEN;
+	int status = 0;
+	int i;
+
+	for (i = 0; i < numFields; i++) {
+		if (frame_addField(frame, &used, sizeof frame, fields[i], lengths[i]) != 0)
+			return -1;
+	}
+	if (numFields > 1 && lengths[0] == 5 && strncmp(fields[0], "Error", 5) == 0)
+		status = atoi(fields[1]);
+	frame_setHeader(frame, used, session->frame.opcode, status, session->frame.requestId);
+
+	if (session->output == NULL)
+		return sendall(session->sock, frame, used);
+	return wb_append(session->output, frame, used);
+}
+
+/**
+ * @brief Send a reply to a client.
+ *
+ * Sessions with an output buffer get the reply queued there; the loop
+ * serving the client writes out the replies to a batch of pipelined
+ * requests together.
+ *
+ * @param session The session the reply is for.
+ * @param cmd The reply, without the trailing newline.
+ * @return Returns 0 on success, -1 otherwise.
+ */
+int replyToClient(Session *session, char *cmd)
+{
+	if (session->binary) {
+		const char *fields[MAX_CMD_LEN / FRAME_FIELD_LEN];
+		size_t lengths[MAX_CMD_LEN / FRAME_FIELD_LEN];
+		int numFields = 0;
+		const char *word = cmd;
+		const char *delimiter;
+
+		// Replies are built by the server from words without '#', so
+		// they split back into the fields they were made of.
+		while (*word != 0 && numFields < MAX_CMD_LEN / FRAME_FIELD_LEN) {
+			delimiter = strchr(word, '#');
+			fields[numFields] = word;
+			lengths[numFields] = delimiter != NULL ? (size_t) (delimiter - word) : strlen(word);
+			numFields++;
+			if (delimiter == NULL)
+				break;
+			word = delimiter + 1;
+		}
+		return replyFrame(session, numFields, fields, lengths);
+	}
+
+	if (session->output == NULL)
+		return handle_command(session->sock, cmd);
+
+	char tempString [MAX_STRING_SIZE];
+	snprintf(tempString, sizeof tempString, "[LOG] Processing command '%s'\n", cmd);
+	logger(ServerFileLog, tempString);
+
+	if (wb_append(session->output, cmd, strlen(cmd)) != 0 || wb_append(session->output, "\n", 1) != 0)
+		return -1;
+	return 0;
+}
+
+/**
+ * @brief Send a reply made of fields that may contain '#'.
+ *
+ * Text clients get the fields joined by '#', each followed by one.
+ *
+ * @param session The session the reply is for.
+ * @param numFields The number of fields.
+ * @param fields The fields of the reply.
+ * @return Returns 0 on success, -1 otherwise.
+ */
+int replyFields(Session *session, int numFields, const char **fields)
+{
+	size_t lengths[numFields];
+	size_t used = 0;
+	int i;
+
+	for (i = 0; i < numFields; i++)
+		lengths[i] = strlen(fields[i]);
+	if (session->binary)
+		return replyFrame(session, numFields, fields, lengths);
 
-return 0;
+	for (i = 0; i < numFields && used + lengths[i] + 1 < MAX_CMD_LEN; i++) {
+		memcpy(session->message + used, fields[i], lengths[i]);
+		used += lengths[i];
+		session->message[used++] = '#';
+	}
+	session->message[used] = 0;
+	return replyToClient(session, session->message);
 }
 
 
 /**
- * @brief Process a Authenticate function 
+ * @brief Process a Authenticate function
  *
  * @param command The command received from the client.
+ * @param session The session of the client.
  * @return void
  */
 
-void Authenticate(char ** command, int clientsock ) {
+void Authenticate(Command *command, Session *session ) {
+	char *message = session->message;
+
 	//getting the password and username
-		char * username = getNextWord(command, '#');
-		char * password = getNextWord(command, '#');
+		char * username = cmd_next(command);
+		char * password = cmd_next(command);
+
+		//0) A field is missing
+		if (username == NULL || password == NULL) {
+			sprintf(message, "Error#%d#", ERR_INVALID_PARAM);
+			replyToClient(session, message);
+			return;
+		}
 
 		//comparing the encrypted password
 		//1) Encrypted password - no match
@@ -134,72 +269,65 @@ void Authenticate(char ** command, int clientsock ) {
 			sprintf(message, "Error#%d#", ERR_AUTHENTICATION_FAILED);
 
 			//send the message
-			int status1 = handle_command(clientsock, message);
-			if (status1 != 0)
-				wait_for_commands = 0; // Oops.  An error occured.
+			replyToClient(session, message);
 		}
 
 		//2) Encrypted password - match
 		// Username - match
 		else {
-			params.authorized = true;
+			session->authenticationStatus = true;
 			sprintf(message, "SUCCESS");
-			handle_command(clientsock, message);
+			replyToClient(session, message);
 		}
 
-		//deallocating memory
-		free(username);
-		free(password);
 }
 
 /**
- * @brief Process a Get function 
+ * @brief Process a Get function
  *
  * @param command The command received from the client.
+ * @param session The session of the client.
  * @return void
  */
 
-void Get(char ** command, int clientsock ) {
+void Get(Command *command, Session *session ) {
 
-	printf("i get the value here1");
 	char tempString[MAX_STRING_SIZE];
+	char *message = session->message;
+
 	// 0) Not Authenticated
-	if(!params.authorized){
+	if(session->authenticationStatus == false){
 		sprintf(message, "Error#%d#", ERR_NOT_AUTHENTICATED);
-		handle_command(clientsock, message);
+		replyToClient(session, message);
 		return;
 	}
 
-	//getting table and key 
-	char *table = getNextWord(command, '#');
-	char *key = getNextWord(command, '#');
+	//getting table and key
+	char *table = cmd_next(command);
+	char *key = cmd_next(command);
+	if (table == NULL || key == NULL) {
+		sprintf(message, "Error#%d#", ERR_INVALID_PARAM);
+		replyToClient(session, message);
+		return;
+	}
 	int table_index = isTableNameExist(table, &params);
 
-
-	//dealing with only one table - from config file
-	printf("i get the value here2");
-
 	//1) tablename not found
 	if (table_index == -1) {
 		//message to the client
 		sprintf(message, "Error#%d#", ERR_TABLE_NOT_FOUND);
 
 		//send the message
-		int status1 = handle_command(clientsock, message);
-		if (status1 != 0)
-			wait_for_commands = 0; // Oops.  An error occured.
+		replyToClient(session, message);
 		return;
 	}
 
 	struct timeval start_time, end_time;
 	gettimeofday(&start_time, NULL);
-	printf("i get the value here3");
-	//char* data = ht_get(ourHashTable[table_index], key);
 
-	//pthread_mutex_lock( &getMutex ); 	
-	Entry* data = ht_get(ourHashTable[table_index], key);
-	//pthread_mutex_unlock( &getMutex ); 
-	//sets the metabase value to the previousMeta value.
+	char *value = NULL;
+	uintptr_t metadata;
+	int status = ht_getRecord(ourHashTable[table_index], key, &value, &metadata);
 
 	gettimeofday(&end_time, NULL);
     double tempEvaluationTime = (end_time.tv_usec) - (start_time.tv_usec);
@@ -209,143 +337,366 @@ void Get(char ** command, int clientsock ) {
     sprintf(tempString, "[PERFORMANCE] Current Server Total Processing Time: %lf microseconds.\n", total_server_process_time);
     logger(ServerFileLog, tempString);
 
-    printf("i get the value here4");
 	//2) keyvalue not found
-	
-	if (data == NULL ) {
+	if (status != 0) {
 		sprintf(message, "Error#%d#", ERR_KEY_NOT_FOUND);
-		handle_command(clientsock, message);
-		return;
 	}
 
-	char metadata[MAX_STRING_SIZE]; 
-	sprintf(metadata, "%d", data->metadata);
-
 	//3) everything fine
-	if (data != NULL){
-		sprintf(message, "SUCCESS#%s#%s#%s#", key, data->value, metadata);
-		handle_command(clientsock, message);
+	else {
+		char version[MAX_STRING_SIZE];
+		const char *fields[] = { "SUCCESS", key, value, version };
+
+		snprintf(version, sizeof version, "%" PRIuPTR, metadata);
+		replyFields(session, 4, fields);
 	}
+	if (status != 0)
+		replyToClient(session, message);
 
 	//deallocating memory
-	free(table);
-	free(key);
+	free(value);
+}
+
+/**
+ * @brief Apply a set, or with an empty value a delete, to a table.
+ *
+ * @param table_index The table of the record.
+ * @param key The key of the record.
+ * @param value The new value, parsed against the table schema.
+ * @param metaData 0 to set unconditionally, otherwise the version the
+ * record must have.
+ * @param version Set to the version of the record after a set; if it is
+ * non-zero, the record is given that version instead.
+ * @param log If not NULL, called under the record's lock before the
+ * change is made; see ht_setLogged().
+ * @param arg Passed to log.
+ * @return Returns HASH_SET_INSERT, HASH_SET_UPDATE or HASH_SET_DELETE on
+ * success, otherwise the error code for the client.
+ */
+static int applyRecord(int table_index, char *key, char *value, uintptr_t metaData, uintptr_t *version,
+		HtLogChange log, void *arg) {
+	if (strlen(value) == 0) {
+		int status = ht_removeLogged(ourHashTable[table_index], key, log, arg);
+		if (status == HASH_SET_DELETE)
+			return status;
+		return status == HASH_SET_FAIL ? ERR_UNKNOWN : ERR_KEY_NOT_FOUND;
+	}
+
+	//Parse the value against the table schema; this also checks its format
+	Schema *schema = &params.table_names[table_index].schema;
+	char row[MAX_ROW_SIZE];
+	if (schema->numColumns > 0 && !parseRow(schema, value, row))
+		return ERR_INVALID_PARAM;
+
+	//1) if the metadata == 0 just set
+	//2) if the metadata is nonzero, it must match the record in the hashtable
+	int status = ht_setLogged(ourHashTable[table_index], key, value,
+			schema->numColumns > 0 ? row : NULL, metaData, version, log, arg);
+
+	if (status == HASH_SET_UPDATE || status == HASH_SET_INSERT)
+		return status;
+	//the metadata did not match
+	return status == HASH_SET_ABORT ? ERR_TRANSACTION_ABORT : ERR_UNKNOWN;
+}
+
+/**
+ * @brief A change to log, and where it was logged.
+ */
+typedef struct loggedChange {
+	WalRecord record;
+	uint64_t position;	///< Set by logChange(), 0 on error.
+} LoggedChange;
+
+/**
+ * @brief Append a change to the write-ahead log before it is made.
+ *
+ * Called under the lock of the record, which orders the changes to a
+ * key; the log's own lock is only held for the append.
+ *
+ * @param version The version of the record after the change.
+ * @param arg The LoggedChange.
+ * @return Returns 0 on success, -1 to give the change up.
+ */
+static int logChange(uintptr_t version, void *arg) {
+	LoggedChange *change = (LoggedChange *) arg;
+
+	change->record.version = version;
+	wal_lock(serverWal);
+	change->position = wal_append(serverWal, &change->record);
+	wal_unlock(serverWal);
+	return change->position != 0 ? 0 : -1;
+}
+
+/**
+ * @brief Set, or with an empty value delete, one record, and log it.
+ *
+ * The change is appended to the write-ahead log under the record's lock
+ * just before it is made, so the log orders the changes to a key as
+ * they were made, and a change that could not be logged is not made.
+ * It is durable once commitSession() returns.
+ *
+ * @param table_index The table of the record.
+ * @param key The key of the record.
+ * @param value The new value, parsed against the table schema.
+ * @param metaData 0 to set unconditionally, otherwise the version the
+ * record must have.
+ * @param position Set to the position of the change in the log, 0 if
+ * nothing was logged.
+ * @return Returns HASH_SET_INSERT, HASH_SET_UPDATE or HASH_SET_DELETE on
+ * success, otherwise the error code for the client.
+ */
+static int setRecord(int table_index, char *key, char *value, uintptr_t metaData, uint64_t *position) {
+	*position = 0;
+	if (serverWal == NULL)
+		return applyRecord(table_index, key, value, metaData, NULL, NULL, NULL);
+
+	uintptr_t version = 0;
+	LoggedChange change = { { strlen(value) == 0 ? WAL_DELETE : WAL_SET, 0,
+			params.table_names[table_index].tablename, key, value }, 0 };
+	int status = applyRecord(table_index, key, value, metaData, &version, logChange, &change);
+	*position = change.position;
+	return status;
+}
+
+/**
+ * @brief Wait until the changes a session logged are durable.
+ *
+ * The loops serving clients call this before writing out a batch of
+ * replies, so the changes of pipelined requests share one commit, and
+ * sessions committing together share one write and sync of the log.
+ *
+ * @param session The session.
+ * @return Returns 0 on success, -1 if the log could not be written.
+ */
+static int commitSession(Session *session) {
+	uint64_t position = session->walPosition;
+
+	session->walPosition = 0;
+	if (serverWal == NULL || position == 0)
+		return 0;
+	if (wal_commit(serverWal, position) != 0) {
+		logger(ServerFileLog, "[LOG] Error writing the write-ahead log\n");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Note a change logged by a session, to commit before its reply.
+ *
+ * @param session The session.
+ * @param position A position set by setRecord().
+ * @return Returns 0 on success, -1 if the change could not be committed.
+ */
+static int logged(Session *session, uint64_t position) {
+	if (position > session->walPosition)
+		session->walPosition = position;
+	//a reply sent right away must wait for the commit
+	return session->output == NULL ? commitSession(session) : 0;
+}
+
+/**
+ * @brief Apply a record replayed from the write-ahead log.
+ *
+ * Records of tables no longer in the config file, or that no longer
+ * fit the schema of their table, are skipped.
+ *
+ * @param record The record.
+ * @param arg Unused.
+ * @return Returns 0 on success, -1 otherwise.
+ */
+static int replayRecord(const WalRecord *record, void *arg) {
+	int table_index = isTableNameExist((char *) record->table, &params);
+	if (table_index == -1)
+		return 0;
+
+	uintptr_t version = (uintptr_t) record->version;
+	int status = applyRecord(table_index, (char *) record->key,
+			record->type == WAL_DELETE ? "" : (char *) record->value, 0, &version, NULL, NULL);
+	return status == ERR_UNKNOWN ? -1 : 0;
+}
+
+/**
+ * @brief Make room for the records of a table loaded from a snapshot.
+ *
+ * @param table The name of the table.
+ * @param count The number of records.
+ * @param arg Unused.
+ * @return Returns 0 on success, -1 otherwise.
+ */
+static int reserveTable(const char *table, uint32_t count, void *arg) {
+	int table_index = isTableNameExist((char *) table, &params);
+	if (table_index == -1 || count > INT_MAX)
+		return 0;
+	return ht_reserve(ourHashTable[table_index], (int) count);
+}
+
+/**
+ * @brief Write a snapshot of every table to the data directory.
+ *
+ * The log moves on to a new generation and the tables are frozen just
+ * long enough to fork; the child writes the snapshot from its copy of
+ * the tables while the server goes on. Once it is written, the log
+ * files it covers are removed. Only snapshotThread() calls this, so
+ * snapshots never overlap.
+ *
+ * @return Returns 0 on success, -1 otherwise.
+ */
+static int takeSnapshot(void) {
+	char *names[MAX_TABLES];
+	int numTables;
+	int status;
+	int t;
+
+	//let a load in progress finish first
+	pthread_mutex_lock(&setMutex);
+	//a change is logged and made under the lock of its record, so once
+	//the tables are frozen, each change in the log is in them too
+	numTables = params.table_number;
+	for (t = 0; t < numTables; t++) {
+		names[t] = params.table_names[t].tablename;
+		ht_freeze(ourHashTable[t]);
+	}
+	wal_lock(serverWal);
+	uint32_t generation = wal_rotate(serverWal);
+	wal_unlock(serverWal);
+	pid_t parent = getpid();
+	pid_t pid = generation != 0 ? fork() : -1;
+	if (pid == 0) {
+		//a child left behind by a crash would rename its snapshot over
+		//the one of the restarted server, and hold its listening socket
+		if (prctl(PR_SET_PDEATHSIG, SIGKILL) != 0 || getppid() != parent)
+			_exit(1);
+		_exit(snapshot_write(params.data_directory, generation, numTables, names, ourHashTable) == 0 ? 0 : 1);
+	}
+	for (t = numTables - 1; t >= 0; t--)
+		ht_thaw(ourHashTable[t]);
+	pthread_mutex_unlock(&setMutex);
+
+	if (pid < 0)
+		return -1;
+	while (waitpid(pid, &status, 0) < 0) {
+		if (errno != EINTR)
+			return -1;
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		return -1;
+	wal_removeBefore(params.data_directory, generation);
+	return 0;
+}
+
+/**
+ * @brief Start routine of the thread taking snapshots, when asked to by
+ * the SNAPSHOT command and every snapshot_interval seconds.
+ */
+static void *snapshotThread(void *arg) {
+	struct timespec deadline;
+
+	pthread_mutex_lock(&snapshotMutex);
+	while (!snapshotStop) {
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += params.snapshotInterval;
+		while (!snapshotRequested && !snapshotStop) {
+			if (params.snapshotInterval <= 0)
+				pthread_cond_wait(&snapshotWake, &snapshotMutex);
+			else if (pthread_cond_timedwait(&snapshotWake, &snapshotMutex, &deadline) == ETIMEDOUT)
+				break;
+		}
+		if (snapshotStop)
+			break;
+		snapshotRequested = false;
+		pthread_mutex_unlock(&snapshotMutex);
+
+		if (takeSnapshot() == 0)
+			logger(ServerFileLog, "[LOG] Wrote a snapshot\n");
+		else
+			logger(ServerFileLog, "[LOG] Error writing a snapshot\n");
+		pthread_mutex_lock(&snapshotMutex);
+	}
+	pthread_mutex_unlock(&snapshotMutex);
+	return NULL;
+}
+
+/**
+ * @brief Ask the snapshot thread for a snapshot, without waiting for it.
+ */
+static void requestSnapshot(void) {
+	pthread_mutex_lock(&snapshotMutex);
+	snapshotRequested = true;
+	pthread_cond_signal(&snapshotWake);
+	pthread_mutex_unlock(&snapshotMutex);
 }
 
 /**
- * @brief Process a Set function 
+ * @brief Process a Set function
  *
  * @param command The command received from the client.
+ * @param session The session of the client.
  * @return void
  */
 
-void Set( char ** command, int clientsock ) {
+void Set( Command *command, Session *session ) {
 
 	char tempString[MAX_STRING_SIZE];
+	char *message = session->message;
+
 		// 0) Not Authenticated
-		if(!params.authorized){
+		if(session->authenticationStatus == false){
 			errno = ERR_NOT_AUTHENTICATED;
 			sprintf(message, "Error#%d#", errno);
-			handle_command(clientsock, message);
+			replyToClient(session, message);
 			return;
 		}
 
 		//getting table, key, and value
-		char *table = getNextWord(command, '#');
-		char *key = getNextWord(command, '#');
-		char *value = getNextWord(command, '#');
-		char *metadata = getNextWord(command, '#');
-
-
+		char *table = cmd_next(command);
+		char *key = cmd_next(command);
+		char *value = cmd_next(command);
+		char *metadata = cmd_next(command);
+		if (table == NULL || key == NULL || value == NULL || metadata == NULL) {
+			sprintf(message, "Error#%d#", ERR_INVALID_PARAM);
+			replyToClient(session, message);
+			return;
+		}
 
 		int table_index = isTableNameExist(table, &params);
 		char *p;
-		long int metaData = strtol(metadata, &p, 10);
+		uintptr_t metaData = strtoull(metadata, &p, 10);
 
-		printf("Parsed Set\n" );
 		//1) tablename not found
 		if (table_index == -1) {
 			//message to the client
 			sprintf(message, "Error#%d#", ERR_TABLE_NOT_FOUND);
 
 			//send the message
-			int status1 = handle_command(clientsock, message);
-			if (status1 != 0)
-				wait_for_commands = 0; // Oops.  An error occured.
-			return;
-		}
-
-		//2) Deleting Process
-		if (strlen(value) == 0) {
-
-			int isDeleted = ht_removeItem(ourHashTable[table_index], key);
-
-			if (isDeleted == HASH_SET_DELETE)
-				handle_command(clientsock, "DELETE#");
-			else {
-				sprintf(message, "Error#%d#",ERR_KEY_NOT_FOUND );
-				handle_command(clientsock, message);
-			}
+			replyToClient(session, message);
 			return;
 		}
 
- 		
- 		// 4) UPLOAD function
+		//2) UPLOAD function
 		if (strcmp(key, "UPLOAD") == 0 && strcmp(value, "UPLOAD") == 0) {
+			pthread_mutex_lock( &setMutex );
 			int status = upload(table_index);
+			pthread_mutex_unlock( &setMutex );
 			if (status == 0) {
 				sprintf(message, "UPLOAD#");
-				handle_command(clientsock, message);
+				replyToClient(session, message);
 			}
 			else {
 				sprintf(message, "Error#%d#",ERR_UNKNOWN );
-				handle_command(clientsock, message);
+				replyToClient(session, message);
 			}
 			return;
 		}
-		
-		//3) Check if the input string format is correct
-		if (strcmp(key, "UPLOAD") != 0 && strcmp(value, "UPLOAD") != 0 && strlen(value) != 0 ) {
-			
-			printf("insert isInputValid Function \n");
-			bool Input_String_Format = isInputFormatCorrect(value, &params, table_index);
-			if (Input_String_Format == false) {
-				sprintf(message, "Error#%d#", ERR_INVALID_PARAM);
-
-				//send the message
-				int status1 = handle_command(clientsock, message);
-				if (status1 != 0)
-					wait_for_commands = 0; // Oops.  An error occured.
-				return;
-			}
-		}
-
-
-		//gets the metadat value
-		//1) if the metadata == 0 just set
-		//2) if the metadata is nonzero, compare with the value from the hashtable
-
-		Entry* data = ht_get(ourHashTable[table_index], key);
-
-		if (data != NULL && metaData != 0 && data->metadata != metaData) {
-			sprintf(message, "Error#%d#",ERR_TRANSACTION_ABORT );
-			handle_command(clientsock, message);
-			return;
-		}
-
-		// the data doesn't exist but the metaData is not zero
-		if (data == NULL && metaData != 0) {
-			sprintf(message, "Error#%d#",ERR_TRANSACTION_ABORT );
-			handle_command(clientsock, message);
-			return;
-		}
 
 		struct timeval start_time, end_time;
     	gettimeofday(&start_time, NULL);
 
-    	pthread_mutex_lock( &setMutex );
-		int status = ht_set(ourHashTable[table_index], key, value);
-		pthread_mutex_unlock( &setMutex ); 
+		//3) set, or with an empty value delete, the record
+		uint64_t position;
+		int status = setRecord(table_index, key, value, metaData, &position);
+		if (logged(session, position) != 0)
+			status = ERR_UNKNOWN;
 
 		gettimeofday(&end_time, NULL);
 	    double tempEvaluationTime = (end_time.tv_usec) - (start_time.tv_usec);
@@ -356,951 +707,1034 @@ void Set( char ** command, int clientsock ) {
 	    logger(ServerFileLog, tempString);
 
 
+		//deleting data
+		if (status == HASH_SET_DELETE) {
+			replyToClient(session, "DELETE#");
+		}
+
 		//updating data
-		if (status == HASH_SET_UPDATE) {
-			handle_command(clientsock, "MODIFY#");
+		else if (status == HASH_SET_UPDATE) {
+			replyToClient(session, "MODIFY#");
 		}
 
 		//inserting the data
-		else if (status == HASH_SET_INSERT) 
+		else if (status == HASH_SET_INSERT)
 		{
-			handle_command(clientsock, "INSERT#");
+			replyToClient(session, "INSERT#");
+		}
+
+		else {
+			sprintf(message, "Error#%d#", status);
+			replyToClient(session, message);
 		}
 
-		//deallocating memory
-		free(metadata); 
-		free(table);
-		free(key);
-		free(value);	
 }
 
 /**
- * @brief Process a Query function 
+ * @brief Send a list of fields, split over as many replies as needed.
  *
- * @param command The command received from the client.
+ * Each reply fits in MAX_CMD_LEN: any number of "MORE#field#...#"
+ * replies, then "SUCCESS#<count>#field#...#". A list that fits in one
+ * reply is sent as that single SUCCESS reply. Fields are kept in groups
+ * of group, so one entry is never split over two replies.
+ *
+ * @param session The session of the client.
+ * @param count The number sent in the SUCCESS reply.
+ * @param fields The fields to send.
+ * @param numFields The number of fields, a multiple of group.
+ * @param group The number of fields per entry.
  * @return void
  */
-void Query(char ** command,int clientsock ){
-	char tempString[MAX_STRING_SIZE];
-	
-		// 0) Not Authenticated
-		if(!params.authorized){
-			errno = ERR_NOT_AUTHENTICATED;
-			sprintf(message, "Error#%d#", errno);
-			handle_command(clientsock, message);
-			return;
+static void replyList(Session *session, int count, const char **fields, int numFields, int group) {
+	const char *reply[MAX_REPLY_FIELDS + 2];
+	char number[MAX_STRING_SIZE];
+	size_t overhead = session->binary ? FRAME_FIELD_LEN : 1;
+	int start = 0;
+	int end;
+	int i;
+
+	snprintf(number, sizeof number, "%d", count);
+	for (;;) {
+		size_t size = QUERY_PREFIX_LEN;
+
+		//whole groups, each field with its '#' or frame length, while they fit
+		for (end = start; end < numFields && end - start + group <= MAX_REPLY_FIELDS; end += group) {
+			size_t groupSize = 0;
+			for (i = end; i < end + group; i++)
+				groupSize += strlen(fields[i]) + overhead;
+			if (end > start && size + groupSize >= MAX_CMD_LEN)
+				break;
+			size += groupSize;
 		}
 
-		//getting table, predicates, and max_key
-		char *table = getNextWord(command, '#');
-		char *predicates = getNextWord(command, '#');
-		char *tempMax_keys = getNextWord(command, '#');
-		int table_index = isTableNameExist(table, &params);
+		int numReply = 0;
+		if (end < numFields)
+			reply[numReply++] = "MORE";
+		else {
+			reply[numReply++] = "SUCCESS";
+			reply[numReply++] = number;
+		}
+		for (i = start; i < end; i++)
+			reply[numReply++] = fields[i];
+		replyFields(session, numReply, reply);
 
+		if (end >= numFields)
+			return;
+		start = end;
+	}
+}
 
-		long int max_keys;
-		char* p;
-		max_keys = strtol(tempMax_keys, &p, 10);
+/**
+ * @brief Send the keys found by a query.
+ *
+ * @param session The session of the client.
+ * @param numMatches The number of matching records.
+ * @param keys The keys to send.
+ * @param numKeys The number of keys.
+ * @return void
+ */
+static void replyQueryKeys(Session *session, int numMatches, char **keys, int numKeys) {
+	replyList(session, numMatches, (const char **) keys, numKeys, 1);
+}
 
+/**
+ * @brief The reply to a QUERY, sent while the table is scanned.
+ *
+ * Keys are copied into line until one more would not fit in a reply,
+ * and then sent as a "MORE#" reply, so a query holds one reply's worth
+ * of keys whatever the number of matches.
+ */
+typedef struct queryReply {
+	Session *session;
+	const char *fields[MAX_REPLY_FIELDS + 2];	///< The status and count, then the keys in line.
+	char line[MAX_CMD_LEN];
+	size_t used;		///< Bytes of line holding keys.
+	size_t size;		///< Size of the reply, as replyList() counts it.
+	int numKeys;
+} QueryReply;
 
-		//1) tablename not found
-		if (table_index == -1) {
-			//message to the client
-			sprintf(message, "Error#%d#", ERR_TABLE_NOT_FOUND);
+/**
+ * @brief Add a key found by a query to its reply; a KeySink visit function.
+ *
+ * @return Returns 0 on success, -1 if the reply could not be sent.
+ */
+static int replyQueryKey(const char *key, void *arg) {
+	QueryReply *reply = (QueryReply *) arg;
+	size_t length = strlen(key);
+	size_t fieldSize = length + (reply->session->binary ? FRAME_FIELD_LEN : 1);
+
+	if (reply->numKeys > 0 && (reply->numKeys == MAX_REPLY_FIELDS || reply->size + fieldSize >= MAX_CMD_LEN)) {
+		reply->fields[1] = "MORE";
+		if (replyFields(reply->session, reply->numKeys + 1, reply->fields + 1) != 0)
+			return -1;
+		reply->used = 0;
+		reply->size = QUERY_PREFIX_LEN;
+		reply->numKeys = 0;
+	}
+	memcpy(reply->line + reply->used, key, length + 1);
+	reply->fields[2 + reply->numKeys++] = reply->line + reply->used;
+	reply->used += length + 1;
+	reply->size += fieldSize;
+	return 0;
+}
 
-			//send the message
-			int status1 = handle_command(clientsock, message);
-			if (status1 != 0)
-				wait_for_commands = 0; // Oops.  An error occured.`
-			return;
-		}
+/**
+ * @brief Process a MGET function: get several records of a table
+ *
+ * Replies "SUCCESS#<n>#" followed by three fields per key, in order: 0,
+ * the value and the version if the key was found, otherwise the error
+ * code and two empty fields.
+ *
+ * @param command The command received from the client.
+ * @param session The session of the client.
+ * @return void
+ */
+void MGet(Command *command, Session *session ) {
+	char *message = session->message;
 
-    	char * keys[max_keys];
-    	int i;
-    	for (i = 0; i < max_keys; i++)
-    		keys[i] = NULL;
+	if(session->authenticationStatus == false){
+		sprintf(message, "Error#%d#", ERR_NOT_AUTHENTICATED);
+		replyToClient(session, message);
+		return;
+	}
 
+	char *table = cmd_next(command);
+	int table_index = table != NULL ? isTableNameExist(table, &params) : -1;
+	if (table_index == -1) {
+		sprintf(message, "Error#%d#", ERR_TABLE_NOT_FOUND);
+		replyToClient(session, message);
+		return;
+	}
 
-        //Allocate predicates in predicate struct
-        int numPredicates = getNumPredicates(predicates);
-        //Allocate predicates
-       	
+	char *keys[MAX_BATCH_KEYS];
+	int numKeys = 0;
+	char *key;
+	while (numKeys < MAX_BATCH_KEYS && (key = cmd_next(command)) != NULL)
+		keys[numKeys++] = key;
+	if (numKeys == 0 || cmd_next(command) != NULL) {
+		sprintf(message, "Error#%d#", ERR_INVALID_PARAM);
+		replyToClient(session, message);
+		return;
+	}
 
-       	Predicate* predLists = createPredicateList (numPredicates, predicates); 
-       	int value = isPredicateValid(predLists, &params, table_index, numPredicates);
-       	
+	const char *fields[3 * MAX_BATCH_KEYS];
+	char *values[MAX_BATCH_KEYS];
+	char numbers[MAX_BATCH_KEYS][2][MAX_KEY_LEN];
+	int i;
 
-       	if (value == INVALID) {
-			//message to the client
-			sprintf(message, "Error#%d#", ERR_INVALID_PARAM);
+	for (i = 0; i < numKeys; i++) {
+		uintptr_t metadata;
 
-			//send the message
-			int status1 = handle_command(clientsock, message);
-			if (status1 != 0)
-				wait_for_commands = 0; // Oops.  An error occured.`
-			return;
+		values[i] = NULL;
+		if (ht_getRecord(ourHashTable[table_index], keys[i], &values[i], &metadata) == 0) {
+			snprintf(numbers[i][0], MAX_KEY_LEN, "0");
+			snprintf(numbers[i][1], MAX_KEY_LEN, "%" PRIuPTR, metadata);
+		}
+		else {
+			snprintf(numbers[i][0], MAX_KEY_LEN, "%d", ERR_KEY_NOT_FOUND);
+			numbers[i][1][0] = '\0';
 		}
+		fields[3 * i] = numbers[i][0];
+		fields[3 * i + 1] = values[i] != NULL ? values[i] : "";
+		fields[3 * i + 2] = numbers[i][1];
+	}
+	replyList(session, numKeys, fields, 3 * numKeys, 3);
 
-       	struct timeval start_time, end_time;
-    	gettimeofday(&start_time, NULL);
+	for (i = 0; i < numKeys; i++)
+		free(values[i]);
+}
 
-        int status = ht_query (ourHashTable[table_index], predLists, numPredicates, keys, max_keys);   
+/**
+ * @brief Process a MSET function: set several records of a table
+ *
+ * The command carries a key, a value and a version per record, as SET
+ * does. Replies "SUCCESS#<n>#" followed by one field per record, in
+ * order: 0 if it was set, otherwise its error code.
+ *
+ * @param command The command received from the client.
+ * @param session The session of the client.
+ * @return void
+ */
+void MSet(Command *command, Session *session ) {
+	char *message = session->message;
 
-        gettimeofday(&end_time, NULL);
-	    double tempEvaluationTime = (end_time.tv_usec) - (start_time.tv_usec);
-	    total_server_process_time += tempEvaluationTime;
-	    sprintf(tempString, "[PERFORMANCE] Server QUERY Processing Time: %lf microseconds.\n", tempEvaluationTime);
-	    logger(ServerFileLog, tempString);
-	    sprintf(tempString, "[PERFORMANCE] Current Server Total Processing Time: %lf microseconds.\n", total_server_process_time);
-	    logger(ServerFileLog, tempString); 
-
-        //Free the 2D array of keys
-   	 
-   	 	int x = 0;
-   	 	char *keyMessage = NULL;  	 	
-
-   	 	for (x = 0; x < max_keys && x < status; x++){
-   	 		if(keys[x]!=NULL)
-   	 		{
-   	 			printf("Found keys");
-   	 			if(x == 0){
-   	 				printf("Created message to send all the keys back\n");
-   	 				keyMessage = myStrDup(keys[x]);
-   	 				keyMessage = addStringSecond(keyMessage,HASHTAG);
-   	 			}
-   	 			else{
-   	 				keyMessage = addStringSecond(keyMessage,keys[x]);
-   	 				keyMessage = addStringSecond(keyMessage,HASHTAG);
-   	 			}
-   	 		}
-
-   	 	}
-
-   	 	for (i = 0; i < max_keys; i++){
-   	 		if (keys[i] != NULL){
-   	 			free (keys[i]);
-   	 		}
-   	 	}
+	if(session->authenticationStatus == false){
+		sprintf(message, "Error#%d#", ERR_NOT_AUTHENTICATED);
+		replyToClient(session, message);
+		return;
+	}
 
+	char *table = cmd_next(command);
+	int table_index = table != NULL ? isTableNameExist(table, &params) : -1;
+	if (table_index == -1) {
+		sprintf(message, "Error#%d#", ERR_TABLE_NOT_FOUND);
+		replyToClient(session, message);
+		return;
+	}
 
-		if (status == -1) {
-			sprintf(message, "Error#%d#",ERR_KEY_NOT_FOUND );
-			handle_command(clientsock, message);
+	char *records[MAX_BATCH_KEYS][3];
+	int numRecords = 0;
+	bool partial = false;
+	char *key;
+	while (numRecords < MAX_BATCH_KEYS && (key = cmd_next(command)) != NULL) {
+		records[numRecords][0] = key;
+		records[numRecords][1] = cmd_next(command);
+		records[numRecords][2] = cmd_next(command);
+		if (records[numRecords][2] == NULL) {
+			partial = true;
+			break;
 		}
+		numRecords++;
+	}
+	if (numRecords == 0 || partial || cmd_next(command) != NULL) {
+		sprintf(message, "Error#%d#", ERR_INVALID_PARAM);
+		replyToClient(session, message);
+		return;
+	}
 
-		//Keys Found
-		else  
-		{
-			sprintf(message, "SUCCESS#%d#%s",status,keyMessage );
-			printf("%s\n",keyMessage);
-			handle_command(clientsock, message);
-		}
-		//deallocating memory
-		free(table);
-		free(predicates);
-		free(tempMax_keys);
-		printf("Before free\n");
-		if(keyMessage != NULL){
-			printf("During free1\n");
-			free(keyMessage);	
-			printf("During free2\n");
-		}
-		printf("After free\n"); 
-}
+	const char *fields[MAX_BATCH_KEYS];
+	char codes[MAX_BATCH_KEYS][MAX_KEY_LEN];
+	int i;
 
+	for (i = 0; i < numRecords; i++) {
+		char *p;
+		uint64_t position;
+		uintptr_t metaData = strtoull(records[i][2], &p, 10);
+		int status = setRecord(table_index, records[i][0], records[i][1], metaData, &position);
+
+		if (status == HASH_SET_INSERT || status == HASH_SET_UPDATE || status == HASH_SET_DELETE)
+			status = 0;
+		if (logged(session, position) != 0)
+			status = ERR_UNKNOWN;
+		snprintf(codes[i], MAX_KEY_LEN, "%d", status);
+		fields[i] = codes[i];
+	}
+	replyList(session, numRecords, fields, numRecords, 1);
+}
 
-/*
-bool columnName_checker(char *columnName)
-{
-	//Check with table schema for valid parameters
-	return false;
-} */
 /**
- * @brief Uploading census.txt file to the data structure
+ * @brief Process a SNAPSHOT function: write a snapshot in the background
+ *
+ * Replies "SUCCESS#" once the snapshot is started, not written; the
+ * server log tells how it went. Fails with ERR_INVALID_PARAM when no
+ * data_directory is configured.
  *
+ * @param command The command received from the client.
+ * @param session The session of the client.
  * @return void
  */
+void Snapshot(Command *command, Session *session ) {
+	char *message = session->message;
 
-int upload(int table_index) {
-
-	char *census_config_file = "../data/census.conf";
-	int status = CheckConfigFile(census_config_file, &census_params);
-	
-	if (status != 0)
-		return -1;
-
-	FILE *fp;
-	fp = fopen("../data/census/census.csv","r");
-   	if ( fp != NULL )
-	{
-		char *line = (char *)malloc((MAX_STRING_SIZE) * sizeof(char) ); // or other suitable maximum line size 
-
-
-		while ( fgets ( line, MAX_STRING_SIZE, fp ) != NULL )//  read a line 
-		{
-			char *linePointer = line;
-			
-			char* kkey = getNextWord(&linePointer, ',');
-			char* vvalue = getNextWord(&linePointer, '\n');
-
-			ht_set( ourHashTable[table_index], kkey, vvalue);
-
-			free(kkey);
-			free(vvalue);
-		}
-		free(line);
-	    fclose ( fp );
+	if(session->authenticationStatus == false){
+		sprintf(message, "Error#%d#", ERR_NOT_AUTHENTICATED);
+		replyToClient(session, message);
+		return;
 	}
-	return 0;
+	if (serverWal == NULL) {
+		sprintf(message, "Error#%d#", ERR_INVALID_PARAM);
+		replyToClient(session, message);
+		return;
+	}
+
+	requestSnapshot();
+	replyToClient(session, "SUCCESS#");
 }
 
 /**
- * @brief Check the validity of the Configuration file. 
+ * @brief Log the memory held by the records of a table.
  *
- * @param config_file the config_file name.
- * @return Returns 0 on success, exit otherwise.
+ * @param table_index The table.
  */
-int CheckConfigFile(char * config_file, struct config_params* params ) {
-	strcpy(params->username, "NOTINIT");
-	strcpy(params->password, "NOTINIT");
-	strcpy(params->server_host, "NOTINIT");
-	params->table_number =0;
-	params->server_port =0;
-	params->concurrencyMode = -1;
-
-	//updating the config file with bison and flex
-	int status;
-	status =  parse(config_file, params);
-
-	//checking if the config file is valid
-	bool isValidColumn = isValidColumnIndex(params);
-
-	if (isValidColumn == false) {
-		status =  -1;
-	}
-
-
-	if (strcmp(params->username, "NOTINIT") == 0 || strcmp(params->password, "NOTINIT") == 0 
-			|| strcmp(params->server_host, "NOTINIT") == 0 || params->table_number == 0 || params->server_port == 0
-			|| params->password == 0 || params->concurrencyMode == -1) 
-		status =  -1;
-
-	return status; 
+static void logTableMemory(int table_index) {
+	char tempString[MAX_STRING_SIZE];
+	size_t inUse, reserved;
 
+	//the open engine allocates its records with malloc
+	if (ourHashTable[table_index]->engine == HT_ENGINE_OPEN)
+		return;
+	ht_memoryUsage(ourHashTable[table_index], &inUse, &reserved);
+	snprintf(tempString, sizeof tempString, "[LOG] Table %.*s holds %zu bytes of records in %zu bytes reserved\n",
+			MAX_TABLE_LEN, params.table_names[table_index].tablename, inUse, reserved);
+	logger(ServerFileLog, tempString);
 }
 
 /**
- * @brief Initialize the logger File Setting 
- *
- * @return void.
+ * @brief The log of a LOAD in progress.
  */
+typedef struct loadLogState {
+	const char *table;
+	uint64_t position;	///< The position of the last record appended, changed atomically.
+	bool failed;		///< A commit failed, changed atomically.
+} LoadLogState;
 
-void Initialize() {
+/**
+ * @brief Append a record about to be loaded to the write-ahead log, as
+ * logChange() does for a SET.
+ */
+static int appendLoaded(const char *key, const char *value, uintptr_t version, void *arg) {
+	LoadLogState *state = (LoadLogState *) arg;
+	WalRecord record = { WAL_SET, version, state->table, key, value };
+
+	wal_lock(serverWal);
+	uint64_t position = wal_append(serverWal, &record);
+	//appended under the lock, so the positions stored only grow
+	if (position != 0)
+		__atomic_store_n(&state->position, position, __ATOMIC_RELAXED);
+	wal_unlock(serverWal);
+	return position != 0 ? 0 : -1;
+}
 
-	//logger File
-	char tempString[MAX_STRING_SIZE];
-	time_t rawtime;
-    struct tm *tm_struct;
-    time (&rawtime);
-    tm_struct = localtime (&rawtime);
-	sprintf(tempString, "Server-%d-%d-%d-%d-%d-%d.log", 1900+tm_struct->tm_year, 1+tm_struct->tm_mon, tm_struct->tm_mday, tm_struct->tm_hour, 	  tm_struct->tm_min, tm_struct->tm_sec);
-	
-	if (LOGGING == 2){
-   		ServerFileLog = fopen(tempString, "a");
-   	}else if (LOGGING == 1){
-   		ServerFileLog = stdout;
-   	}else{
-   		ServerFileLog = NULL;
-   	}
+/**
+ * @brief Make the records a load appended so far durable.
+ */
+static int commitLoaded(void *arg) {
+	LoadLogState *state = (LoadLogState *) arg;
 
-   	//initialize threadcounter
-   	ThreadCounter = 0;
-   	printf("ThreadCounter = %d\n", ThreadCounter);
+	if (wal_commit(serverWal, __atomic_load_n(&state->position, __ATOMIC_RELAXED)) == 0)
+		return 0;
+	__atomic_store_n(&state->failed, true, __ATOMIC_RELAXED);
+	return -1;
 }
 
 /**
- * @brief Deallocate all the hash tables
+ * @brief Process a LOAD function: load a CSV file local to the server
+ * into a table
  *
- * @return void.
+ * Replies "SUCCESS#<loaded>#<rejected>#" with the number of records set
+ * and of lines not set. With a data_directory, each record is logged
+ * as SET logs it, so a load that stops partway still keeps the records
+ * it set, and is answered with them; a snapshot is then asked for in
+ * the background to fold them out of the log.
+ *
+ * @param command The command received from the client.
+ * @param session The session of the client.
+ * @return void
  */
+void Load(Command *command, Session *session ) {
+	char tempString[MAX_STRING_SIZE];
+	char *message = session->message;
 
-void RemoveHashTables () {
-	int i;
-	for (i=0;i < params.table_number; i++ )
-		ht_removeAll(ourHashTable[i]);
-}
-
+	if(session->authenticationStatus == false){
+		sprintf(message, "Error#%d#", ERR_NOT_AUTHENTICATED);
+		replyToClient(session, message);
+		return;
+	}
 
+	char *table = cmd_next(command);
+	char *path = cmd_next(command);
+	int table_index = table != NULL ? isTableNameExist(table, &params) : -1;
+	if (table_index == -1) {
+		sprintf(message, "Error#%d#", ERR_TABLE_NOT_FOUND);
+		replyToClient(session, message);
+		return;
+	}
+	if (path == NULL) {
+		sprintf(message, "Error#%d#", ERR_INVALID_PARAM);
+		replyToClient(session, message);
+		return;
+	}
 
-ThreadInfo getThreadInfo(void) { 
-  ThreadInfo currThreadInfo = NULL;
+	struct timeval start_time, end_time;
+	gettimeofday(&start_time, NULL);
 
-  /* Wait as long as there are no more threads in the buffer */ 
-  pthread_mutex_lock( &conditionMutex ); 
-  while (((botRT+1)%MAX_THREADS)==topRT)
-  pthread_cond_wait(&conditionCond,&conditionMutex); 
-  
-  /* At this point, there is at least one thread available for us. We
-     take it, and update the circular buffer  */ 
-  currThreadInfo = runtimeThreads[botRT]; 
-  botRT = (botRT + 1)%MAX_THREADS;
+	//one load at a time, and none while a snapshot is taken
+	LoadStats stats;
+	LoadLogState state = { params.table_names[table_index].tablename, 0, false };
+	LoadLog log = { appendLoaded, commitLoaded, &state };
+	pthread_mutex_lock(&setMutex);
+	int status = loader_load(ourHashTable[table_index], &params.table_names[table_index].schema, path, 0,
+			serverWal != NULL ? &log : NULL, &stats);
+	int error = errno;
+	pthread_mutex_unlock(&setMutex);
+	if (serverWal != NULL && stats.loaded > 0)
+		requestSnapshot();
 
-  /* Release the mutex, so other clients can add threads back */ 
-  pthread_mutex_unlock( &conditionMutex ); 
-  
-  return currThreadInfo;
+	gettimeofday(&end_time, NULL);
+	double tempEvaluationTime = (end_time.tv_sec - start_time.tv_sec) * 1000000.0 + (end_time.tv_usec - start_time.tv_usec);
+	sprintf(tempString, "[PERFORMANCE] Server LOAD of %d records from %s: %lf microseconds.\n",
+			stats.loaded, path, tempEvaluationTime);
+	logger(ServerFileLog, tempString);
+	logTableMemory(table_index);
+
+	//records set before an error are kept, so the load partly succeeded
+	if (!state.failed && (status == 0 || stats.loaded > 0))
+		sprintf(message, "SUCCESS#%d#%d#", stats.loaded, stats.rejected);
+	else
+		sprintf(message, "Error#%d#", error == ENOENT ? ERR_INVALID_PARAM : ERR_UNKNOWN);
+	replyToClient(session, message);
 }
 
-/* Function called when thread is about to finish -- unless it is
-   called, the ThreadInfo assigned to it is lost */ 
-void releaseThread(ThreadInfo me) {
-  pthread_mutex_lock( &conditionMutex ); 
-  //assert( botRT!=topRT ); 
- 
-  runtimeThreads[topRT] = me; 
-  topRT = (topRT + 1)%MAX_THREADS; 
-
-  /* tell getThreadInfo a new thread is available */ 
-  pthread_cond_signal( &conditionCond ); 
+/**
+ * @brief Process a Query function
+ *
+ * @param command The command received from the client.
+ * @param session The session of the client.
+ * @return void
+ */
+void Query(Command *command, Session *session ){
+	char tempString[MAX_STRING_SIZE];
+	char *message = session->message;
 
-  /* Release the mutex, so other clients can get new threads */ 
-  pthread_mutex_unlock( &conditionMutex ); 
-}
+		// 0) Not Authenticated
+		if(session->authenticationStatus == false){
+			errno = ERR_NOT_AUTHENTICATED;
+			sprintf(message, "Error#%d#", errno);
+			replyToClient(session, message);
+			return;
+		}
 
+		//getting table, predicates, and max_key
+		char *table = cmd_next(command);
+		char *predicates = cmd_next(command);
+		char *tempMax_keys = cmd_next(command);
+		if (table == NULL || predicates == NULL || tempMax_keys == NULL) {
+			sprintf(message, "Error#%d#", ERR_INVALID_PARAM);
+			replyToClient(session, message);
+			return;
+		}
+		int table_index = isTableNameExist(table, &params);
 
-/* This function receives a string from clients and echoes it back --
-   the thread is released when the thread is finished */
-void * threadCallFunction(void *arg) { 
-  printf("successfully created a thread\n");
 
-  ThreadInfo tiInfo = (ThreadInfo)arg; 
-  CommandHandler(&(tiInfo->clientsock));
+		long int max_keys;
+		char* p;
+		max_keys = strtol(tempMax_keys, &p, 10);
 
-  printf("Releasing the thread \n");
-  releaseThread( tiInfo ); 
-  return NULL; 
-}
 
+		//1) tablename not found
+		if (table_index == -1) {
+			//message to the client
+			sprintf(message, "Error#%d#", ERR_TABLE_NOT_FOUND);
 
+			//send the message
+			replyToClient(session, message);
+			return;
+		}
 
-void CommandHandler ( int*clientsock ) {
-	char tempString[MAX_STRING_SIZE];
+		//2) max_keys is not a count
+		if (p == tempMax_keys || max_keys < 0 || max_keys > INT_MAX) {
+			sprintf(message, "Error#%d#", ERR_INVALID_PARAM);
+			replyToClient(session, message);
+			return;
+		}
 
-	// Listen loop.
-	wait_for_connections = 1;
-	while (wait_for_connections) {
 
 
+        //Compiling the predicates, or reusing the plan of an identical query
+        QueryPlan *plan = qp_get(&params, table_index, predicates);
+        if (plan == NULL) {
+			sprintf(message, "Error#%d#", ERR_UNKNOWN);
+			replyToClient(session, message);
+			return;
+        }
 
-		//get command from the client
-		wait_for_commands = 1;
-		commandPointer = (char *)malloc(sizeof(char) * MAX_CMD_LEN);
-		char *command = commandPointer;
-		message = (char *)malloc(sizeof(char) * MAX_CMD_LEN);
+       	if (plan->valid == INVALID) {
+			qp_release(plan);
+			//message to the client
+			sprintf(message, "Error#%d#", ERR_INVALID_PARAM);
 
-		do {
-			printf("came in here with %d\n", *clientsock);
-			int status1 = recvline(*clientsock, command, MAX_CMD_LEN);
+			//send the message
+			replyToClient(session, message);
+			return;
+		}
 
-			// Either an error occurred or the client closed the connection.
-			if (status1 != 0) {
-				wait_for_commands = 0;
-			}
+    	//keys are sent as the scan finds them, up to max_keys
+    	QueryReply *reply = (QueryReply *) malloc(sizeof(QueryReply));
+    	if (reply == NULL) {
+			qp_release(plan);
+			sprintf(message, "Error#%d#", ERR_UNKNOWN);
+			replyToClient(session, message);
+			return;
+    	}
+    	reply->session = session;
+    	reply->used = 0;
+    	reply->size = QUERY_PREFIX_LEN;
+    	reply->numKeys = 0;
+    	KeySink sink = { replyQueryKey, reply, (int) max_keys, 0, false };
 
-			else {
-			//getting the function word
-				printf("goes in the else statement \n");
-
-				char *function = getNextWord(&command, '#');
-				printf("goes in the else statement 1 %s\n", function);
-				//1) Authenticate Function
-				if (strcmp(function, "AUTH") == 0) {
-					Authenticate(&command, *clientsock);
-				}
-				//parallize as much as i can
-		
-				//2) GET Function
-				else if (strcmp(function, "GET") == 0) {
-					Get(&command, *clientsock);
-				}
+       	struct timeval start_time, end_time;
+    	gettimeofday(&start_time, NULL);
 
-				//3) SET Function
-				else if (strcmp(function, "SET") == 0) {
-					Set(&command, *clientsock);
-				}
+        int status = ht_query (ourHashTable[table_index], plan, &sink);
+        qp_release(plan);
 
-				else if (strcmp(function, "QUERY") == 0) {
-					Query(&command, *clientsock);
-				}
+        gettimeofday(&end_time, NULL);
+	    double tempEvaluationTime = (end_time.tv_usec) - (start_time.tv_usec);
+	    total_server_process_time += tempEvaluationTime;
+	    sprintf(tempString, "[PERFORMANCE] Server QUERY Processing Time: %lf microseconds.\n", tempEvaluationTime);
+	    logger(ServerFileLog, tempString);
+	    sprintf(tempString, "[PERFORMANCE] Current Server Total Processing Time: %lf microseconds.\n", total_server_process_time);
+	    logger(ServerFileLog, tempString);
 
-				//deallocating memory
-				free(function);
-			}
-		} while (wait_for_commands);
+		//an error after "MORE#" replies still ends the reply
+		if (status == -1) {
+			sprintf(message, "Error#%d#", sink.failed ? ERR_UNKNOWN : ERR_KEY_NOT_FOUND);
+			replyToClient(session, message);
+		}
 
-		//deallocating memory
-		free(commandPointer);
-		free(message);
+		//Keys Found, the last of them with the number of matches
+		else {
+			char number[MAX_STRING_SIZE];
+			snprintf(number, sizeof number, "%d", status);
+			reply->fields[0] = "SUCCESS";
+			reply->fields[1] = number;
+			replyFields(session, reply->numKeys + 2, reply->fields);
+		}
+		free(reply);
+}
 
-		// Close the connection with the client.
-		printf("closing client socket \n");
-		wait_for_connections = 0;
 
-		close(*clientsock);
-		//sprintf(tempString,"[LOG] Closed connection from %s:%d.\n", inet_ntoa(clientaddr.sin_addr), clientaddr.sin_port);
-		//logger(ServerFileLog, tempString);
+/**
+ * @brief Close every cursor a client left open.
+ *
+ * @param session The session of the client.
+ * @return void
+ */
+void closeCursors(Session *session) {
+	int i;
+	for (i = 0; i < MAX_CURSORS; i++) {
+		if (session->cursors[i] != NULL)
+			ht_queryClose(session->cursors[i]);
+		session->cursors[i] = NULL;
 	}
 }
 
-void MultiThreadMode()  {
-
-	//Listening for any connection
-   int status = listen(listensock, MAX_LISTENQUEUELEN);
-   printf("listened\n");
-  if (status != 0) { 
-    printf("Error listening.\n"); 
-    return -1; 
-  }
-
-  int i;
-  // First, we allocate the thread pool 
-  for (i = 0; i!=MAX_THREADS; ++i)
-    runtimeThreads[i] = malloc( sizeof( struct _ThreadInfo ) ); 
-
-  while (1) { 
-    ThreadInfo tiInfo = getThreadInfo(); 
-    tiInfo->clientaddrlen = sizeof(struct sockaddr_in); 
-    tiInfo->clientsock = accept(listensock, (struct sockaddr*)&tiInfo->clientaddr, &tiInfo->clientaddrlen);
-  	  printf("accepted\n");
-
-    // accepting the client socket fails
-    if (tiInfo->clientsock <0) {
-      pthread_mutex_lock( &printMutex ); 
-      printf("ERROR in connecting to %s:%d.\n", 
-	     inet_ntoa(tiInfo->clientaddr.sin_addr), tiInfo->clientaddr.sin_port);
-      pthread_mutex_unlock( &printMutex ); 
-    } 
-
-    // succeeded in listening -> create thread
-    else {
-      pthread_create( &tiInfo->theThread, NULL, threadCallFunction, tiInfo ); 
-    }
-  } 
-
-  /* At the end, wait until all connections close */ 
-  for (i=topRT; i!=botRT; i = (i+1)%MAX_THREADS)
-    pthread_join(runtimeThreads[i]->theThread, 0 ); 
-
-  /* Deallocate all the resources */ 
-  for (i=0; i!=MAX_THREADS; i++)
-    free( runtimeThreads[i] ); 
+/**
+ * @brief Get the cursor a command names.
+ *
+ * @param id The cursor id sent by the client.
+ * @param session The session of the client.
+ * @return Returns the index of the cursor in the session, -1 if there is no such cursor.
+ */
+static int findCursor(char *id, Session *session) {
+	char *p;
+	long int index;
+
+	if (id == NULL)
+		return -1;
+	index = strtol(id, &p, 10);
+	if (p == id || *p != '\0' || index < 0 || index >= MAX_CURSORS || session->cursors[index] == NULL)
+		return -1;
+	return (int) index;
 }
 
-void NoConcurrentMode() {
+/**
+ * @brief Process a QUERY_OPEN function: open a cursor over the matches of a query
+ *
+ * Replies "SUCCESS#<cursor>#".
+ *
+ * @param command The command received from the client.
+ * @param session The session of the client.
+ * @return void
+ */
+void QueryOpen(Command *command, Session *session ){
+	char *message = session->message;
 
-  	// Listen for connections.
-	int status = listen(listensock, MAX_LISTENQUEUELEN);
-	if (status != 0) {
-		printf("Error listening on socket.\n");
-		errno = ERR_UNKNOWN;
-		exit(EXIT_FAILURE);
-	}
+		if(session->authenticationStatus == false){
+			sprintf(message, "Error#%d#", ERR_NOT_AUTHENTICATED);
+			replyToClient(session, message);
+			return;
+		}
 
-	// Listen loop.
-	wait_for_connections = 1;
-	while (wait_for_connections) {
+		char *table = cmd_next(command);
+		char *predicates = cmd_next(command);
+		int table_index = table != NULL ? isTableNameExist(table, &params) : -1;
+		int id;
 
-		// Wait for a connection.
-		struct sockaddr_in clientaddr;
-		socklen_t clientaddrlen = sizeof clientaddr;
-		int clientsock = accept(listensock, (struct sockaddr*)&clientaddr, &clientaddrlen);
-		if (clientsock < 0) {
-			printf("Error accepting a connection.\n");
-			errno = ERR_CONNECTION_FAIL;
-			exit(EXIT_FAILURE);
+		for (id = 0; id < MAX_CURSORS && session->cursors[id] != NULL; id++)
+			;
+
+		if (table_index == -1 || predicates == NULL) {
+			sprintf(message, "Error#%d#", table_index == -1 ? ERR_TABLE_NOT_FOUND : ERR_INVALID_PARAM);
+			replyToClient(session, message);
+		}
+		else if (id == MAX_CURSORS) {
+			sprintf(message, "Error#%d#", ERR_UNKNOWN);
+			replyToClient(session, message);
+		}
+		else {
+			QueryPlan *plan = qp_get(&params, table_index, predicates);
+			if (plan != NULL && plan->valid == INVALID) {
+				qp_release(plan);
+				sprintf(message, "Error#%d#", ERR_INVALID_PARAM);
+			}
+			else if (plan == NULL || (session->cursors[id] = ht_queryOpen(ourHashTable[table_index], plan)) == NULL) {
+				if (plan != NULL)
+					qp_release(plan);
+				sprintf(message, "Error#%d#", ERR_UNKNOWN);
+			}
+			else
+				sprintf(message, "SUCCESS#%d#", id);
+			replyToClient(session, message);
 		}
 
-		//logger
-		sprintf(tempString, "[LOG] Got a connection from %s:%d.\n", inet_ntoa(clientaddr.sin_addr), clientaddr.sin_port);
-		logger(ServerFileLog, tempString);
-		params.authorized = false;
+}
 
-		//get command from the client
-		wait_for_commands = 1;
-		commandPointer = (char *)malloc(sizeof(char) * MAX_CMD_LEN);
-		command = commandPointer;
-		message = (char *)malloc(sizeof(char) * MAX_CMD_LEN);
+/**
+ * @brief Process a QUERY_NEXT function: send the next page of a cursor
+ *
+ * Replies as QUERY does, with the number of keys in the page; a page
+ * shorter than asked for is the last one.
+ *
+ * @param command The command received from the client.
+ * @param session The session of the client.
+ * @return void
+ */
+void QueryNext(Command *command, Session *session ){
+	char *message = session->message;
 
-		do {
-			int status1 = recvline(clientsock, command, MAX_CMD_LEN);
+		if(session->authenticationStatus == false){
+			sprintf(message, "Error#%d#", ERR_NOT_AUTHENTICATED);
+			replyToClient(session, message);
+			return;
+		}
 
-			// Either an error occurred or the client closed the connection.
-			if (status1 != 0) {
+		char *id = cmd_next(command);
+		char *tempMax_keys = cmd_next(command);
+		int index = findCursor(id, session);
+		long int max_keys = -1;
+		char *p;
 
-				wait_for_commands = 0;
-			}
+		if (tempMax_keys != NULL) {
+			max_keys = strtol(tempMax_keys, &p, 10);
+			if (p == tempMax_keys || max_keys > MAX_PAGE_KEYS)
+				max_keys = -1;
+		}
 
+		char **keys = max_keys > 0 ? (char **) malloc(sizeof(char *) * max_keys) : NULL;
+		int status = -1;
 
-			else {
-			//getting the function word
-				char *function = getNextWord(&command, '#');
-
-				//1) Authenticate Function
-				if (strcmp(function, "AUTH") == 0) {
-					Authenticate(&command, clientsock);
-				}
-				
-				//2) GET Function
-				else if (strcmp(function, "GET") == 0) {
-					Get(&command,clientsock);
-				}
-
-				//3) SET Function
-				else if (strcmp(function, "SET") == 0) {
-					Set(&command, clientsock);
-				}
-
-				else if (strcmp(function, "QUERY") == 0) {
-					Query(&command, clientsock);
-				}
-				//deallocating memory
-				free(function);
-			}
-		} while (wait_for_commands);
-
-		//deallocating memory
-		free(commandPointer);
-		free(message);
+		if (index == -1 || max_keys < 0) {
+			sprintf(message, "Error#%d#", ERR_INVALID_PARAM);
+			replyToClient(session, message);
+		}
+		else if ((max_keys > 0 && keys == NULL)
+				|| (status = ht_queryNext(session->cursors[index], keys, (int) max_keys)) < 0) {
+			sprintf(message, "Error#%d#", ERR_UNKNOWN);
+			replyToClient(session, message);
+		}
+		else
+			replyQueryKeys(session, status, keys, status);
 
-		// Close the connection with the client.
-		close(clientsock);
-		sprintf(tempString,"[LOG] Closed connection from %s:%d.\n", inet_ntoa(clientaddr.sin_addr), clientaddr.sin_port);
-		logger(ServerFileLog, tempString);
-	}
+		int i;
+		for (i = 0; i < status; i++)
+			free(keys[i]);
+		free(keys);
 }
 
-
-
-/******************************************************************************/
 /**
- * @brief Process a Authenticate function 
+ * @brief Process a QUERY_CLOSE function: release a cursor
  *
  * @param command The command received from the client.
+ * @param session The session of the client.
  * @return void
  */
-void AuthenticateSelect (char ** command, ListOfClients * client ) {
-	//getting the password and username
-		char * username = getNextWord(command, '#');
-		char * password = getNextWord(command, '#');
-
-		//comparing the encrypted password
-		//1) Encrypted password - no match
-		//	 Username - nomatch
-		if (strcmp(password, params.password) != 0 || strcmp(username, params.username) != 0) {
+void QueryClose(Command *command, Session *session ){
+	char *message = session->message;
 
-			//message to the client
-			sprintf(message, "Error#%d#", ERR_AUTHENTICATION_FAILED);
+		char *id = cmd_next(command);
+		int index = findCursor(id, session);
 
-			//send the message
-			int status1 = handle_command(client->sock, message);
-			if (status1 != 0)
-				wait_for_commands = 0; // Oops.  An error occured.
+		if (index == -1) {
+			sprintf(message, "Error#%d#", ERR_INVALID_PARAM);
+			replyToClient(session, message);
 		}
-
-		//2) Encrypted password - match
-		// Username - match
 		else {
-			client->authenticationStatus = true;
-			sprintf(message, "SUCCESS");
-			handle_command(client->sock, message);
+			ht_queryClose(session->cursors[index]);
+			session->cursors[index] = NULL;
+			replyToClient(session, "SUCCESS#");
 		}
-
-		//deallocating memory
-		free(username);
-		free(password);
 }
 
 /**
- * @brief Process a Get function 
+ * @brief Run one command of a client.
  *
- * @param command The command received from the client.
- * @return void
+ * @param session The session of the client that sent the command.
+ * @param request The command line without the trailing newline, or the
+ * payload of the frame in session->frame; split in place.
+ * @return Returns EXIT if the client asked to disconnect, NOT_EXIT otherwise.
  */
+int processClientCommand (Session *session, char *request) {
+	int status = NOT_EXIT;
+	Command command;
+	int opcode;
+
+	//getting the function, from the frame header or the first word
+	if (session->binary) {
+		cmd_init(&command, request, session->frame.length, true);
+		opcode = session->frame.opcode;
+	}
+	else {
+		cmd_init(&command, request, strlen(request), false);
+		opcode = commandOpcode(cmd_next(&command));
+	}
 
-void GetSelect (char ** command, ListOfClients* client ) {
-
-	printf("i get the value here1");
-	char tempString[MAX_STRING_SIZE];
-	// 0) Not Authenticated
-	if(client->authenticationStatus == false){
-		sprintf(message, "Error#%d#", ERR_NOT_AUTHENTICATED);
-		handle_command(client->sock, message);
-		return;
+	switch (opcode) {
+	case OP_AUTH:
+		Authenticate(&command, session);
+		break;
+	case OP_GET:
+		Get(&command, session);
+		break;
+	case OP_SET:
+		Set(&command, session);
+		break;
+	case OP_QUERY:
+		Query(&command, session);
+		break;
+	case OP_QUERY_OPEN:
+		QueryOpen(&command, session);
+		break;
+	case OP_QUERY_NEXT:
+		QueryNext(&command, session);
+		break;
+	case OP_QUERY_CLOSE:
+		QueryClose(&command, session);
+		break;
+	case OP_MGET:
+		MGet(&command, session);
+		break;
+	case OP_MSET:
+		MSet(&command, session);
+		break;
+	case OP_SNAPSHOT:
+		Snapshot(&command, session);
+		break;
+	case OP_LOAD:
+		Load(&command, session);
+		break;
+	case OP_DISCONNECT:
+		replyToClient(session, "SUCCESS");
+		session->authenticationStatus = false;
+		status = EXIT;
+		break;
+	case OP_BINARY:
+		//the reply is the last text line, then both sides send frames
+		replyToClient(session, "SUCCESS#");
+		session->binary = true;
+		break;
+	default:
+		//answered all the same, so pipelined replies stay in order
+		sprintf(session->message, "Error#%d#", ERR_INVALID_PARAM);
+		replyToClient(session, session->message);
+		break;
 	}
+	return status;
+}
 
-	//getting table and key 
-	char *table = getNextWord(command, '#');
-	char *key = getNextWord(command, '#');
-	int table_index = isTableNameExist(table, &params);
+/**
+ * @brief Take the next request of a client out of its read buffer.
+ *
+ * @param session The session of the client.
+ * @param buf Where the request is copied; MAX_CMD_LEN bytes.
+ * @return Returns 1 if a request was copied, 0 if none is complete yet,
+ * -1 if the client sent something that is not a frame.
+ */
+static int getRequest (Session *session, char *buf) {
+	if (session->binary)
+		return rb_getframe(&session->readBuffer, &session->frame, buf);
+	return rb_getline(&session->readBuffer, buf, MAX_CMD_LEN);
+}
 
+/**
+ * @brief Check whether getRequest() has something to return.
+ */
+static bool hasRequest (const Session *session) {
+	if (session->binary)
+		return rb_hasFrame(&session->readBuffer);
+	return rb_hasLine(&session->readBuffer);
+}
 
-	//dealing with only one table - from config file
-	printf("i get the value here2");
+/**
+ * @brief Receive the next request of a client, blocking until it is complete.
+ *
+ * @param session The session of the client.
+ * @param buf Where the request is copied; MAX_CMD_LEN bytes.
+ * @return Returns 0 on success, -1 otherwise.
+ */
+static int recvRequest (Session *session, char *buf) {
+	if (session->binary)
+		return rb_recvframe(&session->readBuffer, &session->frame, buf);
+	return rb_recvline(&session->readBuffer, buf, MAX_CMD_LEN);
+}
 
-	//1) tablename not found
-	if (table_index == -1) {
-		//message to the client
-		sprintf(message, "Error#%d#", ERR_TABLE_NOT_FOUND);
+/*
+bool columnName_checker(char *columnName)
+{
+	//Check with table schema for valid parameters
+	return false;
+} */
+/**
+ * @brief Uploading census.txt file to the data structure
+ *
+ * Loads the census file with the bulk loader, and logs its records, as
+ * LOAD does.
+ *
+ * @return Returns 0 on success, -1 otherwise.
+ */
 
-		//send the message
-		int status1 = handle_command(client->sock, message);
-		if (status1 != 0)
-			wait_for_commands = 0; // Oops.  An error occured.
-		return;
-	}
+int upload(int table_index) {
+	LoadStats stats;
+	LoadLogState state = { params.table_names[table_index].tablename, 0, false };
+	LoadLog log = { appendLoaded, commitLoaded, &state };
+
+	int status = loader_load(ourHashTable[table_index], &params.table_names[table_index].schema, UPLOAD_FILE, 0,
+			serverWal != NULL ? &log : NULL, &stats);
+	if (serverWal != NULL && stats.loaded > 0)
+		requestSnapshot();
+	return status == 0 && !state.failed ? 0 : -1;
+}
 
-	struct timeval start_time, end_time;
-	gettimeofday(&start_time, NULL);
-	printf("i get the value here3");
-	//char* data = ht_get(ourHashTable[table_index], key);
+/**
+ * @brief Check the validity of the Configuration file. 
+ *
+ * @param config_file the config_file name.
+ * @return Returns 0 on success, exit otherwise.
+ */
+int CheckConfigFile(char * config_file, struct config_params* params ) {
+	strcpy(params->username, "NOTINIT");
+	strcpy(params->password, "NOTINIT");
+	strcpy(params->server_host, "NOTINIT");
+	params->table_number =0;
+	params->server_port =0;
+	params->concurrencyMode = -1;
+	params->workerThreads = 0;
+	params->parallelScanThreshold = 0;
+	params->data_directory[0] = '\0';
+	params->durability = WAL_SYNC_COMMIT;
+	params->snapshotInterval = 0;
 
-	//pthread_mutex_lock( &getMutex ); 	
-	Entry* data = ht_get(ourHashTable[table_index], key);
-	//pthread_mutex_unlock( &getMutex ); 
-	//sets the metabase value to the previousMeta value.
+	//updating the config file with bison and flex
+	int status;
+	status =  parse(config_file, params);
 
-	gettimeofday(&end_time, NULL);
-    double tempEvaluationTime = (end_time.tv_usec) - (start_time.tv_usec);
-    total_server_process_time += tempEvaluationTime;
-    sprintf(tempString, "[PERFORMANCE] Server GET Processing Time: %lf microseconds.\n", tempEvaluationTime);
-    logger(ServerFileLog, tempString);
-    sprintf(tempString, "[PERFORMANCE] Current Server Total Processing Time: %lf microseconds.\n", total_server_process_time);
-    logger(ServerFileLog, tempString);
+	//checking if the config file is valid
+	bool isValidColumn = isValidColumnIndex(params);
 
-    printf("i get the value here4");
-	//2) keyvalue not found
-	
-	if (data == NULL ) {
-		sprintf(message, "Error#%d#", ERR_KEY_NOT_FOUND);
-		handle_command(client->sock, message);
-		return;
+	if (isValidColumn == false) {
+		status =  -1;
 	}
 
-	char metadata[MAX_STRING_SIZE]; 
-	sprintf(metadata, "%d", data->metadata);
 
-	//3) everything fine
-	if (data != NULL){
-		sprintf(message, "SUCCESS#%s#%s#%s#", key, data->value, metadata);
-		handle_command(client->sock, message);
-	}
+	if (strcmp(params->username, "NOTINIT") == 0 || strcmp(params->password, "NOTINIT") == 0 
+			|| strcmp(params->server_host, "NOTINIT") == 0 || params->table_number == 0 || params->server_port == 0
+			|| params->password == 0 || params->concurrencyMode == -1) 
+		status =  -1;
+
+	return status; 
 
-	//deallocating memory
-	free(table);
-	free(key);
 }
 
 /**
- * @brief Process a Set function 
+ * @brief Initialize the logger File Setting 
  *
- * @param command The command received from the client.
- * @return void
+ * @return void.
  */
 
-void SetSelect( char ** command, ListOfClients* client  ) {
+void Initialize() {
 
+	//logger File
 	char tempString[MAX_STRING_SIZE];
-		// 0) Not Authenticated
-		if(client->authenticationStatus == false){
-			errno = ERR_NOT_AUTHENTICATED;
-			sprintf(message, "Error#%d#", errno);
-			handle_command(client->sock, message);
-			return;
-		}
-
-		//getting table, key, and value
-		char *table = getNextWord(command, '#');
-		char *key = getNextWord(command, '#');
-		char *value = getNextWord(command, '#');
-		char *metadata = getNextWord(command, '#');
-
+	time_t rawtime;
+    struct tm *tm_struct;
+    time (&rawtime);
+    tm_struct = localtime (&rawtime);
+	sprintf(tempString, "Server-%d-%d-%d-%d-%d-%d.log", 1900+tm_struct->tm_year, 1+tm_struct->tm_mon, tm_struct->tm_mday, tm_struct->tm_hour, 	  tm_struct->tm_min, tm_struct->tm_sec);
+	
+	if (LOGGING == 2){
+   		ServerFileLog = fopen(tempString, "a");
+   	}else if (LOGGING == 1){
+   		ServerFileLog = stdout;
+   	}else{
+   		ServerFileLog = NULL;
+   	}
 
+   	//initialize threadcounter
+   	ThreadCounter = 0;
+   	printf("ThreadCounter = %d\n", ThreadCounter);
+}
 
-		int table_index = isTableNameExist(table, &params);
-		char *p;
-		long int metaData = strtol(metadata, &p, 10);
+/**
+ * @brief Deallocate all the hash tables
+ *
+ * @return void.
+ */
 
-		printf("Parsed Set\n" );
-		//1) tablename not found
-		if (table_index == -1) {
-			//message to the client
-			sprintf(message, "Error#%d#", ERR_TABLE_NOT_FOUND);
+void RemoveHashTables () {
+	int i;
+	for (i=0;i < params.table_number; i++ ) {
+		logTableMemory(i);
+		ht_removeAll(ourHashTable[i]);
+	}
+}
 
-			//send the message
-			int status1 = handle_command(client->sock, message);
-			if (status1 != 0)
-				wait_for_commands = 0; // Oops.  An error occured.
-			return;
-		}
 
-		//2) Deleting Process
-		if (strlen(value) == 0) {
 
-			int isDeleted = ht_removeItem(ourHashTable[table_index], key);
+void NoConcurrentMode() {
 
-			if (isDeleted == HASH_SET_DELETE)
-				handle_command(client->sock, "DELETE#");
-			else {
-				sprintf(message, "Error#%d#",ERR_KEY_NOT_FOUND );
-				handle_command(client->sock, message);
-			}
-			return;
-		}
+  	// Listen for connections.
+	int status = listen(listensock, MAX_LISTENQUEUELEN);
+	if (status != 0) {
+		printf("Error listening on socket.\n");
+		errno = ERR_UNKNOWN;
+		exit(EXIT_FAILURE);
+	}
 
- 		
- 		// 4) UPLOAD function
-		if (strcmp(key, "UPLOAD") == 0 && strcmp(value, "UPLOAD") == 0) {
-			int status = upload(table_index);
-			if (status == 0) {
-				sprintf(message, "UPLOAD#");
-				handle_command(client->sock, message);
-			}
-			else {
-				sprintf(message, "Error#%d#",ERR_UNKNOWN );
-				handle_command(client->sock, message);
-			}
-			return;
-		}
-		
-		//3) Check if the input string format is correct
-		if (strcmp(key, "UPLOAD") != 0 && strcmp(value, "UPLOAD") != 0 && strlen(value) != 0 ) {
-			
-			printf("insert isInputValid Function \n");
-			bool Input_String_Format = isInputFormatCorrect(value, &params, table_index);
-			if (Input_String_Format == false) {
-				sprintf(message, "Error#%d#", ERR_INVALID_PARAM);
+	// Listen loop.
+	wait_for_connections = 1;
+	while (wait_for_connections) {
 
-				//send the message
-				int status1 = handle_command(client->sock, message);
-				if (status1 != 0)
-					wait_for_commands = 0; // Oops.  An error occured.
-				return;
-			}
+		// Wait for a connection.
+		struct sockaddr_in clientaddr;
+		socklen_t clientaddrlen = sizeof clientaddr;
+		int clientsock = accept(listensock, (struct sockaddr*)&clientaddr, &clientaddrlen);
+		if (clientsock < 0) {
+			printf("Error accepting a connection.\n");
+			errno = ERR_CONNECTION_FAIL;
+			exit(EXIT_FAILURE);
 		}
+		setNoDelay(clientsock);
 
+		//logger
+		sprintf(tempString, "[LOG] Got a connection from %s:%d.\n", inet_ntoa(clientaddr.sin_addr), clientaddr.sin_port);
+		logger(ServerFileLog, tempString);
 
-		//gets the metadat value
-		//1) if the metadata == 0 just set
-		//2) if the metadata is nonzero, compare with the value from the hashtable
-
-		Entry* data = ht_get(ourHashTable[table_index], key);
-
-		if (data != NULL && metaData != 0 && data->metadata != metaData) {
-			sprintf(message, "Error#%d#",ERR_TRANSACTION_ABORT );
-			handle_command(client->sock, message);
-			return;
+		// One session at a time in this mode, so the buffers are reused
+		// for every connection.
+		static Session session;
+		session.sock = clientsock;
+		session.authenticationStatus = false;
+		memset(session.cursors, 0, sizeof session.cursors);
+		session.binary = false;
+		session.walPosition = 0;
+		rb_init(&session.readBuffer, clientsock);
+		WriteBuffer output;
+		wb_init(&output);
+		session.output = &output;
+
+		//get command from the client; the replies to the requests that
+		//arrived together go out in one write
+		char command[MAX_CMD_LEN];
+		int status = NOT_EXIT;
+		while (status != EXIT && recvRequest(&session, command) == 0) {
+			status = processClientCommand(&session, command);
+			if ((status == EXIT || !hasRequest(&session))
+					&& (commitSession(&session) != 0 || wb_sendall(&output, clientsock) != 0))
+				break;
 		}
 
-		struct timeval start_time, end_time;
-    	gettimeofday(&start_time, NULL);
-
-    	//pthread_mutex_lock( &setMutex );
-		int status = ht_set(ourHashTable[table_index], key, value);
-		//pthread_mutex_unlock( &setMutex ); 
+		// Close the connection with the client.
+		closeCursors(&session);
+		wb_free(&output);
+		close(clientsock);
+		sprintf(tempString,"[LOG] Closed connection from %s:%d.\n", inet_ntoa(clientaddr.sin_addr), clientaddr.sin_port);
+		logger(ServerFileLog, tempString);
+	}
+}
 
-		gettimeofday(&end_time, NULL);
-	    double tempEvaluationTime = (end_time.tv_usec) - (start_time.tv_usec);
-	    total_server_process_time += tempEvaluationTime;
-	    sprintf(tempString, "[PERFORMANCE] Server SET Processing Time: %lf microseconds.\n", tempEvaluationTime);
-	    logger(ServerFileLog, tempString);
-	    sprintf(tempString, "[PERFORMANCE] Current Server Total Processing Time: %lf microseconds.\n", total_server_process_time);
-	    logger(ServerFileLog, tempString);
 
 
-		//updating data
-		if (status == HASH_SET_UPDATE) {
-			handle_command(client->sock, "MODIFY#");
+void initializeFDS (fd_set* setOfConn, int listensock, Session *clients, int numClients) {
+	if (numClients < 10) {
+		FD_SET(listensock, setOfConn);
+	}
+	//Setup integer i
+	int i;
+	for (i = 0; i != 10; i++) {
+		if (clients[i].sock != 0) {
+			FD_SET(clients[i].sock, setOfConn);
 		}
+	}
+	return;
+}
 
-		//inserting the data
-		else if (status == HASH_SET_INSERT) 
-		{
-			handle_command(client->sock, "INSERT#");
+int calculateNFDS (int listensock, Session *clients) {
+	int maxFD = listensock;
+	printf("Goes into the calculateNFDS\n");
+	int i;
+	for (i = 0; i != 10; i++) {
+		printf("Goes into the calculateNFDS FOR LOOP %d\n", i);
+		if (clients[i].sock != 0 && clients[i].sock > maxFD) {
+			maxFD = clients[i].sock;
 		}
-
-		//deallocating memory
-		free(table);
-		free(key);
-		free(value);	
+	}
+	return maxFD;
 }
 
-/**
- * @brief Process a Query function 
- *
- * @param command The command received from the client.
- * @return void
- */
-void QuerySelect (char ** command, ListOfClients* client){
-	char tempString[MAX_STRING_SIZE];
-
-		// 0) Not Authenticated
-		if(client->authenticationStatus == false){
-			errno = ERR_NOT_AUTHENTICATED;
-			sprintf(message, "Error#%d#", errno);
-			handle_command(client->sock, message);
-			return;
-		}
-
-		//getting table, predicates, and max_key
-		char *table = getNextWord(command, '#');
-		char *predicates = getNextWord(command, '#');
-		char *tempMax_keys = getNextWord(command, '#');
-		int table_index = isTableNameExist(table, &params);
-
-
-		long int max_keys;
-		char* p;
-		max_keys = strtol(tempMax_keys, &p, 10);
-
-
-		//1) tablename not found
-		if (table_index == -1) {
-			//message to the client
-			sprintf(message, "Error#%d#", ERR_TABLE_NOT_FOUND);
-
-			//send the message
-			int status1 = handle_command(client->sock, message);
-			if (status1 != 0)
-				wait_for_commands = 0; // Oops.  An error occured.`
-			return;
-		}
-
-    	char * keys[max_keys];
-    	int i;
-    	for (i = 0; i < max_keys; i++)
-    		keys[i] = NULL;
-
-
-        //Allocate predicates in predicate struct
-        int numPredicates = getNumPredicates(predicates);
-        //Allocate predicates
-
-       	Predicate* predLists = createPredicateList (numPredicates, predicates); 
-
-       	int value = isPredicateValid(predLists, &params, table_index, numPredicates);
-       	
-
-       	if (value == INVALID) {
-			//message to the client
-			sprintf(message, "Error#%d#", ERR_INVALID_PARAM);
-
-			//send the message
-			int status1 = handle_command(client->sock, message);
-			if (status1 != 0)
-				wait_for_commands = 0; // Oops.  An error occured.`
-			return;
-		}
-
-
-       	struct timeval start_time, end_time;
-    	gettimeofday(&start_time, NULL);
-
-        int status = ht_query (ourHashTable[table_index], predLists, numPredicates, keys, max_keys);   
-
-
-        gettimeofday(&end_time, NULL);
-	    double tempEvaluationTime = (end_time.tv_usec) - (start_time.tv_usec);
-	    total_server_process_time += tempEvaluationTime;
-	    sprintf(tempString, "[PERFORMANCE] Server QUERY Processing Time: %lf microseconds.\n", tempEvaluationTime);
-	    logger(ServerFileLog, tempString);
-	    sprintf(tempString, "[PERFORMANCE] Current Server Total Processing Time: %lf microseconds.\n", total_server_process_time);
-	    logger(ServerFileLog, tempString); 
-
-        //Free the 2D array of keys
-   	 
-   	 	int x = 0;
-   	 	char *keyMessage = NULL;  	 	
-
-   	 	for (x = 0; x < max_keys && x < status; x++){
-   	 		if(keys[x]!=NULL)
-   	 		{
-   	 			printf("Found keys");
-   	 			if(x == 0){
-   	 				printf("Created message to send all the keys back\n");
-   	 				keyMessage = myStrDup(keys[x]);
-   	 				keyMessage = addStringSecond(keyMessage,HASHTAG);
-   	 			}
-   	 			else{
-   	 				keyMessage = addStringSecond(keyMessage,keys[x]);
-   	 				keyMessage = addStringSecond(keyMessage,HASHTAG);
-   	 			}
-   	 		}
-
-   	 	}
-
-
-   	 	for (i = 0; i < max_keys; i++){
-   	 		if (keys[i] != NULL){
-   	 			free (keys[i]);
-   	 		}
-   	 	}
-
-		if (status == 0) {
-			sprintf(message, "SUCCESS1#%d#",status);
-			handle_command(client->sock, message);
-		}
-
-		//Keys Found
-		else  
-		{
-			sprintf(message, "SUCCESS2#%d#%s",status,keyMessage );
-			handle_command(client->sock, message);
-		}
-		//deallocating memory
-		free(table);
-		free(predicates);
-		free(tempMax_keys);
-		if(keyMessage != NULL){
-			free(keyMessage);	
-		}
-}
-
-
-void initializeFDS (fd_set* setOfConn, int listensock, ListOfClients *clients, int numClients) {
-	if (numClients < 10) {
-		FD_SET(listensock, setOfConn);
-	}
-	//Setup integer i
-	int i;
-	for (i = 0; i != 10; i++) {
-		if (clients[i].sock != 0) {
-			FD_SET(clients[i].sock, setOfConn);
-		}
-	}
-	return;
-}
-
-int calculateNFDS (int listensock, ListOfClients *clients) {
-	int maxFD = listensock;
-	printf("Goes into the calculateNFDS\n");
-	int i;
-	for (i = 0; i != 10; i++) {
-		printf("Goes into the calculateNFDS FOR LOOP %d\n", i);
-		if (clients[i].sock != 0 && clients[i].sock > maxFD) {
-			maxFD = clients[i].sock;
-		}
-	}
-	return maxFD;
-}
 
-
-void addToClientSockets (ListOfClients *clients, int socket) {
+void addToClientSockets (Session *clients, WriteBuffer *outputs, int socket) {
 	int i;
 	for (i = 0; i != 10; i++) {
 		if (clients[i].sock == 0) {
 			clients[i].sock = socket;
 			//Initially set it to false
 			clients[i].authenticationStatus = false;
+			memset(clients[i].cursors, 0, sizeof clients[i].cursors);
+			clients[i].binary = false;
+			clients[i].walPosition = 0;
+			rb_init(&clients[i].readBuffer, socket);
+			wb_init(&outputs[i]);
+			clients[i].output = &outputs[i];
 			return;
 		}
 	}
@@ -1322,7 +1756,8 @@ void SelectMode (){
 	fd_set rfds;
 	int nfds;
 	int numConnectedClients = 0;
-	ListOfClients connectedClients[10] = {{0, 0}};
+	static Session connectedClients[10];
+	static WriteBuffer clientOutputs[10];
 	printf("Made the list of connected clients\n");
 
 	// Listen loop.
@@ -1357,7 +1792,8 @@ void SelectMode (){
 				errno = ERR_CONNECTION_FAIL;
 				exit(EXIT_FAILURE);
 			} else{
-				addToClientSockets (connectedClients, clientsock);
+				setNoDelay(clientsock);
+				addToClientSockets (connectedClients, clientOutputs, clientsock);
 				numConnectedClients++;
 				//logger
 				sprintf(tempString, "[LOG] Got a connection from %s:%d.\n", inet_ntoa(clientaddr.sin_addr), clientaddr.sin_port);
@@ -1371,691 +1807,668 @@ void SelectMode (){
 			if (FD_ISSET(connectedClients[i].sock, &rfds)) {
 				printf("Attempting to handle Client #%d AuthenticationStatus = %d\n", i, connectedClients[i].authenticationStatus);
 				//get command from the client
-				wait_for_commands = 1;
-				commandPointer = (char *)malloc(sizeof(char) * MAX_CMD_LEN);
-				command = commandPointer;
-				message = (char *)malloc(sizeof(char) * MAX_CMD_LEN);
-
-				//do {
-					int status1 = recvline(connectedClients[i].sock, command, MAX_CMD_LEN);
-
-					// Either an error occurred or the client closed the connection.
-					if (status1 != 0) {
-						// Close the connection with the client.
-						close(connectedClients[i].sock);
-						numConnectedClients--;
-					}
-
-					else {
-					//getting the function word
-						char *function = getNextWord(&command, '#');
-
-						//1) Authenticate Function
-						if (strcmp(function, "AUTH") == 0) {
-							AuthenticateSelect(&command, &connectedClients[i]);
-						}
-						
-						//2) GET Function
-						else if (strcmp(function, "GET") == 0) {
-							GetSelect(&command, &connectedClients[i]);
-						}
-
-						//3) SET Function
-						else if (strcmp(function, "SET") == 0) {
-							SetSelect(&command, &connectedClients[i]);
-						}
-
-						else if (strcmp(function, "QUERY") == 0) {
-							QuerySelect(&command, &connectedClients[i]);
-						}
-						//deallocating memory
-						free(function);
-					}
-				free(commandPointer);
-				free(message);
+				char command[MAX_CMD_LEN];
+				bool wait_for_commands = true;
+
+				// A single wakeup may carry several commands, and select()
+				// will not report the ones already sitting in the read buffer.
+				do {
+					int status1 = recvRequest(&connectedClients[i], command);
+
+					// Either an error occurred, the client closed the connection
+					// or it asked to disconnect.
+					if (status1 != 0 || processClientCommand(&connectedClients[i], command) == EXIT)
+						wait_for_commands = false;
+				} while (wait_for_commands && hasRequest(&connectedClients[i]));
+
+				// The replies to the whole batch go out in one write.
+				if (commitSession(&connectedClients[i]) != 0
+						|| wb_sendall(&clientOutputs[i], connectedClients[i].sock) != 0)
+					wait_for_commands = false;
+
+				if (!wait_for_commands) {
+					// Close the connection with the client.
+					closeCursors(&connectedClients[i]);
+					wb_free(&clientOutputs[i]);
+					close(connectedClients[i].sock);
+					connectedClients[i].sock = 0;
+					numConnectedClients--;
+				}
 			}
 		}
 	}
 }
 
-/******************************************************************************/
-
+/**
+ * @brief A client connection of the epoll mode.
+ */
+typedef struct epollClient {
+	Session session;
+	WriteBuffer output;	///< Replies not yet accepted by the socket.
+	struct sockaddr_in clientaddr;
+} EpollClient;
 
+/**
+ * @brief Switch a socket to non-blocking mode.
+ *
+ * @return Returns 0 on success, -1 otherwise.
+ */
+int setNonBlocking (int sock) {
+	int flags = fcntl(sock, F_GETFL, 0);
+	if (flags < 0)
+		return -1;
+	return fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+}
 
 /**
- * @brief Start the storage server.
+ * @brief Close an epoll client and release its buffers.
  *
- * This is the main entry point for the storage server.  It reads the
- * configuration file, starts listening on a port, and proccesses
- * commands from clients.
+ * Closing the socket also removes it from the epoll set.
  */
+void closeEpollClient (EpollClient *conn) {
+	sprintf(tempString,"[LOG] Closed connection from %s:%d.\n", inet_ntoa(conn->clientaddr.sin_addr), conn->clientaddr.sin_port);
+	logger(ServerFileLog, tempString);
 
-int main(int argc, char *argv[])
-{
+	closeCursors(&conn->session);
+	close(conn->session.sock);
+	wb_free(&conn->output);
+	free(conn);
+}
 
-	total_server_process_time = 0;
-	//Initialize 
-	char tempString[MAX_STRING_SIZE];
-	Initialize();
-   	
-	// Process command line arguments.
-	// This program expects exactly one argument: the config file name.
-	//assert(argc > 0);
-	if (argc != 2) {
-		printf("Usage %s <config_file>\n", argv[0]);
-		exit(EXIT_FAILURE);
+/**
+ * @brief Do all the work an epoll event allows for one client.
+ *
+ * Notifications are edge-triggered, so a client is only reported again
+ * once new data arrives or its socket becomes writable. This keeps
+ * running buffered commands, flushing their output and reading until
+ * reads would block, or until the client has so much unsent output that it
+ * has to wait for EPOLLOUT.
+ *
+ * @param conn The client to service.
+ * @return Returns EXIT if the connection must be closed, NOT_EXIT otherwise.
+ */
+int serviceEpollClient (EpollClient *conn) {
+	Session *session = &conn->session;
+	char command[MAX_CMD_LEN];
+
+	for (;;) {
+		// Run every buffered request before writing, so the replies to a
+		// pipelined batch go out together.
+		if (wb_pending(&conn->output) <= EPOLL_OUTPUT_HIGH_WATER) {
+			int request = getRequest(session, command);
+			if (request < 0)
+				return EXIT;
+			if (request > 0) {
+				if (processClientCommand(session, command) == EXIT) {
+					if (commitSession(session) == 0)
+						wb_flush(&conn->output, session->sock);
+					return EXIT;
+				}
+				continue;
+			}
+		}
+
+		if (commitSession(session) != 0 || wb_flush(&conn->output, session->sock) < 0)
+			return EXIT;
+		if (wb_pending(&conn->output) > EPOLL_OUTPUT_HIGH_WATER)
+			return NOT_EXIT;
+		if (hasRequest(session))
+			continue;
+
+		ssize_t bytes = rb_fill(&session->readBuffer);
+		if (bytes == 0)
+			return EXIT; // the client closed the connection
+		if (bytes < 0)
+			return (errno == EAGAIN || errno == EWOULDBLOCK) ? NOT_EXIT : EXIT;
 	}
-	char *config_file = argv[1];
+}
 
-	// Checking Config File
-	int status = CheckConfigFile(config_file, &params);
+/**
+ * @brief Accept every pending connection on the listening socket.
+ *
+ * @param epollfd The epoll instance new clients are added to.
+ * @param sock The listening socket.
+ * @return void
+ */
+void acceptEpollClients (int epollfd, int sock) {
+	for (;;) {
+		struct sockaddr_in clientaddr;
+		socklen_t clientaddrlen = sizeof clientaddr;
+		int clientsock = accept(sock, (struct sockaddr*)&clientaddr, &clientaddrlen);
+		if (clientsock < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				sprintf(tempString, "[LOG] Error accepting a connection: %s\n", strerror(errno));
+				logger(ServerFileLog, tempString);
+			}
+			return;
+		}
 
-	if (status != 0) {
-		printf("Error processing config file.\n");
-		errno = ERR_UNKNOWN;
-		exit(EXIT_FAILURE);
-	}
+		EpollClient *conn = (EpollClient *)malloc(sizeof(EpollClient));
+		if (conn == NULL || setNonBlocking(clientsock) != 0 || setNoDelay(clientsock) != 0) {
+			free(conn);
+			close(clientsock);
+			continue;
+		}
+		conn->session.sock = clientsock;
+		conn->session.authenticationStatus = false;
+		memset(conn->session.cursors, 0, sizeof conn->session.cursors);
+		conn->session.binary = false;
+		conn->session.walPosition = 0;
+		rb_init(&conn->session.readBuffer, clientsock);
+		wb_init(&conn->output);
+		conn->session.output = &conn->output;
+		conn->clientaddr = clientaddr;
+
+		// Register for both directions once; with EPOLLET there is no
+		// need to toggle EPOLLOUT as the output buffer fills and drains.
+		struct epoll_event event;
+		event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+		event.data.ptr = conn;
+		if (epoll_ctl(epollfd, EPOLL_CTL_ADD, clientsock, &event) != 0) {
+			close(clientsock);
+			free(conn);
+			continue;
+		}
 
-	sprintf (tempString,  "[LOG] Server on %s:%d\n", params.server_host, params.server_port);
-	logger(ServerFileLog,tempString);
+		//logger
+		sprintf(tempString, "[LOG] Got a connection from %s:%d.\n", inet_ntoa(clientaddr.sin_addr), clientaddr.sin_port);
+		logger(ServerFileLog, tempString);
+	}
+}
 
-	// Create a socket.
-	listensock = socket(PF_INET, SOCK_STREAM, 0);
-	if (listensock < 0) {
-		printf("Error creating socket.\n");
+/**
+ * @brief Run an edge-triggered epoll loop over one listening socket.
+ *
+ * Unlike SelectMode there is no cap on the number of clients and no
+ * periodic wakeup. All sockets are non-blocking; each client has its own
+ * read and write buffers, so slow readers and partial writes never
+ * block the loop. Everything the loop touches is either local or
+ * per-thread, so several loops can run side by side.
+ *
+ * @param sock A bound listening socket.
+ * @return void
+ */
+void runEpollLoop (int sock){
+	// Listen for connections.
+	int status = listen(sock, SOMAXCONN);
+	if (status != 0 || setNonBlocking(sock) != 0) {
+		printf("Error listening on socket.\n");
 		errno = ERR_UNKNOWN;
 		exit(EXIT_FAILURE);
 	}
 
-	// Allow listening port to be reused if defunct.
-	int yes = 1;
-	status = setsockopt(listensock, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof yes);
-	if (status != 0) {
-		printf("Error configuring socket.\n");
+	int epollfd = epoll_create1(0);
+	if (epollfd < 0) {
+		printf("Error creating epoll instance.\n");
 		errno = ERR_UNKNOWN;
 		exit(EXIT_FAILURE);
 	}
 
-	// Bind it to the listening port.
-	struct sockaddr_in listenaddr;
-	memset(&listenaddr, 0, sizeof listenaddr);
-	listenaddr.sin_family = AF_INET;
-	listenaddr.sin_port = htons(params.server_port);
-	inet_pton(AF_INET, params.server_host, &(listenaddr.sin_addr)); // bind to local IP address
-	status = bind(listensock, (struct sockaddr*) &listenaddr, sizeof listenaddr);
-	if (status != 0) {
-		printf("Error binding socket.\n");
+	// The listening socket is the only entry without a client pointer.
+	struct epoll_event event;
+	event.events = EPOLLIN | EPOLLET;
+	event.data.ptr = NULL;
+	if (epoll_ctl(epollfd, EPOLL_CTL_ADD, sock, &event) != 0) {
+		printf("Error adding socket to epoll instance.\n");
 		errno = ERR_UNKNOWN;
 		exit(EXIT_FAILURE);
 	}
 
-	if (params.concurrencyMode == 0)
-		NoConcurrentMode();
-	
-
+	struct epoll_event events[MAX_EPOLL_EVENTS];
 
-	if(params.concurrencyMode == 1) 
-		MultiThreadMode();
+	// Listen loop.
+	while (wait_for_connections) {
+		int numEvents = epoll_wait(epollfd, events, MAX_EPOLL_EVENTS, -1);
+		if (numEvents < 0) {
+			if (errno == EINTR)
+				continue;
+			printf("Error waiting for events.\n");
+			break;
+		}
 
-	if (params.concurrencyMode == 2){
-		SelectMode();
+		int i;
+		for (i = 0; i < numEvents; i++) {
+			EpollClient *conn = (EpollClient *)events[i].data.ptr;
+			if (conn == NULL) {
+				acceptEpollClients(epollfd, sock);
+			} else if ((events[i].events & EPOLLERR) || serviceEpollClient(conn) == EXIT) {
+				closeEpollClient(conn);
+			}
+		}
 	}
 
-	
-	// Stop listening for connections.
-	sprintf(tempString, "[PERFORMANCE] TOTAL SERVER PROCESSING TIME: %lf microseconds.\n", total_server_process_time);
-	logger(ServerFileLog, tempString);
-	RemoveHashTables();
-	close(listensock);
-	if (ServerFileLog != NULL)
-		fclose(ServerFileLog);
-	return EXIT_SUCCESS;
+	close(epollfd);
+}
+
+/**
+ * @brief Serve every client from one thread with edge-triggered epoll.
+ */
+void EpollMode (){
+	wait_for_connections = 1;
+	runEpollLoop(listensock);
 }
 
-/******************************************************************************/
 /**
- * @brief Process a Authenticate function 
+ * @brief Start routine of a reactor thread.
  *
- * @param command The command received from the client.
- * @return void
+ * @param arg Pointer to the thread's listening socket.
  */
-void AuthenticateSelect (char ** command, ListOfClients * client ) {
-	//getting the password and username
-		char * username = getNextWord(command, '#');
-		char * password = getNextWord(command, '#');
+void * reactorThread (void *arg) {
+	runEpollLoop(*(int *)arg);
+	return NULL;
+}
 
-		//comparing the encrypted password
-		//1) Encrypted password - no match
-		//	 Username - nomatch
-		if (strcmp(password, params.password) != 0 || strcmp(username, params.username) != 0) {
+/**
+ * @brief Create another listening socket bound to the server port.
+ *
+ * Every socket sharing the port must set SO_REUSEPORT before bind();
+ * the kernel then spreads incoming connections across them.
+ *
+ * @return Returns the socket, or -1 on error.
+ */
+int createReusePortSocket () {
+	int sock = socket(PF_INET, SOCK_STREAM, 0);
+	if (sock < 0)
+		return -1;
 
-			//message to the client
-			sprintf(message, "Error#%d#", ERR_AUTHENTICATION_FAILED);
+	int yes = 1;
+	struct sockaddr_in listenaddr;
+	memset(&listenaddr, 0, sizeof listenaddr);
+	listenaddr.sin_family = AF_INET;
+	listenaddr.sin_port = htons(params.server_port);
+	inet_pton(AF_INET, params.server_host, &(listenaddr.sin_addr));
+	if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof yes) != 0
+			|| setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof yes) != 0
+			|| bind(sock, (struct sockaddr*) &listenaddr, sizeof listenaddr) != 0) {
+		close(sock);
+		return -1;
+	}
+	return sock;
+}
 
-			//send the message
-			int status1 = handle_command(client->sock, message);
-			if (status1 != 0)
-				wait_for_commands = 0; // Oops.  An error occured.
+/**
+ * @brief Serve clients from several independent epoll loops.
+ *
+ * Each of the params.workerThreads threads owns a listening socket on
+ * the server port and an epoll loop. The kernel balances new
+ * connections across the sockets, so there is no shared accept thread
+ * and a connection stays on the thread that accepted it.
+ */
+void ReactorMode (){
+	int numThreads = params.workerThreads;
+	if (numThreads <= 0)
+		numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (numThreads <= 0)
+		numThreads = 1;
+
+	pthread_t *threads = (pthread_t *)malloc(sizeof(pthread_t) * numThreads);
+	int *socks = (int *)malloc(sizeof(int) * numThreads);
+
+	// The main thread runs the first loop on the socket bound in main().
+	socks[0] = listensock;
+	int i;
+	for (i = 1; i < numThreads; i++) {
+		socks[i] = createReusePortSocket();
+		if (socks[i] < 0) {
+			printf("Error creating socket for reactor thread %d.\n", i);
+			errno = ERR_UNKNOWN;
+			exit(EXIT_FAILURE);
 		}
+	}
 
-		//2) Encrypted password - match
-		// Username - match
-		else {
-			client->authenticationStatus = true;
-			sprintf(message, "SUCCESS");
-			handle_command(client->sock, message);
-		}
+	sprintf(tempString, "[LOG] Starting %d reactor threads.\n", numThreads);
+	logger(ServerFileLog, tempString);
+
+	wait_for_connections = 1;
+	for (i = 1; i < numThreads; i++)
+		pthread_create(&threads[i], NULL, reactorThread, &socks[i]);
 
-		//deallocating memory
-		free(username);
-		free(password);
+	runEpollLoop(socks[0]);
+
+	for (i = 1; i < numThreads; i++) {
+		pthread_join(threads[i], NULL);
+		close(socks[i]);
+	}
+	free(threads);
+	free(socks);
 }
 
 /**
- * @brief Process a Get function 
+ * @brief A client connection of the thread pool mode.
  *
- * @param command The command received from the client.
- * @return void
+ * The socket is registered with EPOLLONESHOT, so at most one worker
+ * handles a connection at a time and its commands run in order.
  */
+typedef struct pooledClient {
+	Session session;
+	WriteBuffer output;	///< Replies of the requests being served.
+	struct sockaddr_in clientaddr;
+} PooledClient;
 
-void GetSelect (char ** command, ListOfClients* client ) {
+WorkQueue *workQueue;
+int poolEpollfd;
 
-	printf("i get the value here1");
-	char tempString[MAX_STRING_SIZE];
-	// 0) Not Authenticated
-	if(client->authenticationStatus == false){
-		sprintf(message, "Error#%d#", ERR_NOT_AUTHENTICATED);
-		handle_command(client->sock, message);
-		return;
-	}
+/**
+ * @brief Close a thread pool client and release it.
+ */
+void closePooledClient (PooledClient *conn) {
+	sprintf(tempString,"[LOG] Closed connection from %s:%d.\n", inet_ntoa(conn->clientaddr.sin_addr), conn->clientaddr.sin_port);
+	logger(ServerFileLog, tempString);
 
-	//getting table and key 
-	char *table = getNextWord(command, '#');
-	char *key = getNextWord(command, '#');
-	int table_index = isTableNameExist(table, &params);
-
-
-	//dealing with only one table - from config file
-	printf("i get the value here2");
+	closeCursors(&conn->session);
+	close(conn->session.sock);
+	wb_free(&conn->output);
+	free(conn);
+}
 
-	//1) tablename not found
-	if (table_index == -1) {
-		//message to the client
-		sprintf(message, "Error#%d#", ERR_TABLE_NOT_FOUND);
+/**
+ * @brief Job run by a worker when a client socket becomes readable, or
+ * writable again.
+ *
+ * Sends what is left of earlier replies, then reads what the socket
+ * has, runs every complete command in the buffer, and re-arms the
+ * socket. A worker is therefore only busy while there is input to
+ * process; idle connections hold no thread. Replies the socket does not
+ * take at once are finished by a later job, when it is armed for
+ * EPOLLOUT; the client is not read meanwhile.
+ *
+ * @param arg The PooledClient whose socket is ready.
+ */
+void serviceClientJob (void *arg) {
+	PooledClient *conn = (PooledClient *)arg;
+	Session *session = &conn->session;
+	char command[MAX_CMD_LEN];
+	bool closed = false;
+
+	int pending = wb_flush(&conn->output, session->sock);
+	if (pending == 0) {
+		ssize_t bytes = rb_fill(&session->readBuffer);
+		closed = bytes == 0 || (bytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
+
+		int request;
+		while ((request = getRequest(session, command)) == 1) {
+			if (processClientCommand(session, command) == EXIT) {
+				closed = true;
+				break;
+			}
+		}
+		if (request < 0)
+			closed = true;
 
-		//send the message
-		int status1 = handle_command(client->sock, message);
-		if (status1 != 0)
-			wait_for_commands = 0; // Oops.  An error occured.
-		return;
+		// The replies to everything this job read go out in one write.
+		if (commitSession(session) != 0)
+			closed = true;
+		pending = wb_flush(&conn->output, session->sock);
 	}
 
-	struct timeval start_time, end_time;
-	gettimeofday(&start_time, NULL);
-	printf("i get the value here3");
-	//char* data = ht_get(ourHashTable[table_index], key);
-
-	//pthread_mutex_lock( &getMutex ); 	
-	Entry* data = ht_get(ourHashTable[table_index], key);
-	//pthread_mutex_unlock( &getMutex ); 
-	//sets the metabase value to the previousMeta value.
-
-	gettimeofday(&end_time, NULL);
-    double tempEvaluationTime = (end_time.tv_usec) - (start_time.tv_usec);
-    total_server_process_time += tempEvaluationTime;
-    sprintf(tempString, "[PERFORMANCE] Server GET Processing Time: %lf microseconds.\n", tempEvaluationTime);
-    logger(ServerFileLog, tempString);
-    sprintf(tempString, "[PERFORMANCE] Current Server Total Processing Time: %lf microseconds.\n", total_server_process_time);
-    logger(ServerFileLog, tempString);
-
-    printf("i get the value here4");
-	//2) keyvalue not found
-	
-	if (data == NULL ) {
-		sprintf(message, "Error#%d#", ERR_KEY_NOT_FOUND);
-		handle_command(client->sock, message);
+	if (closed || pending < 0) {
+		closePooledClient(conn);
 		return;
 	}
 
-	char metadata[MAX_STRING_SIZE]; 
-	sprintf(metadata, "%d", data->metadata);
-
-	//3) everything fine
-	if (data != NULL){
-		sprintf(message, "SUCCESS#%s#%s#%s#", key, data->value, metadata);
-		handle_command(client->sock, message);
-	}
-
-	//deallocating memory
-	free(table);
-	free(key);
+	struct epoll_event event;
+	event.events = pending == 1 ? EPOLLOUT | EPOLLONESHOT : EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+	event.data.ptr = conn;
+	if (epoll_ctl(poolEpollfd, EPOLL_CTL_MOD, session->sock, &event) != 0)
+		closePooledClient(conn);
 }
 
 /**
- * @brief Process a Set function 
+ * @brief Serve clients from a persistent pool of worker threads.
  *
- * @param command The command received from the client.
- * @return void
+ * The calling thread accepts connections and waits for input on all
+ * of them. Each time a client has input, a job is queued for the
+ * params.workerThreads workers; the queue is bounded, so a burst of
+ * input slows down this thread rather than growing without limit.
  */
+void MultiThreadMode() {
+	int status = listen(listensock, SOMAXCONN);
+	if (status != 0) {
+		printf("Error listening on socket.\n");
+		errno = ERR_UNKNOWN;
+		exit(EXIT_FAILURE);
+	}
 
-void SetSelect( char ** command, ListOfClients* client  ) {
-
-	char tempString[MAX_STRING_SIZE];
-		// 0) Not Authenticated
-		if(client->authenticationStatus == false){
-			errno = ERR_NOT_AUTHENTICATED;
-			sprintf(message, "Error#%d#", errno);
-			handle_command(client->sock, message);
-			return;
-		}
-
-		//getting table, key, and value
-		char *table = getNextWord(command, '#');
-		char *key = getNextWord(command, '#');
-		char *value = getNextWord(command, '#');
-		char *metadata = getNextWord(command, '#');
+	int numWorkers = params.workerThreads;
+	if (numWorkers <= 0)
+		numWorkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (numWorkers <= 0)
+		numWorkers = 1;
 
+	workQueue = wq_create(numWorkers, WORK_QUEUE_CAPACITY);
+	poolEpollfd = epoll_create1(0);
+	if (workQueue == NULL || poolEpollfd < 0) {
+		printf("Error creating thread pool.\n");
+		errno = ERR_UNKNOWN;
+		exit(EXIT_FAILURE);
+	}
 
+	// The listening socket is the only entry without a client pointer.
+	struct epoll_event event;
+	event.events = EPOLLIN;
+	event.data.ptr = NULL;
+	if (epoll_ctl(poolEpollfd, EPOLL_CTL_ADD, listensock, &event) != 0) {
+		printf("Error adding socket to epoll instance.\n");
+		errno = ERR_UNKNOWN;
+		exit(EXIT_FAILURE);
+	}
 
-		int table_index = isTableNameExist(table, &params);
-		char *p;
-		long int metaData = strtol(metadata, &p, 10);
+	sprintf(tempString, "[LOG] Started %d worker threads.\n", numWorkers);
+	logger(ServerFileLog, tempString);
 
-		printf("Parsed Set\n" );
-		//1) tablename not found
-		if (table_index == -1) {
-			//message to the client
-			sprintf(message, "Error#%d#", ERR_TABLE_NOT_FOUND);
+	struct epoll_event events[MAX_EPOLL_EVENTS];
 
-			//send the message
-			int status1 = handle_command(client->sock, message);
-			if (status1 != 0)
-				wait_for_commands = 0; // Oops.  An error occured.
-			return;
+	// Listen loop.
+	wait_for_connections = 1;
+	while (wait_for_connections) {
+		int numEvents = epoll_wait(poolEpollfd, events, MAX_EPOLL_EVENTS, -1);
+		if (numEvents < 0) {
+			if (errno == EINTR)
+				continue;
+			printf("Error waiting for events.\n");
+			break;
 		}
 
-		//2) Deleting Process
-		if (strlen(value) == 0) {
-
-			int isDeleted = ht_removeItem(ourHashTable[table_index], key);
-
-			if (isDeleted == HASH_SET_DELETE)
-				handle_command(client->sock, "DELETE#");
-			else {
-				sprintf(message, "Error#%d#",ERR_KEY_NOT_FOUND );
-				handle_command(client->sock, message);
+		int i;
+		for (i = 0; i < numEvents; i++) {
+			PooledClient *conn = (PooledClient *)events[i].data.ptr;
+			if (conn != NULL) {
+				// The socket stays disarmed until the job re-arms it.
+				if (wq_push(workQueue, serviceClientJob, conn) != 0)
+					closePooledClient(conn);
+				continue;
 			}
-			return;
-		}
 
- 		
- 		// 4) UPLOAD function
-		if (strcmp(key, "UPLOAD") == 0 && strcmp(value, "UPLOAD") == 0) {
-			int status = upload(table_index);
-			if (status == 0) {
-				sprintf(message, "UPLOAD#");
-				handle_command(client->sock, message);
-			}
-			else {
-				sprintf(message, "Error#%d#",ERR_UNKNOWN );
-				handle_command(client->sock, message);
+			struct sockaddr_in clientaddr;
+			socklen_t clientaddrlen = sizeof clientaddr;
+			int clientsock = accept(listensock, (struct sockaddr*)&clientaddr, &clientaddrlen);
+			if (clientsock < 0)
+				continue;
+
+			conn = (PooledClient *)malloc(sizeof(PooledClient));
+			if (conn == NULL || setNonBlocking(clientsock) != 0 || setNoDelay(clientsock) != 0) {
+				free(conn);
+				close(clientsock);
+				continue;
 			}
-			return;
-		}
-		
-		//3) Check if the input string format is correct
-		if (strcmp(key, "UPLOAD") != 0 && strcmp(value, "UPLOAD") != 0 && strlen(value) != 0 ) {
-			
-			printf("insert isInputValid Function \n");
-			bool Input_String_Format = isInputFormatCorrect(value, &params, table_index);
-			if (Input_String_Format == false) {
-				sprintf(message, "Error#%d#", ERR_INVALID_PARAM);
-
-				//send the message
-				int status1 = handle_command(client->sock, message);
-				if (status1 != 0)
-					wait_for_commands = 0; // Oops.  An error occured.
-				return;
+			conn->session.sock = clientsock;
+			conn->session.authenticationStatus = false;
+			memset(conn->session.cursors, 0, sizeof conn->session.cursors);
+			conn->session.binary = false;
+			conn->session.walPosition = 0;
+			rb_init(&conn->session.readBuffer, clientsock);
+			wb_init(&conn->output);
+			conn->session.output = &conn->output;
+			conn->clientaddr = clientaddr;
+
+			struct epoll_event clientEvent;
+			clientEvent.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+			clientEvent.data.ptr = conn;
+			if (epoll_ctl(poolEpollfd, EPOLL_CTL_ADD, clientsock, &clientEvent) != 0) {
+				close(clientsock);
+				free(conn);
+				continue;
 			}
-		}
-
-
-		//gets the metadat value
-		//1) if the metadata == 0 just set
-		//2) if the metadata is nonzero, compare with the value from the hashtable
-
-		Entry* data = ht_get(ourHashTable[table_index], key);
 
-		if (data != NULL && metaData != 0 && data->metadata != metaData) {
-			sprintf(message, "Error#%d#",ERR_TRANSACTION_ABORT );
-			handle_command(client->sock, message);
-			return;
+			sprintf(tempString, "[LOG] Got a connection from %s:%d.\n", inet_ntoa(clientaddr.sin_addr), clientaddr.sin_port);
+			logger(ServerFileLog, tempString);
 		}
+	}
 
-		struct timeval start_time, end_time;
-    	gettimeofday(&start_time, NULL);
-
-    	//pthread_mutex_lock( &setMutex );
-		int status = ht_set(ourHashTable[table_index], key, value);
-		//pthread_mutex_unlock( &setMutex ); 
-
-		gettimeofday(&end_time, NULL);
-	    double tempEvaluationTime = (end_time.tv_usec) - (start_time.tv_usec);
-	    total_server_process_time += tempEvaluationTime;
-	    sprintf(tempString, "[PERFORMANCE] Server SET Processing Time: %lf microseconds.\n", tempEvaluationTime);
-	    logger(ServerFileLog, tempString);
-	    sprintf(tempString, "[PERFORMANCE] Current Server Total Processing Time: %lf microseconds.\n", total_server_process_time);
-	    logger(ServerFileLog, tempString);
-
+	wq_destroy(workQueue);
+	close(poolEpollfd);
+}
 
-		//updating data
-		if (status == HASH_SET_UPDATE) {
-			handle_command(client->sock, "MODIFY#");
-		}
+/******************************************************************************/
 
-		//inserting the data
-		else if (status == HASH_SET_INSERT) 
-		{
-			handle_command(client->sock, "INSERT#");
-		}
 
-		//deallocating memory
-		free(table);
-		free(key);
-		free(value);	
-}
 
 /**
- * @brief Process a Query function 
+ * @brief Start the storage server.
  *
- * @param command The command received from the client.
- * @return void
+ * This is the main entry point for the storage server.  It reads the
+ * configuration file, starts listening on a port, and proccesses
+ * commands from clients.
  */
-void QuerySelect (char ** command, ListOfClients* client){
-	char tempString[MAX_STRING_SIZE];
-
-		// 0) Not Authenticated
-		if(client->authenticationStatus == false){
-			errno = ERR_NOT_AUTHENTICATED;
-			sprintf(message, "Error#%d#", errno);
-			handle_command(client->sock, message);
-			return;
-		}
-
-		//getting table, predicates, and max_key
-		char *table = getNextWord(command, '#');
-		char *predicates = getNextWord(command, '#');
-		char *tempMax_keys = getNextWord(command, '#');
-		int table_index = isTableNameExist(table, &params);
-
-
-		long int max_keys;
-		char* p;
-		max_keys = strtol(tempMax_keys, &p, 10);
-
-
-		//1) tablename not found
-		if (table_index == -1) {
-			//message to the client
-			sprintf(message, "Error#%d#", ERR_TABLE_NOT_FOUND);
-
-			//send the message
-			int status1 = handle_command(client->sock, message);
-			if (status1 != 0)
-				wait_for_commands = 0; // Oops.  An error occured.`
-			return;
-		}
-
-    	char * keys[max_keys];
-    	int i;
-    	for (i = 0; i < max_keys; i++)
-    		keys[i] = NULL;
-
-
-        //Allocate predicates in predicate struct
-        int numPredicates = getNumPredicates(predicates);
-        //Allocate predicates
-
-       	Predicate* predLists = createPredicateList (numPredicates, predicates); 
-
-       	int value = isPredicateValid(predLists, &params, table_index, numPredicates);
-       	
-
-       	if (value == INVALID) {
-			//message to the client
-			sprintf(message, "Error#%d#", ERR_INVALID_PARAM);
-
-			//send the message
-			int status1 = handle_command(client->sock, message);
-			if (status1 != 0)
-				wait_for_commands = 0; // Oops.  An error occured.`
-			return;
-		}
 
+int main(int argc, char *argv[])
+{
 
-       	struct timeval start_time, end_time;
-    	gettimeofday(&start_time, NULL);
+	total_server_process_time = 0;
+	//Initialize 
+	char tempString[MAX_STRING_SIZE];
+	Initialize();
+   	
+	// Process command line arguments.
+	// This program expects exactly one argument: the config file name.
+	//assert(argc > 0);
+	if (argc != 2) {
+		printf("Usage %s <config_file>\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	char *config_file = argv[1];
 
-        int status = ht_query (ourHashTable[table_index], predLists, numPredicates, keys, max_keys);   
+	// Checking Config File
+	int status = CheckConfigFile(config_file, &params);
 
+	if (status != 0) {
+		printf("Error processing config file.\n");
+		errno = ERR_UNKNOWN;
+		exit(EXIT_FAILURE);
+	}
 
-        gettimeofday(&end_time, NULL);
-	    double tempEvaluationTime = (end_time.tv_usec) - (start_time.tv_usec);
-	    total_server_process_time += tempEvaluationTime;
-	    sprintf(tempString, "[PERFORMANCE] Server QUERY Processing Time: %lf microseconds.\n", tempEvaluationTime);
-	    logger(ServerFileLog, tempString);
-	    sprintf(tempString, "[PERFORMANCE] Current Server Total Processing Time: %lf microseconds.\n", total_server_process_time);
-	    logger(ServerFileLog, tempString); 
-
-        //Free the 2D array of keys
-   	 
-   	 	int x = 0;
-   	 	char *keyMessage = NULL;  	 	
-
-   	 	for (x = 0; x < max_keys && x < status; x++){
-   	 		if(keys[x]!=NULL)
-   	 		{
-   	 			printf("Found keys");
-   	 			if(x == 0){
-   	 				printf("Created message to send all the keys back\n");
-   	 				keyMessage = myStrDup(keys[x]);
-   	 				keyMessage = addStringSecond(keyMessage,HASHTAG);
-   	 			}
-   	 			else{
-   	 				keyMessage = addStringSecond(keyMessage,keys[x]);
-   	 				keyMessage = addStringSecond(keyMessage,HASHTAG);
-   	 			}
-   	 		}
-
-   	 	}
-
-
-   	 	for (i = 0; i < max_keys; i++){
-   	 		if (keys[i] != NULL){
-   	 			free (keys[i]);
-   	 		}
-   	 	}
-
-		if (status == 0) {
-			sprintf(message, "SUCCESS1#%d#",status);
-			handle_command(client->sock, message);
+	// Secondary indexes, once the schemas are known.
+	int t;
+	for (t = 0; t < params.table_number; t++) {
+		if (ht_createIndexes(ourHashTable[t]) != 0) {
+			printf("Error creating indexes.\n");
+			errno = ERR_UNKNOWN;
+			exit(EXIT_FAILURE);
 		}
+	}
+	if (params.parallelScanThreshold > 0 && ht_startParallelScan(params.parallelScanThreshold, 0) != 0) {
+		printf("Error starting scan threads.\n");
+		errno = ERR_UNKNOWN;
+		exit(EXIT_FAILURE);
+	}
 
-		//Keys Found
-		else  
-		{
-			sprintf(message, "SUCCESS2#%d#%s",status,keyMessage );
-			handle_command(client->sock, message);
+	// Load the snapshot and replay the write-ahead log after it into the
+	// tables, then keep appending to the log.
+	if (params.data_directory[0] != '\0') {
+		uint32_t generation;
+		if ((mkdir(params.data_directory, 0755) != 0 && errno != EEXIST)
+				|| snapshot_load(params.data_directory, &generation, reserveTable, replayRecord, NULL) != 0) {
+			printf("Error loading the snapshot in %s.\n", params.data_directory);
+			errno = ERR_UNKNOWN;
+			exit(EXIT_FAILURE);
 		}
-		//deallocating memory
-		free(table);
-		free(predicates);
-		free(tempMax_keys);
-		if(keyMessage != NULL){
-			free(keyMessage);	
+		serverWal = wal_open(params.data_directory, generation, params.durability, replayRecord, NULL);
+		if (serverWal == NULL) {
+			printf("Error opening the write-ahead log in %s.\n", params.data_directory);
+			errno = ERR_UNKNOWN;
+			exit(EXIT_FAILURE);
 		}
-}
-
-
-void initializeFDS (fd_set* setOfConn, int listensock, ListOfClients *clients, int numClients) {
-	if (numClients < 10) {
-		FD_SET(listensock, setOfConn);
-	}
-	//Setup integer i
-	int i;
-	for (i = 0; i != 10; i++) {
-		if (clients[i].sock != 0) {
-			FD_SET(clients[i].sock, setOfConn);
+		if (pthread_create(&snapshotThreadId, NULL, snapshotThread, NULL) != 0) {
+			printf("Error starting the snapshot thread.\n");
+			errno = ERR_UNKNOWN;
+			exit(EXIT_FAILURE);
 		}
+		sprintf(tempString, "[LOG] Loaded the tables from %s, log generation %u\n",
+				params.data_directory, serverWal->generation);
+		logger(ServerFileLog, tempString);
 	}
-	return;
-}
 
-int calculateNFDS (int listensock, ListOfClients *clients) {
-	int maxFD = listensock;
-	printf("Goes into the calculateNFDS\n");
-	int i;
-	for (i = 0; i != 10; i++) {
-		printf("Goes into the calculateNFDS FOR LOOP %d\n", i);
-		if (clients[i].sock != 0 && clients[i].sock > maxFD) {
-			maxFD = clients[i].sock;
-		}
-	}
-	return maxFD;
-}
+	sprintf (tempString,  "[LOG] Server on %s:%d\n", params.server_host, params.server_port);
+	logger(ServerFileLog,tempString);
 
+	// Create a socket.
+	listensock = socket(PF_INET, SOCK_STREAM, 0);
+	if (listensock < 0) {
+		printf("Error creating socket.\n");
+		errno = ERR_UNKNOWN;
+		exit(EXIT_FAILURE);
+	}
 
-void addToClientSockets (ListOfClients *clients, int socket) {
-	int i;
-	for (i = 0; i != 10; i++) {
-		if (clients[i].sock == 0) {
-			clients[i].sock = socket;
-			//Initially set it to false
-			clients[i].authenticationStatus = false;
-			return;
-		}
+	// Allow listening port to be reused if defunct.
+	int yes = 1;
+	status = setsockopt(listensock, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof yes);
+	// The reactor threads share the port through one socket each.
+	if (status == 0 && params.concurrencyMode == 4)
+		status = setsockopt(listensock, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof yes);
+	if (status != 0) {
+		printf("Error configuring socket.\n");
+		errno = ERR_UNKNOWN;
+		exit(EXIT_FAILURE);
 	}
-	return;
-}
 
-void SelectMode (){
-	struct timeval tv;
-	// Listen for connections.
-	printf("Goes into SelectMode\n");
-	//int status
-	int status = listen(listensock, MAX_LISTENQUEUELEN);
+	// Bind it to the listening port.
+	struct sockaddr_in listenaddr;
+	memset(&listenaddr, 0, sizeof listenaddr);
+	listenaddr.sin_family = AF_INET;
+	listenaddr.sin_port = htons(params.server_port);
+	inet_pton(AF_INET, params.server_host, &(listenaddr.sin_addr)); // bind to local IP address
+	status = bind(listensock, (struct sockaddr*) &listenaddr, sizeof listenaddr);
 	if (status != 0) {
-		printf("Error listening on socket.\n");
+		printf("Error binding socket.\n");
 		errno = ERR_UNKNOWN;
 		exit(EXIT_FAILURE);
 	}
-	//Create the list of file descriptors
-	fd_set rfds;
-	int nfds;
-	int numConnectedClients = 0;
-	ListOfClients connectedClients[10] = {{0, 0}};
-	printf("Made the list of connected clients\n");
 
-	// Listen loop.
-	wait_for_connections = 1;
-	while (wait_for_connections) {
-		FD_ZERO (&rfds);
-		//Initialize the rdfs
-		initializeFDS (&rfds, listensock, connectedClients,	numConnectedClients);
-		if (FD_ISSET(listensock, &rfds)){
-			printf("Listensock was correctly set\n");
-		}
+	if (params.concurrencyMode == 0)
+		NoConcurrentMode();
+	
 
-		printf("FDS is initalized\n");
 
-		nfds = calculateNFDS (listensock,connectedClients);
-    	
-  //	printf ("DOING NAUGHTY THINGS %d %d\n", rfds.fd_count, rfds.fd_array[0]);
-		tv.tv_sec = 2;
-    	tv.tv_usec = 0;
-    	printf ("Gonna call the select with %d\n", nfds);
-    	select(nfds + 1, &rfds, NULL, NULL, &tv);
-    	printf ("Gonna enter the if\n");
+	if(params.concurrencyMode == 1) 
+		MultiThreadMode();
 
+	if (params.concurrencyMode == 2){
+		SelectMode();
+	}
 
-    	if (FD_ISSET(listensock, &rfds) && numConnectedClients < 10) {
-			// Wait for a connection.
-			struct sockaddr_in clientaddr;
-			socklen_t clientaddrlen = sizeof clientaddr;
-			int clientsock = accept(listensock, (struct sockaddr*)&clientaddr, &clientaddrlen);
-			if (clientsock < 0) {
-				printf("Error accepting a connection.\n");
-				errno = ERR_CONNECTION_FAIL;
-				exit(EXIT_FAILURE);
-			} else{
-				addToClientSockets (connectedClients, clientsock);
-				numConnectedClients++;
-				//logger
-				sprintf(tempString, "[LOG] Got a connection from %s:%d.\n", inet_ntoa(clientaddr.sin_addr), clientaddr.sin_port);
-				logger(ServerFileLog, tempString);
+	if (params.concurrencyMode == 3)
+		EpollMode();
 
-			}
-		}
+	if (params.concurrencyMode == 4)
+		ReactorMode();
 
-		int i;
-		for (i = 0; i != 10; i++) {
-			if (FD_ISSET(connectedClients[i].sock, &rfds)) {
-				printf("Attempting to handle Client #%d AuthenticationStatus = %d\n", i, connectedClients[i].authenticationStatus);
-				//get command from the client
-				wait_for_commands = 1;
-				commandPointer = (char *)malloc(sizeof(char) * MAX_CMD_LEN);
-				command = commandPointer;
-				message = (char *)malloc(sizeof(char) * MAX_CMD_LEN);
-
-				//do {
-					int status1 = recvline(connectedClients[i].sock, command, MAX_CMD_LEN);
-
-					// Either an error occurred or the client closed the connection.
-					if (status1 != 0) {
-						// Close the connection with the client.
-						close(connectedClients[i].sock);
-						numConnectedClients--;
-					}
-
-					else {
-					//getting the function word
-						char *function = getNextWord(&command, '#');
-
-						//1) Authenticate Function
-						if (strcmp(function, "AUTH") == 0) {
-							AuthenticateSelect(&command, &connectedClients[i]);
-						}
-						
-						//2) GET Function
-						else if (strcmp(function, "GET") == 0) {
-							GetSelect(&command, &connectedClients[i]);
-						}
-
-						//3) SET Function
-						else if (strcmp(function, "SET") == 0) {
-							SetSelect(&command, &connectedClients[i]);
-						}
-
-						else if (strcmp(function, "QUERY") == 0) {
-							QuerySelect(&command, &connectedClients[i]);
-						} else if (strcmp(function, "DISCONNECT") == 0) {
-							if (numConnectedClients > 0){
-								// Close the connection with the client.
-								connectedClients[i].authenticationStatus = false;
-								close(connectedClients[i].sock);
-								numConnectedClients--;
-							}
-							sprintf(message, "SUCCESS" );
-							handle_command(connectedClients[i].sock, message);
-						}
-						//deallocating memory
-						free(function);
-					}
-				free(commandPointer);
-				free(message);
-			}
-		}
+	
+	// Stop listening for connections.
+	sprintf(tempString, "[PERFORMANCE] TOTAL SERVER PROCESSING TIME: %lf microseconds.\n", total_server_process_time);
+	logger(ServerFileLog, tempString);
+	if (serverWal != NULL) {
+		pthread_mutex_lock(&snapshotMutex);
+		snapshotStop = true;
+		pthread_cond_signal(&snapshotWake);
+		pthread_mutex_unlock(&snapshotMutex);
+		pthread_join(snapshotThreadId, NULL);
+		wal_close(serverWal);
 	}
+	RemoveHashTables();
+	close(listensock);
+	if (ServerFileLog != NULL)
+		fclose(ServerFileLog);
+	return EXIT_SUCCESS;
 }
-
-/******************************************************************************/
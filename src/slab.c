@@ -0,0 +1,325 @@
+/**
+ * @file
+ * @brief This file implements the slab allocator of the tables.
+ *
+ * A thread's free lists for a slab live in a slot of a thread-local
+ * array picked by the slab id. Slabs whose ids share a slot take turns
+ * in it: before the slot is reused, its blocks go back to the slab that
+ * owns them, found by id among the live slabs. Ids are never reused, so
+ * blocks whose slab was destroyed are simply dropped. When a thread
+ * exits, its blocks go back to the slabs still alive the same way.
+ */
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "slab.h"
+
+#define SLAB_ALIGN 16
+#define SLAB_LARGE_HEADER ((sizeof(SlabLarge) + SLAB_ALIGN - 1) / SLAB_ALIGN * SLAB_ALIGN)
+
+static const size_t slab_classes[SLAB_CLASSES] = {
+	32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, SLAB_MAX_BLOCK
+};
+
+/**
+ * @brief The free lists of one thread for one slab.
+ */
+typedef struct slabCache {
+	uint64_t id;		///< The slab, or 0 for none.
+	void *free[SLAB_CLASSES];
+	int count[SLAB_CLASSES];
+} SlabCache;
+
+static __thread SlabCache slab_caches[SLAB_CACHES];
+static __thread bool slab_registered = false;
+
+static uint64_t slab_nextId = 0;
+static pthread_once_t slab_once = PTHREAD_ONCE_INIT;
+static pthread_key_t slab_exitKey;
+static pthread_mutex_t slab_liveLock = PTHREAD_MUTEX_INITIALIZER;
+static Slab *slab_live[SLAB_CACHES];	///< The slabs still alive, listed by cache slot.
+
+static void *slab_next(void *block)
+{
+	return *(void **)block;
+}
+
+static void slab_setNext(void *block, void *next)
+{
+	*(void **)block = next;
+}
+
+/**
+ * @brief Return the size class of a size, or SLAB_CLASSES if it is too large.
+ */
+static int slab_class(size_t size)
+{
+	int c = 0;
+
+	while (c < SLAB_CLASSES && slab_classes[c] < size)
+		c++;
+	return c;
+}
+
+/**
+ * @brief Give back a list of blocks of a class; the caller holds the lock.
+ */
+static void slab_giveBack(Slab *slab, int c, void *head)
+{
+	while (head != NULL) {
+		void *next = slab_next(head);
+		slab_setNext(head, slab->free[c]);
+		slab->free[c] = head;
+		head = next;
+	}
+}
+
+/**
+ * @brief Return a thread's free lists to the slab they came from, if it is
+ * still alive, and empty them.
+ */
+static void slab_flushCache(SlabCache *cache)
+{
+	Slab *slab;
+	int c;
+
+	if (cache->id == 0)
+		return;
+	pthread_mutex_lock(&slab_liveLock);
+	for (slab = slab_live[cache->id % SLAB_CACHES]; slab != NULL; slab = slab->liveNext)
+		if (slab->id == cache->id)
+			break;
+	if (slab != NULL) {
+		pthread_mutex_lock(&slab->lock);
+		for (c = 0; c < SLAB_CLASSES; c++)
+			slab_giveBack(slab, c, cache->free[c]);
+		pthread_mutex_unlock(&slab->lock);
+	}
+	pthread_mutex_unlock(&slab_liveLock);
+	memset(cache, 0, sizeof(SlabCache));
+}
+
+/**
+ * @brief Return the blocks of an exiting thread to the slabs still alive.
+ */
+static void slab_threadExit(void *arg)
+{
+	SlabCache *caches = (SlabCache *)arg;
+	int i;
+
+	for (i = 0; i < SLAB_CACHES; i++)
+		slab_flushCache(&caches[i]);
+}
+
+static void slab_initOnce(void)
+{
+	pthread_key_create(&slab_exitKey, slab_threadExit);
+}
+
+/**
+ * @brief Return this thread's free lists for a slab, handing back the
+ * lists of another slab that held the slot.
+ */
+static SlabCache *slab_cache(Slab *slab)
+{
+	SlabCache *cache = &slab_caches[slab->id % SLAB_CACHES];
+
+	if (cache->id != slab->id) {
+		if (!slab_registered) {
+			pthread_setspecific(slab_exitKey, slab_caches);
+			slab_registered = true;
+		}
+		slab_flushCache(cache);
+		cache->id = slab->id;
+	}
+	return cache;
+}
+
+void slab_init(Slab *slab)
+{
+	pthread_once(&slab_once, slab_initOnce);
+	memset(slab, 0, sizeof(Slab));
+	pthread_mutex_init(&slab->lock, NULL);
+	slab->id = __sync_add_and_fetch(&slab_nextId, 1);
+
+	pthread_mutex_lock(&slab_liveLock);
+	slab->liveNext = slab_live[slab->id % SLAB_CACHES];
+	slab_live[slab->id % SLAB_CACHES] = slab;
+	pthread_mutex_unlock(&slab_liveLock);
+}
+
+size_t slab_blockSize(size_t size)
+{
+	int c = slab_class(size);
+
+	return c < SLAB_CLASSES ? slab_classes[c] : size;
+}
+
+/**
+ * @brief Fill this thread's list of a class with up to SLAB_BATCH blocks,
+ * reused first, then carved.
+ *
+ * @return Returns the number of blocks moved, 0 if out of memory.
+ */
+static int slab_refill(Slab *slab, SlabCache *cache, int c)
+{
+	size_t size = slab_classes[c];
+	int moved = 0;
+
+	pthread_mutex_lock(&slab->lock);
+	while (moved < SLAB_BATCH && slab->free[c] != NULL) {
+		void *block = slab->free[c];
+		slab->free[c] = slab_next(block);
+		slab_setNext(block, cache->free[c]);
+		cache->free[c] = block;
+		moved++;
+	}
+	while (moved < SLAB_BATCH) {
+		if (slab->carveLeft < size) {
+			char *chunk = (char *)malloc(SLAB_CHUNK_SIZE);
+			if (chunk == NULL)
+				break;
+			//the first block holds the link to the previous chunk
+			slab_setNext(chunk, slab->chunks);
+			slab->chunks = chunk;
+			slab->carve = chunk + SLAB_ALIGN;
+			slab->carveLeft = SLAB_CHUNK_SIZE - SLAB_ALIGN;
+			slab->reserved += SLAB_CHUNK_SIZE;
+		}
+		slab_setNext(slab->carve, cache->free[c]);
+		cache->free[c] = slab->carve;
+		slab->carve += size;
+		slab->carveLeft -= size;
+		moved++;
+	}
+	pthread_mutex_unlock(&slab->lock);
+	cache->count[c] += moved;
+	return moved;
+}
+
+/**
+ * @brief Allocate a block on its own, linked to the slab to be freed with it.
+ */
+static void *slab_allocLarge(Slab *slab, size_t size)
+{
+	SlabLarge *large = (SlabLarge *)malloc(SLAB_LARGE_HEADER + size);
+
+	if (large == NULL)
+		return NULL;
+	large->size = size;
+	large->prev = NULL;
+	pthread_mutex_lock(&slab->lock);
+	large->next = slab->large;
+	if (slab->large != NULL)
+		slab->large->prev = large;
+	slab->large = large;
+	slab->reserved += SLAB_LARGE_HEADER + size;
+	pthread_mutex_unlock(&slab->lock);
+	return (char *)large + SLAB_LARGE_HEADER;
+}
+
+void *slab_alloc(Slab *slab, size_t size)
+{
+	int c = slab_class(size);
+	void *block;
+
+	if (c == SLAB_CLASSES)
+		block = slab_allocLarge(slab, size);
+	else {
+		SlabCache *cache = slab_cache(slab);
+		if (cache->free[c] == NULL && slab_refill(slab, cache, c) == 0)
+			return NULL;
+		block = cache->free[c];
+		cache->free[c] = slab_next(block);
+		cache->count[c]--;
+		size = slab_classes[c];
+	}
+	if (block != NULL)
+		__atomic_fetch_add(&slab->inUse, size, __ATOMIC_RELAXED);
+	return block;
+}
+
+void slab_free(Slab *slab, void *block, size_t size)
+{
+	int c = slab_class(size);
+
+	if (block == NULL)
+		return;
+	if (c == SLAB_CLASSES) {
+		SlabLarge *large = (SlabLarge *)((char *)block - SLAB_LARGE_HEADER);
+		pthread_mutex_lock(&slab->lock);
+		if (large->prev != NULL)
+			large->prev->next = large->next;
+		else
+			slab->large = large->next;
+		if (large->next != NULL)
+			large->next->prev = large->prev;
+		slab->reserved -= SLAB_LARGE_HEADER + size;
+		pthread_mutex_unlock(&slab->lock);
+		free(large);
+	} else {
+		SlabCache *cache = slab_cache(slab);
+		slab_setNext(block, cache->free[c]);
+		cache->free[c] = block;
+
+		//past two batches, give one back for other threads to reuse
+		if (++cache->count[c] >= 2 * SLAB_BATCH) {
+			void *head = cache->free[c];
+			void *tail = head;
+			int n;
+			for (n = 1; n < SLAB_BATCH; n++)
+				tail = slab_next(tail);
+			cache->free[c] = slab_next(tail);
+			slab_setNext(tail, NULL);
+			cache->count[c] -= SLAB_BATCH;
+			pthread_mutex_lock(&slab->lock);
+			slab_giveBack(slab, c, head);
+			pthread_mutex_unlock(&slab->lock);
+		}
+		size = slab_classes[c];
+	}
+	__atomic_fetch_sub(&slab->inUse, size, __ATOMIC_RELAXED);
+}
+
+void slab_usage(Slab *slab, size_t *inUse, size_t *reserved)
+{
+	pthread_mutex_lock(&slab->lock);
+	*reserved = slab->reserved;
+	pthread_mutex_unlock(&slab->lock);
+	*inUse = __atomic_load_n(&slab->inUse, __ATOMIC_RELAXED);
+}
+
+void slab_destroy(Slab *slab)
+{
+	Slab **link;
+
+	pthread_mutex_lock(&slab_liveLock);
+	for (link = &slab_live[slab->id % SLAB_CACHES]; *link != NULL; link = &(*link)->liveNext)
+		if (*link == slab) {
+			*link = slab->liveNext;
+			break;
+		}
+	pthread_mutex_unlock(&slab_liveLock);
+
+	//this thread's lists would otherwise outlive the chunks they point into
+	SlabCache *cache = &slab_caches[slab->id % SLAB_CACHES];
+	if (cache->id == slab->id)
+		memset(cache, 0, sizeof(SlabCache));
+
+	while (slab->chunks != NULL) {
+		void *chunk = slab->chunks;
+		slab->chunks = slab_next(chunk);
+		free(chunk);
+	}
+	while (slab->large != NULL) {
+		SlabLarge *large = slab->large;
+		slab->large = large->next;
+		free(large);
+	}
+	memset(slab->free, 0, sizeof(slab->free));
+	slab->carve = NULL;
+	slab->carveLeft = 0;
+	slab->reserved = 0;
+	slab->inUse = 0;
+	pthread_mutex_destroy(&slab->lock);
+}
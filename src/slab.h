@@ -0,0 +1,102 @@
+/**
+ * @file
+ * @brief This file declares the slab allocator of the tables.
+ *
+ * Each table allocates its records from its own slab. Blocks come in
+ * size classes and are carved from large chunks; a freed block goes on
+ * a free list of its class, to be reused by the next allocation of that
+ * class. Each thread keeps its own free lists per slab and trades
+ * blocks with the slab's shared lists a batch at a time, so most
+ * allocations and frees take no lock. Destroying a slab frees all of
+ * its chunks at once.
+ */
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define SLAB_CLASSES 13		///< Size classes, from 32 to SLAB_MAX_BLOCK bytes.
+#define SLAB_MAX_BLOCK 2048	///< Larger blocks are allocated one by one.
+#define SLAB_CHUNK_SIZE (64 * 1024)	///< Bytes carved into blocks at a time.
+#define SLAB_BATCH 32		///< Blocks moved between a thread and the slab at a time.
+#define SLAB_CACHES 128		///< Slabs a thread keeps free lists for; see slab_alloc().
+
+/**
+ * @brief A block larger than SLAB_MAX_BLOCK, on the list of its slab.
+ */
+typedef struct slabLarge {
+	struct slabLarge *prev;
+	struct slabLarge *next;
+	size_t size;
+} SlabLarge;
+
+/**
+ * @brief The memory of one table.
+ */
+typedef struct slab {
+	uint64_t id;		///< Unique over the life of the process.
+	pthread_mutex_t lock;	///< Guards the fields below but inUse.
+	void *free[SLAB_CLASSES];	///< Blocks returned by threads, linked through their first word.
+	void *chunks;		///< Chunks allocated, linked through their first word.
+	char *carve;		///< The unused part of the last chunk.
+	size_t carveLeft;
+	SlabLarge *large;
+	size_t reserved;	///< Bytes of the chunks and large blocks.
+	size_t inUse;		///< Bytes of the blocks allocated and not freed, changed atomically.
+	struct slab *liveNext;	///< The next live slab of the same cache slot.
+} Slab;
+
+/**
+ * @brief Set up an empty slab.
+ *
+ * @param slab The slab.
+ */
+void slab_init(Slab *slab);
+
+/**
+ * @brief Allocate a block.
+ *
+ * @param slab The slab.
+ * @param size The bytes needed; pass the same size to slab_free().
+ * @return Returns the block, 16 byte aligned, or NULL if out of memory.
+ */
+void *slab_alloc(Slab *slab, size_t size);
+
+/**
+ * @brief Free a block.
+ *
+ * @param slab The slab the block came from.
+ * @param block The block, or NULL.
+ * @param size The size it was allocated with.
+ */
+void slab_free(Slab *slab, void *block, size_t size);
+
+/**
+ * @brief Return the usable size of a block.
+ *
+ * @param size The size a block is allocated with.
+ * @return Returns the size of the class serving it, at least size.
+ */
+size_t slab_blockSize(size_t size);
+
+/**
+ * @brief Return the memory of a slab.
+ *
+ * @param slab The slab.
+ * @param inUse Set to the bytes of the blocks allocated and not freed.
+ * @param reserved Set to the bytes taken from the system.
+ */
+void slab_usage(Slab *slab, size_t *inUse, size_t *reserved);
+
+/**
+ * @brief Free every block of a slab at once.
+ *
+ * Blocks still on the free lists of threads are dropped with it.
+ *
+ * @param slab The slab.
+ */
+void slab_destroy(Slab *slab);
+
+#endif
@@ -0,0 +1,321 @@
+/**
+ * @file
+ * @brief This file implements the snapshots of the storage server.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include "snapshot.h"
+
+#define SNAPSHOT_MAGIC "KVSNAP1\n"
+#define SNAPSHOT_MAGIC_LEN 8
+#define SNAPSHOT_END 0		///< Tag closing the file, before the checksum.
+#define SNAPSHOT_TABLE 1	///< Tag of a table; the records after it are its own.
+#define SNAPSHOT_RECORD 2	///< Tag of a record.
+#define SNAPSHOT_TABLE_LEN 6	///< The tag, the name length and the record count of a table, but the name.
+#define SNAPSHOT_RECORD_LEN 15	///< The tag, the lengths and the version of a record.
+#define SNAPSHOT_BUFFER (256 * 1024)
+#define SNAPSHOT_MAX_PATH (WAL_MAX_PATH + 32)
+
+/**
+ * @brief A snapshot file being written, through a buffer.
+ */
+typedef struct snapshotWriter {
+	int fd;
+	char *buffer;
+	size_t used;
+	uint32_t crc;		///< The CRC-32 of the bytes written out so far.
+	bool failed;
+} SnapshotWriter;
+
+static void putWord(char *p, uint64_t value, int bytes)
+{
+	int i;
+
+	for (i = bytes - 1; i >= 0; i--) {
+		p[i] = (char) (value & 0xFF);
+		value >>= 8;
+	}
+}
+
+static uint64_t getWord(const char *p, int bytes)
+{
+	uint64_t value = 0;
+	int i;
+
+	for (i = 0; i < bytes; i++)
+		value = (value << 8) | (unsigned char) p[i];
+	return value;
+}
+
+/**
+ * @brief Write out the buffer, adding it to the checksum.
+ */
+static void flushWriter(SnapshotWriter *writer)
+{
+	const char *data = writer->buffer;
+	size_t len = writer->used;
+
+	writer->crc = wal_crc32(writer->crc, data, len);
+	writer->used = 0;
+	while (!writer->failed && len > 0) {
+		ssize_t bytes = write(writer->fd, data, len);
+		if (bytes < 0) {
+			if (errno != EINTR)
+				writer->failed = true;
+			continue;
+		}
+		data += bytes;
+		len -= (size_t) bytes;
+	}
+}
+
+static void writeBytes(SnapshotWriter *writer, const char *data, size_t len)
+{
+	while (len > 0) {
+		size_t chunk = SNAPSHOT_BUFFER - writer->used;
+		if (chunk > len)
+			chunk = len;
+		memcpy(writer->buffer + writer->used, data, chunk);
+		writer->used += chunk;
+		data += chunk;
+		len -= chunk;
+		if (writer->used == SNAPSHOT_BUFFER)
+			flushWriter(writer);
+	}
+}
+
+/**
+ * @brief Write one record; the visitor of ht_forEach().
+ */
+static int writeRecord(Entry *entry, void *arg)
+{
+	SnapshotWriter *writer = (SnapshotWriter *) arg;
+	size_t keyLen = strlen(entry->key);
+	size_t valueLen = strlen(entry->value);
+	char header[SNAPSHOT_RECORD_LEN];
+
+	if (keyLen > UINT16_MAX || valueLen > UINT32_MAX)
+		return -1;
+	header[0] = SNAPSHOT_RECORD;
+	putWord(header + 1, keyLen, 2);
+	putWord(header + 3, valueLen, 4);
+	putWord(header + 7, entry->metadata, 8);
+	writeBytes(writer, header, SNAPSHOT_RECORD_LEN);
+	writeBytes(writer, entry->key, keyLen);
+	writeBytes(writer, entry->value, valueLen);
+	return writer->failed ? -1 : 0;
+}
+
+int snapshot_write(const char *directory, uint32_t generation, int numTables, char **names, HashTable **tables)
+{
+	char path[SNAPSHOT_MAX_PATH];
+	char target[SNAPSHOT_MAX_PATH];
+	char header[SNAPSHOT_MAGIC_LEN + 4];
+	SnapshotWriter writer;
+	int status = 0;
+	int t;
+
+	snprintf(path, sizeof path, SNAPSHOT_TEMP_FORMAT, directory, generation);
+	snprintf(target, sizeof target, "%s/%s", directory, SNAPSHOT_FILE_NAME);
+	writer.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	writer.buffer = (char *) malloc(SNAPSHOT_BUFFER);
+	writer.used = 0;
+	writer.crc = 0;
+	writer.failed = writer.fd < 0 || writer.buffer == NULL;
+
+	memcpy(header, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN);
+	putWord(header + SNAPSHOT_MAGIC_LEN, generation, 4);
+	if (!writer.failed)
+		writeBytes(&writer, header, sizeof header);
+
+	for (t = 0; !writer.failed && status == 0 && t < numTables; t++) {
+		size_t nameLen = strlen(names[t]);
+		char item[SNAPSHOT_TABLE_LEN];
+		if (nameLen > 255) {
+			status = -1;
+			break;
+		}
+		item[0] = SNAPSHOT_TABLE;
+		item[1] = (char) nameLen;
+		putWord(item + 2, (uint64_t) ht_count(tables[t]), 4);
+		writeBytes(&writer, item, 2);
+		writeBytes(&writer, names[t], nameLen);
+		writeBytes(&writer, item + 2, 4);
+		status = ht_forEach(tables[t], writeRecord, &writer);
+	}
+
+	if (!writer.failed && status == 0) {
+		char end[5];
+		end[0] = SNAPSHOT_END;
+		writeBytes(&writer, end, 1);
+		flushWriter(&writer);
+		putWord(end, writer.crc, 4);
+		writeBytes(&writer, end, 4);
+		flushWriter(&writer);
+	}
+	if (writer.failed || status != 0 || fsync(writer.fd) != 0)
+		status = -1;
+	if (writer.fd >= 0 && close(writer.fd) != 0)
+		status = -1;
+	free(writer.buffer);
+
+	if (status == 0 && rename(path, target) != 0)
+		status = -1;
+	if (status != 0) {
+		unlink(path);
+		return -1;
+	}
+
+	//keep the rename
+	int fd = open(directory, O_RDONLY);
+	if (fd >= 0) {
+		fsync(fd);
+		close(fd);
+	}
+	return 0;
+}
+
+/**
+ * @brief Read a whole file into memory.
+ *
+ * @return Returns the bytes, which the caller must free, or NULL with
+ * errno set.
+ */
+static char *readFile(const char *path, size_t *len)
+{
+	struct stat st;
+	char *data = NULL;
+	size_t done = 0;
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) == 0 && (data = (char *) malloc((size_t) st.st_size + 1)) != NULL) {
+		while (done < (size_t) st.st_size) {
+			ssize_t bytes = read(fd, data + done, (size_t) st.st_size - done);
+			if (bytes < 0 && errno == EINTR)
+				continue;
+			if (bytes <= 0)
+				break;
+			done += (size_t) bytes;
+		}
+		if (done < (size_t) st.st_size) {
+			free(data);
+			data = NULL;
+			errno = EIO;
+		}
+	}
+	close(fd);
+	*len = done;
+	return data;
+}
+
+/**
+ * @brief Remove the files of snapshots that were never renamed over the
+ * snapshot.
+ */
+static void removeTemps(const char *directory)
+{
+	DIR *dir = opendir(directory);
+	struct dirent *file;
+	char path[SNAPSHOT_MAX_PATH];
+	unsigned int g;
+	char end;
+
+	if (dir == NULL)
+		return;
+	while ((file = readdir(dir)) != NULL) {
+		if (sscanf(file->d_name, "snapshot.%u.tm%c", &g, &end) == 2 && end == 'p') {
+			snprintf(path, sizeof path, SNAPSHOT_TEMP_FORMAT, directory, g);
+			unlink(path);
+		}
+	}
+	closedir(dir);
+}
+
+int snapshot_load(const char *directory, uint32_t *generation, SnapshotReserve reserve, WalApply apply, void *arg)
+{
+	char path[SNAPSHOT_MAX_PATH];
+	size_t len;
+	char *data;
+
+	*generation = 0;
+	removeTemps(directory);
+	snprintf(path, sizeof path, "%s/%s", directory, SNAPSHOT_FILE_NAME);
+	data = readFile(path, &len);
+	if (data == NULL)
+		return errno == ENOENT ? 0 : -1;
+
+	//the magic, the generation, the end tag and the checksum at least
+	if (len < SNAPSHOT_MAGIC_LEN + 4 + 1 + 4 || memcmp(data, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN) != 0
+			|| data[len - 5] != SNAPSHOT_END
+			|| wal_crc32(0, data, len - 4) != (uint32_t) getWord(data + len - 4, 4)) {
+		free(data);
+		return -1;
+	}
+
+	//the key and value are copied to be '\0' ended, as a WalRecord
+	char *table = NULL;
+	char *fields = NULL;
+	size_t capacity = 0;
+	const char *p = data + SNAPSHOT_MAGIC_LEN + 4;
+	const char *end = data + len - 5;
+	int status = 0;
+
+	while (status == 0 && p < end) {
+		if (*p == SNAPSHOT_TABLE && end - p >= SNAPSHOT_TABLE_LEN
+				&& end - p - SNAPSHOT_TABLE_LEN >= (unsigned char) p[1]) {
+			size_t nameLen = (unsigned char) p[1];
+			free(table);
+			table = strndup(p + 2, nameLen);
+			if (table == NULL)
+				status = -1;
+			else if (reserve != NULL)
+				status = reserve(table, (uint32_t) getWord(p + 2 + nameLen, 4), arg);
+			p += SNAPSHOT_TABLE_LEN + nameLen;
+		} else if (*p == SNAPSHOT_RECORD && table != NULL && end - p >= SNAPSHOT_RECORD_LEN) {
+			size_t keyLen = (size_t) getWord(p + 1, 2);
+			size_t valueLen = (size_t) getWord(p + 3, 4);
+			WalRecord record;
+			if ((size_t) (end - p) - SNAPSHOT_RECORD_LEN < keyLen + valueLen) {
+				status = -1;
+				break;
+			}
+			if (keyLen + valueLen + 2 > capacity) {
+				char *grown = (char *) realloc(fields, keyLen + valueLen + 2);
+				if (grown == NULL) {
+					status = -1;
+					break;
+				}
+				fields = grown;
+				capacity = keyLen + valueLen + 2;
+			}
+			memcpy(fields, p + SNAPSHOT_RECORD_LEN, keyLen);
+			fields[keyLen] = '\0';
+			memcpy(fields + keyLen + 1, p + SNAPSHOT_RECORD_LEN + keyLen, valueLen);
+			fields[keyLen + 1 + valueLen] = '\0';
+
+			record.type = WAL_SET;
+			record.version = getWord(p + 7, 8);
+			record.table = table;
+			record.key = fields;
+			record.value = fields + keyLen + 1;
+			status = apply(&record, arg);
+			p += SNAPSHOT_RECORD_LEN + keyLen + valueLen;
+		} else
+			status = -1;
+	}
+
+	if (status == 0)
+		*generation = (uint32_t) getWord(data + SNAPSHOT_MAGIC_LEN, 4);
+	free(table);
+	free(fields);
+	free(data);
+	return status;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file
+ * @brief This file declares the snapshots of the storage server.
+ *
+ * A snapshot is every record of every table at one point of the
+ * write-ahead log, in a compact binary file. The server writes it from
+ * a forked child, so the copy-on-write pages of the child hold still
+ * while the parent keeps serving. At startup the snapshot is loaded and
+ * only the log files of later generations are replayed.
+ *
+ * The file starts with the magic "KVSNAP1\n" and the generation of the
+ * first log file after it, then holds a series of tagged items: a table
+ * (its name length byte, name and number of records as 32 bits), or a
+ * record of the last table (the key length as 16 bits, the value length
+ * as 32 bits, the key, the value and the 64 bit version). An end tag and
+ * the CRC-32 of everything before it close the file. Numbers are big
+ * endian.
+ */
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include "hashTable.h"
+#include "wal.h"
+
+#define SNAPSHOT_FILE_NAME "snapshot.db"
+#define SNAPSHOT_TEMP_FORMAT "%s/snapshot.%u.tmp"	///< Written, then renamed over the snapshot: the data directory and the generation.
+
+/**
+ * @brief Makes room in a table for the records of a snapshot, before
+ * they are applied.
+ *
+ * @return Returns 0 on success, -1 to stop loading.
+ */
+typedef int (*SnapshotReserve)(const char *table, uint32_t count, void *arg);
+
+/**
+ * @brief Write a snapshot of some tables.
+ *
+ * The file is written beside the snapshot under a name of its own
+ * generation, synced, and renamed over it, so a crash leaves the
+ * previous snapshot in place. The tables are read
+ * without locking: call this in a child forked while they were frozen.
+ *
+ * @param directory The data directory.
+ * @param generation The generation of the first log file not in the snapshot.
+ * @param numTables The number of tables.
+ * @param names The name of each table.
+ * @param tables The tables.
+ * @return Returns 0 on success, -1 otherwise.
+ */
+int snapshot_write(const char *directory, uint32_t generation, int numTables, char **names, HashTable **tables);
+
+/**
+ * @brief Load the snapshot of a data directory, if there is one.
+ *
+ * Each record is passed to apply as a WAL_SET, as if replayed from the
+ * log. The whole file is checked before any record is applied. The
+ * files of snapshots cut short by a crash are removed.
+ *
+ * @param directory The data directory.
+ * @param generation Set to the generation of the first log file to
+ * replay after the snapshot, 0 if there is no snapshot.
+ * @param reserve Called with the number of records of each table
+ * before its records, or NULL.
+ * @param apply Called with each record.
+ * @param arg Passed to reserve and apply.
+ * @return Returns 0 on success, -1 if the snapshot is corrupt or could
+ * not be read.
+ */
+int snapshot_load(const char *directory, uint32_t *generation, SnapshotReserve reserve, WalApply apply, void *arg);
+
+#endif
@@ -8,22 +8,152 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <inttypes.h>
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netdb.h>
+#include <poll.h>
 #include "storage.h"
 #include "utils.h"
 #include "config_parser.tab.h"
 
 #define SUCCESS 7
+#define MAX_BATCH_WINDOW 8	///< MGET/MSET requests sent ahead of the reply being read.
 
 extern int ThreadCounter;
 
 FILE *ClientFileLog;
 extern struct config_params params;
 
+/**
+ * @brief The state behind the opaque handle returned by storage_connect().
+ *
+ * Replies are read through a buffer that lives as long as the connection,
+ * so bytes received past the end of one reply are kept for the next one.
+ */
+typedef struct connection {
+	int sock;
+	ReadBuffer readBuffer;
+	bool binary;		///< Requests and replies are frames, not text lines.
+	uint32_t requestId;	///< The id of the last request sent.
+	uint32_t replyId;	///< The id echoed by the last frame received.
+	WriteBuffer output;	///< Submitted requests not yet written.
+	/// Submitted requests not yet polled, oldest first from pendingHead.
+	int numPending;
+	int pendingHead;
+	uint8_t pendingOpcodes[MAX_PENDING_REQUESTS];
+	uint32_t pendingIds[MAX_PENDING_REQUESTS];
+}Connection;
+
+/**
+ * @brief Encodes a request in the protocol of the connection
+ *
+ * @param connection The connection to the server
+ * @param buf Where the request is encoded; MAX_CMD_LEN bytes
+ * @param opcode The command
+ * @param numFields The number of fields after the command
+ * @param fields The fields
+ * @return The length of the request, 0 if it does not fit
+ */
+static size_t encodeRequest(Connection *connection, char *buf, int opcode, int numFields, const char **fields)
+{
+	size_t used;
+	int i;
+
+	connection->requestId++;
+
+	if (connection->binary) {
+		used = FRAME_HEADER_LEN;
+		for (i = 0; i < numFields; i++) {
+			if (frame_addField(buf, &used, MAX_CMD_LEN, fields[i], strlen(fields[i])) != 0)
+				return 0;
+		}
+		frame_setHeader(buf, used, opcode, 0, connection->requestId);
+	}
+	else {
+		used = snprintf(buf, MAX_CMD_LEN, "%s#", commandNames[opcode]);
+		for (i = 0; i < numFields && used < MAX_CMD_LEN; i++)
+			used += snprintf(buf + used, MAX_CMD_LEN - used, "%s#", fields[i]);
+		if (used + 1 >= MAX_CMD_LEN)
+			return 0;
+		buf[used++] = '\n';
+	}
+	return used;
+}
+
+/**
+ * @brief Sends a request and leaves the connection waiting for its reply
+ *
+ * Fails while submitted requests are waiting for storage_poll(), since
+ * their replies come first.
+ *
+ * @param connection The connection to the server
+ * @param opcode The command
+ * @param numFields The number of fields after the command
+ * @param fields The fields
+ * @return 0 on success, -1 otherwise
+ */
+static int sendRequest(Connection *connection, int opcode, int numFields, const char **fields)
+{
+	char buf[MAX_CMD_LEN];
+	size_t used;
+
+	if (connection->numPending > 0 || (used = encodeRequest(connection, buf, opcode, numFields, fields)) == 0) {
+		errno = ERR_INVALID_PARAM;
+		return -1;
+	}
+	if (sendall(connection->sock, buf, used) != 0) {
+		errno = ERR_CONNECTION_FAIL;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Receives the next reply and starts splitting it into fields
+ *
+ * @param connection The connection to the server
+ * @param buf Where the reply is kept while its fields are used; MAX_CMD_LEN bytes
+ * @param reply The field cursor over the reply
+ * @return 0 on success, -1 otherwise
+ */
+static int recvReply(Connection *connection, char *buf, Command *reply)
+{
+	FrameHeader header;
+
+	if (connection->binary) {
+		if (rb_recvframe(&connection->readBuffer, &header, buf) != 0) {
+			errno = ERR_CONNECTION_FAIL;
+			return -1;
+		}
+		connection->replyId = header.requestId;
+		cmd_init(reply, buf, header.length, true);
+	}
+	else {
+		if (rb_recvline(&connection->readBuffer, buf, MAX_CMD_LEN) != 0) {
+			errno = ERR_CONNECTION_FAIL;
+			return -1;
+		}
+		cmd_init(reply, buf, strlen(buf), false);
+	}
+	return 0;
+}
+
+/**
+ * @brief Sets errno from the code of an "Error#<code>#" reply
+ *
+ * @param reply The reply, with the status word already taken
+ * @return -1
+ */
+static int replyError(Command *reply)
+{
+	char *error = cmd_next(reply);
+	char *p;
 
+	errno = error != NULL ? strtol(error, &p, 10) : ERR_UNKNOWN;
+	return -1;
+}
 
 /**
  * @brief Connect to the server
@@ -33,6 +163,19 @@ extern struct config_params params;
  * @return void
  */
 void* storage_connect(const char *hostname, const int port)
+{
+	return storage_connect_protocol(hostname, port, STORAGE_PROTOCOL_TEXT);
+}
+
+/**
+ * @brief Connect to the server, choosing the wire protocol
+ *
+ * @param hostname The hostname the client enters.
+ * @param port The port the client enters on.
+ * @param protocol STORAGE_PROTOCOL_TEXT or STORAGE_PROTOCOL_BINARY.
+ * @return A connection on success, NULL otherwise
+ */
+void* storage_connect_protocol(const char *hostname, const int port, const int protocol)
 {
 	if (hostname == NULL) {
 		errno = ERR_INVALID_PARAM;
@@ -40,7 +183,7 @@ void* storage_connect(const char *hostname, const int port)
 	}
 
 	//Checks the port if valid or not
-	if(port<=0){
+	if(port<=0 || (protocol != STORAGE_PROTOCOL_TEXT && protocol != STORAGE_PROTOCOL_BINARY)){
 		errno = ERR_INVALID_PARAM;
 		return NULL;
 	}
@@ -76,12 +219,45 @@ void* storage_connect(const char *hostname, const int port)
 		
 	// Connect to the server.
 	status = connect(sock, res->ai_addr, res->ai_addrlen);
+	freeaddrinfo(res);
 	if (status != 0){
+		close(sock);
 		errno = ERR_CONNECTION_FAIL;
 		return NULL;
 	}
 
-	return (void*) sock;
+	Connection *connection = (Connection *)malloc(sizeof(Connection));
+	if (connection == NULL) {
+		close(sock);
+		errno = ERR_UNKNOWN;
+		return NULL;
+	}
+	connection->sock = sock;
+	connection->binary = false;
+	connection->requestId = 0;
+	connection->numPending = 0;
+	connection->pendingHead = 0;
+	rb_init(&connection->readBuffer, sock);
+	wb_init(&connection->output);
+
+	//Ask for frames; the answer is still a text line
+	if (protocol == STORAGE_PROTOCOL_BINARY) {
+		char buf[MAX_CMD_LEN];
+		Command reply;
+		char *word;
+
+		if (sendRequest(connection, OP_BINARY, 0, NULL) != 0 || recvReply(connection, buf, &reply) != 0
+				|| (word = cmd_next(&reply)) == NULL || strcmp(word, "SUCCESS") != 0) {
+			close(sock);
+			wb_free(&connection->output);
+			free(connection);
+			errno = ERR_CONNECTION_FAIL;
+			return NULL;
+		}
+		connection->binary = true;
+	}
+
+	return (void*) connection;
 }
 
 /**
@@ -93,8 +269,7 @@ void* storage_connect(const char *hostname, const int port)
  */
 int storage_auth(const char *username, const char *passwd, void *conn)
 {
-	// Connection is really just a socket file descriptor.
-	int sock = (int)conn;
+	Connection *connection = (Connection *)conn;
 	
 	if(conn==NULL){
 		errno = ERR_INVALID_PARAM;
@@ -114,43 +289,117 @@ int storage_auth(const char *username, const char *passwd, void *conn)
 	
 	// Send some data.
 	char buf[MAX_CMD_LEN];
-	char *bufferPointer = buf;
-	memset(buf, 0, sizeof buf); // setting buf to all '0'
+	Command reply;
 
 
 	//ecnrypte the password
 	char *encrypted_passwd = generate_encrypted_password(passwd, NULL);
-	snprintf(buf, sizeof buf, "AUTH#%s#%s#\n", username, encrypted_passwd);
-	if (sendall(sock, buf, strlen(buf)) == 0 && recvline(sock, buf, sizeof buf) == 0){ 
+	const char *fields[] = { username, encrypted_passwd };
+	if (sendRequest(connection, OP_AUTH, 2, fields) == 0 && recvReply(connection, buf, &reply) == 0){ 
+
+		//Parses whether successful or an error occured
+		char *status = cmd_next(&reply);
 
-		if (strcmp(buf, "SUCCESS") == 0){
+		if (status != NULL && strcmp(status, "SUCCESS") == 0){
 			return 0;
-		} 
+		}
+		return replyError(&reply);
+	}
+	//Should not get here unless something failed
+	return -1;
+}
 
-		//Parses whether successful or an error occured
-		char *status = getNextWord(&bufferPointer, '#');
-		char *error;
+/**
+ * @brief Reads the reply to a GET into a record
+ *
+ * @param reply The reply
+ * @param record Where the value and version are stored
+ * @return 0 on success, -1 otherwise
+ */
+static int readGetReply(Command *reply, struct storage_record *record)
+{
+	//Parses whether successful or an error occured
+	char *status = cmd_next(reply);
+	char *value;
+	char *version;
+
+	//Parameters to extract the version
+	char *p;
+
+	if (status != NULL && strcmp(status, "SUCCESS") == 0){//If status == SUCCESS
+		cmd_next(reply); //the key
+
+		//Get the value and copy to the record value member
+		value = cmd_next(reply);
+		version = cmd_next(reply);
+		if (value == NULL || version == NULL) {
+			errno = ERR_UNKNOWN;
+			return -1;
+		}
+		strncpy(record->value, value, sizeof record->value);
+		record->metadata[0] = strtoull(version, &p, 10);
+		return 0;
+	}
 
-		//Paramters to extract error number
-		long int errorCode;
-		char *p;
+	//If status == error
+	return replyError(reply);
+}
 
+/**
+ * @brief Reads the reply to a SET
+ *
+ * @param reply The reply
+ * @param word Where the status word (INSERT, MODIFY, DELETE, ...) is stored
+ * @return 0 on success, -1 otherwise
+ */
+static int readSetReply(Command *reply, char **word)
+{
+	char *status = cmd_next(reply);
 
-		if (strlen(status)==SUCCESS){//If status = SUCCESS
-			return 0;
-		}
-		else{
-			error = getNextWord(&bufferPointer, '#');
-			errorCode = strtol(error, &p, 10);
-			errno = errorCode;
+	*word = status;
+	if (status == NULL) {
+		errno = ERR_UNKNOWN;
+		return -1;
+	}
+	if (strcmp(status, "SUCCESS") == 0 || strcmp(status, "MODIFY") == 0 || strcmp(status, "INSERT") == 0
+			|| strcmp(status, "DELETE") == 0 || strcmp(status, "UPLOAD") == 0)
+		return 0;
+
+	//If status == error
+	return replyError(reply);
+}
+
+/**
+ * @brief Checks the parameters of a SET and lays out its fields
+ *
+ * @param connection The connection to the server
+ * @param table A table stored in the database.
+ * @param key A key in the table
+ * @param record The new value, NULL to delete the key
+ * @param fields Where the four fields are stored
+ * @param metadata Room for the version; MAX_STRING_SIZE bytes
+ * @return 0 on success, -1 if otherwise
+ */
+static int setFields(Connection *connection, const char *table, const char *key, struct storage_record *record,
+		const char **fields, char *metadata)
+{
+	fields[0] = table;
+	fields[1] = key;
+	fields[2] = "";
+	fields[3] = "-1";
+
+	//Check if parameters are valid; frames carry any value, the server checks its format
+	if(record != NULL){
+		if( !parameterCheck((char *) table) || !parameterCheck((char *) key) || !(connection->binary || recordCheck(record->value)) ){
+			errno = ERR_INVALID_PARAM;
 			return -1;
 		}
-		free(status);
-		free(error);
+		sprintf(metadata,"%" PRIuPTR,(record->metadata)[0]);
+		fields[2] = record->value;
+		fields[3] = metadata;
 	}
-	//Should not get here unless something failed
-	//Set errno to unknown?
-	return -1;
+	//A NULL record deletes the key
+	return 0;
 }
 
 /**
@@ -163,8 +412,7 @@ int storage_auth(const char *username, const char *passwd, void *conn)
  */
 int storage_get(const char *table, const char *key, struct storage_record *record, void *conn)
 {
-	// Connection is really just a socket file descriptor.
-	int sock = (int)conn;
+	Connection *connection = (Connection *)conn;
 
 	//MAY STILL NEEED TO CHECK RECORD VALUE
 	//Check if parameters are valid
@@ -181,63 +429,66 @@ int storage_get(const char *table, const char *key, struct storage_record *recor
 
 	// Send some data.
 	char buf[MAX_CMD_LEN];
-	char *bufferPointer = buf;
+	Command reply;
 	char tempString[MAX_STRING_SIZE];
 	sprintf(tempString, "[LOG] GET Request Made. Table: %s Key: %s\n", table, key);
 	logger(ClientFileLog,tempString);	//Arash Khazaei: An attempt is made to request data from Server
-	memset(buf, 0, sizeof buf);
-	snprintf(buf, sizeof buf, "GET#%s#%s#\n", table, key);
-	if (sendall(sock, buf, strlen(buf)) == 0 && recvline(sock, buf, sizeof buf) == 0) {
-		
+	const char *fields[] = { table, key };
+	if (sendRequest(connection, OP_GET, 2, fields) == 0 && recvReply(connection, buf, &reply) == 0)
+		return readGetReply(&reply, record);
+	//Should not get here unless something failed
+	return -1;
+}
 
-		//strncpy(record->value, buf, sizeof record->value);
-		
-		//Parses whether successful or an error occured
-		char *status = getNextWord(&bufferPointer, '#');
-		char *error;
-		char *key;
-		char *value;
-		char *version;
-
-		//Parameters to extract error number
-		long int errorCode;
-		long int metadata;
-		char *p;
-		
-		if (strcmp(status, "SUCCESS") == 0){//If status == SUCCESS
-			key = getNextWord(&bufferPointer, '#');
-
-			//Get the value and copy to the record value member
-			value = getNextWord(&bufferPointer, '#');
-			strncpy(record->value, value, sizeof record->value);
-			version = getNextWord(&bufferPointer, '#');
-			metadata = strtol(version, &p, 10);
-			record->metadata[0] = metadata;
-
-			free(status);
-			free(value);
-			free(version);
-			free(key);
-			return 0;
-		}
 
-		else{//If status == error
-			error = getNextWord(&bufferPointer, '#');
-			//Get the error code from the server and set the errno variable to the corresponding error
-			errorCode = strtol(error, &p, 10);
-			errno = errorCode;
-			free(status);
-			free(error);
+/**
+ * @brief Reads the reply to a QUERY or QUERY_NEXT
+ *
+ * Keys may arrive over several "MORE#" replies before the final
+ * "SUCCESS#<count>#" one.
+ *
+ * @param connection The connection the request was sent on.
+ * @param keys An array with room for at least max_keys keys.
+ * @param max_keys The size of the keys array.
+ * @return The number of matching keys on success, -1 otherwise
+ */
+static int readQueryKeys(Connection *connection, char **keys, const int max_keys)
+{
+	char buf[MAX_CMD_LEN];
+	Command reply;
+	char *status;
+	char *keyMessage;
+	int x = 0;
+
+	if (recvReply(connection, buf, &reply) != 0)
+		return -1;
+
+	//Long results come in "MORE#" replies ahead of the last one
+	while ((status = cmd_next(&reply)) != NULL && strcmp(status, "MORE") == 0) {
+		while ((keyMessage = cmd_next(&reply)) != NULL) {
+			if (x < max_keys)
+				strcpy(keys[x], keyMessage);
+			x++;
+		}
+		if (recvReply(connection, buf, &reply) != 0)
 			return -1;
-			}
-		
+	}
 
+	if (status == NULL || strcmp(status, "SUCCESS") != 0)//If status == error
+		return replyError(&reply);
+
+	char *keyNumber = cmd_next(&reply);
+	char *p;
+	long int keysFound = keyNumber != NULL ? strtol(keyNumber, &p, 10) : 0;
+	for (; x < max_keys && x < keysFound; x++){
+		keyMessage = cmd_next(&reply);
+		if (keyMessage == NULL)
+			break;
+		strcpy(keys[x],keyMessage);
 	}
-	//Should not get here unless something failed
-	return -1;
+	return keysFound;
 }
 
-
 /**
  * @brief Get the stored table and key with the correct value
  *
@@ -249,104 +500,50 @@ int storage_get(const char *table, const char *key, struct storage_record *recor
 int storage_set(const char *table, const char *key, struct storage_record *record, void *conn)
 {
 	
-	// Connection is really just a socket file descriptor.
-	int sock = (int)conn;
-	char *keyPrint = key;
+	Connection *connection = (Connection *)conn;
+	const char *keyPrint = key;
 	//MAY STILL NEEED TO CHECK RECORD VALUE
 
-	//printf("%d\n",record->metadata[0]);
-	
-	if (table == NULL || key == NULL ) {
+	if (table == NULL || key == NULL || conn == NULL) {
 		errno = ERR_INVALID_PARAM;
 		return -1;
 	}
 
 	// Send some data.
 	char buf[MAX_CMD_LEN];
-	char *bufferPointer = buf;
+	Command reply;
 	char metadata[MAX_STRING_SIZE];
+	const char *fields[4];
 
-	printf("Before record check\n");	
-	//Check if parameters are valid
-	if(record != NULL){
-		if( !parameterCheck(table) || !parameterCheck(key) || conn==NULL || !recordCheck(record->value) ){
-			errno = ERR_INVALID_PARAM;
-			return -1;
-		}
-		printf("Before Storing metadata\n");	
-		sprintf(metadata,"%d",(record->metadata)[0]);
-		printf("After Storing metadata\n");	
-		memset(buf, 0, sizeof buf);
-		snprintf(buf, sizeof buf, "SET#%s#%s#%s#%s#\n", table, key, record->value, metadata);
-		//snprintf(buf, sizeof buf, "SET#%s#%s#%s#%s#\n", table, key, record->value, "15");
-		printf("%s\n",buf);
-	}
-	else{
-		
-		memset(buf, 0, sizeof buf);
-		snprintf(buf, sizeof buf, "SET#%s#%s#%s#%s#\n", table, key, "", "-1");
-		printf("%s\n",buf);
-	}
-
-	//LOG TO FILE
-	//char tempString[MAX_STRING_SIZE];
-	//sprintf(tempString, "[LOG] SET Request Made. Table: %s Key: %s\n", table, key);
-	//logger(ClientFileLog,tempString);	//Arash Khazaei: An attempt will be made to modify data to server
-	//END LOG TO FILE
-	printf("After record check\n");
+	if (setFields(connection, table, key, record, fields, metadata) != 0)
+		return -1;
 
-	if (sendall(sock, buf, strlen(buf)) == 0 && recvline(sock, buf, sizeof buf) == 0) {
+	if (sendRequest(connection, OP_SET, 4, fields) == 0 && recvReply(connection, buf, &reply) == 0) {
  
 		//Parses whether successful or an error occured
-		char *status = getNextWord(&bufferPointer, '#');
-		char *error;
-		char *key;
-		char *value;
-
-		//Parameters to extract error number
-		long int errorCode;
-		char *p;		
+		char *status;
 
-		if (strcmp(status, "SUCCESS")==0){//If status == SUCCESS
-			free(status);
-			return 0;
-		}
+		if (readSetReply(&reply, &status) != 0)
+			return -1;
 
-		else if(strcmp(status, "MODIFY") == 0){
+		if(strcmp(status, "MODIFY") == 0){
 			printf("Modified key: %s @ %s\n",record->value,keyPrint);
-			free(status);
-			return 0;
 		}
 
 		else if(strcmp(status, "INSERT") == 0){
 			printf("Inserted key: %s @ %s\n",record->value, keyPrint);
-			free(status);
-			return 0;
 		}
 
 		else if(strcmp(status, "DELETE") == 0){
 			printf("Deleted key: %s\n",keyPrint);
-			free(status);
-			return 0;
 		}
 
 		else if(strcmp(status, "UPLOAD") == 0){
 			printf("Uploaded Table: %s\n",table);
-			free(status);
-			return 0;
 		}
-		else{//If status == error
-			error = getNextWord(&bufferPointer, '#');
-			//Get the error code from the server and set the errno variable to the corresponding error
-			errorCode = strtol(error, &p, 10);
-			errno = errorCode;
-			free(status);
-			free(error);
-			return -1;
-		}
-		//Should not get here unless something failed
-		return -1;
+		return 0;
 	}
+	return -1;
 }
 
 //
@@ -360,8 +557,7 @@ int storage_query(const char *table, const char *predicates, char **keys, const
 		return -1;
 	}
 	predicates = myStrDup (predicates);
-	// Connection is really just a socket file descriptor.
-	int sock = (int)conn;
+	Connection *connection = (Connection *)conn;
 	long int keysFound = 0;
 
 	if( !parameterCheck(table) || !queryCheck(predicates)){
@@ -370,66 +566,533 @@ int storage_query(const char *table, const char *predicates, char **keys, const
 	}
 
 	// Send some data.
-	char buf[MAX_CMD_LEN];
-	char *bufferPointer = buf;
+	char maxKeys[MAX_STRING_SIZE];
 	//LOG TO FILE
 	char tempString[MAX_STRING_SIZE];
 	sprintf(tempString, "[LOG] QUERY Request Made. Table: %s Predicates: %s\n", table, predicates);
 	logger(ClientFileLog,tempString);	//Arash Khazaei: An attempt will be made to modify data to server
 	//END LOG TO FILE
 
-	memset(buf, 0, sizeof buf);
-	snprintf(buf, sizeof buf, "QUERY#%s#%s#%d#\n", table, predicates, max_keys);
+	snprintf(maxKeys, sizeof maxKeys, "%d", max_keys);
+	const char *fields[] = { table, predicates, maxKeys };
+
+	keysFound = sendRequest(connection, OP_QUERY, 3, fields) == 0 ? readQueryKeys(connection, keys, max_keys) : -1;
+	free (predicates);
+	return keysFound;
+}
+
+/**
+ * @brief Opens a cursor over the records of a table matching a query
+ *
+ * @param table A table in the database.
+ * @param predicates A comma separated list of predicates.
+ * @param conn A pointer to the connection structure
+ * @return The id of the cursor on success, -1 otherwise
+ */
+int storage_query_open(const char *table, const char *predicates, void *conn)
+{
+	if (table == NULL || predicates == NULL || conn == NULL || !parameterCheck(table)) {
+		errno = ERR_INVALID_PARAM;
+		return -1;
+	}
+	char *query = myStrDup (predicates);
+	if (!queryCheck(query)) {
+		free (query);
+		errno = ERR_INVALID_PARAM;
+		return -1;
+	}
+
+	Connection *connection = (Connection *)conn;
+	char buf[MAX_CMD_LEN];
+	Command reply;
+	const char *fields[] = { table, query };
+	int status = sendRequest(connection, OP_QUERY_OPEN, 2, fields);
 
+	free (query);
+	if (status != 0 || recvReply(connection, buf, &reply) != 0)
+		return -1;
 
-	if (sendall(sock, buf, strlen(buf)) == 0 && recvline(sock, buf, sizeof buf) == 0) {
+	char *word = cmd_next(&reply);
+	if (word == NULL || strcmp(word, "SUCCESS") != 0)
+		return replyError(&reply);
+	word = cmd_next(&reply);
+	if (word == NULL) {
+		errno = ERR_UNKNOWN;
+		return -1;
+	}
+	return atoi(word);
+}
 
-		
-		//Parses whether successful or an error occured
-		char *status = getNextWord(&bufferPointer, '#');
-		char *error;
-		char *keyNumber;
-		char *keyMessage;
-
-		//Parameters to extract error number
-		long int errorCode;
-		char *p;		
-
-		if (strcmp(status, "SUCCESS")==0){//If status == SUCCESS
-			//NEED TO PARSE PROPERLY
-			keyNumber = getNextWord(&bufferPointer, '#');
-			keysFound = strtol(keyNumber,&p,10);
-			int x;
-   	 		for (x = 0; x < max_keys ; x++){
-   	 			if(x<keysFound){
-   	 				keyMessage = getNextWord(&bufferPointer, '#');
-   	 				printf("%s\n",keyMessage );
-   	 				strcpy(keys[x],keyMessage);
-   	 				free(keyMessage);
-   	 			}
-   	 		}
-			free(status);
-			free(keyNumber);
-			free (predicates);
-			return keysFound;
+/**
+ * @brief Retrieves the next page of keys of a cursor
+ *
+ * @param cursor A cursor returned by storage_query_open.
+ * @param keys An array with room for at least max_keys keys.
+ * @param max_keys The size of the keys array.
+ * @param conn A pointer to the connection structure
+ * @return The number of keys retrieved, less than max_keys once the
+ * cursor is exhausted; -1 on error
+ */
+int storage_query_next(int cursor, char **keys, const int max_keys, void *conn)
+{
+	if (cursor < 0 || keys == NULL || max_keys < 0 || conn == NULL) {
+		errno = ERR_INVALID_PARAM;
+		return -1;
+	}
+
+	Connection *connection = (Connection *)conn;
+	char id[MAX_STRING_SIZE];
+	char count[MAX_STRING_SIZE];
+	const char *fields[] = { id, count };
+
+	snprintf(id, sizeof id, "%d", cursor);
+	snprintf(count, sizeof count, "%d", max_keys);
+	if (sendRequest(connection, OP_QUERY_NEXT, 2, fields) != 0)
+		return -1;
+	return readQueryKeys(connection, keys, max_keys);
+}
+
+/**
+ * @brief Releases a cursor on the server
+ *
+ * @param cursor A cursor returned by storage_query_open.
+ * @param conn A pointer to the connection structure
+ * @return 0 on success, -1 otherwise
+ */
+int storage_query_close(int cursor, void *conn)
+{
+	if (cursor < 0 || conn == NULL) {
+		errno = ERR_INVALID_PARAM;
+		return -1;
+	}
+
+	Connection *connection = (Connection *)conn;
+	char buf[MAX_CMD_LEN];
+	Command reply;
+	char id[MAX_STRING_SIZE];
+	const char *fields[] = { id };
+
+	snprintf(id, sizeof id, "%d", cursor);
+	if (sendRequest(connection, OP_QUERY_CLOSE, 1, fields) != 0 || recvReply(connection, buf, &reply) != 0)
+		return -1;
+
+	char *word = cmd_next(&reply);
+	if (word != NULL && strcmp(word, "SUCCESS") == 0)
+		return 0;
+	return replyError(&reply);
+}
+
+/**
+ * @brief Queues a request behind the ones already submitted
+ *
+ * The request is written once enough are queued, or by storage_poll().
+ *
+ * @param connection The connection to the server
+ * @param opcode The command
+ * @param numFields The number of fields after the command
+ * @param fields The fields
+ * @return The id of the request on success, -1 otherwise
+ */
+static int submitRequest(Connection *connection, int opcode, int numFields, const char **fields)
+{
+	char buf[MAX_CMD_LEN];
+	size_t used;
+
+	if (connection->numPending == MAX_PENDING_REQUESTS
+			|| (used = encodeRequest(connection, buf, opcode, numFields, fields)) == 0) {
+		errno = ERR_INVALID_PARAM;
+		return -1;
+	}
+	if (wb_append(&connection->output, buf, used) != 0) {
+		errno = ERR_UNKNOWN;
+		return -1;
+	}
+	if (wb_pending(&connection->output) >= MAX_CMD_LEN && wb_sendall(&connection->output, connection->sock) != 0) {
+		errno = ERR_CONNECTION_FAIL;
+		return -1;
+	}
+
+	int slot = (connection->pendingHead + connection->numPending) % MAX_PENDING_REQUESTS;
+	connection->pendingOpcodes[slot] = (uint8_t) opcode;
+	connection->pendingIds[slot] = connection->requestId;
+	connection->numPending++;
+	return (int) (connection->requestId & INT32_MAX);
+}
+
+/**
+ * @brief Submits a GET without waiting for its reply
+ *
+ * @param table A table stored in the database.
+ * @param key A key in the table
+ * @param conn A pointer to the connection structure
+ * @return The id of the request on success, -1 otherwise
+ */
+int storage_submit_get(const char *table, const char *key, void *conn)
+{
+	if (table == NULL || key == NULL || conn == NULL || !parameterCheck((char *) table) || !parameterCheck((char *) key)) {
+		errno = ERR_INVALID_PARAM;
+		return -1;
+	}
+
+	const char *fields[] = { table, key };
+	return submitRequest((Connection *)conn, OP_GET, 2, fields);
+}
+
+/**
+ * @brief Submits a SET without waiting for its reply
+ *
+ * @param table A table stored in the database.
+ * @param key A key in the table
+ * @param record The new value, NULL to delete the key
+ * @param conn A pointer to the connection structure
+ * @return The id of the request on success, -1 otherwise
+ */
+int storage_submit_set(const char *table, const char *key, struct storage_record *record, void *conn)
+{
+	Connection *connection = (Connection *)conn;
+	char metadata[MAX_STRING_SIZE];
+	const char *fields[4];
+
+	if (table == NULL || key == NULL || conn == NULL) {
+		errno = ERR_INVALID_PARAM;
+		return -1;
+	}
+	if (setFields(connection, table, key, record, fields, metadata) != 0)
+		return -1;
+	return submitRequest(connection, OP_SET, 4, fields);
+}
+
+/**
+ * @brief Checks whether a reply can be read without blocking
+ *
+ * @param connection The connection to the server
+ * @return true if a reply (or the end of the connection) is buffered
+ */
+static bool replyReady(Connection *connection)
+{
+	ReadBuffer *rb = &connection->readBuffer;
+	struct pollfd pfd = { connection->sock, POLLIN, 0 };
+
+	for (;;) {
+		if (connection->binary ? rb_hasFrame(rb) : rb_hasLine(rb))
+			return true;
+		if (poll(&pfd, 1, 0) <= 0)
+			return false;
+		if (rb_fill(rb) <= 0)
+			return true;
+	}
+}
+
+/**
+ * @brief Collects the reply to the oldest submitted request
+ *
+ * @param conn A pointer to the connection structure
+ * @param result Where the outcome of the request is stored
+ * @param wait Whether to block until the reply arrives
+ * @return 1 if a result was stored, 0 if nothing is pending or (without
+ * wait) the reply has not arrived yet, -1 on error
+ */
+int storage_poll(void *conn, struct storage_result *result, int wait)
+{
+	Connection *connection = (Connection *)conn;
+	char buf[MAX_CMD_LEN];
+	Command reply;
+	char *word;
+
+	if (conn == NULL || result == NULL) {
+		errno = ERR_INVALID_PARAM;
+		return -1;
+	}
+	if (connection->numPending == 0)
+		return 0;
+	if (wb_sendall(&connection->output, connection->sock) != 0) {
+		errno = ERR_CONNECTION_FAIL;
+		return -1;
+	}
+	if (!wait && !replyReady(connection))
+		return 0;
+	if (recvReply(connection, buf, &reply) != 0)
+		return -1;
+
+	int opcode = connection->pendingOpcodes[connection->pendingHead];
+	uint32_t id = connection->pendingIds[connection->pendingHead];
+	connection->pendingHead = (connection->pendingHead + 1) % MAX_PENDING_REQUESTS;
+	connection->numPending--;
+
+	//Replies come in order; a frame also names its request
+	if (connection->binary && connection->replyId != id) {
+		errno = ERR_UNKNOWN;
+		return -1;
+	}
+
+	result->id = (int) (id & INT32_MAX);
+	int status = opcode == OP_GET ? readGetReply(&reply, &result->record) : readSetReply(&reply, &word);
+	result->status = status == 0 ? 0 : errno;
+	return 1;
+}
+
+/**
+ * @brief Reads the replies to one MGET or MSET request
+ *
+ * The per key results may arrive over several "MORE#" replies before the
+ * final "SUCCESS#<count>#" one. An error reply to the whole request is
+ * stored as the status of each of its keys.
+ *
+ * @param connection The connection to the server
+ * @param opcode OP_MGET or OP_MSET
+ * @param id The id of the request
+ * @param records Where MGET stores the records read
+ * @param statuses Where the status of each key is stored
+ * @param count The number of keys in the request
+ * @return 0 on success, -1 otherwise
+ */
+static int readBatchReply(Connection *connection, int opcode, uint32_t id, struct storage_record *records,
+		int *statuses, int count)
+{
+	char buf[MAX_CMD_LEN];
+	Command reply;
+	char *status;
+	char *code;
+	char *p;
+	bool more = true;
+	int x = 0;
+
+	while (more) {
+		if (recvReply(connection, buf, &reply) != 0)
+			return -1;
+		status = cmd_next(&reply);
+		if (status == NULL || (connection->binary && connection->replyId != id)) {
+			errno = ERR_UNKNOWN;
+			return -1;
+		}
+
+		more = strcmp(status, "MORE") == 0;
+		if (!more && strcmp(status, "SUCCESS") != 0) {
+			replyError(&reply);
+			for (; x < count; x++)
+				statuses[x] = errno;
+			return 0;
+		}
+		if (!more)
+			cmd_next(&reply); //the count
+
+		while (x < count && (code = cmd_next(&reply)) != NULL) {
+			statuses[x] = strtol(code, &p, 10);
+			if (opcode == OP_MGET) {
+				char *value = cmd_next(&reply);
+				char *version = cmd_next(&reply);
+				if (value == NULL || version == NULL) {
+					errno = ERR_UNKNOWN;
+					return -1;
+				}
+				if (statuses[x] == 0) {
+					strncpy(records[x].value, value, sizeof records[x].value);
+					records[x].metadata[0] = strtoull(version, &p, 10);
+				}
+			}
+			x++;
+		}
+	}
+
+	if (x != count) {
+		errno = ERR_UNKNOWN;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Sends the keys of a MGET or MSET in as many requests as needed
+ *
+ * Each request takes up to MAX_BATCH_KEYS keys and fits in MAX_CMD_LEN.
+ * Up to MAX_BATCH_WINDOW requests are sent ahead of the reply being read.
+ *
+ * @param connection The connection to the server
+ * @param opcode OP_MGET or OP_MSET
+ * @param table A table in the database
+ * @param keys The keys
+ * @param records The records to set, or where the records read are stored
+ * @param statuses Where the status of each key is stored
+ * @param count The number of keys
+ * @return 0 on success, -1 otherwise
+ */
+static int runBatch(Connection *connection, int opcode, const char *table, const char **keys,
+		struct storage_record *records, int *statuses, int count)
+{
+	const char *fields[1 + 3 * MAX_BATCH_KEYS];
+	char versions[MAX_BATCH_KEYS][MAX_KEY_LEN];
+	char buf[MAX_CMD_LEN];
+	size_t overhead = connection->binary ? FRAME_FIELD_LEN : 1;
+	int ends[MAX_BATCH_WINDOW];
+	uint32_t ids[MAX_BATCH_WINDOW];
+	int numSent = 0;
+	int head = 0;
+	int sent = 0;
+	int done = 0;
+
+	while (done < count) {
+		//queue requests while the window has room
+		while (sent < count && numSent < MAX_BATCH_WINDOW) {
+			size_t size = FRAME_HEADER_LEN + strlen(commandNames[opcode]) + strlen(table) + 2 * overhead;
+			int numFields = 1;
+			int i;
+
+			fields[0] = table;
+			for (i = sent; i < count && i - sent < MAX_BATCH_KEYS; i++) {
+				size_t keySize = strlen(keys[i]) + overhead;
+				if (opcode == OP_MSET) {
+					snprintf(versions[i - sent], MAX_KEY_LEN, "%" PRIuPTR, records[i].metadata[0]);
+					keySize += strlen(records[i].value) + strlen(versions[i - sent]) + 2 * overhead;
+				}
+				if (i > sent && size + keySize >= MAX_CMD_LEN)
+					break;
+				size += keySize;
+
+				fields[numFields++] = keys[i];
+				if (opcode == OP_MSET) {
+					fields[numFields++] = records[i].value;
+					fields[numFields++] = versions[i - sent];
+				}
+			}
+
+			size_t used = encodeRequest(connection, buf, opcode, numFields, fields);
+			if (used == 0) {
+				errno = ERR_INVALID_PARAM;
+				return -1;
+			}
+			if (wb_append(&connection->output, buf, used) != 0) {
+				errno = ERR_UNKNOWN;
+				return -1;
+			}
+			int slot = (head + numSent) % MAX_BATCH_WINDOW;
+			ends[slot] = i;
+			ids[slot] = connection->requestId;
+			numSent++;
+			sent = i;
+		}
+		if (wb_sendall(&connection->output, connection->sock) != 0) {
+			errno = ERR_CONNECTION_FAIL;
+			return -1;
+		}
+
+		//the replies come in order
+		if (readBatchReply(connection, opcode, ids[head], records + done, statuses + done, ends[head] - done) != 0)
+			return -1;
+		done = ends[head];
+		head = (head + 1) % MAX_BATCH_WINDOW;
+		numSent--;
+	}
+	return 0;
+}
+
+/**
+ * @brief Gets several records of a table
+ *
+ * @param table A table stored in the database.
+ * @param keys The keys to get
+ * @param records Where the record of each key found is stored
+ * @param statuses Where 0 or the error code of each key is stored
+ * @param count The number of keys
+ * @param conn A pointer to the connection structure
+ * @return 0 on success, -1 if otherwise
+ */
+int storage_mget(const char *table, const char **keys, struct storage_record *records, int *statuses, int count, void *conn)
+{
+	Connection *connection = (Connection *)conn;
+	int i;
+
+	if (table == NULL || keys == NULL || records == NULL || statuses == NULL || count < 0 || conn == NULL
+			|| connection->numPending > 0 || !parameterCheck((char *) table)) {
+		errno = ERR_INVALID_PARAM;
+		return -1;
+	}
+	for (i = 0; i < count; i++) {
+		if (keys[i] == NULL || !parameterCheck((char *) keys[i])) {
+			errno = ERR_INVALID_PARAM;
+			return -1;
 		}
-		else{//If status == error
-			error = getNextWord(&bufferPointer, '#');
-			//Get the error code from the server and set the errno variable to the corresponding error
-			errorCode = strtol(error, &p, 10);
-			errno = errorCode;
-			free(status);
-			free(error);
-			free (predicates);
+	}
+
+	char tempString[MAX_STRING_SIZE];
+	sprintf(tempString, "[LOG] MGET Request Made. Table: %s Keys: %d\n", table, count);
+	logger(ClientFileLog,tempString);
+	return runBatch(connection, OP_MGET, table, keys, records, statuses, count);
+}
+
+/**
+ * @brief Sets several records of a table
+ *
+ * @param table A table stored in the database.
+ * @param keys The keys to set
+ * @param records The new records; an empty value deletes the key
+ * @param statuses Where 0 or the error code of each key is stored
+ * @param count The number of keys
+ * @param conn A pointer to the connection structure
+ * @return 0 on success, -1 if otherwise
+ */
+int storage_mset(const char *table, const char **keys, struct storage_record *records, int *statuses, int count, void *conn)
+{
+	Connection *connection = (Connection *)conn;
+	int i;
+
+	if (table == NULL || keys == NULL || records == NULL || statuses == NULL || count < 0 || conn == NULL
+			|| connection->numPending > 0 || !parameterCheck((char *) table)) {
+		errno = ERR_INVALID_PARAM;
+		return -1;
+	}
+	//frames carry any value, the server checks its format
+	for (i = 0; i < count; i++) {
+		if (keys[i] == NULL || !parameterCheck((char *) keys[i]) || memchr(records[i].value, 0, sizeof records[i].value) == NULL
+				|| !(connection->binary || records[i].value[0] == 0 || recordCheck(records[i].value))) {
+			errno = ERR_INVALID_PARAM;
 			return -1;
 		}
-		//Should not get here unless something failed
+	}
+
+	char tempString[MAX_STRING_SIZE];
+	sprintf(tempString, "[LOG] MSET Request Made. Table: %s Keys: %d\n", table, count);
+	logger(ClientFileLog,tempString);
+	return runBatch(connection, OP_MSET, table, keys, records, statuses, count);
+}
+
+/**
+ * @brief Loads a CSV file local to the server into a table
+ *
+ * @param table A table stored in the database.
+ * @param path The file, as the server sees it.
+ * @param conn A pointer to the connection structure
+ * @return The number of records loaded on success, -1 otherwise
+ */
+int storage_load(const char *table, const char *path, void *conn)
+{
+	Connection *connection = (Connection *)conn;
+
+	//a text request ends at a '#' or a newline
+	if (table == NULL || path == NULL || conn == NULL || !parameterCheck((char *) table) || path[0] == 0
+			|| (!connection->binary && strpbrk(path, "#\n") != NULL)) {
+		errno = ERR_INVALID_PARAM;
 		return -1;
+	}
 
+	char buf[MAX_CMD_LEN];
+	Command reply;
+	const char *fields[] = { table, path };
+
+	char tempString[MAX_STRING_SIZE];
+	snprintf(tempString, sizeof tempString, "[LOG] LOAD Request Made. Table: %s File: %s\n", table, path);
+	logger(ClientFileLog,tempString);
+	if (sendRequest(connection, OP_LOAD, 2, fields) != 0 || recvReply(connection, buf, &reply) != 0)
+		return -1;
 
+	char *word = cmd_next(&reply);
+	if (word == NULL || strcmp(word, "SUCCESS") != 0)
+		return replyError(&reply);
+	word = cmd_next(&reply);
+	if (word == NULL) {
+		errno = ERR_UNKNOWN;
+		return -1;
 	}
-		free (predicates);
-		return 0;
+	return atoi(word);
 }
 
 /**
@@ -447,7 +1110,8 @@ int storage_disconnect(void *conn)
 		return -1;
 	}
 
-	int sock = (int)conn;
+	Connection *connection = (Connection *)conn;
+	int sock = connection->sock;
 	// Send some data.
 	/*char buf[MAX_CMD_LEN];
 	char *bufferPointer = buf;
@@ -466,6 +1130,8 @@ int storage_disconnect(void *conn)
 	} else {*/
 		close(sock);
 	//}
+	wb_free(&connection->output);
+	free(connection);
 	return 0;
 }
 
@@ -72,6 +72,28 @@ struct storage_record {
  */
 void* storage_connect(const char *hostname, const int port);
 
+/**
+ * @brief The wire protocols a client can choose at connect time.
+ */
+#define STORAGE_PROTOCOL_TEXT 0		///< '#' separated lines.
+#define STORAGE_PROTOCOL_BINARY 1	///< Length prefixed frames; values may hold '#'.
+
+/**
+ * @brief Establish a connection to the server using a given protocol.
+ *
+ * storage_connect() is the same as passing STORAGE_PROTOCOL_TEXT.
+ *
+ * @param hostname The IP address or hostname of the server.
+ * @param port The TCP port of the server.
+ * @param protocol STORAGE_PROTOCOL_TEXT or STORAGE_PROTOCOL_BINARY.
+ * @return If successful, return a pointer to a data structure that
+ * represents a connection to the server. Otherwise return NULL.
+ *
+ * On error, errno will be set to one of the following, as appropriate: 
+ * ERR_INVALID_PARAM, ERR_CONNECTION_FAIL, or ERR_UNKNOWN.
+ */
+void* storage_connect_protocol(const char *hostname, const int port, const int protocol);
+
 /**
  * @brief Authenticate the client's connection to the server.
  *
@@ -138,7 +160,8 @@ int storage_set(const char *table, const char *key, struct storage_record
  * @param max_keys The size of the keys array.
  * @param conn A connection to the server.
  * @return Return the number of matching keys (which may be more than
- * max_keys) if successful, and -1 otherwise.
+ * max_keys) if successful, and -1 otherwise.  The keys arrive over as
+ * many replies as they need, and are copied into keys as each is read.
  *
  * On error, errno will be set to one of the following, as appropriate: 
  * ERR_INVALID_PARAM, ERR_CONNECTION_FAIL, ERR_TABLE_NOT_FOUND, 
@@ -152,6 +175,182 @@ int storage_set(const char *table, const char *key, struct storage_record
 int storage_query(const char *table, const char *predicates, char **keys, 
 		const int max_keys, void *conn);
 
+/**
+ * @brief Open a cursor over the records of a table that match a query.
+ *
+ * The matching keys are then read a page at a time with storage_query_next;
+ * records set while the cursor is open may or may not be seen, but a key
+ * present throughout is returned at least once.
+ *
+ * @param table A table in the database.
+ * @param predicates A comma separated list of predicates, as for storage_query.
+ * @param conn A connection to the server.
+ * @return Return the id of the cursor if successful, and -1 otherwise.
+ *
+ * On error, errno will be set to one of the following, as appropriate: 
+ * ERR_INVALID_PARAM, ERR_CONNECTION_FAIL, ERR_TABLE_NOT_FOUND, 
+ * ERR_NOT_AUTHENTICATED, or ERR_UNKNOWN.
+ */
+int storage_query_open(const char *table, const char *predicates, void *conn);
+
+/**
+ * @brief Retrieve the next page of keys of a cursor.
+ *
+ * @param cursor A cursor returned by storage_query_open.
+ * @param keys An array of strings with room for at least max_keys keys.
+ * @param max_keys The size of the keys array.
+ * @param conn A connection to the server.
+ * @return Return the number of keys copied if successful, and -1 otherwise.
+ * A count less than max_keys means the cursor is exhausted.
+ *
+ * On error, errno will be set to one of the following, as appropriate: 
+ * ERR_INVALID_PARAM, ERR_CONNECTION_FAIL, ERR_NOT_AUTHENTICATED, or ERR_UNKNOWN.
+ */
+int storage_query_next(int cursor, char **keys, const int max_keys, void *conn);
+
+/**
+ * @brief Release a cursor on the server.
+ *
+ * Cursors still open when the connection closes are released with it.
+ *
+ * @param cursor A cursor returned by storage_query_open.
+ * @param conn A connection to the server.
+ * @return Return 0 if successful, and -1 otherwise.
+ */
+int storage_query_close(int cursor, void *conn);
+
+/**
+ * @brief The max number of keys in one MGET or MSET request.
+ *
+ * storage_mget() and storage_mset() take any number of keys and split
+ * them over several requests.
+ */
+#define MAX_BATCH_KEYS 256
+
+/**
+ * @brief Get several records of a table in one round trip.
+ *
+ * @param table A table in the database.
+ * @param keys The keys to get.
+ * @param records An array with room for count records; the record of
+ * each key found is stored at its index.
+ * @param statuses An array with room for count statuses; 0 is stored for
+ * each key found, otherwise its error code (e.g. ERR_KEY_NOT_FOUND).
+ * @param count The number of keys.
+ * @param conn A connection to the server.
+ * @return Return 0 if a status was stored for each key, and -1 otherwise.
+ *
+ * On error, errno will be set to one of the following, as appropriate: 
+ * ERR_INVALID_PARAM, ERR_CONNECTION_FAIL, or ERR_UNKNOWN.
+ */
+int storage_mget(const char *table, const char **keys, struct storage_record *records, int *statuses, int count, void *conn);
+
+/**
+ * @brief Set several records of a table in one round trip.
+ *
+ * Each record is set as storage_set() would; a record with an empty
+ * value deletes its key.
+ *
+ * @param table A table in the database.
+ * @param keys The keys to set.
+ * @param records The new records, one per key.
+ * @param statuses An array with room for count statuses; 0 is stored for
+ * each record set, otherwise its error code.
+ * @param count The number of keys.
+ * @param conn A connection to the server.
+ * @return Return 0 if a status was stored for each key, and -1 otherwise.
+ *
+ * On error, errno will be set to one of the following, as appropriate: 
+ * ERR_INVALID_PARAM, ERR_CONNECTION_FAIL, or ERR_UNKNOWN.
+ */
+int storage_mset(const char *table, const char **keys, struct storage_record *records, int *statuses, int count, void *conn);
+
+/**
+ * @brief Load a CSV file of "key,value" lines into a table.
+ *
+ * The file is read by the server, so the path is one on the server's
+ * machine. Lines with a bad key, or a value not fitting the table, are
+ * skipped. A load stopped partway by an error on the server keeps the
+ * records it set, and returns their number.
+ *
+ * @param table A table in the database.
+ * @param path The file, as the server sees it.
+ * @param conn A connection to the server.
+ * @return Return the number of records loaded if successful, and -1 otherwise.
+ *
+ * On error, errno will be set to one of the following, as appropriate: 
+ * ERR_INVALID_PARAM, ERR_CONNECTION_FAIL, ERR_TABLE_NOT_FOUND, 
+ * ERR_NOT_AUTHENTICATED, or ERR_UNKNOWN.
+ */
+int storage_load(const char *table, const char *path, void *conn);
+
+/**
+ * @brief The max number of requests submitted on one connection and not
+ * yet collected with storage_poll().
+ */
+#define MAX_PENDING_REQUESTS 1024
+
+/**
+ * @brief The outcome of a request submitted with storage_submit_get() or
+ * storage_submit_set().
+ */
+struct storage_result {
+	/// The id returned when the request was submitted.
+	int id;
+
+	/// 0 if the request succeeded, otherwise its error code.
+	int status;
+
+	/// For a GET, the record that was read.
+	struct storage_record record;
+};
+
+/**
+ * @brief Submit a GET without waiting for the reply.
+ *
+ * Requests submitted on a connection are pipelined: they are sent
+ * together and the server answers them in order. Collect the replies
+ * with storage_poll(); other calls fail with ERR_INVALID_PARAM while
+ * any are pending.
+ *
+ * @param table A table in the database.
+ * @param key A key in the table.
+ * @param conn A connection to the server.
+ * @return Return the id of the request if successful, and -1 otherwise.
+ *
+ * On error, errno will be set to one of the following, as appropriate: 
+ * ERR_INVALID_PARAM (also when MAX_PENDING_REQUESTS are pending),
+ * ERR_CONNECTION_FAIL, or ERR_UNKNOWN.
+ */
+int storage_submit_get(const char *table, const char *key, void *conn);
+
+/**
+ * @brief Submit a SET without waiting for the reply.
+ *
+ * See storage_submit_get(). A NULL record deletes the key.
+ *
+ * @param table A table in the database.
+ * @param key A key in the table.
+ * @param record The new value.
+ * @param conn A connection to the server.
+ * @return Return the id of the request if successful, and -1 otherwise.
+ */
+int storage_submit_set(const char *table, const char *key, struct storage_record *record, void *conn);
+
+/**
+ * @brief Collect the result of the oldest submitted request.
+ *
+ * Sends any submitted requests not written yet first.
+ *
+ * @param conn A connection to the server.
+ * @param result Where the outcome of the request is stored.
+ * @param wait Non-zero to block until the reply arrives.
+ * @return Return 1 if a result was stored, 0 if no request is pending or,
+ * when not waiting, its reply has not arrived yet, and -1 on a connection
+ * error.
+ */
+int storage_poll(void *conn, struct storage_result *result, int wait);
+
 /**
  * @brief Close the connection to the server.
  *
@@ -10,6 +10,7 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <poll.h>
 #include <unistd.h>
 #include <ctype.h>
 #include "utils.h"
@@ -58,6 +59,14 @@ int sendall(const int sock, const char *buf, const size_t len)
 	size_t tosend = len;
 	while (tosend > 0) {
 		ssize_t bytes = send(sock, buf, tosend, 0);
+		if (bytes < 0 && errno == EINTR)
+			continue;
+		if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			// Non-blocking socket with a full send buffer: wait until it drains.
+			struct pollfd pfd = { sock, POLLOUT, 0 };
+			poll(&pfd, 1, -1);
+			continue;
+		}
 		if (bytes <= 0) 
 			break; // send() was not successful, so stop.
 		tosend -= (size_t) bytes;
@@ -109,6 +118,440 @@ int recvline(const int sock, char *buf, const size_t buflen)
 	return status;
 }
 
+/**
+ * @brief Attaches an empty read buffer to a socket.
+ *
+ * @param rb The read buffer owned by the connection
+ * @param sock A socket created by either server or client
+ * @return void
+ */
+void rb_init(ReadBuffer *rb, const int sock)
+{
+	rb->sock = sock;
+	rb->start = 0;
+	rb->end = 0;
+}
+
+/**
+ * @brief Reads whatever the socket has available into the buffer.
+ *
+ * Unread bytes are first moved to the front so the whole free space
+ * can be handed to a single recv() call.
+ *
+ * @param rb The read buffer owned by the connection
+ * @return Number of bytes read, 0 if the peer closed, -1 on error
+ */
+ssize_t rb_fill(ReadBuffer *rb)
+{
+	if (rb->start > 0) {
+		memmove(rb->data, rb->data + rb->start, rb->end - rb->start);
+		rb->end -= rb->start;
+		rb->start = 0;
+	}
+
+	ssize_t bytes;
+	do {
+		bytes = recv(rb->sock, rb->data + rb->end, sizeof rb->data - rb->end, 0);
+	} while (bytes < 0 && errno == EINTR);
+
+	if (bytes > 0)
+		rb->end += (size_t) bytes;
+	return bytes;
+}
+
+/**
+ * @brief Copies the next buffered line out, without touching the socket.
+ *
+ * A line longer than buflen - 1 (or one that fills the whole buffer
+ * without a newline) is handed out in pieces, which matches what
+ * recvline() did for oversized lines.
+ *
+ * @param rb The read buffer owned by the connection
+ * @param buf Where the line is copied, null terminated
+ * @param buflen A size of the buf
+ * @return 1 if a line was copied, 0 if no complete line is buffered
+ */
+int rb_getline(ReadBuffer *rb, char *buf, const size_t buflen)
+{
+	char *first = rb->data + rb->start;
+	size_t avail = rb->end - rb->start;
+	char *newline = memchr(first, '\n', avail);
+	size_t linelen = (newline != NULL) ? (size_t)(newline - first) : avail;
+	bool bufferFull = (rb->start == 0 && rb->end == sizeof rb->data);
+
+	if (newline == NULL && linelen < buflen - 1 && !bufferFull)
+		return 0;
+
+	size_t copylen = linelen < buflen - 1 ? linelen : buflen - 1;
+	memcpy(buf, first, copylen);
+	buf[copylen] = 0;
+
+	rb->start += copylen;
+	if (newline != NULL && copylen == linelen)
+		rb->start += 1; // consume the end of line as well
+
+	if (rb->start == rb->end)
+		rb->start = rb->end = 0;
+	return 1;
+}
+
+/**
+ * @brief Checks whether a complete line is already buffered.
+ *
+ * @param rb The read buffer owned by the connection
+ * @return true if rb_getline() would return a line, false otherwise
+ */
+bool rb_hasLine(const ReadBuffer *rb)
+{
+	if (rb->start == 0 && rb->end == sizeof rb->data)
+		return true;
+	return memchr(rb->data + rb->start, '\n', rb->end - rb->start) != NULL;
+}
+
+/**
+ * @brief Receives a line through the connection's read buffer.
+ *
+ * @param rb The read buffer owned by the connection
+ * @param buf A message sent to either client or server
+ * @param buflen A size of the buf
+ * @return 0 on success, -1 if otherwise
+ */
+int rb_recvline(ReadBuffer *rb, char *buf, const size_t buflen)
+{
+	while (rb_getline(rb, buf, buflen) == 0) {
+		if (rb_fill(rb) <= 0) {
+			// recv() was not successful, so stop.
+			*buf = 0;
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static uint32_t getBigEndian32(const char *p)
+{
+	const unsigned char *u = (const unsigned char *) p;
+	return ((uint32_t) u[0] << 24) | ((uint32_t) u[1] << 16) | ((uint32_t) u[2] << 8) | u[3];
+}
+
+static void putBigEndian32(char *p, const uint32_t value)
+{
+	p[0] = (char) (value >> 24);
+	p[1] = (char) (value >> 16);
+	p[2] = (char) (value >> 8);
+	p[3] = (char) value;
+}
+
+/**
+ * @brief Copies the next buffered frame out, without touching the socket.
+ *
+ * @param rb The read buffer owned by the connection
+ * @param header Where the decoded header is stored
+ * @param buf Where the payload is copied, null terminated; MAX_CMD_LEN bytes
+ * @return 1 if a frame was copied, 0 if no complete frame is buffered,
+ * -1 if the buffered bytes are not a frame
+ */
+int rb_getframe(ReadBuffer *rb, FrameHeader *header, char *buf)
+{
+	const char *first = rb->data + rb->start;
+	size_t avail = rb->end - rb->start;
+
+	if (avail == 0)
+		return 0;
+	if ((unsigned char) first[0] != FRAME_MAGIC)
+		return -1;
+	if (avail < FRAME_HEADER_LEN)
+		return 0;
+
+	uint32_t length = getBigEndian32(first + 8);
+	if (length > MAX_CMD_LEN - FRAME_HEADER_LEN)
+		return -1;
+	if (avail < FRAME_HEADER_LEN + length)
+		return 0;
+
+	header->opcode = (unsigned char) first[1];
+	header->status = (uint16_t) (((unsigned char) first[2] << 8) | (unsigned char) first[3]);
+	header->requestId = getBigEndian32(first + 4);
+	header->length = length;
+	memcpy(buf, first + FRAME_HEADER_LEN, length);
+	buf[length] = 0;
+
+	rb->start += FRAME_HEADER_LEN + length;
+	if (rb->start == rb->end)
+		rb->start = rb->end = 0;
+	return 1;
+}
+
+/**
+ * @brief Checks whether rb_getframe() has something to return.
+ *
+ * @param rb The read buffer owned by the connection
+ * @return true if rb_getframe() would not return 0, false otherwise
+ */
+bool rb_hasFrame(const ReadBuffer *rb)
+{
+	const char *first = rb->data + rb->start;
+	size_t avail = rb->end - rb->start;
+
+	if (avail == 0)
+		return false;
+	if ((unsigned char) first[0] != FRAME_MAGIC)
+		return true;
+	if (avail < FRAME_HEADER_LEN)
+		return false;
+	uint32_t length = getBigEndian32(first + 8);
+	return length > MAX_CMD_LEN - FRAME_HEADER_LEN || avail >= FRAME_HEADER_LEN + length;
+}
+
+/**
+ * @brief Receives a frame through the connection's read buffer.
+ *
+ * @param rb The read buffer owned by the connection
+ * @param header Where the decoded header is stored
+ * @param buf Where the payload is copied, null terminated; MAX_CMD_LEN bytes
+ * @return 0 on success, -1 if otherwise
+ */
+int rb_recvframe(ReadBuffer *rb, FrameHeader *header, char *buf)
+{
+	int status;
+
+	while ((status = rb_getframe(rb, header, buf)) == 0) {
+		if (rb_fill(rb) <= 0)
+			return -1;
+	}
+	return status == 1 ? 0 : -1;
+}
+
+/**
+ * @brief Appends a length prefixed field to a frame.
+ *
+ * @param buf The frame being built
+ * @param used The bytes of buf used so far; updated
+ * @param buflen The size of buf
+ * @param field The bytes of the field
+ * @param len The length of the field
+ * @return 0 on success, -1 if the field does not fit
+ */
+int frame_addField(char *buf, size_t *used, const size_t buflen, const char *field, const size_t len)
+{
+	if (len > buflen || *used + FRAME_FIELD_LEN + len > buflen)
+		return -1;
+	putBigEndian32(buf + *used, (uint32_t) len);
+	memcpy(buf + *used + FRAME_FIELD_LEN, field, len);
+	*used += FRAME_FIELD_LEN + len;
+	return 0;
+}
+
+/**
+ * @brief Fills in the header of a frame.
+ *
+ * @param buf The frame, with its fields already added
+ * @param used The total size of the frame
+ * @param opcode The opcode of the request
+ * @param status 0, or an error code
+ * @param requestId The id of the request
+ * @return void
+ */
+void frame_setHeader(char *buf, const size_t used, const int opcode, const int status, const uint32_t requestId)
+{
+	buf[0] = (char) FRAME_MAGIC;
+	buf[1] = (char) opcode;
+	buf[2] = (char) (status >> 8);
+	buf[3] = (char) status;
+	putBigEndian32(buf + 4, requestId);
+	putBigEndian32(buf + 8, (uint32_t) (used - FRAME_HEADER_LEN));
+}
+
+/**
+ * @brief Starts handing out the fields of a message.
+ *
+ * @param command The field cursor
+ * @param buf The message, split in place
+ * @param len The length of the message
+ * @param binary true for a frame payload, false for a text line
+ * @return void
+ */
+void cmd_init(Command *command, char *buf, const size_t len, const bool binary)
+{
+	command->next = buf;
+	command->end = buf + len;
+	command->binary = binary;
+}
+
+/**
+ * @brief Hands out the next field of a message.
+ *
+ * A binary field is moved over its own length prefix to make room for
+ * the terminating null, so the fields after it are left intact.
+ *
+ * @param command The field cursor
+ * @return The field, or NULL if there are no more
+ */
+char *cmd_next(Command *command)
+{
+	char *field = command->next;
+	size_t avail = (size_t) (command->end - command->next);
+
+	if (command->binary) {
+		if (avail < FRAME_FIELD_LEN)
+			return NULL;
+		uint32_t len = getBigEndian32(field);
+		if (len > avail - FRAME_FIELD_LEN)
+			return NULL;
+		memmove(field, field + FRAME_FIELD_LEN, len);
+		field[len] = 0;
+		command->next += FRAME_FIELD_LEN + len;
+		return field;
+	}
+
+	if (avail == 0)
+		return NULL;
+	char *delimiter = memchr(field, '#', avail);
+	if (delimiter == NULL) {
+		command->next = command->end;
+		return *field != 0 ? field : NULL;
+	}
+	*delimiter = 0;
+	command->next = delimiter + 1;
+	return field;
+}
+
+const char *const commandNames[NUM_OPCODES] = {
+	NULL, "AUTH", "GET", "SET", "QUERY", "QUERY_OPEN", "QUERY_NEXT",
+	"QUERY_CLOSE", "DISCONNECT", "BINARY", "MGET", "MSET", "SNAPSHOT", "LOAD"
+};
+
+/**
+ * @brief Looks up the opcode of a text command.
+ *
+ * @param name The command name
+ * @return The opcode, 0 if the name is unknown
+ */
+int commandOpcode(const char *name)
+{
+	int i;
+
+	if (name == NULL)
+		return 0;
+	for (i = 1; i < NUM_OPCODES; i++) {
+		if (strcmp(commandNames[i], name) == 0)
+			return i;
+	}
+	return 0;
+}
+
+/**
+ * @brief Initializes an empty write buffer.
+ *
+ * @param wb The write buffer owned by the connection
+ * @return void
+ */
+void wb_init(WriteBuffer *wb)
+{
+	wb->data = NULL;
+	wb->start = 0;
+	wb->end = 0;
+	wb->capacity = 0;
+}
+
+/**
+ * @brief Releases the memory held by a write buffer.
+ *
+ * @param wb The write buffer owned by the connection
+ * @return void
+ */
+void wb_free(WriteBuffer *wb)
+{
+	free(wb->data);
+	wb_init(wb);
+}
+
+/**
+ * @brief Queues bytes at the end of a write buffer, growing it if needed.
+ *
+ * @param wb The write buffer owned by the connection
+ * @param buf The bytes to queue
+ * @param len Number of bytes in buf
+ * @return 0 on success, -1 if out of memory
+ */
+int wb_append(WriteBuffer *wb, const char *buf, const size_t len)
+{
+	// Reuse the space in front of the unsent bytes before growing.
+	if (wb->start > 0 && wb->end + len > wb->capacity) {
+		memmove(wb->data, wb->data + wb->start, wb->end - wb->start);
+		wb->end -= wb->start;
+		wb->start = 0;
+	}
+
+	if (wb->end + len > wb->capacity) {
+		size_t capacity = wb->capacity > 0 ? wb->capacity : MAX_CMD_LEN;
+		while (capacity < wb->end + len)
+			capacity *= 2;
+		char *data = realloc(wb->data, capacity);
+		if (data == NULL)
+			return -1;
+		wb->data = data;
+		wb->capacity = capacity;
+	}
+
+	memcpy(wb->data + wb->end, buf, len);
+	wb->end += len;
+	return 0;
+}
+
+/**
+ * @brief Number of queued bytes not yet written to the socket.
+ *
+ * @param wb The write buffer owned by the connection
+ * @return The number of pending bytes
+ */
+size_t wb_pending(const WriteBuffer *wb)
+{
+	return wb->end - wb->start;
+}
+
+/**
+ * @brief Writes the whole buffer, waiting whenever the socket is full.
+ *
+ * @param wb The write buffer owned by the connection
+ * @param sock A blocking or non-blocking socket
+ * @return 0 on success, -1 on error
+ */
+int wb_sendall(WriteBuffer *wb, const int sock)
+{
+	int status;
+
+	while ((status = wb_flush(wb, sock)) == 1) {
+		struct pollfd pfd = { sock, POLLOUT, 0 };
+		poll(&pfd, 1, -1);
+	}
+	return status;
+}
+
+/**
+ * @brief Writes as much of the buffer as the socket accepts.
+ *
+ * @param wb The write buffer owned by the connection
+ * @param sock A non-blocking socket
+ * @return 0 if emptied, 1 if bytes are still pending, -1 on error
+ */
+int wb_flush(WriteBuffer *wb, const int sock)
+{
+	while (wb->start < wb->end) {
+		ssize_t bytes = send(sock, wb->data + wb->start, wb->end - wb->start, MSG_NOSIGNAL);
+		if (bytes < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 1;
+			return -1;
+		}
+		wb->start += (size_t) bytes;
+	}
+	wb->start = wb->end = 0;
+	return 0;
+}
+
 
 /**
  * @brief Parse and process a line in the config file.
@@ -397,7 +840,6 @@ char* getColumnName(char **string)
 
 void delete_char(char *stringS, int i)
 {
-	i =0;
 	if (stringS == NULL)
 		return;
 
@@ -735,110 +1177,135 @@ int isTableNameExist (char *table_name, struct config_params *params) {
 }
 
 /**
- * @brief Check if the input format for "SET" Function from the user is valid. 
+ * @brief Build the typed row layout of a table from its column info.
  *
- * @param inputString string from the user
- * @param params A struct that contains all the config file info
- * @param table_index A table index of the hashtable container
- * @return true if duplicate exists, false if otherwise
+ * @param column_info The columns as stored by the config parser, e.g. "col1#int#col2#char#10#".
+ * @param indexedColumns Bit i set if column i has a secondary index.
+ * @param schema The schema to fill in.
+ * @return true on success, false if a column is too long, too wide or too many.
  */
 
-bool isInputFormatCorrect(char *inputString, struct config_params *params, int table_index) {
-
-	printf("input String %s \n", inputString);
-	bool status = true;
-
-	char *column_info = params->table_names[table_index].column_info;
-	int column_num = params->table_names[table_index].columnNum;
+bool buildSchema(char *column_info, unsigned int indexedColumns, Schema *schema) {
 
-	//a. making it into "//value!1234#dkdj!4848#" format
+	int offset = 0;
+	schema->numColumns = 0;
+	schema->rowSize = 0;
 
-	char *input_new = createMessage(inputString );
-	printf("input String2 %s \n", input_new);
-
-	int i;
-	for (i =0; i<column_num; i++) {
-
-		//b. getting column's id and type
-		char *column_id = getNextWord(&column_info, '#');
+	char *column_id = getNextWord(&column_info, '#');
+	while (column_id != NULL) {
 		char *column_type = getNextWord(&column_info, '#');
-		char * column_char_size = NULL;
-		char * input_column = NULL;
-		char * input_name = NULL;
-
-		//need to make another pointer copy to delete it later
-		char *single_column = getNextWord(&input_new, '#');
-
-		// 1. not enough column info
-		if (single_column == NULL) {
-			status = false;
-		}
+		char *column_size = NULL;
+		bool status = column_type != NULL && schema->numColumns < MAX_COLUMNS_PER_TABLE
+				&& strlen(column_id) <= MAX_COLNAME_LEN;
 
-		// 2. still okay
-		else {
-			//1. checking if the input is char type
-			input_column = single_column;
-			input_name = getNextWord(&input_column, '/');
+		if (status) {
+			Column *column = &schema->columns[schema->numColumns];
+			strcpy(column->name, column_id);
+			column->offset = offset;
+			column->indexed = (indexedColumns >> schema->numColumns) & 1;
 
-			//2. column_type is int && input_type is char -> wrong type
-			if ( input_name != NULL && strcmp(column_type, "int") == 0)  {
-				status = false;
+			if (strcmp(column_type, "char") == 0) {
+				column_size = getNextWord(&column_info, '#');
+				column->type = COLUMN_CHAR;
+				column->size = column_size != NULL ? atoi(column_size) : 0;
+				status = column->size > 0 && column->size <= MAX_STRTYPE_SIZE;
+				offset += (column->size + 1 + 7) / 8 * 8;
+			}
+			else {
+				column->type = COLUMN_INT;
+				column->size = 0;
+				offset += sizeof(int64_t);
 			}
+			schema->numColumns++;
+		}
 
-			//3. checking if the input is int type && column_type is int -> right type
-			else if (input_name == NULL && strcmp(column_type, "int") == 0) {
-	            // 1.a column name is not correct
-	            input_column = single_column;
-	            input_name = getNextWord(&input_column, '!');
-	            printf("input String3 %s \n", input_column);
-	            if (strcmp(column_id, input_name) != 0) {
-	              status = false;
-	            }
-
-	            //checking if the input is right type
-	            printf("input String4 %s \n", input_column);
-	            bool status1 = isWhiteCharacter(input_column);
-	            printf("input String5 %s \n", input_column);
-	            printf("status1 %d", status1);
-	            if (status1 == true) {
-	            	status = false;
-	            }	            
-	            printf("input String6 %s \n", input_column);
+		free(column_id);
+		free(column_type);
+		free(column_size);
+		if (!status)
+			return false;
 
-			}
+		column_id = getNextWord(&column_info, '#');
+	}
 
+	schema->rowSize = offset;
+	return true;
+}
 
-		      // column name is not correct 
-		      else if (strcmp(column_id, input_name) != 0) {
-		              status = false;
-		      }
+/**
+ * @brief Parse a value from a "SET" command into a typed row.
+ *
+ * The value must name every column of the schema, in order, as in
+ * "col1 38, col2 hello". Integers must be whole numbers and strings
+ * must fit their column.
+ *
+ * @param schema The schema of the table.
+ * @param value The value sent by the client.
+ * @param row Filled with schema->rowSize bytes.
+ * @return true if the value matches the schema, false otherwise.
+ */
 
-			//2. checking the string size 
-			//confirmed that the type is char at this point
-			else {
-				column_char_size = getNextWord(&column_info, '#');
-				int column_length = atoi(column_char_size);
-				int input_length = strlen(input_column);
+bool parseRow(Schema *schema, const char *value, char *row) {
 
-				if (input_length > column_length) {
-					//status = false;
-				}
+	const char *field = value;
+	const char *end = value;
+	int i;
 
-				else 
-					printf("correct size type char\n");
-			}
+	memset(row, 0, schema->rowSize);
+	for (i = 0; i < schema->numColumns; i++) {
+		Column *column = &schema->columns[i];
+
+		// 1. not enough columns
+		if (i > 0 && *end != ',')
+			return false;
+
+		end = strchr(field, ',');
+		if (end == NULL)
+			end = field + strlen(field);
+
+		//trimming the field, then splitting it into the name and the value
+		const char *last = end;
+		while (field < last && isspace((unsigned char)*field))
+			field++;
+		while (last > field && isspace((unsigned char)last[-1]))
+			last--;
+		const char *name_end = field;
+		while (name_end < last && !isspace((unsigned char)*name_end))
+			name_end++;
+		const char *data = name_end;
+		while (data < last && isspace((unsigned char)*data))
+			data++;
+		size_t length = last - data;
+
+		// 2. column name is not correct
+		if ((size_t)(name_end - field) != strlen(column->name) || strncmp(field, column->name, name_end - field) != 0)
+			return false;
+
+		// 3. checking the type and size of the value
+		if (column->type == COLUMN_INT) {
+			char number[32];
+			char *p;
+			if (length == 0 || length >= sizeof(number))
+				return false;
+			memcpy(number, data, length);
+			number[length] = '\0';
+			errno = 0;
+			int64_t integer = strtoll(number, &p, 10);
+			if (*p != '\0' || errno != 0)
+				return false;
+			memcpy(row + column->offset, &integer, sizeof(integer));
+		}
+		else {
+			if (length > (size_t)column->size)
+				return false;
+			memcpy(row + column->offset, data, length);
 		}
 
-		//Deallocate all
-		free(column_id);
-		free(column_type);
-		free(column_char_size);
-		free(single_column);
-		free(input_name);
-
+		field = end + 1;
 	}
 
-	return status;
+	// 4. too many columns
+	return *end == '\0';
 }
 
 bool isStringInt (char *testString) {
@@ -909,6 +1376,10 @@ bool isValidColumnIndex (struct config_params *params) {
 			status = false;
 		}
 
+		if (!buildSchema(params->table_names[i].column_info, params->table_names[i].indexedColumns,
+				&params->table_names[i].schema))
+			status = false;
+
 		//checking if there is any duplicate
 		bool isDuplicateColumn = isDuplicateColumnIndex(listString,params->table_names[i].columnNum );
 		if (isDuplicateColumn)
@@ -10,6 +10,8 @@
 #include <stdio.h>
 #include <errno.h>
 #include <stdbool.h>
+#include <sys/types.h>
+#include <stdint.h>
 #include "storage.h"
 #define MAX_STRING_SIZE 800
 #define EXIT -1
@@ -18,15 +20,6 @@
 #define STRINGSYMBOL "/"
 #define INTSYMBOL "!"
 
-/*
-	Enable Usage of Global Variables 
-*/
-//Setup a STRUCT for Arash Select
-typedef struct listOfClients {
-	int sock;
-	bool authenticationStatus;
-}ListOfClients;
-
 /**
  * @brief Any lines in the config file that start with this character 
  * are treated as comments.
@@ -38,6 +31,142 @@ static const char CONFIG_COMMENT_CHAR = '#';
  */
 #define MAX_CMD_LEN (1024 * 8)
 
+/**
+ * @brief Room kept in each QUERY reply line for "SUCCESS#<matches>#" or
+ * "MORE#" and the newline; the keys fill the rest of MAX_CMD_LEN.
+ */
+#define QUERY_PREFIX_LEN 32
+
+/**
+ * @brief A per-connection receive buffer.
+ *
+ * Reads from the socket in large chunks and hands out one line at a
+ * time. Bytes past the end of the current line are kept for the next
+ * call, so each connection must own exactly one ReadBuffer.
+ */
+typedef struct readBuffer {
+	int sock;		///< The socket this buffer reads from.
+	size_t start;		///< Offset of the first unread byte in data.
+	size_t end;		///< Offset one past the last buffered byte.
+	char data[MAX_CMD_LEN];
+}ReadBuffer;
+
+/**
+ * @brief A growable per-connection send buffer.
+ *
+ * Used with non-blocking sockets: replies are appended here and written
+ * out as the socket accepts them, so a short send() never loses bytes.
+ */
+typedef struct writeBuffer {
+	char *data;
+	size_t start;		///< Offset of the first unsent byte in data.
+	size_t end;		///< Offset one past the last queued byte.
+	size_t capacity;	///< Allocated size of data.
+}WriteBuffer;
+
+/**
+ * @brief Command opcodes.
+ *
+ * Binary frames carry the opcode; text lines carry the matching name
+ * from commandNames.
+ */
+#define OP_AUTH 1
+#define OP_GET 2
+#define OP_SET 3
+#define OP_QUERY 4
+#define OP_QUERY_OPEN 5
+#define OP_QUERY_NEXT 6
+#define OP_QUERY_CLOSE 7
+#define OP_DISCONNECT 8
+#define OP_BINARY 9
+#define OP_MGET 10
+#define OP_MSET 11
+#define OP_SNAPSHOT 12
+#define OP_LOAD 13
+#define NUM_OPCODES 14
+
+/**
+ * @brief First byte of every binary frame.
+ */
+#define FRAME_MAGIC 0xB5
+
+/**
+ * @brief Size in bytes of an encoded FrameHeader.
+ */
+#define FRAME_HEADER_LEN 12
+
+/**
+ * @brief Size in bytes of the length in front of each field of a frame.
+ */
+#define FRAME_FIELD_LEN 4
+
+/**
+ * @brief The header of a frame of the binary protocol.
+ *
+ * A client switches to the binary protocol by sending the text line
+ * "BINARY#"; once it is answered, every request and reply is a frame.
+ * On the wire the header is FRAME_HEADER_LEN bytes: magic, opcode and
+ * status, then the request id and the payload length, all big endian.
+ * The payload is a run of fields, each a FRAME_FIELD_LEN byte length
+ * followed by that many raw bytes. Requests have the fields of the text
+ * command; replies have the words of the text reply, so a value may
+ * hold any byte but '\0'. A whole frame fits in MAX_CMD_LEN.
+ */
+typedef struct frameHeader {
+	uint8_t opcode;
+	uint16_t status;	///< 0, or the error code of a failed reply.
+	uint32_t requestId;	///< Chosen by the client, echoed by the reply.
+	uint32_t length;	///< Bytes of payload after the header.
+}FrameHeader;
+
+/**
+ * @brief The fields of a request or reply, split in place.
+ *
+ * Fields are handed out one at a time by cmd_next(), null terminated
+ * inside the buffer they came in, so reading them allocates nothing.
+ */
+typedef struct command {
+	char *next;		///< The first byte not handed out yet.
+	char *end;		///< One past the last byte of the message.
+	bool binary;		///< Length prefixed fields instead of '#' separated.
+}Command;
+
+/**
+ * @brief The max number of QUERY_OPEN cursors a client may hold.
+ */
+#define MAX_CURSORS 8
+
+/**
+ * @brief The max number of keys a QUERY_NEXT page may ask for.
+ */
+#define MAX_PAGE_KEYS 100000
+
+/**
+ * @brief The state of one client connection.
+ *
+ * Every command handler works on the session of the client that sent
+ * the command, so connections served by different threads never share
+ * authentication state or reply buffers.
+ */
+typedef struct session {
+	int sock;
+	bool authenticationStatus;
+	ReadBuffer readBuffer;
+	/// If not NULL, replies are queued here instead of sent right away.
+	WriteBuffer *output;
+	/// The reply being built; reused for every command.
+	char message[MAX_CMD_LEN];
+	/// Open query cursors, by id; NULL if the id is free.
+	struct queryCursor *cursors[MAX_CURSORS];
+	/// The client sends frames instead of text lines.
+	bool binary;
+	/// The header of the frame being served, in binary mode.
+	FrameHeader frame;
+	/// The end of this session's changes in the write-ahead log; they are
+	/// committed before the replies to them are written.
+	uint64_t walPosition;
+}Session;
+
 /**
  * @brief A macro to log some information.
  *
@@ -84,10 +213,44 @@ struct config_params {
 };
 */
 
+#define COLUMN_INT 0	///< A column of integers, stored in a row as an int64_t.
+#define COLUMN_CHAR 1	///< A column of strings, stored in a row as char[size + 1].
+
+/**
+ * @brief Maximum bytes of a row: every column a padded char[MAX_STRTYPE_SIZE + 1].
+ */
+#define MAX_ROW_SIZE (MAX_COLUMNS_PER_TABLE * (MAX_STRTYPE_SIZE + 8))
+
+/**
+ * @brief A column of a table and where its field lives in a row.
+ */
+typedef struct column {
+	char name[MAX_COLNAME_LEN + 1];
+	int type;		///< COLUMN_INT or COLUMN_CHAR.
+	int size;		///< For COLUMN_CHAR, the maximum length of a value.
+	int offset;		///< Offset of the field in a row; multiple of 8.
+	bool indexed;		///< Whether the column has a secondary index.
+}Column;
+
+/**
+ * @brief The typed layout of the records of a table.
+ *
+ * A row holds one field per column, in column order, each starting on
+ * an 8 byte boundary. A schema with no columns means the table's
+ * records are stored untyped.
+ */
+typedef struct schema {
+	int numColumns;
+	int rowSize;		///< Bytes in a row.
+	Column columns[MAX_COLUMNS_PER_TABLE];
+}Schema;
+
 struct table {
 	char tablename[MAX_STRING_SIZE];
 	char column_info[MAX_STRING_SIZE];\
 	char columnNum;
+	unsigned int indexedColumns;	///< Bit i is set if column i is declared "indexed".
+	Schema schema;		///< Parsed from column_info by isValidColumnIndex().
 };
  
 
@@ -127,8 +290,16 @@ struct config_params {
 	//store number of tables
 	int table_number;
 	int concurrencyMode;
-//	char data_directory[MAX_PATH_LEN];
-	bool authorized;
+	/// Number of event loops for the reactor mode; 0 means one per CPU.
+	int workerThreads;
+	/// Records from which a QUERY without an index scans on several threads; 0 never.
+	int parallelScanThreshold;
+	/// The directory of the write-ahead log; empty to keep the tables in memory only.
+	char data_directory[MAX_PATH_LEN];
+	/// How durable a SET is once replied to: WAL_SYNC_NONE, WAL_SYNC_COMMIT or a sync period in milliseconds.
+	int durability;
+	/// Seconds between snapshots of the tables to the data directory; 0 only on SNAPSHOT.
+	int snapshotInterval;
 };
 
 
@@ -158,6 +329,140 @@ int sendall(const int sock, const char *buf, const size_t len);
  */
 int recvline(const int sock, char *buf, const size_t buflen);
 
+/**
+ * @brief Attach an empty read buffer to a socket.
+ */
+void rb_init(ReadBuffer *rb, const int sock);
+
+/**
+ * @brief Read once from the socket into the free space of the buffer.
+ * @return Return the number of bytes read, 0 if the peer closed the
+ * connection, -1 on error (errno is left as set by recv()).
+ */
+ssize_t rb_fill(ReadBuffer *rb);
+
+/**
+ * @brief Take the next complete line out of the buffer without reading
+ * from the socket.
+ * @return Return 1 if a line was copied into buf, 0 otherwise.
+ *
+ * A line that does not fit in buflen is split, like recvline() does.
+ */
+int rb_getline(ReadBuffer *rb, char *buf, const size_t buflen);
+
+/**
+ * @brief Check whether a complete line is already buffered.
+ */
+bool rb_hasLine(const ReadBuffer *rb);
+
+/**
+ * @brief Receive an entire line through a read buffer.
+ * @return Return 0 on success, -1 otherwise.
+ *
+ * Same contract as recvline(), but reads as many bytes as are available
+ * per recv() call instead of one.
+ */
+int rb_recvline(ReadBuffer *rb, char *buf, const size_t buflen);
+
+/**
+ * @brief Take the next complete frame out of the buffer without reading
+ * from the socket.
+ * @return Return 1 if the payload was copied into buf and null
+ * terminated, 0 if no complete frame is buffered, -1 if the bytes are
+ * not a valid frame.
+ *
+ * buf must hold MAX_CMD_LEN bytes.
+ */
+int rb_getframe(ReadBuffer *rb, FrameHeader *header, char *buf);
+
+/**
+ * @brief Check whether a complete (or invalid) frame is already buffered.
+ */
+bool rb_hasFrame(const ReadBuffer *rb);
+
+/**
+ * @brief Receive an entire frame through a read buffer.
+ * @return Return 0 on success, -1 otherwise.
+ */
+int rb_recvframe(ReadBuffer *rb, FrameHeader *header, char *buf);
+
+/**
+ * @brief Append a field to a frame being built in buf.
+ * @return Return 0 on success, -1 if the frame would not fit in buflen.
+ *
+ * *used starts at FRAME_HEADER_LEN, leaving room for frame_setHeader().
+ */
+int frame_addField(char *buf, size_t *used, const size_t buflen, const char *field, const size_t len);
+
+/**
+ * @brief Write the header of a frame of used bytes at the start of buf.
+ */
+void frame_setHeader(char *buf, const size_t used, const int opcode, const int status, const uint32_t requestId);
+
+/**
+ * @brief Start handing out the fields of a message.
+ *
+ * @param command The field cursor to set up.
+ * @param buf The message; it is modified in place.
+ * @param len The length of the message.
+ * @param binary Whether the message is a frame payload or a text line.
+ */
+void cmd_init(Command *command, char *buf, const size_t len, const bool binary);
+
+/**
+ * @brief Get the next field of a message.
+ * @return Return the field, null terminated, or NULL if there is none.
+ *
+ * Text fields end at a '#'; a last field without one is kept if it is
+ * not empty.
+ */
+char *cmd_next(Command *command);
+
+/**
+ * @brief The text name of each opcode, NULL for unused ones.
+ */
+extern const char *const commandNames[NUM_OPCODES];
+
+/**
+ * @brief Look up the opcode of a text command name.
+ * @return Return the opcode, or 0 if the name is unknown.
+ */
+int commandOpcode(const char *name);
+
+/**
+ * @brief Initialize an empty write buffer.
+ */
+void wb_init(WriteBuffer *wb);
+
+/**
+ * @brief Release the memory held by a write buffer.
+ */
+void wb_free(WriteBuffer *wb);
+
+/**
+ * @brief Queue bytes at the end of a write buffer.
+ * @return Return 0 on success, -1 if out of memory.
+ */
+int wb_append(WriteBuffer *wb, const char *buf, const size_t len);
+
+/**
+ * @brief Number of queued bytes not yet written to the socket.
+ */
+size_t wb_pending(const WriteBuffer *wb);
+
+/**
+ * @brief Write as much of the buffer as a non-blocking socket accepts.
+ * @return Return 0 if the buffer was emptied, 1 if bytes are still
+ * pending because the socket would block, -1 on error.
+ */
+int wb_flush(WriteBuffer *wb, const int sock);
+
+/**
+ * @brief Write the whole buffer, waiting for the socket when it is full.
+ * @return Return 0 on success, -1 on error.
+ */
+int wb_sendall(WriteBuffer *wb, const int sock);
+
 /**
  * @brief Read and load configuration parameters.
  *
@@ -195,12 +500,15 @@ void logger(FILE *file,char* message);
 char *generate_encrypted_password(const char *passwd, const char *salt);
 char *getNextWord(char**word, char delimeter);
 int isTableNameExist (char *table_name, struct config_params *params);
-bool isInputFormatCorrect(char *input_string, struct config_params *params, int table_index);
+bool buildSchema(char *column_info, unsigned int indexedColumns, Schema *schema);
+bool parseRow(Schema *schema, const char *value, char *row);
 bool isStringInt (char *testString);
 bool isValidColumnIndex (struct config_params *params);
 bool isDuplicateColumnIndex (char** input, int length);
 void freeAllList (char ** input, int length);
 int isPredicateValid(Predicate* predicates, struct config_params *params, int table_index, int numPredicates);
+int getNumPredicates(char *predicates);
+Predicate* createPredicateList (int numPredicates, char* predicate);
 
 
 //Justin
@@ -0,0 +1,418 @@
+/**
+ * @file
+ * @brief This file implements the write-ahead log of the storage server.
+ *
+ * Each record is a header of two big endian 32 bit words, the length and
+ * the CRC-32 of the body, then the body: the type byte, the version as a
+ * big endian 64 bit word, and the table, key and value, each ended by a
+ * '\0'.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <dirent.h>
+#include "wal.h"
+
+#define WAL_HEADER_LEN 8		///< The length and checksum words.
+#define WAL_FIXED_LEN 9			///< The type byte and the version.
+#define WAL_MAX_RECORD (1024 * 1024)	///< Longer bodies are taken as corruption.
+#define WAL_MIN_BUFFER 4096
+
+static uint32_t crcTable[256];
+static pthread_once_t crcOnce = PTHREAD_ONCE_INIT;
+
+static void crcInit(void)
+{
+	uint32_t i;
+	int bit;
+
+	for (i = 0; i < 256; i++) {
+		uint32_t c = i;
+		for (bit = 0; bit < 8; bit++)
+			c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+		crcTable[i] = c;
+	}
+}
+
+uint32_t wal_crc32(uint32_t crc, const char *data, size_t len)
+{
+	uint32_t c = crc ^ 0xFFFFFFFFu;
+	size_t i;
+
+	pthread_once(&crcOnce, crcInit);
+	for (i = 0; i < len; i++)
+		c = crcTable[(c ^ (unsigned char) data[i]) & 0xFF] ^ (c >> 8);
+	return c ^ 0xFFFFFFFFu;
+}
+
+static void putWord(char *p, uint64_t value, int bytes)
+{
+	int i;
+
+	for (i = bytes - 1; i >= 0; i--) {
+		p[i] = (char) (value & 0xFF);
+		value >>= 8;
+	}
+}
+
+static uint64_t getWord(const char *p, int bytes)
+{
+	uint64_t value = 0;
+	int i;
+
+	for (i = 0; i < bytes; i++)
+		value = (value << 8) | (unsigned char) p[i];
+	return value;
+}
+
+/**
+ * @brief Write all of a buffer, retrying short writes.
+ *
+ * @return Returns 0 on success, -1 otherwise.
+ */
+static int writeAll(int fd, const char *data, size_t len)
+{
+	while (len > 0) {
+		ssize_t bytes = write(fd, data, len);
+		if (bytes < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		data += bytes;
+		len -= (size_t) bytes;
+	}
+	return 0;
+}
+
+/**
+ * @brief Replay the records of a log file.
+ *
+ * @param fd The log file, at its start.
+ * @param apply Called with each record.
+ * @param arg Passed to apply.
+ * @return Returns the bytes of whole records, or -1 if apply failed.
+ */
+static off_t replay(int fd, WalApply apply, void *arg)
+{
+	int copy = dup(fd);
+	FILE *f = copy >= 0 ? fdopen(copy, "rb") : NULL;
+	char header[WAL_HEADER_LEN];
+	char *body = NULL;
+	off_t valid = 0;
+
+	if (f == NULL) {
+		if (copy >= 0)
+			close(copy);
+		return -1;
+	}
+
+	while (fread(header, 1, WAL_HEADER_LEN, f) == WAL_HEADER_LEN) {
+		uint32_t len = (uint32_t) getWord(header, 4);
+		if (len < WAL_FIXED_LEN + 3 || len > WAL_MAX_RECORD)
+			break;
+		char *grown = (char *) realloc(body, len);
+		if (grown == NULL) {
+			valid = -1;
+			break;
+		}
+		body = grown;
+		if (fread(body, 1, len, f) != len || wal_crc32(0, body, len) != (uint32_t) getWord(header + 4, 4))
+			break;
+
+		//the table, key and value, each ended by a '\0'
+		WalRecord record;
+		const char *end = body + len;
+		const char *p = body + WAL_FIXED_LEN;
+		const char *fields[3];
+		int i;
+		for (i = 0; i < 3 && p < end; i++) {
+			const char *nul = (const char *) memchr(p, 0, (size_t) (end - p));
+			if (nul == NULL)
+				break;
+			fields[i] = p;
+			p = nul + 1;
+		}
+		if (i < 3 || p != end)
+			break;
+
+		record.type = (unsigned char) body[0];
+		record.version = getWord(body + 1, 8);
+		record.table = fields[0];
+		record.key = fields[1];
+		record.value = fields[2];
+		if (apply(&record, arg) != 0) {
+			valid = -1;
+			break;
+		}
+		valid += WAL_HEADER_LEN + len;
+	}
+
+	free(body);
+	fclose(f);
+	return valid;
+}
+
+/**
+ * @brief Write out the appended records; the caller holds the lock and
+ * no flush is running.
+ *
+ * The lock is released while writing and syncing.
+ *
+ * @param wal The log.
+ * @param sync Whether to sync the file after writing.
+ */
+static void flushLocked(Wal *wal, bool sync)
+{
+	char *data = wal->buffer;
+	size_t len = wal->used;
+	size_t capacity = wal->capacity;
+	uint64_t end = wal->appended;
+
+	wal->buffer = wal->spare;
+	wal->capacity = wal->spareCapacity;
+	wal->used = 0;
+	wal->spare = NULL;
+	wal->spareCapacity = 0;
+	wal->flushing = true;
+	pthread_mutex_unlock(&wal->lock);
+
+	int status = writeAll(wal->fd, data, len);
+	if (status == 0 && sync)
+		status = fdatasync(wal->fd);
+
+	pthread_mutex_lock(&wal->lock);
+	wal->spare = data;
+	wal->spareCapacity = capacity;
+	wal->flushing = false;
+	if (status == 0)
+		wal->durable = end;
+	else
+		wal->failed = true;
+	pthread_cond_broadcast(&wal->written);
+}
+
+/**
+ * @brief Start routine of the thread syncing the log every period.
+ */
+static void *syncThread(void *arg)
+{
+	Wal *wal = (Wal *) arg;
+	struct timespec deadline;
+
+	pthread_mutex_lock(&wal->lock);
+	while (!wal->stop) {
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += wal->durability / 1000;
+		deadline.tv_nsec += (long) (wal->durability % 1000) * 1000000;
+		if (deadline.tv_nsec >= 1000000000) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+		pthread_cond_timedwait(&wal->wake, &wal->lock, &deadline);
+		if (wal->used > 0 && !wal->flushing)
+			flushLocked(wal, true);
+	}
+	pthread_mutex_unlock(&wal->lock);
+	return NULL;
+}
+
+/**
+ * @brief Sync a directory, so the files created in it are kept.
+ */
+static void syncDirectory(const char *directory)
+{
+	int fd = open(directory, O_RDONLY);
+
+	if (fd >= 0) {
+		fsync(fd);
+		close(fd);
+	}
+}
+
+void wal_removeBefore(const char *directory, uint32_t generation)
+{
+	DIR *dir = opendir(directory);
+	struct dirent *file;
+	char path[WAL_MAX_PATH + 32];
+	unsigned int g;
+	char end;
+
+	if (dir == NULL)
+		return;
+	while ((file = readdir(dir)) != NULL) {
+		if (sscanf(file->d_name, "wal.%u.lo%c", &g, &end) == 2 && end == 'g' && g < generation) {
+			snprintf(path, sizeof path, WAL_FILE_FORMAT, directory, g);
+			unlink(path);
+		}
+	}
+	closedir(dir);
+}
+
+Wal *wal_open(const char *directory, uint32_t generation, int durability, WalApply apply, void *arg)
+{
+	char path[WAL_MAX_PATH + 32];
+
+	if (strlen(directory) >= WAL_MAX_PATH)
+		return NULL;
+	Wal *wal = (Wal *) calloc(1, sizeof(Wal));
+	if (wal == NULL)
+		return NULL;
+	strcpy(wal->directory, directory);
+	wal_removeBefore(directory, generation);
+
+	//replay each generation in turn, and append to the last one
+	wal->generation = generation;
+	for (;;) {
+		snprintf(path, sizeof path, WAL_FILE_FORMAT, directory, wal->generation);
+		wal->fd = open(path, O_RDWR | O_CREAT, 0644);
+		if (wal->fd < 0) {
+			free(wal);
+			return NULL;
+		}
+
+		//keep the whole records; a crash may have cut the last one short
+		off_t valid = replay(wal->fd, apply, arg);
+		if (valid < 0 || ftruncate(wal->fd, valid) != 0 || lseek(wal->fd, valid, SEEK_SET) != valid) {
+			close(wal->fd);
+			free(wal);
+			return NULL;
+		}
+		snprintf(path, sizeof path, WAL_FILE_FORMAT, directory, wal->generation + 1);
+		if (access(path, F_OK) != 0)
+			break;
+		close(wal->fd);
+		wal->generation++;
+	}
+	syncDirectory(directory);
+
+	wal->durability = durability;
+	pthread_mutex_init(&wal->lock, NULL);
+	pthread_cond_init(&wal->written, NULL);
+	pthread_cond_init(&wal->wake, NULL);
+	if (durability > 0) {
+		if (pthread_create(&wal->thread, NULL, syncThread, wal) != 0) {
+			wal_close(wal);
+			return NULL;
+		}
+		wal->hasThread = true;
+	}
+	return wal;
+}
+
+void wal_lock(Wal *wal)
+{
+	pthread_mutex_lock(&wal->lock);
+}
+
+void wal_unlock(Wal *wal)
+{
+	pthread_mutex_unlock(&wal->lock);
+}
+
+uint64_t wal_append(Wal *wal, const WalRecord *record)
+{
+	size_t tableLen = strlen(record->table) + 1;
+	size_t keyLen = strlen(record->key) + 1;
+	size_t valueLen = strlen(record->value) + 1;
+	size_t len = WAL_FIXED_LEN + tableLen + keyLen + valueLen;
+
+	if (len > WAL_MAX_RECORD)
+		return 0;
+	if (wal->used + WAL_HEADER_LEN + len > wal->capacity) {
+		size_t capacity = wal->capacity > 0 ? wal->capacity : WAL_MIN_BUFFER;
+		while (capacity < wal->used + WAL_HEADER_LEN + len)
+			capacity *= 2;
+		char *grown = (char *) realloc(wal->buffer, capacity);
+		if (grown == NULL)
+			return 0;
+		wal->buffer = grown;
+		wal->capacity = capacity;
+	}
+
+	char *p = wal->buffer + wal->used;
+	char *body = p + WAL_HEADER_LEN;
+	body[0] = (char) record->type;
+	putWord(body + 1, record->version, 8);
+	memcpy(body + WAL_FIXED_LEN, record->table, tableLen);
+	memcpy(body + WAL_FIXED_LEN + tableLen, record->key, keyLen);
+	memcpy(body + WAL_FIXED_LEN + tableLen + keyLen, record->value, valueLen);
+	putWord(p, len, 4);
+	putWord(p + 4, wal_crc32(0, body, len), 4);
+
+	wal->used += WAL_HEADER_LEN + len;
+	wal->appended += WAL_HEADER_LEN + len;
+	return wal->appended;
+}
+
+uint32_t wal_rotate(Wal *wal)
+{
+	char path[WAL_MAX_PATH + 32];
+
+	while (wal->flushing)
+		pthread_cond_wait(&wal->written, &wal->lock);
+	if (wal->failed || writeAll(wal->fd, wal->buffer, wal->used) != 0 || fdatasync(wal->fd) != 0) {
+		wal->failed = true;
+		return 0;
+	}
+	wal->used = 0;
+	wal->durable = wal->appended;
+	pthread_cond_broadcast(&wal->written);
+
+	snprintf(path, sizeof path, WAL_FILE_FORMAT, wal->directory, wal->generation + 1);
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return 0;
+	syncDirectory(wal->directory);
+	close(wal->fd);
+	wal->fd = fd;
+	return ++wal->generation;
+}
+
+int wal_commit(Wal *wal, uint64_t position)
+{
+	int status;
+
+	pthread_mutex_lock(&wal->lock);
+	if (wal->durability <= 0) {
+		//the first writer to find no flush running writes for everyone waiting
+		while (!wal->failed && wal->durable < position) {
+			if (wal->flushing)
+				pthread_cond_wait(&wal->written, &wal->lock);
+			else
+				flushLocked(wal, wal->durability == WAL_SYNC_COMMIT);
+		}
+	}
+	status = wal->failed ? -1 : 0;
+	pthread_mutex_unlock(&wal->lock);
+	return status;
+}
+
+void wal_close(Wal *wal)
+{
+	pthread_mutex_lock(&wal->lock);
+	wal->stop = true;
+	pthread_cond_signal(&wal->wake);
+	pthread_mutex_unlock(&wal->lock);
+	if (wal->hasThread)
+		pthread_join(wal->thread, NULL);
+
+	pthread_mutex_lock(&wal->lock);
+	while (wal->flushing)
+		pthread_cond_wait(&wal->written, &wal->lock);
+	if (wal->used > 0)
+		flushLocked(wal, wal->durability != WAL_SYNC_NONE);
+	pthread_mutex_unlock(&wal->lock);
+
+	close(wal->fd);
+	pthread_mutex_destroy(&wal->lock);
+	pthread_cond_destroy(&wal->written);
+	pthread_cond_destroy(&wal->wake);
+	free(wal->buffer);
+	free(wal->spare);
+	free(wal);
+}
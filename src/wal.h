@@ -0,0 +1,176 @@
+/**
+ * @file
+ * @brief This file declares the write-ahead log of the storage server.
+ *
+ * Every SET and DELETE applied to a table is appended to a log file,
+ * which is replayed into the tables when the server starts. Writers that
+ * commit together share one write and one fsync (group commit).
+ *
+ * The log is a series of files, wal.<generation>.log. Taking a snapshot
+ * starts the next generation; once the snapshot is written, the files
+ * before it are removed.
+ */
+#ifndef WAL_H
+#define WAL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define WAL_SYNC_NONE -1	///< Commits are written to the file but never synced.
+#define WAL_SYNC_COMMIT 0	///< Each commit waits for its records to be synced.
+/* A durability above 0 syncs the log every that many milliseconds. */
+
+#define WAL_SET 1		///< A record was set to a value.
+#define WAL_DELETE 2		///< A record was deleted.
+
+#define WAL_FILE_FORMAT "%s/wal.%u.log"	///< A log file: the data directory and the generation.
+#define WAL_MAX_PATH 512
+
+/**
+ * @brief One change to a table, as appended to and replayed from the log.
+ */
+typedef struct walRecord {
+	int type;		///< WAL_SET or WAL_DELETE.
+	uint64_t version;	///< The version of the record after a WAL_SET.
+	const char *table;
+	const char *key;
+	const char *value;	///< The new value of a WAL_SET, "" for a WAL_DELETE.
+} WalRecord;
+
+/**
+ * @brief Applies a replayed record to the tables.
+ *
+ * @return Returns 0 on success, -1 to stop the replay.
+ */
+typedef int (*WalApply)(const WalRecord *record, void *arg);
+
+/**
+ * @brief An open log and the records not yet written to it.
+ *
+ * Records are appended to buffer. A committing writer becomes the leader
+ * if no flush is running: it swaps buffer with spare, then writes and
+ * syncs the swapped out records without holding the lock. Writers that
+ * commit meanwhile wait for the flush, and the next leader takes all
+ * their records at once.
+ */
+typedef struct wal {
+	char directory[WAL_MAX_PATH];
+	uint32_t generation;	///< The generation of the file appended to.
+	int fd;
+	int durability;		///< WAL_SYNC_NONE, WAL_SYNC_COMMIT or a sync period in milliseconds.
+
+	pthread_mutex_t lock;
+	pthread_cond_t written;	///< Signalled after each flush.
+	pthread_cond_t wake;	///< Wakes the sync thread to stop.
+
+	char *buffer;		///< Records appended and not yet flushed.
+	size_t used;
+	size_t capacity;
+	char *spare;		///< The buffer being flushed, or the next one to use.
+	size_t spareCapacity;
+
+	uint64_t appended;	///< Bytes appended since the log was opened.
+	uint64_t durable;	///< Bytes of those flushed, and synced unless WAL_SYNC_NONE.
+	bool flushing;
+	bool failed;		///< A write or sync failed; later commits fail too.
+
+	bool stop;
+	bool hasThread;
+	pthread_t thread;	///< Syncs the log when durability is a period.
+} Wal;
+
+/**
+ * @brief Open a log, replaying the records it holds.
+ *
+ * The files from the given generation on are replayed in order, and the
+ * last one is appended to; it is created if there is none. A record cut
+ * short or corrupted by a crash ends the replay of its file, and the
+ * file is truncated before it. Files of earlier generations are removed.
+ *
+ * @param directory The directory of the log files.
+ * @param generation The first generation to replay.
+ * @param durability WAL_SYNC_NONE, WAL_SYNC_COMMIT or a sync period in milliseconds.
+ * @param apply Called with each record in the log, in order.
+ * @param arg Passed to apply.
+ * @return Returns the log, or NULL on error.
+ */
+Wal *wal_open(const char *directory, uint32_t generation, int durability, WalApply apply, void *arg);
+
+/**
+ * @brief Take the lock of the records not yet written.
+ *
+ * It is held just to append or rotate. Writers append the change to a
+ * record under the record's own lock, before making it, so the log has
+ * the changes to a key in the order they were made.
+ *
+ * @param wal The log.
+ */
+void wal_lock(Wal *wal);
+
+/**
+ * @brief Release the lock taken by wal_lock().
+ *
+ * @param wal The log.
+ */
+void wal_unlock(Wal *wal);
+
+/**
+ * @brief Append a record; the caller holds the lock.
+ *
+ * @param wal The log.
+ * @param record The record.
+ * @return Returns the position to pass to wal_commit(), or 0 on error.
+ */
+uint64_t wal_append(Wal *wal, const WalRecord *record);
+
+/**
+ * @brief Make the records appended up to a position as durable as the
+ * log is configured to; the caller does not hold the lock.
+ *
+ * With WAL_SYNC_COMMIT this waits for the records to be synced; with a
+ * sync period it returns at once.
+ *
+ * @param wal The log.
+ * @param position A position returned by wal_append().
+ * @return Returns 0 on success, -1 if the log could not be written.
+ */
+int wal_commit(Wal *wal, uint64_t position);
+
+/**
+ * @brief Start the next generation; the caller holds the lock.
+ *
+ * The records appended so far are written and synced to the current
+ * file first, so it holds every change applied before the call.
+ *
+ * @param wal The log.
+ * @return Returns the new generation, or 0 on error.
+ */
+uint32_t wal_rotate(Wal *wal);
+
+/**
+ * @brief Remove the files of the generations before a given one.
+ *
+ * @param directory The directory of the log files.
+ * @param generation The first generation to keep.
+ */
+void wal_removeBefore(const char *directory, uint32_t generation);
+
+/**
+ * @brief Compute the CRC-32 of some bytes, continuing from an earlier one.
+ *
+ * @param crc 0, or the CRC-32 of the bytes before.
+ * @param data The bytes.
+ * @param len The number of bytes.
+ * @return Returns the CRC-32 of all the bytes.
+ */
+uint32_t wal_crc32(uint32_t crc, const char *data, size_t len);
+
+/**
+ * @brief Flush and sync the records appended, then close the log.
+ *
+ * @param wal The log.
+ */
+void wal_close(Wal *wal);
+
+#endif
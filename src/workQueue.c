@@ -0,0 +1,113 @@
+/**
+ * @file
+ * @brief This file implements the worker pool used by the storage server.
+ */
+#include <stdlib.h>
+#include "workQueue.h"
+
+/**
+ * @brief Start routine of a worker thread.
+ *
+ * Runs jobs until the queue is shut down and empty.
+ */
+static void *wq_worker(void *arg)
+{
+	WorkQueue *queue = (WorkQueue *)arg;
+
+	for (;;) {
+		pthread_mutex_lock(&queue->lock);
+		while (queue->count == 0 && !queue->shutdown)
+			pthread_cond_wait(&queue->notEmpty, &queue->lock);
+		if (queue->count == 0) {
+			pthread_mutex_unlock(&queue->lock);
+			return NULL;
+		}
+
+		Job job = queue->jobs[queue->head];
+		queue->head = (queue->head + 1) % queue->capacity;
+		queue->count--;
+		pthread_cond_signal(&queue->notFull);
+		pthread_mutex_unlock(&queue->lock);
+
+		job.run(job.arg);
+	}
+}
+
+WorkQueue *wq_create(int numWorkers, int capacity)
+{
+	if (numWorkers <= 0 || capacity <= 0)
+		return NULL;
+
+	WorkQueue *queue = (WorkQueue *)malloc(sizeof(WorkQueue));
+	if (queue == NULL)
+		return NULL;
+	queue->jobs = (Job *)malloc(sizeof(Job) * capacity);
+	queue->workers = (pthread_t *)malloc(sizeof(pthread_t) * numWorkers);
+	if (queue->jobs == NULL || queue->workers == NULL) {
+		free(queue->jobs);
+		free(queue->workers);
+		free(queue);
+		return NULL;
+	}
+
+	queue->capacity = capacity;
+	queue->head = 0;
+	queue->count = 0;
+	queue->shutdown = false;
+	pthread_mutex_init(&queue->lock, NULL);
+	pthread_cond_init(&queue->notEmpty, NULL);
+	pthread_cond_init(&queue->notFull, NULL);
+
+	queue->numWorkers = 0;
+	int i;
+	for (i = 0; i < numWorkers; i++) {
+		if (pthread_create(&queue->workers[i], NULL, wq_worker, queue) != 0)
+			break;
+		queue->numWorkers++;
+	}
+	if (queue->numWorkers == 0) {
+		wq_destroy(queue);
+		return NULL;
+	}
+
+	return queue;
+}
+
+int wq_push(WorkQueue *queue, void (*run)(void *arg), void *arg)
+{
+	pthread_mutex_lock(&queue->lock);
+	while (queue->count == queue->capacity && !queue->shutdown)
+		pthread_cond_wait(&queue->notFull, &queue->lock);
+	if (queue->shutdown) {
+		pthread_mutex_unlock(&queue->lock);
+		return -1;
+	}
+
+	int tail = (queue->head + queue->count) % queue->capacity;
+	queue->jobs[tail].run = run;
+	queue->jobs[tail].arg = arg;
+	queue->count++;
+	pthread_cond_signal(&queue->notEmpty);
+	pthread_mutex_unlock(&queue->lock);
+	return 0;
+}
+
+void wq_destroy(WorkQueue *queue)
+{
+	pthread_mutex_lock(&queue->lock);
+	queue->shutdown = true;
+	pthread_cond_broadcast(&queue->notEmpty);
+	pthread_cond_broadcast(&queue->notFull);
+	pthread_mutex_unlock(&queue->lock);
+
+	int i;
+	for (i = 0; i < queue->numWorkers; i++)
+		pthread_join(queue->workers[i], NULL);
+
+	pthread_mutex_destroy(&queue->lock);
+	pthread_cond_destroy(&queue->notEmpty);
+	pthread_cond_destroy(&queue->notFull);
+	free(queue->jobs);
+	free(queue->workers);
+	free(queue);
+}
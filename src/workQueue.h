@@ -0,0 +1,66 @@
+/**
+ * @file
+ * @brief This file declares the worker pool used by the storage server.
+ *
+ * A fixed number of worker threads take jobs from a bounded queue.
+ * Any thread may add jobs and any worker may run them.
+ */
+#ifndef WORK_QUEUE
+#define WORK_QUEUE
+
+#include <pthread.h>
+#include <stdbool.h>
+
+/**
+ * @brief A unit of work: a function and the argument to call it with.
+ */
+typedef struct job {
+	void (*run)(void *arg);
+	void *arg;
+} Job;
+
+/**
+ * @brief A bounded job queue and the threads serving it.
+ */
+typedef struct workQueue {
+	Job *jobs;		///< Circular buffer of pending jobs.
+	int capacity;
+	int head;		///< Index of the oldest job.
+	int count;		///< Number of pending jobs.
+	bool shutdown;
+
+	pthread_mutex_t lock;
+	pthread_cond_t notEmpty;
+	pthread_cond_t notFull;
+
+	pthread_t *workers;
+	int numWorkers;
+} WorkQueue;
+
+/**
+ * @brief Create a queue and start its worker threads.
+ *
+ * @param numWorkers The number of worker threads.
+ * @param capacity The maximum number of pending jobs.
+ * @return Returns the queue, or NULL on error.
+ */
+WorkQueue *wq_create(int numWorkers, int capacity);
+
+/**
+ * @brief Add a job to the queue, waiting while the queue is full.
+ *
+ * @param queue The queue.
+ * @param run The function a worker will call.
+ * @param arg The argument passed to run.
+ * @return Returns 0 on success, -1 if the queue is shutting down.
+ */
+int wq_push(WorkQueue *queue, void (*run)(void *arg), void *arg);
+
+/**
+ * @brief Run the pending jobs, stop the workers and free the queue.
+ *
+ * @param queue The queue.
+ */
+void wq_destroy(WorkQueue *queue);
+
+#endif
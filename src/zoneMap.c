@@ -0,0 +1,85 @@
+/**
+ * @file
+ * @brief This file implements the zone maps used to skip parts of a scan.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "zoneMap.h"
+
+void zm_reset(ZoneMap *zone)
+{
+	int i;
+	for (i = 0; i < MAX_COLUMNS_PER_TABLE; i++) {
+		zone->min[i] = INT64_MAX;
+		zone->max[i] = INT64_MIN;
+	}
+	zone->untyped = false;
+	zone->loose = false;
+}
+
+void zm_add(ZoneMap *zone, const Schema *schema, const char *row)
+{
+	int i;
+
+	if (row == NULL || schema == NULL) {
+		zone->untyped = true;
+		return;
+	}
+	for (i = 0; i < schema->numColumns; i++) {
+		if (schema->columns[i].type != COLUMN_INT)
+			continue;
+
+		int64_t number;
+		memcpy(&number, row + schema->columns[i].offset, sizeof(number));
+		if (number < zone->min[i])
+			__atomic_store_n(&zone->min[i], number, __ATOMIC_RELAXED);
+		if (number > zone->max[i])
+			__atomic_store_n(&zone->max[i], number, __ATOMIC_RELAXED);
+	}
+}
+
+void zm_loosen(ZoneMap *zone)
+{
+	__atomic_store_n(&zone->loose, true, __ATOMIC_RELAXED);
+}
+
+bool zm_isLoose(ZoneMap *zone)
+{
+	return __atomic_load_n(&zone->loose, __ATOMIC_RELAXED);
+}
+
+void zm_publish(ZoneMap *zone, const ZoneMap *bounds)
+{
+	int i;
+	for (i = 0; i < MAX_COLUMNS_PER_TABLE; i++) {
+		__atomic_store_n(&zone->min[i], bounds->min[i], __ATOMIC_RELAXED);
+		__atomic_store_n(&zone->max[i], bounds->max[i], __ATOMIC_RELAXED);
+	}
+	__atomic_store_n(&zone->untyped, bounds->untyped, __ATOMIC_RELAXED);
+	__atomic_store_n(&zone->loose, false, __ATOMIC_RELAXED);
+}
+
+bool zm_excludes(ZoneMap *zone, const QueryPlan *plan)
+{
+	int i;
+
+	if (__atomic_load_n(&zone->untyped, __ATOMIC_RELAXED))
+		return false;
+	for (i = 0; i < plan->numPredicates; i++) {
+		const QueryStep *step = &plan->steps[i];
+
+		/* No typed row matches the step. */
+		if (step->op == 0)
+			return true;
+		if (step->type != COLUMN_INT)
+			continue;
+
+		int64_t min = __atomic_load_n(&zone->min[step->column], __ATOMIC_RELAXED);
+		int64_t max = __atomic_load_n(&zone->max[step->column], __ATOMIC_RELAXED);
+		if ((step->op == '<' && min >= step->number)
+				|| (step->op == '>' && max <= step->number)
+				|| (step->op == '=' && (step->number < min || step->number > max)))
+			return true;
+	}
+	return false;
+}
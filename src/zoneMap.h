@@ -0,0 +1,83 @@
+/**
+ * @file
+ * @brief This file declares the zone maps used to skip parts of a scan.
+ *
+ * A zone map holds the smallest and largest value of every int column
+ * over a group of records: a lock stripe of a chained table or a shard
+ * of an open one. A scan skips a group whose bounds show that none of
+ * its records can match a query.
+ *
+ * Bounds widen as records are set. Removing or changing a record only
+ * marks them loose; the next scan reading the whole group computes
+ * them anew.
+ */
+#ifndef ZONE_MAP
+#define ZONE_MAP
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "utils.h"
+#include "queryPlan.h"
+
+/**
+ * @brief The bounds of the int columns over a group of records.
+ *
+ * Changed under the write lock of the group. Scans, holding the lock
+ * for reading, read it and tighten it with atomic accesses.
+ */
+typedef struct zoneMap {
+	int64_t min[MAX_COLUMNS_PER_TABLE];
+	int64_t max[MAX_COLUMNS_PER_TABLE];
+	bool untyped;		///< The group may hold untyped records, which are never skipped.
+	bool loose;		///< Records were removed or changed since the bounds were computed.
+} ZoneMap;
+
+/**
+ * @brief Set the bounds of an empty group.
+ *
+ * @param zone The zone map.
+ */
+void zm_reset(ZoneMap *zone);
+
+/**
+ * @brief Widen the bounds to cover a record being set.
+ *
+ * @param zone The zone map.
+ * @param schema The schema of the table, or NULL if it is unknown.
+ * @param row The typed row of the record, or NULL if it is untyped.
+ */
+void zm_add(ZoneMap *zone, const Schema *schema, const char *row);
+
+/**
+ * @brief Note that a record of the group was removed or changed.
+ *
+ * @param zone The zone map.
+ */
+void zm_loosen(ZoneMap *zone);
+
+/**
+ * @brief Tell whether the bounds are loose.
+ *
+ * @param zone The zone map.
+ * @return true if the next scan of the whole group should call zm_publish().
+ */
+bool zm_isLoose(ZoneMap *zone);
+
+/**
+ * @brief Replace loose bounds with ones computed by a scan.
+ *
+ * @param zone The zone map.
+ * @param bounds Bounds built with zm_reset() and zm_add() over every record of the group.
+ */
+void zm_publish(ZoneMap *zone, const ZoneMap *bounds);
+
+/**
+ * @brief Tell whether no record of the group can match a query.
+ *
+ * @param zone The zone map.
+ * @param plan The compiled query.
+ * @return true if the group can be skipped.
+ */
+bool zm_excludes(ZoneMap *zone, const QueryPlan *plan);
+
+#endif
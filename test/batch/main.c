@@ -0,0 +1,275 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include <errno.h>
+#include "storage.h"
+#include "fixture.h"
+
+#define TESTTIMEOUT	60		// How long to wait for each test to run.
+#define TABLE1		"table1"	// The table to use.
+
+#define COLVAL		"col1 %d, col2 %d"	// The value of a record, given its number and generation.
+#define NUM_RECORDS	10		// Records set by the fixture.
+#define NUM_MANY	(2 * MAX_BATCH_KEYS + 10)	// Keys split over several requests.
+
+/// The keys of the test cases, key0, key1, ...
+char test_keyBuffers[NUM_MANY][MAX_KEY_LEN];
+const char *test_keys[NUM_MANY];
+
+/**
+ * @brief Fill records with the values of a generation, to be set unconditionally.
+ */
+void fill_records(struct storage_record *records, int count, int generation)
+{
+	int i;
+
+	memset(records, 0, count * sizeof(struct storage_record));
+	for (i = 0; i < count; i++)
+		snprintf(records[i].value, sizeof records[i].value, COLVAL, i, generation);
+}
+
+/**
+ * @brief Check that each record read holds the value of a generation.
+ */
+void check_records(struct storage_record *records, int *statuses, int count, int generation)
+{
+	char value[MAX_VALUE_LEN];
+	int i;
+
+	for (i = 0; i < count; i++) {
+		fail_unless(statuses[i] == 0, "key%d has status %d.", i, statuses[i]);
+		snprintf(value, sizeof value, COLVAL, i, generation);
+		fail_unless(strcmp(records[i].value, value) == 0, "key%d holds %s instead of %s.", i, records[i].value, value);
+	}
+}
+
+
+
+/**
+ * @brief Text fixture setup.  Start the server and set the first records.
+ */
+void test_setup_populate()
+{
+	struct storage_record records[NUM_RECORDS];
+	int statuses[NUM_RECORDS];
+	int i;
+
+	for (i = 0; i < NUM_MANY; i++) {
+		snprintf(test_keyBuffers[i], MAX_KEY_LEN, "key%d", i);
+		test_keys[i] = test_keyBuffers[i];
+	}
+	test_conn = start_connect(TESTING_CONF, "testing.serverout", &test_server_pid);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+
+	fill_records(records, NUM_RECORDS, 1);
+	int status = storage_mset(TABLE1, test_keys, records, statuses, NUM_RECORDS, test_conn);
+	fail_unless(status == 0, "storage_mset failed with errno %d.", errno);
+	for (i = 0; i < NUM_RECORDS; i++)
+		fail_unless(statuses[i] == 0, "Setting key%d failed with status %d.", i, statuses[i]);
+}
+
+/**
+ * @brief Text fixture teardown.  Disconnect and stop the server.
+ */
+void test_teardown()
+{
+	storage_disconnect(test_conn);
+	kill_server(test_server_pid);
+}
+
+
+
+START_TEST (test_batch_get)
+{
+	struct storage_record records[NUM_RECORDS];
+	int statuses[NUM_RECORDS];
+
+	int status = storage_mget(TABLE1, test_keys, records, statuses, NUM_RECORDS, test_conn);
+	fail_unless(status == 0, "storage_mget failed with errno %d.", errno);
+	check_records(records, statuses, NUM_RECORDS, 1);
+
+	// The versions match those of single gets.
+	struct storage_record record;
+	status = storage_get(TABLE1, test_keys[0], &record, test_conn);
+	fail_unless(status == 0, "storage_get failed with errno %d.", errno);
+	fail_unless(record.metadata[0] == records[0].metadata[0], "storage_mget returned version %d instead of %d.",
+			(int) records[0].metadata[0], (int) record.metadata[0]);
+}
+END_TEST
+
+START_TEST (test_batch_get_missing)
+{
+	struct storage_record records[NUM_RECORDS + 1];
+	int statuses[NUM_RECORDS + 1];
+	const char *keys[NUM_RECORDS + 1];
+	int i;
+
+	// A missing key fails on its own, between keys found.
+	for (i = 0; i < NUM_RECORDS; i++)
+		keys[i] = test_keys[i];
+	keys[NUM_RECORDS] = keys[NUM_RECORDS / 2];
+	keys[NUM_RECORDS / 2] = "missingkey";
+	int status = storage_mget(TABLE1, keys, records, statuses, NUM_RECORDS + 1, test_conn);
+	fail_unless(status == 0, "storage_mget failed with errno %d.", errno);
+	for (i = 0; i < NUM_RECORDS + 1; i++) {
+		int expected = i == NUM_RECORDS / 2 ? ERR_KEY_NOT_FOUND : 0;
+		fail_unless(statuses[i] == expected, "Key %d has status %d instead of %d.", i, statuses[i], expected);
+	}
+
+	// A request failing as a whole fails each of its keys.
+	status = storage_mget("missingtable", keys, records, statuses, NUM_RECORDS, test_conn);
+	fail_unless(status == 0, "storage_mget failed with errno %d.", errno);
+	for (i = 0; i < NUM_RECORDS; i++)
+		fail_unless(statuses[i] == ERR_TABLE_NOT_FOUND, "Key %d of a missing table has status %d.", i, statuses[i]);
+}
+END_TEST
+
+START_TEST (test_batch_set_versions)
+{
+	struct storage_record records[NUM_RECORDS];
+	int statuses[NUM_RECORDS];
+	int i;
+
+	// Set with the versions read, but one of them stale.
+	int status = storage_mget(TABLE1, test_keys, records, statuses, NUM_RECORDS, test_conn);
+	fail_unless(status == 0, "storage_mget failed with errno %d.", errno);
+	for (i = 0; i < NUM_RECORDS; i++)
+		snprintf(records[i].value, sizeof records[i].value, COLVAL, i, 2);
+	records[0].metadata[0]++;
+	status = storage_mset(TABLE1, test_keys, records, statuses, NUM_RECORDS, test_conn);
+	fail_unless(status == 0, "storage_mset failed with errno %d.", errno);
+	fail_unless(statuses[0] == ERR_TRANSACTION_ABORT, "A stale version has status %d.", statuses[0]);
+	for (i = 1; i < NUM_RECORDS; i++)
+		fail_unless(statuses[i] == 0, "Setting key%d failed with status %d.", i, statuses[i]);
+
+	// Only the record with a stale version kept its value.
+	status = storage_mget(TABLE1, test_keys, records, statuses, NUM_RECORDS, test_conn);
+	fail_unless(status == 0, "storage_mget failed with errno %d.", errno);
+	check_records(records, statuses, 1, 1);
+	for (i = 1; i < NUM_RECORDS; i++) {
+		char value[MAX_VALUE_LEN];
+		snprintf(value, sizeof value, COLVAL, i, 2);
+		fail_unless(strcmp(records[i].value, value) == 0, "key%d holds %s instead of %s.", i, records[i].value, value);
+	}
+}
+END_TEST
+
+START_TEST (test_batch_set_delete)
+{
+	struct storage_record records[NUM_RECORDS];
+	int statuses[NUM_RECORDS];
+	int i;
+
+	// An empty value deletes; a missing key cannot be deleted.
+	fill_records(records, NUM_RECORDS, 2);
+	records[1].value[0] = '\0';
+	const char *keys[NUM_RECORDS];
+	for (i = 0; i < NUM_RECORDS; i++)
+		keys[i] = test_keys[i];
+	keys[2] = "missingkey";
+	records[2].value[0] = '\0';
+	int status = storage_mset(TABLE1, keys, records, statuses, NUM_RECORDS, test_conn);
+	fail_unless(status == 0, "storage_mset failed with errno %d.", errno);
+	fail_unless(statuses[1] == 0, "Deleting key1 failed with status %d.", statuses[1]);
+	fail_unless(statuses[2] == ERR_KEY_NOT_FOUND, "Deleting a missing key has status %d.", statuses[2]);
+
+	status = storage_mget(TABLE1, test_keys, records, statuses, NUM_RECORDS, test_conn);
+	fail_unless(status == 0, "storage_mget failed with errno %d.", errno);
+	fail_unless(statuses[1] == ERR_KEY_NOT_FOUND, "A deleted key has status %d.", statuses[1]);
+	fail_unless(statuses[2] == 0, "key2 has status %d.", statuses[2]);
+}
+END_TEST
+
+START_TEST (test_batch_many)
+{
+	struct storage_record *records = calloc(NUM_MANY, sizeof(struct storage_record));
+	int statuses[NUM_MANY];
+
+	// More keys than fit in one request are split over several.
+	fill_records(records, NUM_MANY, 3);
+	int status = storage_mset(TABLE1, test_keys, records, statuses, NUM_MANY, test_conn);
+	fail_unless(status == 0, "storage_mset failed with errno %d.", errno);
+	memset(records, 0, NUM_MANY * sizeof(struct storage_record));
+	status = storage_mget(TABLE1, test_keys, records, statuses, NUM_MANY, test_conn);
+	fail_unless(status == 0, "storage_mget failed with errno %d.", errno);
+	check_records(records, statuses, NUM_MANY, 3);
+	free(records);
+}
+END_TEST
+
+START_TEST (test_batch_invalid)
+{
+	struct storage_record records[1];
+	int statuses[1];
+
+	int status = storage_mget(TABLE1, test_keys, records, statuses, -1, test_conn);
+	fail_unless(status == -1 && errno == ERR_INVALID_PARAM, "storage_mget of a negative count should fail.");
+	status = storage_mset(TABLE1, NULL, records, statuses, 1, test_conn);
+	fail_unless(status == -1 && errno == ERR_INVALID_PARAM, "storage_mset without keys should fail.");
+	const char *keys[1] = { "bad key" };
+	status = storage_mget(TABLE1, keys, records, statuses, 1, test_conn);
+	fail_unless(status == -1 && errno == ERR_INVALID_PARAM, "storage_mget of a bad key should fail.");
+}
+END_TEST
+
+
+
+/**
+ * @brief This runs the batch tests.
+ */
+int main(int argc, char *argv[])
+{
+	if(argc == 2)
+		server_port = atoi(argv[1]);
+	else
+		server_port = SERVERPORT;
+	printf("Using server port: %d.\n", server_port);
+	Suite *s = suite_create("batch");
+	TCase *tc;
+
+	tc = tcase_create("test_batch_get");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_populate, test_teardown);
+	tcase_add_test(tc, test_batch_get);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_batch_get_missing");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_populate, test_teardown);
+	tcase_add_test(tc, test_batch_get_missing);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_batch_set_versions");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_populate, test_teardown);
+	tcase_add_test(tc, test_batch_set_versions);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_batch_set_delete");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_populate, test_teardown);
+	tcase_add_test(tc, test_batch_set_delete);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_batch_many");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_populate, test_teardown);
+	tcase_add_test(tc, test_batch_many);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_batch_invalid");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_populate, test_teardown);
+	tcase_add_test(tc, test_batch_invalid);
+	suite_add_tcase(s, tc);
+
+	SRunner *sr = srunner_create(s);
+	srunner_set_log(sr, "results.log");
+	srunner_run_all(sr, CK_ENV);
+	srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return EXIT_SUCCESS;
+}
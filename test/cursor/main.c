@@ -0,0 +1,235 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include <errno.h>
+#include "storage.h"
+#include "fixture.h"
+
+#define TESTTIMEOUT	60		// How long to wait for each test to run.
+#define TABLE1		"table1"	// The table to use.
+
+#define MATCHING_COLVAL	"col1 %d, col2 1"	// A record the query matches.
+#define OTHER_COLVAL	"col1 %d, col2 2"	// A record the query does not match.
+#define QUERY		"col2 = 1"	// The query of the cursors.
+#define NUM_MATCHING	200		// Records matching the query.
+#define NUM_GROWN	600		// Records set while a cursor is open, enough for the 64 buckets to double twice.
+#define PAGE_SIZE	37		// Keys asked for per page; not a divisor of the counts.
+#define CURSORS		8		// Cursors a client may hold; MAX_CURSORS on the server.
+
+
+/**
+ * @brief Set records numbered from first to first + count - 1.
+ *
+ * @param format The value of a record, given its number.
+ */
+void set_records(int first, int count, const char *format)
+{
+	struct storage_record record;
+	char key[MAX_KEY_LEN];
+	int i;
+
+	memset(&record, 0, sizeof record);
+	for (i = first; i < first + count; i++) {
+		snprintf(key, sizeof key, "key%d", i);
+		snprintf(record.value, sizeof record.value, format, i);
+		int status = storage_set(TABLE1, key, &record, test_conn);
+		fail_unless(status == 0, "storage_set of %s failed with errno %d.", key, errno);
+	}
+}
+
+/**
+ * @brief Read a page of a cursor and count each key returned.
+ *
+ * @param seen How many times each matching record was returned, by number.
+ * @return The number of keys in the page.
+ */
+int read_page(int cursor, int *seen)
+{
+	char keyBuffers[PAGE_SIZE][MAX_KEY_LEN];
+	char *keys[PAGE_SIZE];
+	int i;
+
+	for (i = 0; i < PAGE_SIZE; i++)
+		keys[i] = keyBuffers[i];
+	int count = storage_query_next(cursor, keys, PAGE_SIZE, test_conn);
+	fail_unless(count >= 0 && count <= PAGE_SIZE, "storage_query_next failed with errno %d.", errno);
+	for (i = 0; i < count; i++) {
+		int number = -1;
+		fail_unless(sscanf(keys[i], "key%d", &number) == 1 && number >= 0 && number < NUM_MATCHING,
+				"storage_query_next returned a key not matching the query: %s.", keys[i]);
+		seen[number]++;
+	}
+	return count;
+}
+
+/**
+ * @brief Check that each matching record was returned exactly once.
+ */
+void check_seen(int *seen)
+{
+	int i;
+
+	for (i = 0; i < NUM_MATCHING; i++) {
+		fail_unless(seen[i] != 0, "The cursor missed key%d.", i);
+		fail_unless(seen[i] == 1, "The cursor returned key%d %d times.", i, seen[i]);
+	}
+}
+
+
+
+/**
+ * @brief Text fixture setup.  Start the server and set the matching records.
+ */
+void test_setup_populate()
+{
+	test_conn = start_connect(TESTING_CONF, "testing.serverout", &test_server_pid);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+	set_records(0, NUM_MATCHING, MATCHING_COLVAL);
+}
+
+/**
+ * @brief Text fixture teardown.  Disconnect and stop the server.
+ */
+void test_teardown()
+{
+	storage_disconnect(test_conn);
+	kill_server(test_server_pid);
+}
+
+
+
+START_TEST (test_cursor_pages)
+{
+	int seen[NUM_MATCHING] = { 0 };
+	int cursor = storage_query_open(TABLE1, QUERY, test_conn);
+	fail_unless(cursor >= 0, "storage_query_open failed with errno %d.", errno);
+
+	// Pages are full until the last one.
+	int count;
+	int total = 0;
+	while ((count = read_page(cursor, seen)) == PAGE_SIZE)
+		total += count;
+	total += count;
+	fail_unless(total == NUM_MATCHING, "The cursor returned %d keys instead of %d.", total, NUM_MATCHING);
+	check_seen(seen);
+
+	// An exhausted cursor stays empty.
+	fail_unless(read_page(cursor, seen) == 0, "An exhausted cursor returned more keys.");
+	fail_unless(storage_query_close(cursor, test_conn) == 0, "storage_query_close failed.");
+}
+END_TEST
+
+START_TEST (test_cursor_grow_midscan)
+{
+	int seen[NUM_MATCHING] = { 0 };
+	int cursor = storage_query_open(TABLE1, QUERY, test_conn);
+	fail_unless(cursor >= 0, "storage_query_open failed with errno %d.", errno);
+	fail_unless(read_page(cursor, seen) == PAGE_SIZE, "The first page is short.");
+
+	// Grow the table to several times its buckets between pages.
+	int first = NUM_MATCHING;
+	int step = NUM_GROWN / 5;
+	int count;
+	do {
+		if (first < NUM_MATCHING + NUM_GROWN) {
+			set_records(first, step, OTHER_COLVAL);
+			first += step;
+		}
+		count = read_page(cursor, seen);
+	} while (count == PAGE_SIZE);
+
+	// Every record present throughout is returned, none twice.
+	check_seen(seen);
+	fail_unless(storage_query_close(cursor, test_conn) == 0, "storage_query_close failed.");
+}
+END_TEST
+
+START_TEST (test_cursor_invalid)
+{
+	char keyBuffer[MAX_KEY_LEN];
+	char *keys[1] = { keyBuffer };
+
+	int status = storage_query_next(CURSORS, keys, 1, test_conn);
+	fail_unless(status == -1 && errno == ERR_INVALID_PARAM, "storage_query_next of a cursor never opened should fail.");
+
+	int cursor = storage_query_open(TABLE1, QUERY, test_conn);
+	fail_unless(cursor >= 0, "storage_query_open failed with errno %d.", errno);
+	fail_unless(storage_query_close(cursor, test_conn) == 0, "storage_query_close failed.");
+	status = storage_query_next(cursor, keys, 1, test_conn);
+	fail_unless(status == -1 && errno == ERR_INVALID_PARAM, "storage_query_next of a closed cursor should fail.");
+	status = storage_query_close(cursor, test_conn);
+	fail_unless(status == -1 && errno == ERR_INVALID_PARAM, "storage_query_close of a closed cursor should fail.");
+
+	status = storage_query_open("missingtable", QUERY, test_conn);
+	fail_unless(status == -1 && errno == ERR_TABLE_NOT_FOUND, "storage_query_open of a missing table should fail.");
+}
+END_TEST
+
+START_TEST (test_cursor_limit)
+{
+	int cursors[CURSORS];
+	int i;
+
+	for (i = 0; i < CURSORS; i++) {
+		cursors[i] = storage_query_open(TABLE1, QUERY, test_conn);
+		fail_unless(cursors[i] >= 0, "storage_query_open of cursor %d failed with errno %d.", i, errno);
+	}
+	int status = storage_query_open(TABLE1, QUERY, test_conn);
+	fail_unless(status == -1 && errno == ERR_UNKNOWN, "storage_query_open past the cursors of a client should fail.");
+
+	// Closing one frees its slot.
+	fail_unless(storage_query_close(cursors[0], test_conn) == 0, "storage_query_close failed.");
+	cursors[0] = storage_query_open(TABLE1, QUERY, test_conn);
+	fail_unless(cursors[0] >= 0, "storage_query_open after a close failed with errno %d.", errno);
+}
+END_TEST
+
+
+
+/**
+ * @brief This runs the cursor tests.
+ */
+int main(int argc, char *argv[])
+{
+	if(argc == 2)
+		server_port = atoi(argv[1]);
+	else
+		server_port = SERVERPORT;
+	printf("Using server port: %d.\n", server_port);
+	Suite *s = suite_create("cursor");
+	TCase *tc;
+
+	tc = tcase_create("test_cursor_pages");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_populate, test_teardown);
+	tcase_add_test(tc, test_cursor_pages);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_cursor_grow_midscan");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_populate, test_teardown);
+	tcase_add_test(tc, test_cursor_grow_midscan);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_cursor_invalid");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_populate, test_teardown);
+	tcase_add_test(tc, test_cursor_invalid);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_cursor_limit");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_populate, test_teardown);
+	tcase_add_test(tc, test_cursor_limit);
+	suite_add_tcase(s, tc);
+
+	SRunner *sr = srunner_create(s);
+	srunner_set_log(sr, "results.log");
+	srunner_run_all(sr, CK_ENV);
+	srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,261 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include <errno.h>
+#include "storage.h"
+#include "fixture.h"
+
+#define TESTTIMEOUT	60		// How long to wait for each test to run.
+#define SNAPSHOT_CONF	"snapshot.conf"	// The same configuration, with a snapshot every second.
+#define DATA_DIRECTORY	"mydata"	// The data_directory of the config files.
+#define TABLE1		"table1"	// The table to use.
+
+#define COLVAL		"col1 %d, col2 %d"	// The value of a record, given its number and generation.
+#define NUM_RECORDS	50		// Records set before each restart.
+
+
+/**
+ * @brief Set a record, or delete it if value is NULL.
+ *
+ * @return The version of the record after the set.
+ */
+uintptr_t set_value(const char *key, const char *value)
+{
+	struct storage_record record;
+
+	memset(&record, 0, sizeof record);
+	if (value != NULL)
+		strncpy(record.value, value, sizeof record.value - 1);
+	int status = storage_set(TABLE1, key, value != NULL ? &record : NULL, test_conn);
+	fail_unless(status == 0, "storage_set of %s failed with errno %d.", key, errno);
+	if (value == NULL)
+		return 0;
+	status = storage_get(TABLE1, key, &record, test_conn);
+	fail_unless(status == 0, "storage_get of %s failed with errno %d.", key, errno);
+	return record.metadata[0];
+}
+
+/**
+ * @brief Check a record's value and version, or that it is missing if
+ * value is NULL.
+ */
+void check_value(const char *key, const char *value, uintptr_t version)
+{
+	struct storage_record record;
+
+	int status = storage_get(TABLE1, key, &record, test_conn);
+	if (value == NULL) {
+		fail_unless(status == -1 && errno == ERR_KEY_NOT_FOUND, "The deleted key %s was found.", key);
+		return;
+	}
+	fail_unless(status == 0, "storage_get of %s failed with errno %d.", key, errno);
+	fail_unless(strcmp(record.value, value) == 0, "%s is \"%s\" instead of \"%s\".", key, record.value, value);
+	fail_unless(record.metadata[0] == version, "%s has version %lu instead of %lu.", key,
+			(unsigned long) record.metadata[0], (unsigned long) version);
+}
+
+/**
+ * @brief Kill the server without warning.
+ */
+void crash_server()
+{
+	storage_disconnect(test_conn);
+	kill_server(test_server_pid);
+}
+
+/**
+ * @brief Start the server again on the same data directory.
+ */
+void start_again(char *config_file)
+{
+	test_conn = start_connect(config_file, "testing.serverout", &test_server_pid);
+	fail_unless(test_conn != NULL, "Couldn't restart or connect to server.");
+}
+
+/**
+ * @brief Kill the server without warning, and start it again on the
+ * same data directory.
+ */
+void restart_server()
+{
+	crash_server();
+	start_again(TESTING_CONF);
+}
+
+
+
+/**
+ * @brief Text fixture setup.  Start the server on an empty data directory.
+ */
+void test_setup()
+{
+	fail_unless(system("rm -rf " DATA_DIRECTORY) == 0, "Couldn't empty the data directory.");
+	start_again(TESTING_CONF);
+}
+
+/**
+ * @brief Text fixture setup.  Start the server taking snapshots on an
+ * empty data directory.
+ */
+void test_setup_snapshots()
+{
+	fail_unless(system("rm -rf " DATA_DIRECTORY) == 0, "Couldn't empty the data directory.");
+	start_again(SNAPSHOT_CONF);
+}
+
+/**
+ * @brief Text fixture teardown.  Disconnect and stop the server.
+ */
+void test_teardown()
+{
+	storage_disconnect(test_conn);
+	kill_server(test_server_pid);
+}
+
+
+
+START_TEST (test_wal_replay)
+{
+	char key[MAX_KEY_LEN];
+	char value[NUM_RECORDS][MAX_VALUE_LEN];
+	uintptr_t version[NUM_RECORDS];
+	int i;
+
+	// Set every record, update every third and delete every fifth.
+	for (i = 0; i < NUM_RECORDS; i++) {
+		snprintf(key, sizeof key, "key%d", i);
+		snprintf(value[i], sizeof value[i], COLVAL, i, 0);
+		version[i] = set_value(key, value[i]);
+	}
+	for (i = 0; i < NUM_RECORDS; i += 3) {
+		snprintf(key, sizeof key, "key%d", i);
+		snprintf(value[i], sizeof value[i], COLVAL, i, 1);
+		version[i] = set_value(key, value[i]);
+	}
+	for (i = 0; i < NUM_RECORDS; i += 5) {
+		snprintf(key, sizeof key, "key%d", i);
+		set_value(key, NULL);
+	}
+
+	// Each committed change survives a crash, with its version.
+	restart_server();
+	for (i = 0; i < NUM_RECORDS; i++) {
+		snprintf(key, sizeof key, "key%d", i);
+		check_value(key, i % 5 == 0 ? NULL : value[i], version[i]);
+	}
+
+	// The log keeps growing after a replay, and replays again.
+	snprintf(value[0], sizeof value[0], COLVAL, 0, 2);
+	version[0] = set_value("key0", value[0]);
+	set_value("key1", NULL);
+	restart_server();
+	check_value("key0", value[0], version[0]);
+	check_value("key1", NULL, 0);
+	check_value("key2", value[2], version[2]);
+}
+END_TEST
+
+START_TEST (test_wal_versions)
+{
+	struct storage_record record;
+
+	uintptr_t version = set_value("key", "col1 1, col2 1");
+	version = set_value("key", "col1 1, col2 2");
+	restart_server();
+
+	// A set at a stale version still aborts after a restart.
+	memset(&record, 0, sizeof record);
+	strcpy(record.value, "col1 1, col2 3");
+	record.metadata[0] = version - 1;
+	int status = storage_set(TABLE1, "key", &record, test_conn);
+	fail_unless(status == -1 && errno == ERR_TRANSACTION_ABORT, "A set at a stale version should abort.");
+	record.metadata[0] = version;
+	status = storage_set(TABLE1, "key", &record, test_conn);
+	fail_unless(status == 0, "A set at the current version failed with errno %d.", errno);
+}
+END_TEST
+
+START_TEST (test_snapshot_reload)
+{
+	char key[MAX_KEY_LEN];
+	char value[NUM_RECORDS][MAX_VALUE_LEN];
+	uintptr_t version[NUM_RECORDS];
+	int i;
+
+	for (i = 0; i < NUM_RECORDS; i++) {
+		snprintf(key, sizeof key, "key%d", i);
+		snprintf(value[i], sizeof value[i], COLVAL, i, 0);
+		version[i] = set_value(key, value[i]);
+	}
+	for (i = 0; i < NUM_RECORDS; i += 5) {
+		snprintf(key, sizeof key, "key%d", i);
+		set_value(key, NULL);
+	}
+
+	// Wait for a snapshot taken after the last change, then remove the
+	// logs: the records can only come back from the snapshot.
+	sleep(3);
+	crash_server();
+	fail_unless(access(DATA_DIRECTORY "/snapshot.db", F_OK) == 0, "No snapshot was written.");
+	fail_unless(system("rm -f " DATA_DIRECTORY "/wal.*.log") == 0, "Couldn't remove the logs.");
+	start_again(TESTING_CONF);
+	for (i = 0; i < NUM_RECORDS; i++) {
+		snprintf(key, sizeof key, "key%d", i);
+		check_value(key, i % 5 == 0 ? NULL : value[i], version[i]);
+	}
+
+	// Changes after the snapshot are replayed from the log on top of it.
+	snprintf(value[1], sizeof value[1], COLVAL, 1, 1);
+	version[1] = set_value("key1", value[1]);
+	set_value("key2", NULL);
+	restart_server();
+	check_value("key1", value[1], version[1]);
+	check_value("key2", NULL, 0);
+	check_value("key3", value[3], version[3]);
+	check_value("key5", NULL, 0);
+}
+END_TEST
+
+
+
+/**
+ * @brief This runs the write-ahead log and snapshot tests.
+ */
+int main(int argc, char *argv[])
+{
+	if(argc == 2)
+		server_port = atoi(argv[1]);
+	else
+		server_port = SERVERPORT;
+	printf("Using server port: %d.\n", server_port);
+	Suite *s = suite_create("durability");
+	TCase *tc;
+
+	tc = tcase_create("test_wal_replay");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup, test_teardown);
+	tcase_add_test(tc, test_wal_replay);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_wal_versions");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup, test_teardown);
+	tcase_add_test(tc, test_wal_versions);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_snapshot_reload");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_snapshots, test_teardown);
+	tcase_add_test(tc, test_snapshot_reload);
+	suite_add_tcase(s, tc);
+
+	SRunner *sr = srunner_create(s);
+	srunner_set_log(sr, "results.log");
+	srunner_run_all(sr, CK_ENV);
+	srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return EXIT_SUCCESS;
+}
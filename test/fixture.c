@@ -0,0 +1,143 @@
+/**
+ * @file
+ * @brief The fixture shared by the test suites.
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <check.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "storage.h"
+#include "fixture.h"
+
+int server_port;
+
+void *test_conn = NULL;
+
+int test_server_pid = -1;
+
+int start_server(char *config_file, int *status, const char *serverout_file)
+{
+	sleep(1);       // Give the OS enough time to kill previous process
+
+	pid_t childpid = fork();
+	if (childpid < 0) {
+		// Failed to create child.
+		return -1;
+	} else if (childpid == 0) {
+		// The child.
+
+		// Redirect stdout and stderr to a file.
+		const char *outfile = serverout_file == NULL ? SERVEROUT : serverout_file;
+		int outfd = open(outfile, O_CREAT|O_WRONLY, SERVEROUT_MODE);
+		close(STDOUT_FILENO);
+		close(STDERR_FILENO);
+		if (dup2(outfd, STDOUT_FILENO) < 0 || dup2(outfd, STDERR_FILENO) < 0) {
+			perror("dup2 error");
+			return -1;
+		}
+
+		// Start the server
+		execl(SERVEREXEC, SERVEREXEC, config_file, NULL);
+
+		// Should never get here.
+		perror("Couldn't start server");
+		exit(EXIT_FAILURE);
+	} else {
+		// The parent.
+
+		// If the child terminates quickly, then there was probably a
+		// problem running the server (e.g., config file not found).
+		sleep(1);
+		int pid = waitpid(childpid, status, WNOHANG);
+		if (pid == childpid)
+			return -1; // Probably a problem starting the server.
+		else
+			return childpid; // Probably ok.
+	}
+}
+
+void* start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	return start_connect_protocol(config_file, serverout_file, serverpid, STORAGE_PROTOCOL_TEXT);
+}
+
+void* start_connect_protocol(char *config_file, char *serverout_file, int *serverpid, int protocol)
+{
+	// Start the server.
+	int pid = start_server(config_file, NULL, serverout_file);
+	fail_unless(pid > 0, "Server didn't run properly.");
+	if (serverpid != NULL)
+		*serverpid = pid;
+
+	// Connect to the server.
+	void *conn = storage_connect_protocol(SERVERHOST, server_port, protocol);
+	fail_unless(conn != NULL, "Couldn't connect to server.");
+
+	// Authenticate with the server.
+	int status = storage_auth(SERVERUSERNAME, SERVERPASSWORD, conn);
+	fail_unless(status == 0, "Authentication failed.");
+
+	return conn;
+}
+
+int kill_server(int pid)
+{
+	int status = kill(pid, SIGKILL);
+	fail_unless(status == 0, "Couldn't kill server.");
+	waitpid(pid, NULL, 0);
+	return status;
+}
+
+int connect_raw()
+{
+	struct addrinfo hints, *result;
+	char port[16];
+
+	memset(&hints, 0, sizeof hints);
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	snprintf(port, sizeof port, "%d", server_port);
+	fail_unless(getaddrinfo(SERVERHOST, port, &hints, &result) == 0, "Couldn't resolve the server.");
+	int sock = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+	fail_unless(sock >= 0 && connect(sock, result->ai_addr, result->ai_addrlen) == 0, "Couldn't connect to server.");
+	freeaddrinfo(result);
+	return sock;
+}
+
+void send_bytes(int sock, const void *data, size_t len)
+{
+	fail_unless(send(sock, data, len, 0) == (ssize_t) len, "Couldn't send to the server.");
+}
+
+void recv_bytes(int sock, void *data, size_t len)
+{
+	size_t done = 0;
+
+	while (done < len) {
+		ssize_t bytes = recv(sock, (char *) data + done, len - done, 0);
+		fail_unless(bytes > 0, "The server closed the connection.");
+		done += (size_t) bytes;
+	}
+}
+
+void text_request(int sock, const char *request, const char *expected)
+{
+	char reply[256];
+	size_t len = 0;
+
+	send_bytes(sock, request, strlen(request));
+	do {
+		fail_unless(len < sizeof reply - 1, "The reply to %s is too long.", request);
+		recv_bytes(sock, reply + len, 1);
+	} while (reply[len++] != '\n');
+	reply[len - 1] = '\0';
+	fail_unless(strcmp(reply, expected) == 0, "The reply to %s is %s instead of %s.", request, reply, expected);
+}
@@ -0,0 +1,83 @@
+/**
+ * @file
+ * @brief The fixture shared by the test suites: it starts the storage
+ * server, connects to it and stops it.
+ *
+ * Each suite links fixture.c and sets server_port from its command line.
+ */
+#ifndef FIXTURE_H
+#define FIXTURE_H
+#include <stddef.h>
+
+#define SERVEREXEC	"./server"	// Server executable file.
+#define SERVEROUT	"default.serverout"	// File where the server's output is stored.
+#define SERVEROUT_MODE	0666		// Permissions of the server ouptut file.
+#define TESTING_CONF	"testing.conf"	// Server configuration file of the suite.
+
+// These settings should correspond to what's in the config file.
+#define SERVERHOST	"localhost"	// The hostname where the server is running.
+#define SERVERPORT	4848		// The port where the server is running.
+#define SERVERUSERNAME	"admin"		// The server username
+#define SERVERPASSWORD	"dog4sale"	// The server password
+#define SERVERPASSWORD_SENT	"xxxnq.BMCifhU"	// The server password, as the client library sends it.
+
+/* Server port used by test */
+extern int server_port;
+
+/// Connection used by test fixture.
+extern void *test_conn;
+
+/// Server started by test fixture.
+extern int test_server_pid;
+
+/**
+ * @brief Start the storage server.
+ *
+ * @param config_file The configuration file the server should use.
+ * @param status Status info about the server (from waitpid).
+ * @param serverout_file File where server output is stored.
+ * @return Return server process id on success, or -1 otherwise.
+ */
+int start_server(char *config_file, int *status, const char *serverout_file);
+
+/**
+ * @brief Start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* start_connect(char *config_file, char *serverout_file, int *serverpid);
+
+/**
+ * @brief Start the server, and connect to it using a given protocol.
+ * @return A connection to the server if successful.
+ */
+void* start_connect_protocol(char *config_file, char *serverout_file, int *serverpid, int protocol);
+
+/**
+ * @brief Kill the server with given pid.
+ * @return 0 on success, -1 on error.
+ */
+int kill_server(int pid);
+
+/**
+ * @brief Open a plain socket to the server, for requests the client
+ * library does not make.
+ * @return The socket.
+ */
+int connect_raw();
+
+/**
+ * @brief Send bytes on a plain socket.
+ */
+void send_bytes(int sock, const void *data, size_t len);
+
+/**
+ * @brief Receive exactly len bytes from a plain socket.
+ */
+void recv_bytes(int sock, void *data, size_t len);
+
+/**
+ * @brief Send a text request on a plain socket and check the reply line.
+ */
+void text_request(int sock, const char *request, const char *expected);
+
+#endif
@@ -0,0 +1,240 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include <errno.h>
+#include "storage.h"
+#include "fixture.h"
+
+#define TESTTIMEOUT	60		// How long to wait for each test to run.
+#define INDEXED		"itable"	// The table whose int columns are indexed.
+#define SCANNED		"stable"	// The same table without indexes.
+#define CHARINDEXED	"ctable"	// The table whose char column is indexed.
+#define CHARSCANNED	"cscan"		// The same table without the index.
+
+#define INT_COLVAL	"col1 %d, col2 %d"	// A record of the int tables, given col1 and col2.
+#define CHAR_COLVAL	"name %s, age %d"	// A record of the char tables, given name and age.
+#define NUM_RECORDS	200		// Records set in each table by the fixture.
+#define NUM_CHAR_RECORDS	60	// Records set in each char table by the test.
+#define NUM_NAMES	5		// Names the char table records cycle through.
+
+static const char *names[NUM_NAMES] = { "alice", "bob", "carol", "dave", "bo" };
+
+/**
+ * @brief Set the same record in both tables of a pair, or delete it from
+ * both if value is NULL.
+ */
+void set_both(const char *indexed, const char *scanned, const char *key, const char *value)
+{
+	struct storage_record record;
+
+	memset(&record, 0, sizeof record);
+	if (value != NULL)
+		strncpy(record.value, value, sizeof record.value - 1);
+	int status = storage_set(indexed, key, value != NULL ? &record : NULL, test_conn);
+	fail_unless(status == 0, "storage_set of %s in %s failed with errno %d.", key, indexed, errno);
+	status = storage_set(scanned, key, value != NULL ? &record : NULL, test_conn);
+	fail_unless(status == 0, "storage_set of %s in %s failed with errno %d.", key, scanned, errno);
+}
+
+/**
+ * @brief Order keys for qsort().
+ */
+int compare_keys(const void *a, const void *b)
+{
+	return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+/**
+ * @brief Query a table and sort the keys found.
+ *
+ * @return The number of keys found.
+ */
+int query_sorted(const char *table, const char *predicates, char **keys)
+{
+	int found = storage_query(table, predicates, keys, NUM_RECORDS, test_conn);
+	fail_unless(found >= 0 && found <= NUM_RECORDS, "Query \"%s\" of %s failed with errno %d.", predicates, table, errno);
+	qsort(keys, found, sizeof keys[0], compare_keys);
+	return found;
+}
+
+/**
+ * @brief Check that a query finds the same keys in both tables of a pair.
+ *
+ * @return The number of keys found.
+ */
+int check_same(const char *indexed, const char *scanned, const char *predicates)
+{
+	char indexedBuffers[NUM_RECORDS][MAX_KEY_LEN];
+	char scannedBuffers[NUM_RECORDS][MAX_KEY_LEN];
+	char *indexedKeys[NUM_RECORDS];
+	char *scannedKeys[NUM_RECORDS];
+	int i;
+
+	for (i = 0; i < NUM_RECORDS; i++) {
+		indexedKeys[i] = indexedBuffers[i];
+		scannedKeys[i] = scannedBuffers[i];
+	}
+	int found = query_sorted(indexed, predicates, indexedKeys);
+	int expected = query_sorted(scanned, predicates, scannedKeys);
+	fail_unless(found == expected, "Query \"%s\" found %d keys in %s but %d in %s.",
+			predicates, found, indexed, expected, scanned);
+	for (i = 0; i < found; i++)
+		fail_unless(strcmp(indexedKeys[i], scannedKeys[i]) == 0, "Query \"%s\" found %s in %s but %s in %s.",
+				predicates, indexedKeys[i], indexed, scannedKeys[i], scanned);
+	return found;
+}
+
+
+
+/**
+ * @brief Text fixture setup.  Start the server and set the same records
+ * in the indexed and the scanned tables.
+ */
+void test_setup_populate()
+{
+	char key[MAX_KEY_LEN];
+	char value[MAX_VALUE_LEN];
+	int i;
+
+	test_conn = start_connect(TESTING_CONF, "testing.serverout", &test_server_pid);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+	for (i = 0; i < NUM_RECORDS; i++) {
+		snprintf(key, sizeof key, "key%d", i);
+		snprintf(value, sizeof value, INT_COLVAL, (i * 37) % NUM_RECORDS - 100, i % 11);
+		set_both(INDEXED, SCANNED, key, value);
+	}
+}
+
+/**
+ * @brief Text fixture teardown.  Disconnect and stop the server.
+ */
+void test_teardown()
+{
+	storage_disconnect(test_conn);
+	kill_server(test_server_pid);
+}
+
+
+
+START_TEST (test_index_int)
+{
+	fail_unless(check_same(INDEXED, SCANNED, "col1 > 50") > 0, "The range query found nothing.");
+	check_same(INDEXED, SCANNED, "col1 < -80");
+	fail_unless(check_same(INDEXED, SCANNED, "col1 = 57") == 1, "The equality query did not find one key.");
+	check_same(INDEXED, SCANNED, "col2 = 3");
+	check_same(INDEXED, SCANNED, "col1 > 0, col2 = 4");
+	check_same(INDEXED, SCANNED, "col1 < 40, col1 > 30");
+	fail_unless(check_same(INDEXED, SCANNED, "col1 > 500") == 0, "A query past every value found keys.");
+	fail_unless(check_same(INDEXED, SCANNED, "col1 = -101") == 0, "A query of a missing value found keys.");
+}
+END_TEST
+
+START_TEST (test_index_changes)
+{
+	char key[MAX_KEY_LEN];
+	char value[MAX_VALUE_LEN];
+	int i;
+
+	// Move some records to new values, delete others and add new ones.
+	for (i = 0; i < NUM_RECORDS; i += 3) {
+		snprintf(key, sizeof key, "key%d", i);
+		snprintf(value, sizeof value, INT_COLVAL, i % 50, 3);
+		set_both(INDEXED, SCANNED, key, value);
+	}
+	for (i = 1; i < NUM_RECORDS; i += 7) {
+		snprintf(key, sizeof key, "key%d", i);
+		set_both(INDEXED, SCANNED, key, NULL);
+	}
+	for (i = 0; i < 20; i++) {
+		snprintf(key, sizeof key, "new%d", i);
+		snprintf(value, sizeof value, INT_COLVAL, 57, i);
+		set_both(INDEXED, SCANNED, key, value);
+	}
+
+	check_same(INDEXED, SCANNED, "col1 > 50");
+	check_same(INDEXED, SCANNED, "col1 < 10");
+	check_same(INDEXED, SCANNED, "col1 = 57");
+	check_same(INDEXED, SCANNED, "col2 = 3");
+	check_same(INDEXED, SCANNED, "col1 > 20, col2 = 3");
+}
+END_TEST
+
+START_TEST (test_index_char)
+{
+	char key[MAX_KEY_LEN];
+	char value[MAX_VALUE_LEN];
+	int i;
+
+	for (i = 0; i < NUM_CHAR_RECORDS; i++) {
+		snprintf(key, sizeof key, "key%d", i);
+		snprintf(value, sizeof value, CHAR_COLVAL, names[i % NUM_NAMES], i);
+		set_both(CHARINDEXED, CHARSCANNED, key, value);
+	}
+
+	// "bo" is a prefix of "bob", but only equal names match.
+	fail_unless(check_same(CHARINDEXED, CHARSCANNED, "name = bob") == NUM_CHAR_RECORDS / NUM_NAMES,
+			"The equality query did not find every bob.");
+	check_same(CHARINDEXED, CHARSCANNED, "name = bo");
+	check_same(CHARINDEXED, CHARSCANNED, "name = bob, age > 30");
+	fail_unless(check_same(CHARINDEXED, CHARSCANNED, "name = eve") == 0, "A query of a missing name found keys.");
+
+	// Rename some records and delete others.
+	for (i = 0; i < NUM_CHAR_RECORDS; i += 4) {
+		snprintf(key, sizeof key, "key%d", i);
+		snprintf(value, sizeof value, CHAR_COLVAL, "eve", i);
+		set_both(CHARINDEXED, CHARSCANNED, key, value);
+	}
+	for (i = 1; i < NUM_CHAR_RECORDS; i += 6) {
+		snprintf(key, sizeof key, "key%d", i);
+		set_both(CHARINDEXED, CHARSCANNED, key, NULL);
+	}
+
+	check_same(CHARINDEXED, CHARSCANNED, "name = bob");
+	check_same(CHARINDEXED, CHARSCANNED, "name = alice");
+	fail_unless(check_same(CHARINDEXED, CHARSCANNED, "name = eve") > 0, "The renamed records were not found.");
+}
+END_TEST
+
+
+
+/**
+ * @brief This runs the index tests.
+ */
+int main(int argc, char *argv[])
+{
+	if(argc == 2)
+		server_port = atoi(argv[1]);
+	else
+		server_port = SERVERPORT;
+	printf("Using server port: %d.\n", server_port);
+	Suite *s = suite_create("index");
+	TCase *tc;
+
+	tc = tcase_create("test_index_int");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_populate, test_teardown);
+	tcase_add_test(tc, test_index_int);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_index_changes");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_populate, test_teardown);
+	tcase_add_test(tc, test_index_changes);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_index_char");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_populate, test_teardown);
+	tcase_add_test(tc, test_index_char);
+	suite_add_tcase(s, tc);
+
+	SRunner *sr = srunner_create(s);
+	srunner_set_log(sr, "results.log");
+	srunner_run_all(sr, CK_ENV);
+	srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,175 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include <errno.h>
+#include "storage.h"
+#include "fixture.h"
+
+#define TESTTIMEOUT	60		// How long to wait for each test to run.
+#define DATA_DIRECTORY	"mydata"	// The data_directory of the config file.
+#define TABLE1		"table1"	// The table to load.
+#define LOAD_FILE	"load.csv"	// The file loaded, written by the tests.
+#define NUM_GOOD	6		// Lines of load_lines that are loaded.
+#define NUM_BAD		5		// Lines of load_lines that are rejected.
+
+/// A file to load: good lines, bad ones, and empty ones that count as neither.
+static const char *load_lines =
+	"key0,col1 0, col2 0\n"
+	"key1,col1 1, col2 10\r\n"	// CRLF endings are accepted
+	"\n"
+	"key2,col1 2, col2 20\n"
+	"no comma\n"			// no value
+	"key3,\n"			// an empty value
+	"bad key,col1 3, col2 30\n"	// a key SET would refuse
+	"key4,col1 x, col2 40\n"	// not a number
+	"key5,col1 5\n"			// a column missing
+	"key6,col1 6, col2 60\n"
+	"\r\n"
+	"key7,col1 7, col2 70\n"
+	"key8,col1 8, col2 80";		// no final newline
+
+/// The keys of load_lines, and whether each is loaded.
+static const char *keys[] = { "key0", "key1", "key2", "key3", "key4", "key5", "key6", "key7", "key8" };
+static const int loaded[] = { 1, 1, 1, 0, 0, 0, 1, 1, 1 };
+
+/// The path of LOAD_FILE, as the server sees it.
+char load_path[1024];
+
+
+/**
+ * @brief Check that exactly the loaded keys of load_lines are in the table.
+ */
+void check_loaded()
+{
+	struct storage_record record;
+	int i;
+
+	for (i = 0; i < sizeof keys / sizeof keys[0]; i++) {
+		int status = storage_get(TABLE1, keys[i], &record, test_conn);
+		if (loaded[i])
+			fail_unless(status == 0, "storage_get of loaded %s failed with errno %d.", keys[i], errno);
+		else
+			fail_unless(status == -1 && errno == ERR_KEY_NOT_FOUND, "The rejected %s was loaded.", keys[i]);
+	}
+	int status = storage_get(TABLE1, "key1", &record, test_conn);
+	fail_unless(status == 0 && strcmp(record.value, "col1 1, col2 10") == 0, "key1 is \"%s\".", record.value);
+}
+
+
+
+/**
+ * @brief Text fixture setup.  Write the file to load, and start the
+ * server on an empty data directory.
+ */
+void test_setup()
+{
+	fail_unless(system("rm -rf " DATA_DIRECTORY) == 0, "Couldn't empty the data directory.");
+	FILE *file = fopen(LOAD_FILE, "w");
+	fail_unless(file != NULL && fputs(load_lines, file) >= 0 && fclose(file) == 0, "Couldn't write %s.", LOAD_FILE);
+	fail_unless(getcwd(load_path, sizeof load_path - sizeof LOAD_FILE - 1) != NULL, "Couldn't get the directory.");
+	strcat(load_path, "/" LOAD_FILE);
+
+	test_conn = start_connect(TESTING_CONF, "testing.serverout", &test_server_pid);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+}
+
+/**
+ * @brief Text fixture teardown.  Disconnect and stop the server.
+ */
+void test_teardown()
+{
+	storage_disconnect(test_conn);
+	kill_server(test_server_pid);
+	unlink(LOAD_FILE);
+}
+
+
+
+START_TEST (test_load_counts)
+{
+	char request[2048];
+	char reply[64];
+
+	// The reply counts the lines loaded and rejected.
+	int sock = connect_raw();
+	text_request(sock, "AUTH#" SERVERUSERNAME "#" SERVERPASSWORD_SENT "#\n", "SUCCESS");
+	snprintf(request, sizeof request, "LOAD#%s#%s#\n", TABLE1, load_path);
+	snprintf(reply, sizeof reply, "SUCCESS#%d#%d#", NUM_GOOD, NUM_BAD);
+	text_request(sock, request, reply);
+	close(sock);
+	check_loaded();
+
+	// Loading again updates the same records.
+	int count = storage_load(TABLE1, load_path, test_conn);
+	fail_unless(count == NUM_GOOD, "storage_load loaded %d records instead of %d.", count, NUM_GOOD);
+	check_loaded();
+}
+END_TEST
+
+START_TEST (test_load_invalid)
+{
+	int status = storage_load("missingtable", load_path, test_conn);
+	fail_unless(status == -1 && errno == ERR_TABLE_NOT_FOUND, "storage_load of a missing table should fail.");
+	status = storage_load(TABLE1, "/no/such/file.csv", test_conn);
+	fail_unless(status == -1 && errno == ERR_INVALID_PARAM, "storage_load of a missing file should fail.");
+}
+END_TEST
+
+START_TEST (test_load_restart)
+{
+	int count = storage_load(TABLE1, load_path, test_conn);
+	fail_unless(count == NUM_GOOD, "storage_load loaded %d records instead of %d.", count, NUM_GOOD);
+
+	// Loaded records are durable once LOAD replies.
+	storage_disconnect(test_conn);
+	kill_server(test_server_pid);
+	unlink(LOAD_FILE);
+	test_conn = start_connect(TESTING_CONF, "testing.serverout", &test_server_pid);
+	fail_unless(test_conn != NULL, "Couldn't restart or connect to server.");
+	check_loaded();
+}
+END_TEST
+
+
+
+/**
+ * @brief This runs the bulk load tests.
+ */
+int main(int argc, char *argv[])
+{
+	if(argc == 2)
+		server_port = atoi(argv[1]);
+	else
+		server_port = SERVERPORT;
+	printf("Using server port: %d.\n", server_port);
+	Suite *s = suite_create("load");
+	TCase *tc;
+
+	tc = tcase_create("test_load_counts");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup, test_teardown);
+	tcase_add_test(tc, test_load_counts);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_load_invalid");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup, test_teardown);
+	tcase_add_test(tc, test_load_invalid);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_load_restart");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup, test_teardown);
+	tcase_add_test(tc, test_load_restart);
+	suite_add_tcase(s, tc);
+
+	SRunner *sr = srunner_create(s);
+	srunner_set_log(sr, "results.log");
+	srunner_run_all(sr, CK_ENV);
+	srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,242 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <check.h>
+#include "hashTable.h"
+
+#define TESTTIMEOUT	60		// How long to wait for each test to run.
+#define NUM_RECORDS	5000		// Records set in a table by the tests.
+#define NUM_ROUNDS	5		// Rounds of deletes and sets.
+#define NUM_THREADS	4		// Threads changing a table at once.
+#define NUM_SWITCHES	20		// Times the tables sharing a slot take turns.
+#define SMALL_VALUE	"col1 %d, col2 %d"	// A value that fits the block of its entry.
+
+/// The table of the test.
+HashTable *test_table = NULL;
+
+
+/**
+ * @brief Set the records numbered from first to last - 1, stepping by step.
+ */
+void set_records(int first, int last, int step, int generation)
+{
+	char key[MAX_KEY_LEN];
+	char value[MAX_VALUE_LEN];
+	int i;
+
+	for (i = first; i < last; i += step) {
+		snprintf(key, sizeof key, "key%d", i);
+		snprintf(value, sizeof value, SMALL_VALUE, i, generation);
+		int status = ht_set(test_table, key, value);
+		fail_unless(status == HASH_SET_INSERT || status == HASH_SET_UPDATE, "ht_set of %s failed.", key);
+	}
+}
+
+/**
+ * @brief Remove the records numbered from first to last - 1, stepping by step.
+ */
+void remove_records(int first, int last, int step)
+{
+	char key[MAX_KEY_LEN];
+	int i;
+
+	for (i = first; i < last; i += step) {
+		snprintf(key, sizeof key, "key%d", i);
+		fail_unless(ht_removeItem(test_table, key) == HASH_SET_DELETE, "ht_removeItem of %s failed.", key);
+	}
+}
+
+/**
+ * @brief Start routine of a thread churning its own records: every
+ * NUM_THREADS-th one, starting at its number.
+ */
+void *churn(void *arg)
+{
+	int first = *(int *) arg;
+	int round;
+
+	for (round = 0; round < NUM_ROUNDS; round++) {
+		set_records(first, NUM_RECORDS, NUM_THREADS, round);
+		remove_records(first, NUM_RECORDS, NUM_THREADS);
+	}
+	set_records(first, NUM_RECORDS, NUM_THREADS, NUM_ROUNDS);
+	return NULL;
+}
+
+
+
+/**
+ * @brief Text fixture setup.  Create an empty table.
+ */
+void test_setup()
+{
+	test_table = ht_create(HT_DEFAULT_SIZE);
+	fail_unless(test_table != NULL, "ht_create failed.");
+}
+
+/**
+ * @brief Text fixture teardown.  Free the table.
+ */
+void test_teardown()
+{
+	ht_removeAll(test_table);
+}
+
+
+
+START_TEST (test_memory_churn)
+{
+	size_t inUse, reserved, fullInUse, fullReserved;
+	int round;
+
+	set_records(0, NUM_RECORDS, 1, 0);
+	ht_memoryUsage(test_table, &fullInUse, &fullReserved);
+	fail_unless(fullInUse > 0 && fullInUse <= fullReserved, "%zu bytes in use in %zu reserved.", fullInUse, fullReserved);
+
+	// Deleting every record frees every block.
+	remove_records(0, NUM_RECORDS, 1);
+	ht_memoryUsage(test_table, &inUse, &reserved);
+	fail_unless(inUse == 0, "%zu bytes are still in use after deleting every record.", inUse);
+
+	// Freed blocks are reused: sets after deletes reserve nothing more.
+	for (round = 1; round <= NUM_ROUNDS; round++) {
+		set_records(0, NUM_RECORDS, 1, round);
+		remove_records(0, NUM_RECORDS, 2);
+	}
+	set_records(0, NUM_RECORDS, 1, 0);
+	ht_memoryUsage(test_table, &inUse, &reserved);
+	fail_unless(inUse == fullInUse, "%zu bytes in use instead of %zu.", inUse, fullInUse);
+	fail_unless(reserved == fullReserved, "%zu bytes reserved instead of %zu.", reserved, fullReserved);
+}
+END_TEST
+
+START_TEST (test_memory_updates)
+{
+	char large[MAX_VALUE_LEN];
+	size_t inUse, reserved, smallInUse, smallReserved;
+
+	set_records(0, NUM_RECORDS, 1, 0);
+	ht_memoryUsage(test_table, &smallInUse, &smallReserved);
+
+	// A value too large for its entry's block moves to a block of its own.
+	memset(large, 'x', sizeof large - 1);
+	large[sizeof large - 1] = '\0';
+	fail_unless(ht_set(test_table, "key0", large) == HASH_SET_UPDATE, "ht_set of a large value failed.");
+	ht_memoryUsage(test_table, &inUse, &reserved);
+	fail_unless(inUse > smallInUse, "The large value takes no memory.");
+
+	// Setting a small value again frees that block.
+	set_records(0, 1, 1, 1);
+	ht_memoryUsage(test_table, &inUse, &reserved);
+	fail_unless(inUse == smallInUse, "%zu bytes in use instead of %zu.", inUse, smallInUse);
+}
+END_TEST
+
+START_TEST (test_memory_threads)
+{
+	pthread_t threads[NUM_THREADS];
+	int firsts[NUM_THREADS];
+	size_t inUse, reserved, fullInUse, fullReserved;
+	int i;
+
+	// The records each thread leaves are those a single thread sets.
+	set_records(0, NUM_RECORDS, 1, NUM_ROUNDS);
+	ht_memoryUsage(test_table, &fullInUse, &fullReserved);
+	remove_records(0, NUM_RECORDS, 1);
+
+	for (i = 0; i < NUM_THREADS; i++) {
+		firsts[i] = i;
+		fail_unless(pthread_create(&threads[i], NULL, churn, &firsts[i]) == 0, "pthread_create failed.");
+	}
+	for (i = 0; i < NUM_THREADS; i++)
+		pthread_join(threads[i], NULL);
+	ht_memoryUsage(test_table, &inUse, &reserved);
+	fail_unless(inUse == fullInUse, "%zu bytes in use instead of %zu.", inUse, fullInUse);
+
+	// The free lists of the exited threads went back to the table.
+	remove_records(0, NUM_RECORDS, 1);
+	ht_memoryUsage(test_table, &inUse, &reserved);
+	fail_unless(inUse == 0, "%zu bytes are still in use after deleting every record.", inUse);
+	set_records(0, NUM_RECORDS, 1, NUM_ROUNDS);
+	ht_memoryUsage(test_table, &inUse, &reserved);
+	fail_unless(reserved <= NUM_THREADS * fullReserved, "%zu bytes reserved for %zu in use.", reserved, inUse);
+}
+END_TEST
+
+START_TEST (test_memory_shared_slot)
+{
+	HashTable *others[SLAB_CACHES];
+	size_t inUse, reserved, fullInUse, fullReserved;
+	int i;
+
+	set_records(0, NUM_RECORDS, 1, 0);
+	ht_memoryUsage(test_table, &fullInUse, &fullReserved);
+
+	// The slab of the last table takes the slot of the test table's
+	// free lists in this thread, which go back to the test table.
+	for (i = 0; i < SLAB_CACHES; i++) {
+		others[i] = ht_create(HT_DEFAULT_SIZE);
+		fail_unless(others[i] != NULL, "ht_create failed.");
+	}
+	for (i = 0; i < NUM_SWITCHES; i++) {
+		remove_records(0, NUM_RECORDS, 1);
+		fail_unless(ht_set(others[SLAB_CACHES - 1], "key0", "col1 0, col2 0") == HASH_SET_INSERT,
+				"ht_set in the other table failed.");
+		fail_unless(ht_removeItem(others[SLAB_CACHES - 1], "key0") == HASH_SET_DELETE,
+				"ht_removeItem in the other table failed.");
+		set_records(0, NUM_RECORDS, 1, i);
+	}
+	ht_memoryUsage(test_table, &inUse, &reserved);
+	fail_unless(inUse == fullInUse, "%zu bytes in use instead of %zu.", inUse, fullInUse);
+	fail_unless(reserved == fullReserved, "%zu bytes reserved instead of %zu.", reserved, fullReserved);
+
+	for (i = 0; i < SLAB_CACHES; i++) {
+		ht_removeAll(others[i]);
+		free(others[i]);
+	}
+}
+END_TEST
+
+
+
+/**
+ * @brief This runs the table memory tests.
+ */
+int main(int argc, char *argv[])
+{
+	Suite *s = suite_create("memory");
+	TCase *tc;
+
+	tc = tcase_create("test_memory_churn");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup, test_teardown);
+	tcase_add_test(tc, test_memory_churn);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_memory_updates");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup, test_teardown);
+	tcase_add_test(tc, test_memory_updates);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_memory_threads");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup, test_teardown);
+	tcase_add_test(tc, test_memory_threads);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_memory_shared_slot");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup, test_teardown);
+	tcase_add_test(tc, test_memory_shared_slot);
+	suite_add_tcase(s, tc);
+
+	SRunner *sr = srunner_create(s);
+	srunner_set_log(sr, "results.log");
+	srunner_run_all(sr, CK_ENV);
+	srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return EXIT_SUCCESS;
+}
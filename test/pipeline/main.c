@@ -0,0 +1,361 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include "storage.h"
+#include "fixture.h"
+
+#define TESTTIMEOUT	60		// How long to wait for each test to run.
+#define TABLE1		"table1"	// The table to use.
+
+#define COLVAL		"col1 %d, col2 %d"	// The value of a record, given its number and generation.
+#define NUM_RECORDS	100		// Records set and read back by a pipeline.
+#define POOL_CONF	"pool.conf"	// The thread pool mode, with one worker.
+#define NUM_LOADED	3000		// Records loaded for queries with long replies.
+#define LONG_KEY	"longkey%012d"	// A key of MAX_KEY_LEN - 1 characters, given its number.
+#define LOAD_FILE	"long.csv"	// The file they are loaded from, written by the test.
+#define NUM_QUERIES	200		// Queries sent by a client that does not read the replies.
+
+
+/**
+ * @brief Submit a set of each record, then a get of each.
+ *
+ * @param generation Part of the values, so each pipeline sets new ones.
+ * @param ids Set to the id of each request, sets first.
+ */
+void submit_records(int generation, int *ids)
+{
+	struct storage_record record;
+	char key[MAX_KEY_LEN];
+	int i;
+
+	memset(&record, 0, sizeof record);
+	for (i = 0; i < NUM_RECORDS; i++) {
+		snprintf(key, sizeof key, "key%d", i);
+		snprintf(record.value, sizeof record.value, COLVAL, i, generation);
+		ids[i] = storage_submit_set(TABLE1, key, &record, test_conn);
+		fail_unless(ids[i] >= 0, "storage_submit_set of %s failed with errno %d.", key, errno);
+	}
+	for (i = 0; i < NUM_RECORDS; i++) {
+		snprintf(key, sizeof key, "key%d", i);
+		ids[NUM_RECORDS + i] = storage_submit_get(TABLE1, key, test_conn);
+		fail_unless(ids[NUM_RECORDS + i] >= 0, "storage_submit_get of %s failed with errno %d.", key, errno);
+	}
+}
+
+/**
+ * @brief Collect the results of submit_records() and check they come
+ * back in order, each with the value set just before.
+ */
+void poll_records(int generation, int *ids)
+{
+	struct storage_result result;
+	char value[MAX_VALUE_LEN];
+	int i;
+
+	for (i = 0; i < 2 * NUM_RECORDS; i++) {
+		int status = storage_poll(test_conn, &result, 1);
+		fail_unless(status == 1, "storage_poll of request %d returned %d with errno %d.", i, status, errno);
+		fail_unless(result.id == ids[i], "storage_poll returned id %d instead of %d.", result.id, ids[i]);
+		fail_unless(result.status == 0, "Request %d failed with status %d.", i, result.status);
+		if (i >= NUM_RECORDS) {
+			snprintf(value, sizeof value, COLVAL, i - NUM_RECORDS, generation);
+			fail_unless(strcmp(result.record.value, value) == 0,
+					"Get %d returned %s instead of %s.", i - NUM_RECORDS, result.record.value, value);
+		}
+	}
+
+	// Nothing is left pending.
+	fail_unless(storage_poll(test_conn, &result, 1) == 0, "storage_poll returned a result nothing was submitted for.");
+}
+
+
+
+/**
+ * @brief Text fixture setup.  Start the server and connect with the text protocol.
+ */
+void test_setup_text()
+{
+	test_conn = start_connect_protocol(TESTING_CONF, "testing.serverout", &test_server_pid, STORAGE_PROTOCOL_TEXT);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+}
+
+/**
+ * @brief Text fixture setup.  Start the server and connect with the binary protocol.
+ */
+void test_setup_binary()
+{
+	test_conn = start_connect_protocol(TESTING_CONF, "testing.serverout", &test_server_pid, STORAGE_PROTOCOL_BINARY);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+}
+
+/**
+ * @brief Text fixture setup.  Start the server in the thread pool mode
+ * and connect with the text protocol.
+ */
+void test_setup_pool()
+{
+	test_conn = start_connect_protocol(POOL_CONF, "pool.serverout", &test_server_pid, STORAGE_PROTOCOL_TEXT);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+}
+
+/**
+ * @brief Text fixture teardown.  Disconnect and stop the server.
+ */
+void test_teardown()
+{
+	storage_disconnect(test_conn);
+	kill_server(test_server_pid);
+}
+
+
+
+START_TEST (test_pipeline_order)
+{
+	int ids[2 * NUM_RECORDS];
+	int i;
+
+	// Ids are distinct and increase in the order submitted.
+	submit_records(1, ids);
+	for (i = 1; i < 2 * NUM_RECORDS; i++)
+		fail_unless(ids[i] > ids[i - 1], "Request %d got id %d after id %d.", i, ids[i], ids[i - 1]);
+	poll_records(1, ids);
+
+	// A second pipeline on the same connection overwrites the first.
+	submit_records(2, ids);
+	poll_records(2, ids);
+}
+END_TEST
+
+START_TEST (test_pipeline_delete)
+{
+	struct storage_record record;
+	struct storage_result result;
+
+	memset(&record, 0, sizeof record);
+	snprintf(record.value, sizeof record.value, COLVAL, 0, 0);
+	int set = storage_submit_set(TABLE1, "key0", &record, test_conn);
+	int del = storage_submit_set(TABLE1, "key0", NULL, test_conn);
+	int get = storage_submit_get(TABLE1, "key0", test_conn);
+	int again = storage_submit_set(TABLE1, "key0", NULL, test_conn);
+	fail_unless(set >= 0 && del >= 0 && get >= 0 && again >= 0, "Submitting failed with errno %d.", errno);
+
+	fail_unless(storage_poll(test_conn, &result, 1) == 1 && result.id == set && result.status == 0,
+			"The set before the delete failed.");
+	fail_unless(storage_poll(test_conn, &result, 1) == 1 && result.id == del && result.status == 0,
+			"The delete failed with status %d.", result.status);
+	fail_unless(storage_poll(test_conn, &result, 1) == 1 && result.id == get && result.status == ERR_KEY_NOT_FOUND,
+			"The get of a deleted key returned status %d.", result.status);
+	fail_unless(storage_poll(test_conn, &result, 1) == 1 && result.id == again && result.status == ERR_KEY_NOT_FOUND,
+			"The delete of a missing key returned status %d.", result.status);
+}
+END_TEST
+
+START_TEST (test_pipeline_poll_empty)
+{
+	struct storage_result result;
+
+	fail_unless(storage_poll(test_conn, &result, 0) == 0, "storage_poll without a request should return 0.");
+	fail_unless(storage_poll(test_conn, &result, 1) == 0, "storage_poll waiting without a request should return 0.");
+
+	// Without waiting, the reply is collected once it has arrived.
+	int id = storage_submit_get(TABLE1, "missingkey", test_conn);
+	fail_unless(id >= 0, "storage_submit_get failed with errno %d.", errno);
+	int status;
+	while ((status = storage_poll(test_conn, &result, 0)) == 0)
+		usleep(1000);
+	fail_unless(status == 1 && result.id == id && result.status == ERR_KEY_NOT_FOUND,
+			"storage_poll returned %d, id %d and status %d.", status, result.id, result.status);
+	fail_unless(storage_poll(test_conn, &result, 0) == 0, "storage_poll of a drained connection should return 0.");
+}
+END_TEST
+
+START_TEST (test_pipeline_busy)
+{
+	struct storage_record record;
+	struct storage_result result;
+
+	int id = storage_submit_get(TABLE1, "key0", test_conn);
+	fail_unless(id >= 0, "storage_submit_get failed with errno %d.", errno);
+
+	// Other calls would read the reply meant for the pending request.
+	int status = storage_get(TABLE1, "key0", &record, test_conn);
+	fail_unless(status == -1 && errno == ERR_INVALID_PARAM, "storage_get with a request pending should fail.");
+	memset(&record, 0, sizeof record);
+	snprintf(record.value, sizeof record.value, COLVAL, 0, 0);
+	status = storage_set(TABLE1, "key0", &record, test_conn);
+	fail_unless(status == -1 && errno == ERR_INVALID_PARAM, "storage_set with a request pending should fail.");
+
+	fail_unless(storage_poll(test_conn, &result, 1) == 1 && result.id == id, "storage_poll failed.");
+	status = storage_set(TABLE1, "key0", &record, test_conn);
+	fail_unless(status == 0, "storage_set after the poll failed with errno %d.", errno);
+}
+END_TEST
+
+START_TEST (test_pipeline_limit)
+{
+	struct storage_result result;
+	int i;
+
+	for (i = 0; i < MAX_PENDING_REQUESTS; i++)
+		fail_unless(storage_submit_get(TABLE1, "key0", test_conn) >= 0,
+				"storage_submit_get %d failed with errno %d.", i, errno);
+	int status = storage_submit_get(TABLE1, "key0", test_conn);
+	fail_unless(status == -1 && errno == ERR_INVALID_PARAM, "storage_submit_get past the pending limit should fail.");
+
+	for (i = 0; i < MAX_PENDING_REQUESTS; i++)
+		fail_unless(storage_poll(test_conn, &result, 1) == 1, "storage_poll %d failed with errno %d.", i, errno);
+	fail_unless(storage_submit_get(TABLE1, "key0", test_conn) >= 0, "storage_submit_get after draining failed.");
+	fail_unless(storage_poll(test_conn, &result, 1) == 1, "storage_poll after draining failed.");
+}
+END_TEST
+
+START_TEST (test_pipeline_slow_reader)
+{
+	struct storage_record record;
+	char path[1024];
+	char request[256];
+	char buffer[4096];
+	int i;
+
+	FILE *file = fopen(LOAD_FILE, "w");
+	fail_unless(file != NULL, "Couldn't write %s.", LOAD_FILE);
+	for (i = 0; i < NUM_LOADED; i++)
+		fprintf(file, LONG_KEY ",col1 %d, col2 9\n", i, i);
+	fail_unless(fclose(file) == 0, "Couldn't write %s.", LOAD_FILE);
+	fail_unless(getcwd(path, sizeof path - sizeof LOAD_FILE - 1) != NULL, "Couldn't get the directory.");
+	strcat(path, "/" LOAD_FILE);
+	int count = storage_load(TABLE1, path, test_conn);
+	unlink(LOAD_FILE);
+	fail_unless(count == NUM_LOADED, "storage_load loaded %d records instead of %d.", count, NUM_LOADED);
+
+	// Far more replies than the socket takes, none read for now.
+	int sock = connect_raw();
+	text_request(sock, "AUTH#" SERVERUSERNAME "#" SERVERPASSWORD_SENT "#\n", "SUCCESS");
+	snprintf(request, sizeof request, "QUERY#%s#col2 = 9#%d#\n", TABLE1, NUM_LOADED);
+	for (i = 0; i < NUM_QUERIES; i++)
+		send_bytes(sock, request, strlen(request));
+	sleep(1);
+
+	// The only worker is not held up by that client.
+	memset(&record, 0, sizeof record);
+	snprintf(record.value, sizeof record.value, COLVAL, 1, 1);
+	fail_unless(storage_set(TABLE1, "key1", &record, test_conn) == 0, "storage_set failed with errno %d.", errno);
+	fail_unless(storage_get(TABLE1, "key1", &record, test_conn) == 0, "storage_get failed with errno %d.", errno);
+
+	// Every reply still arrives in full: its "MORE#" lines, then the count.
+	const char *last = "SUCCESS#3000#";
+	char line[16];
+	size_t length = 0;
+	int replies = 0;
+	while (replies < NUM_QUERIES) {
+		ssize_t bytes = recv(sock, buffer, sizeof buffer, 0);
+		fail_unless(bytes > 0, "The server closed the connection after %d replies.", replies);
+		for (i = 0; i < bytes; i++) {
+			if (buffer[i] != '\n') {
+				if (length < sizeof line)
+					line[length] = buffer[i];
+				length++;
+				continue;
+			}
+			if (length >= strlen(last) && strncmp(line, last, strlen(last)) == 0)
+				replies++;
+			length = 0;
+		}
+	}
+	close(sock);
+}
+END_TEST
+
+
+
+/**
+ * @brief This runs the pipelining tests.
+ */
+int main(int argc, char *argv[])
+{
+	if(argc == 2)
+		server_port = atoi(argv[1]);
+	else
+		server_port = SERVERPORT;
+	printf("Using server port: %d.\n", server_port);
+	Suite *s = suite_create("pipeline");
+	TCase *tc;
+
+	tc = tcase_create("test_pipeline_order_text");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_text, test_teardown);
+	tcase_add_test(tc, test_pipeline_order);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_pipeline_order_binary");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_binary, test_teardown);
+	tcase_add_test(tc, test_pipeline_order);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_pipeline_delete_text");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_text, test_teardown);
+	tcase_add_test(tc, test_pipeline_delete);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_pipeline_delete_binary");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_binary, test_teardown);
+	tcase_add_test(tc, test_pipeline_delete);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_pipeline_poll_empty_text");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_text, test_teardown);
+	tcase_add_test(tc, test_pipeline_poll_empty);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_pipeline_poll_empty_binary");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_binary, test_teardown);
+	tcase_add_test(tc, test_pipeline_poll_empty);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_pipeline_busy_text");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_text, test_teardown);
+	tcase_add_test(tc, test_pipeline_busy);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_pipeline_busy_binary");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_binary, test_teardown);
+	tcase_add_test(tc, test_pipeline_busy);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_pipeline_limit_text");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_text, test_teardown);
+	tcase_add_test(tc, test_pipeline_limit);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_pipeline_limit_binary");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_binary, test_teardown);
+	tcase_add_test(tc, test_pipeline_limit);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_pipeline_slow_reader");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_pool, test_teardown);
+	tcase_add_test(tc, test_pipeline_slow_reader);
+	suite_add_tcase(s, tc);
+
+	SRunner *sr = srunner_create(s);
+	srunner_set_log(sr, "results.log");
+	srunner_run_all(sr, CK_ENV);
+	srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return EXIT_SUCCESS;
+}
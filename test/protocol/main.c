@@ -0,0 +1,334 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <stdint.h>
+#include "storage.h"
+#include "fixture.h"
+
+#define TESTTIMEOUT	10		// How long to wait for each test to run.
+#define TABLE1		"table1"	// The table of int columns.
+#define TABLE2		"table2"	// The table of a char column and an int column.
+#define MISSINGKEY	"missingkey"	// A non-existing key.
+
+// The binary protocol, as in utils.h of the server.
+#define FRAME_MAGIC	0xB5
+#define FRAME_HEADER_LEN	12
+#define OP_AUTH		1
+#define OP_GET		2
+#define OP_SET		3
+#define OP_QUERY	4
+#define OP_UNKNOWN	200		// An opcode the server does not have.
+
+/// Plain socket used by the tests of malformed requests.
+int test_sock = -1;
+
+
+/**
+ * @brief Set a record, and check that it was set.
+ */
+void set_value(const char *table, const char *key, const char *value, void *conn)
+{
+	struct storage_record record;
+
+	memset(&record, 0, sizeof record);
+	strncpy(record.value, value, sizeof record.value - 1);
+	int status = storage_set(table, key, &record, conn);
+	fail_unless(status == 0, "storage_set of %s failed with errno %d.", key, errno);
+}
+
+/**
+ * @brief Get a record, and check its value.
+ */
+void check_value(const char *table, const char *key, const char *expected, void *conn)
+{
+	struct storage_record record;
+
+	int status = storage_get(table, key, &record, conn);
+	fail_unless(status == 0, "storage_get of %s failed with errno %d.", key, errno);
+	fail_unless(strcmp(record.value, expected) == 0, "storage_get of %s returned \"%s\" instead of \"%s\".",
+			key, record.value, expected);
+}
+
+
+/**
+ * @brief Check that the server is still running.
+ */
+void check_server_alive()
+{
+	int status;
+	fail_unless(waitpid(test_server_pid, &status, WNOHANG) == 0, "The server exited with status %d.", status);
+}
+
+/**
+ * @brief Send a frame on the plain socket and check the status and
+ * request id of the reply.
+ *
+ * @param payload The fields, each with its 4 byte length.
+ * @param len The bytes of payload.
+ */
+void frame_request(int opcode, uint32_t id, const char *payload, size_t len, int expected)
+{
+	unsigned char header[FRAME_HEADER_LEN] = { FRAME_MAGIC, (unsigned char) opcode, 0, 0,
+		id >> 24, id >> 16, id >> 8, id, len >> 24, len >> 16, len >> 8, len };
+	unsigned char reply[FRAME_HEADER_LEN];
+	char discard[256];
+
+	send_bytes(test_sock, header, sizeof header);
+	if (len > 0)
+		send_bytes(test_sock, payload, len);
+	recv_bytes(test_sock, reply, sizeof reply);
+	fail_unless(reply[0] == FRAME_MAGIC, "The reply is not a frame.");
+	uint32_t replyId = (uint32_t) reply[4] << 24 | reply[5] << 16 | reply[6] << 8 | reply[7];
+	uint32_t replyLen = (uint32_t) reply[8] << 24 | reply[9] << 16 | reply[10] << 8 | reply[11];
+	int status = reply[2] << 8 | reply[3];
+	fail_unless(replyLen < sizeof discard, "The reply is too long.");
+	recv_bytes(test_sock, discard, replyLen);
+	fail_unless(replyId == id, "The reply has request id %u instead of %u.", replyId, id);
+	fail_unless(status == expected, "The reply to opcode %d has status %d instead of %d.", opcode, status, expected);
+}
+
+/**
+ * @brief Append a field, with its length, to a frame payload.
+ * @return The new length of the payload.
+ */
+size_t add_field(char *payload, size_t len, const char *field)
+{
+	uint32_t fieldLen = strlen(field);
+
+	payload[len++] = fieldLen >> 24;
+	payload[len++] = fieldLen >> 16;
+	payload[len++] = fieldLen >> 8;
+	payload[len++] = fieldLen;
+	memcpy(payload + len, field, fieldLen);
+	return len + fieldLen;
+}
+
+
+
+/**
+ * @brief Text fixture setup.  Start the server and connect to it with
+ * the binary protocol.
+ */
+void test_setup_binary()
+{
+	test_conn = start_connect_protocol(TESTING_CONF, "testing.serverout", &test_server_pid, STORAGE_PROTOCOL_BINARY);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+}
+
+/**
+ * @brief Text fixture setup.  Start the server and connect a plain socket.
+ */
+void test_setup_raw()
+{
+	test_server_pid = start_server(TESTING_CONF, NULL, "testing.serverout");
+	fail_unless(test_server_pid > 0, "Server didn't run properly.");
+	test_sock = connect_raw();
+}
+
+/**
+ * @brief Text fixture teardown.  Disconnect and stop the server.
+ */
+void test_teardown()
+{
+	storage_disconnect(test_conn);
+	kill_server(test_server_pid);
+}
+
+/**
+ * @brief Text fixture teardown.  Close the plain socket and stop the server.
+ */
+void test_teardown_raw()
+{
+	close(test_sock);
+	kill_server(test_server_pid);
+}
+
+
+
+START_TEST (test_binary_requests)
+{
+	char keyBuffers[2][MAX_KEY_LEN];
+	char *keys[2] = { keyBuffers[0], keyBuffers[1] };
+	struct storage_record record;
+
+	set_value(TABLE1, "key1", "col1 1, col2 2", test_conn);
+	set_value(TABLE1, "key2", "col1 5, col2 2", test_conn);
+	check_value(TABLE1, "key1", "col1 1, col2 2", test_conn);
+
+	int found = storage_query(TABLE1, "col1 > 2", keys, 2, test_conn);
+	fail_unless(found == 1 && strcmp(keys[0], "key2") == 0, "storage_query found %d keys.", found);
+
+	// Errors come back in the frame status.
+	int status = storage_get(TABLE1, MISSINGKEY, &record, test_conn);
+	fail_unless(status == -1 && errno == ERR_KEY_NOT_FOUND, "storage_get of a missing key should fail.");
+	status = storage_get("missingtable", "key1", &record, test_conn);
+	fail_unless(status == -1 && errno == ERR_TABLE_NOT_FOUND, "storage_get of a missing table should fail.");
+
+	// Deleting uses an empty value field.
+	status = storage_set(TABLE1, "key1", NULL, test_conn);
+	fail_unless(status == 0, "storage_set of NULL failed with errno %d.", errno);
+	status = storage_get(TABLE1, "key1", &record, test_conn);
+	fail_unless(status == -1 && errno == ERR_KEY_NOT_FOUND, "A deleted key was found.");
+}
+END_TEST
+
+START_TEST (test_binary_separator_value)
+{
+	// '#' separates the fields of a text request, but is plain data in a frame.
+	set_value(TABLE2, "hash", "name a#b#c, age 7", test_conn);
+	check_value(TABLE2, "hash", "name a#b#c, age 7", test_conn);
+}
+END_TEST
+
+START_TEST (test_text_and_binary)
+{
+	// A text connection to the same server sees the records set in frames.
+	set_value(TABLE1, "shared", "col1 3, col2 4", test_conn);
+	void *text_conn = storage_connect(SERVERHOST, server_port);
+	fail_unless(text_conn != NULL, "Couldn't connect to server.");
+	fail_unless(storage_auth(SERVERUSERNAME, SERVERPASSWORD, text_conn) == 0, "Authentication failed.");
+	check_value(TABLE1, "shared", "col1 3, col2 4", text_conn);
+
+	set_value(TABLE1, "shared", "col1 9, col2 4", text_conn);
+	check_value(TABLE1, "shared", "col1 9, col2 4", test_conn);
+	storage_disconnect(text_conn);
+}
+END_TEST
+
+START_TEST (test_text_missing_fields)
+{
+	text_request(test_sock, "AUTH#\n", "Error#1#");
+	text_request(test_sock, "AUTH#" SERVERUSERNAME "#\n", "Error#1#");
+	text_request(test_sock, "AUTH#" SERVERUSERNAME "#" SERVERPASSWORD_SENT "#\n", "SUCCESS");
+
+	text_request(test_sock, "GET#\n", "Error#1#");
+	text_request(test_sock, "GET#" TABLE1 "#\n", "Error#1#");
+	text_request(test_sock, "SET#" TABLE1 "#\n", "Error#1#");
+	text_request(test_sock, "SET#" TABLE1 "#key#col1 1, col2 2#\n", "Error#1#");
+	text_request(test_sock, "QUERY#" TABLE1 "#\n", "Error#1#");
+	text_request(test_sock, "QUERY#" TABLE1 "#col1 > 0#\n", "Error#1#");
+	text_request(test_sock, "NOSUCHCOMMAND#\n", "Error#1#");
+
+	// Still serving.
+	text_request(test_sock, "GET#" TABLE1 "#" MISSINGKEY "#\n", "Error#6#");
+	check_server_alive();
+}
+END_TEST
+
+START_TEST (test_binary_truncated_frames)
+{
+	char payload[256];
+	size_t len;
+
+	text_request(test_sock, "BINARY#\n", "SUCCESS#");
+
+	// No fields, then a field longer than the frame.
+	frame_request(OP_AUTH, 1, NULL, 0, ERR_INVALID_PARAM);
+	len = add_field(payload, 0, SERVERUSERNAME);
+	frame_request(OP_AUTH, 2, payload, len, ERR_INVALID_PARAM);
+	payload[len] = 0;
+	payload[len + 1] = 0;
+	payload[len + 2] = 0;
+	payload[len + 3] = 100;
+	frame_request(OP_AUTH, 3, payload, len + 4, ERR_INVALID_PARAM);
+
+	len = add_field(payload, 0, SERVERUSERNAME);
+	len = add_field(payload, len, SERVERPASSWORD_SENT);
+	frame_request(OP_AUTH, 4, payload, len, 0);
+
+	frame_request(OP_GET, 5, NULL, 0, ERR_INVALID_PARAM);
+	len = add_field(payload, 0, TABLE1);
+	frame_request(OP_GET, 6, payload, len, ERR_INVALID_PARAM);
+	frame_request(OP_SET, 7, payload, len, ERR_INVALID_PARAM);
+	len = add_field(payload, len, "key");
+	len = add_field(payload, len, "col1 1, col2 2");
+	frame_request(OP_SET, 8, payload, len, ERR_INVALID_PARAM);
+	len = add_field(payload, 0, TABLE1);
+	frame_request(OP_QUERY, 9, payload, len, ERR_INVALID_PARAM);
+	len = add_field(payload, len, "col1 > 0");
+	frame_request(OP_QUERY, 10, payload, len, ERR_INVALID_PARAM);
+	frame_request(OP_UNKNOWN, 11, NULL, 0, ERR_INVALID_PARAM);
+
+	// Still serving.
+	len = add_field(payload, 0, TABLE1);
+	len = add_field(payload, len, MISSINGKEY);
+	frame_request(OP_GET, 12, payload, len, ERR_KEY_NOT_FOUND);
+	check_server_alive();
+}
+END_TEST
+
+START_TEST (test_binary_before_auth)
+{
+	// A request with no fields is refused before the login too.
+	text_request(test_sock, "BINARY#\n", "SUCCESS#");
+	frame_request(OP_AUTH, 1, NULL, 0, ERR_INVALID_PARAM);
+	frame_request(OP_GET, 2, NULL, 0, ERR_NOT_AUTHENTICATED);
+	check_server_alive();
+}
+END_TEST
+
+
+
+/**
+ * @brief This runs the protocol tests.
+ */
+int main(int argc, char *argv[])
+{
+	if(argc == 2)
+		server_port = atoi(argv[1]);
+	else
+		server_port = SERVERPORT;
+	printf("Using server port: %d.\n", server_port);
+	signal(SIGPIPE, SIG_IGN);
+	Suite *s = suite_create("protocol");
+	TCase *tc;
+
+	tc = tcase_create("test_binary_requests");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_binary, test_teardown);
+	tcase_add_test(tc, test_binary_requests);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_binary_separator_value");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_binary, test_teardown);
+	tcase_add_test(tc, test_binary_separator_value);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_text_and_binary");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_binary, test_teardown);
+	tcase_add_test(tc, test_text_and_binary);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_text_missing_fields");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_raw, test_teardown_raw);
+	tcase_add_test(tc, test_text_missing_fields);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_binary_truncated_frames");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_raw, test_teardown_raw);
+	tcase_add_test(tc, test_binary_truncated_frames);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_binary_before_auth");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_raw, test_teardown_raw);
+	tcase_add_test(tc, test_binary_before_auth);
+	suite_add_tcase(s, tc);
+
+	SRunner *sr = srunner_create(s);
+	srunner_set_log(sr, "results.log");
+	srunner_run_all(sr, CK_ENV);
+	srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return EXIT_SUCCESS;
+}
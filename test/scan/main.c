@@ -0,0 +1,267 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include <errno.h>
+#include "storage.h"
+#include "fixture.h"
+
+#define TESTTIMEOUT	60		// How long to wait for each test to run.
+#define TABLE		"numbers"	// The table, large enough to be scanned in parallel.
+
+#define INT_COLVAL	"col1 %d, col2 %d"	// A record of the table, given col1 and col2.
+#define NUM_RECORDS	300		// Records set in the table by the fixture.
+#define MAX_KEYS	10		// Keys asked for by the truncated queries.
+#define NUM_LOADED	3000		// Records loaded for a result longer than a reply.
+#define LONG_KEY	"longkey%012d"	// A key of MAX_KEY_LEN - 1 characters, given its number.
+#define LOAD_FILE	"long.csv"	// The file they are loaded from, written by the test.
+
+/**
+ * @brief Set a record, or delete it if value is NULL.
+ */
+void set_value(const char *table, const char *key, const char *value)
+{
+	struct storage_record record;
+
+	memset(&record, 0, sizeof record);
+	if (value != NULL)
+		strncpy(record.value, value, sizeof record.value - 1);
+	int status = storage_set(table, key, value != NULL ? &record : NULL, test_conn);
+	fail_unless(status == 0, "storage_set of %s failed with errno %d.", key, errno);
+}
+
+/**
+ * @brief Query the table, and check that exactly the records numbered i
+ * with expected[i] set are counted, and that the keys returned (at most
+ * max_keys of them) are the first of the keys a query without a limit
+ * returns.
+ */
+void check_query(const char *predicates, const int *expected, int max_keys)
+{
+	char allBuffers[NUM_RECORDS][MAX_KEY_LEN];
+	char keyBuffers[NUM_RECORDS][MAX_KEY_LEN];
+	char *allKeys[NUM_RECORDS];
+	char *keys[NUM_RECORDS];
+	int seen[NUM_RECORDS] = { 0 };
+	int count = 0;
+	int i;
+
+	for (i = 0; i < NUM_RECORDS; i++) {
+		allKeys[i] = allBuffers[i];
+		keys[i] = keyBuffers[i];
+		count += expected[i];
+	}
+	int found = storage_query(TABLE, predicates, allKeys, NUM_RECORDS, test_conn);
+	fail_unless(found == count, "Query \"%s\" found %d keys instead of %d.", predicates, found, count);
+	for (i = 0; i < found; i++) {
+		int number = -1;
+		fail_unless(sscanf(allKeys[i], "key%d", &number) == 1 && number >= 0 && number < NUM_RECORDS,
+				"Query \"%s\" returned an unknown key %s.", predicates, allKeys[i]);
+		fail_unless(expected[number], "Query \"%s\" returned key%d, which does not match.", predicates, number);
+		fail_unless(seen[number]++ == 0, "Query \"%s\" returned key%d twice.", predicates, number);
+	}
+
+	// A limit changes the keys returned, but not the count.
+	found = storage_query(TABLE, predicates, keys, max_keys, test_conn);
+	fail_unless(found == count, "Query \"%s\" with %d keys counted %d instead of %d.", predicates, max_keys, found, count);
+	for (i = 0; i < max_keys && i < count; i++)
+		fail_unless(strcmp(keys[i], allKeys[i]) == 0, "Query \"%s\" with %d keys returned %s instead of %s.",
+				predicates, max_keys, keys[i], allKeys[i]);
+}
+
+
+
+/**
+ * @brief Text fixture setup.  Start the server and set the records of
+ * the table.
+ */
+void test_setup_populate()
+{
+	char key[MAX_KEY_LEN];
+	char value[MAX_VALUE_LEN];
+	int i;
+
+	test_conn = start_connect(TESTING_CONF, "testing.serverout", &test_server_pid);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+	for (i = 0; i < NUM_RECORDS; i++) {
+		snprintf(key, sizeof key, "key%d", i);
+		snprintf(value, sizeof value, INT_COLVAL, i, i % 4);
+		set_value(TABLE, key, value);
+	}
+}
+
+/**
+ * @brief Text fixture teardown.  Disconnect and stop the server.
+ */
+void test_teardown()
+{
+	storage_disconnect(test_conn);
+	kill_server(test_server_pid);
+}
+
+
+
+START_TEST (test_scan_parallel)
+{
+	int expected[NUM_RECORDS];
+	int i;
+
+	for (i = 0; i < NUM_RECORDS; i++)
+		expected[i] = i % 4 == 1;
+	check_query("col2 = 1", expected, MAX_KEYS);
+
+	for (i = 0; i < NUM_RECORDS; i++)
+		expected[i] = i > 100 && i % 4 != 0;
+	check_query("col1 > 100, col2 > 0", expected, MAX_KEYS);
+
+	// Fewer matches than keys asked for.
+	for (i = 0; i < NUM_RECORDS; i++)
+		expected[i] = i < 5;
+	check_query("col1 < 5", expected, MAX_KEYS);
+
+	for (i = 0; i < NUM_RECORDS; i++)
+		expected[i] = 0;
+	check_query("col1 > 1000", expected, MAX_KEYS);
+}
+END_TEST
+
+START_TEST (test_scan_one_key)
+{
+	int expected[NUM_RECORDS];
+	int i;
+
+	for (i = 0; i < NUM_RECORDS; i++)
+		expected[i] = i % 4 != 3;
+	check_query("col2 < 3, col1 > -1", expected, NUM_RECORDS);
+
+	for (i = 0; i < NUM_RECORDS; i++)
+		expected[i] = i % 4 == 3;
+	check_query("col2 = 3", expected, 1);
+}
+END_TEST
+
+START_TEST (test_scan_zone_changes)
+{
+	char key[MAX_KEY_LEN];
+	int expected[NUM_RECORDS];
+	int i;
+
+	// Every group's bounds lie within 0 and NUM_RECORDS - 1.
+	for (i = 0; i < NUM_RECORDS; i++)
+		expected[i] = 0;
+	check_query("col1 > 1000", expected, MAX_KEYS);
+
+	// An update widens the bounds of its group.
+	set_value(TABLE, "key5", "col1 5000, col2 1");
+	expected[5] = 1;
+	check_query("col1 > 1000", expected, MAX_KEYS);
+
+	// Moving it back and deleting records leaves bounds loose. The scans
+	// after each change tighten them again.
+	set_value(TABLE, "key5", "col1 5, col2 1");
+	expected[5] = 0;
+	check_query("col1 > 1000", expected, MAX_KEYS);
+	for (i = 0; i < NUM_RECORDS; i += 3) {
+		snprintf(key, sizeof key, "key%d", i);
+		set_value(TABLE, key, NULL);
+	}
+	for (i = 0; i < NUM_RECORDS; i++)
+		expected[i] = i % 3 != 0 && i < 20;
+	check_query("col1 < 20", expected, MAX_KEYS);
+	check_query("col1 < 20", expected, MAX_KEYS);
+
+	// Sets after the bounds were tightened widen them again.
+	for (i = 0; i < NUM_RECORDS; i += 3) {
+		snprintf(key, sizeof key, "key%d", i);
+		set_value(TABLE, key, "col1 -500, col2 0");
+	}
+	for (i = 0; i < NUM_RECORDS; i++)
+		expected[i] = i % 3 == 0;
+	check_query("col1 < -100", expected, MAX_KEYS);
+	for (i = 0; i < NUM_RECORDS; i++)
+		expected[i] = i == 7;
+	check_query("col1 = 7", expected, MAX_KEYS);
+}
+END_TEST
+
+START_TEST (test_scan_many_replies)
+{
+	static char keyBuffers[NUM_LOADED][MAX_KEY_LEN];
+	static char *keys[NUM_LOADED];
+	static int seen[NUM_LOADED];
+	char path[1024];
+	int i;
+
+	// Long keys, so the result takes several reply lines.
+	FILE *file = fopen(LOAD_FILE, "w");
+	fail_unless(file != NULL, "Couldn't write %s.", LOAD_FILE);
+	for (i = 0; i < NUM_LOADED; i++)
+		fprintf(file, LONG_KEY ",col1 %d, col2 9\n", i, NUM_RECORDS + i);
+	fail_unless(fclose(file) == 0, "Couldn't write %s.", LOAD_FILE);
+	fail_unless(getcwd(path, sizeof path - sizeof LOAD_FILE - 1) != NULL, "Couldn't get the directory.");
+	strcat(path, "/" LOAD_FILE);
+	int count = storage_load(TABLE, path, test_conn);
+	unlink(LOAD_FILE);
+	fail_unless(count == NUM_LOADED, "storage_load loaded %d records instead of %d.", count, NUM_LOADED);
+
+	for (i = 0; i < NUM_LOADED; i++)
+		keys[i] = keyBuffers[i];
+	int found = storage_query(TABLE, "col2 = 9", keys, NUM_LOADED, test_conn);
+	fail_unless(found == NUM_LOADED, "The query found %d keys instead of %d.", found, NUM_LOADED);
+	for (i = 0; i < found; i++) {
+		int number = -1;
+		fail_unless(sscanf(keys[i], "longkey%d", &number) == 1 && number >= 0 && number < NUM_LOADED,
+				"The query returned an unknown key %s.", keys[i]);
+		fail_unless(seen[number]++ == 0, "The query returned %s twice.", keys[i]);
+	}
+}
+END_TEST
+
+
+
+/**
+ * @brief This runs the parallel scan and zone map tests.
+ */
+int main(int argc, char *argv[])
+{
+	if(argc == 2)
+		server_port = atoi(argv[1]);
+	else
+		server_port = SERVERPORT;
+	printf("Using server port: %d.\n", server_port);
+	Suite *s = suite_create("scan");
+	TCase *tc;
+
+	tc = tcase_create("test_scan_parallel");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_populate, test_teardown);
+	tcase_add_test(tc, test_scan_parallel);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_scan_one_key");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_populate, test_teardown);
+	tcase_add_test(tc, test_scan_one_key);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_scan_zone_changes");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_populate, test_teardown);
+	tcase_add_test(tc, test_scan_zone_changes);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_scan_many_replies");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_populate, test_teardown);
+	tcase_add_test(tc, test_scan_many_replies);
+	suite_add_tcase(s, tc);
+
+	SRunner *sr = srunner_create(s);
+	srunner_set_log(sr, "results.log");
+	srunner_run_all(sr, CK_ENV);
+	srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return EXIT_SUCCESS;
+}
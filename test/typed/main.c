@@ -0,0 +1,232 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include <errno.h>
+#include "storage.h"
+#include "fixture.h"
+
+#define TESTTIMEOUT	60		// How long to wait for each test to run.
+#define INTTABLE	"table1"	// The table of int columns.
+#define CHARTABLE	"table2"	// The table of a char column and an int column.
+
+#define INT_COLVAL	"col1 %d, col2 %d"	// A record of the int table, given col1 and col2.
+#define CHAR_COLVAL	"name %s, age %d"	// A record of the char table, given name and age.
+#define NUM_RECORDS	200		// Records set in each table by the fixture.
+#define NUM_NAMES	5		// Names the char table records cycle through.
+
+static const char *names[NUM_NAMES] = { "alice", "bob", "carol", "dave", "bo" };
+
+/**
+ * @brief Set a record, and check that it was set.
+ */
+void set_value(const char *table, const char *key, const char *value)
+{
+	struct storage_record record;
+
+	memset(&record, 0, sizeof record);
+	strncpy(record.value, value, sizeof record.value - 1);
+	int status = storage_set(table, key, &record, test_conn);
+	fail_unless(status == 0, "storage_set of %s failed with errno %d.", key, errno);
+}
+
+/**
+ * @brief Query a table, and check that exactly the records numbered i
+ * with expected[i] set are returned.
+ */
+void check_query(const char *table, const char *predicates, const int *expected)
+{
+	char keyBuffers[NUM_RECORDS][MAX_KEY_LEN];
+	char *keys[NUM_RECORDS];
+	int seen[NUM_RECORDS] = { 0 };
+	int count = 0;
+	int i;
+
+	for (i = 0; i < NUM_RECORDS; i++) {
+		keys[i] = keyBuffers[i];
+		count += expected[i];
+	}
+	int found = storage_query(table, predicates, keys, NUM_RECORDS, test_conn);
+	fail_unless(found == count, "Query \"%s\" found %d keys instead of %d.", predicates, found, count);
+	for (i = 0; i < found; i++) {
+		int number = -1;
+		fail_unless(sscanf(keys[i], "key%d", &number) == 1 && number >= 0 && number < NUM_RECORDS,
+				"Query \"%s\" returned an unknown key %s.", predicates, keys[i]);
+		fail_unless(expected[number], "Query \"%s\" returned key%d, which does not match.", predicates, number);
+		fail_unless(seen[number]++ == 0, "Query \"%s\" returned key%d twice.", predicates, number);
+	}
+}
+
+
+
+/**
+ * @brief Text fixture setup.  Start the server and set the records of
+ * both tables.
+ */
+void test_setup_populate()
+{
+	char key[MAX_KEY_LEN];
+	char value[MAX_VALUE_LEN];
+	int i;
+
+	test_conn = start_connect(TESTING_CONF, "testing.serverout", &test_server_pid);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+	for (i = 0; i < NUM_RECORDS; i++) {
+		snprintf(key, sizeof key, "key%d", i);
+		snprintf(value, sizeof value, INT_COLVAL, i - NUM_RECORDS / 2, i % 7);
+		set_value(INTTABLE, key, value);
+		snprintf(value, sizeof value, CHAR_COLVAL, names[i % NUM_NAMES], i);
+		set_value(CHARTABLE, key, value);
+	}
+}
+
+/**
+ * @brief Text fixture teardown.  Disconnect and stop the server.
+ */
+void test_teardown()
+{
+	storage_disconnect(test_conn);
+	kill_server(test_server_pid);
+}
+
+
+
+START_TEST (test_typed_get_raw)
+{
+	struct storage_record record;
+
+	// The value comes back as the string it was set to, not as the row.
+	set_value(INTTABLE, "raw", "col1 -42, col2 7");
+	int status = storage_get(INTTABLE, "raw", &record, test_conn);
+	fail_unless(status == 0, "storage_get failed with errno %d.", errno);
+	fail_unless(strcmp(record.value, "col1 -42, col2 7") == 0, "storage_get returned \"%s\".", record.value);
+
+	set_value(CHARTABLE, "raw", "name eve, age 3");
+	status = storage_get(CHARTABLE, "raw", &record, test_conn);
+	fail_unless(status == 0, "storage_get failed with errno %d.", errno);
+	fail_unless(strcmp(record.value, "name eve, age 3") == 0, "storage_get returned \"%s\".", record.value);
+}
+END_TEST
+
+START_TEST (test_typed_query_int)
+{
+	int expected[NUM_RECORDS];
+	int i;
+
+	for (i = 0; i < NUM_RECORDS; i++)
+		expected[i] = i - NUM_RECORDS / 2 > 50;
+	check_query(INTTABLE, "col1 > 50", expected);
+
+	for (i = 0; i < NUM_RECORDS; i++)
+		expected[i] = i - NUM_RECORDS / 2 < -90 && i % 7 == 3;
+	check_query(INTTABLE, "col1 < -90, col2 = 3", expected);
+
+	for (i = 0; i < NUM_RECORDS; i++)
+		expected[i] = i - NUM_RECORDS / 2 == 0;
+	check_query(INTTABLE, "col1 = 0", expected);
+
+	// An update moves a record out of the matches.
+	set_value(INTTABLE, "key199", "col1 -1, col2 6");
+	for (i = 0; i < NUM_RECORDS; i++)
+		expected[i] = i != 199 && i - NUM_RECORDS / 2 > 50;
+	check_query(INTTABLE, "col1 > 50", expected);
+}
+END_TEST
+
+START_TEST (test_typed_query_char)
+{
+	int expected[NUM_RECORDS];
+	int i;
+
+	// "bo" is a prefix of "bob", but only equal names match.
+	for (i = 0; i < NUM_RECORDS; i++)
+		expected[i] = i % NUM_NAMES == 1;
+	check_query(CHARTABLE, "name = bob", expected);
+
+	for (i = 0; i < NUM_RECORDS; i++)
+		expected[i] = i % NUM_NAMES == 4;
+	check_query(CHARTABLE, "name = bo", expected);
+
+	for (i = 0; i < NUM_RECORDS; i++)
+		expected[i] = i % NUM_NAMES == 1 && i > 150;
+	check_query(CHARTABLE, "name = bob, age > 150", expected);
+}
+END_TEST
+
+START_TEST (test_typed_invalid)
+{
+	struct storage_record record;
+	int i;
+
+	const char *invalid[] = {
+		"col9 1, col2 2",	// a column the table does not have
+		"col2 2, col1 1",	// columns out of order
+		"col1 x, col2 2",	// not a number
+		"col1 1",		// a column missing
+	};
+	for (i = 0; i < sizeof invalid / sizeof invalid[0]; i++) {
+		memset(&record, 0, sizeof record);
+		strcpy(record.value, invalid[i]);
+		int status = storage_set(INTTABLE, "invalid", &record, test_conn);
+		fail_unless(status == -1 && errno == ERR_INVALID_PARAM, "storage_set of \"%s\" should fail.", invalid[i]);
+	}
+
+	// A string longer than its char[10] column.
+	memset(&record, 0, sizeof record);
+	strcpy(record.value, "name abcdefghijk, age 1");
+	int status = storage_set(CHARTABLE, "invalid", &record, test_conn);
+	fail_unless(status == -1 && errno == ERR_INVALID_PARAM, "storage_set of a string too long should fail.");
+
+	status = storage_get(INTTABLE, "invalid", &record, test_conn);
+	fail_unless(status == -1 && errno == ERR_KEY_NOT_FOUND, "An invalid record was stored.");
+}
+END_TEST
+
+
+
+/**
+ * @brief This runs the typed row tests.
+ */
+int main(int argc, char *argv[])
+{
+	if(argc == 2)
+		server_port = atoi(argv[1]);
+	else
+		server_port = SERVERPORT;
+	printf("Using server port: %d.\n", server_port);
+	Suite *s = suite_create("typed");
+	TCase *tc;
+
+	tc = tcase_create("test_typed_get_raw");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_populate, test_teardown);
+	tcase_add_test(tc, test_typed_get_raw);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_typed_query_int");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_populate, test_teardown);
+	tcase_add_test(tc, test_typed_query_int);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_typed_query_char");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_populate, test_teardown);
+	tcase_add_test(tc, test_typed_query_char);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("test_typed_invalid");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_populate, test_teardown);
+	tcase_add_test(tc, test_typed_invalid);
+	suite_add_tcase(s, tc);
+
+	SRunner *sr = srunner_create(s);
+	srunner_set_log(sr, "results.log");
+	srunner_run_all(sr, CK_ENV);
+	srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return EXIT_SUCCESS;
+}